@@ -0,0 +1,511 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AsyncIo.cpp
+ * @brief	位置指定の非同期一括入出力の実装
+ */
+// ----------------------------------------------------------------------------
+#include "AsyncIo.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+
+#if !(defined(_WIN32) && defined(_MSC_VER))
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && !defined(WAVE11_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define WAVE11_HAVE_IO_URING
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	要求を同期的に処理する
+ * @param[in]	r	要求
+ * @return	読み書きしたバイト数。エラー時は負のエラー番号。
+ */
+// ----------------------------------------------------------------------------
+int64_t syncIo(const AsyncIoRequest& r)
+{
+	size_t done = 0;
+#if defined(_WIN32) && defined(_MSC_VER)
+	HANDLE h = reinterpret_cast<HANDLE>(r.handle);
+	while (done < r.size) {
+		OVERLAPPED ov = {};
+		uint64_t pos = r.offset + done;
+		ov.Offset = static_cast<DWORD>(pos);
+		ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+		DWORD n = 0;
+		DWORD want = (r.size - done > 0x40000000) ? 0x40000000 : static_cast<DWORD>(r.size - done);
+		BOOL ok = r.write
+			? ::WriteFile(h, static_cast<const BYTE*>(r.buf) + done, want, &n, &ov)
+			: ::ReadFile(h, static_cast<BYTE*>(r.buf) + done, want, &n, &ov);
+		if (!ok) {
+			DWORD err = ::GetLastError();
+			if (err == ERROR_HANDLE_EOF) break;
+			return -static_cast<int64_t>(err);
+		}
+		if (n == 0) break;
+		done += n;
+	}
+#else
+	const int fd = static_cast<int>(r.handle);
+	while (done < r.size) {
+		ssize_t n = r.write
+			? ::pwrite(fd, static_cast<const BYTE*>(r.buf) + done, r.size - done, static_cast<off_t>(r.offset + done))
+			: ::pread(fd, static_cast<BYTE*>(r.buf) + done, r.size - done, static_cast<off_t>(r.offset + done));
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -static_cast<int64_t>(errno);
+		}
+		if (n == 0) break;
+		done += static_cast<size_t>(n);
+	}
+#endif
+	return static_cast<int64_t>(done);
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief スレッドプール上で同期入出力を行う実装
+ */
+// ----------------------------------------------------------------------------
+class ThreadPoolIo : public AsyncIo
+{
+public:
+	ThreadPoolIo(size_t depth, ThreadPool* pool) : depth_(depth), pool_(pool), inflight_(0) {
+		if (pool_ == nullptr) {
+			own_.reset(new ThreadPool());
+			pool_ = own_.get();
+		}
+	}
+	/** 発行済みの要求が全て完了するまで待つ */
+	~ThreadPoolIo() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		cond_.wait(lock, [this]() { return inflight_ == done_.size(); });
+	}
+
+	bool push(const AsyncIoRequest& req) {
+		if (pending() >= depth_) return false;
+		queued_.push_back(req);
+		return true;
+	}
+	size_t submit() {
+		const size_t n = queued_.size();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			inflight_ += n;
+		}
+		for (size_t i = 0; i < n; i++) {
+			AsyncIoRequest r = queued_[i];
+			pool_->submit([this, r]() {
+				AsyncIoCompletion c = { r.tag, syncIo(r) };
+				std::lock_guard<std::mutex> lock(mutex_);
+				done_.push_back(c);
+				cond_.notify_all();
+			});
+		}
+		queued_.clear();
+		return n;
+	}
+	size_t wait(AsyncIoCompletion* out, size_t max, size_t min) {
+		submit();
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (min > inflight_) min = inflight_;
+		if (min > max) min = max;
+		cond_.wait(lock, [this, min]() { return done_.size() >= min; });
+		size_t n = 0;
+		while (n < max && !done_.empty()) {
+			out[n++] = done_.front();
+			done_.pop_front();
+		}
+		inflight_ -= n;
+		return n;
+	}
+	size_t pending() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return queued_.size() + inflight_;
+	}
+	size_t depth() const { return depth_; }
+	const char* name() const { return "threadpool"; }
+
+private:
+	//! 同時要求数
+	const size_t depth_;
+	//! 入出力を行うスレッドプール
+	ThreadPool* pool_;
+	//! 内部で生成したスレッドプール
+	std::unique_ptr<ThreadPool> own_;
+	//! 未発行の要求
+	std::vector<AsyncIoRequest> queued_;
+	//! 未回収の完了通知
+	std::deque<AsyncIoCompletion> done_;
+	//! 発行済みで回収していない要求数
+	size_t inflight_;
+	//! 完了通知の排他
+	mutable std::mutex mutex_;
+	//! 完了の通知
+	std::condition_variable cond_;
+};
+
+#ifdef WAVE11_HAVE_IO_URING
+// ----------------------------------------------------------------------------
+/**
+ * @brief io_uringによる実装
+ *
+ * liburingには依存せず、システムコールでリングを直接操作する。
+ * 読み書きはIORING_OP_READV/WRITEVで発行する。途中までで返った読み書きは
+ * 続きを発行し、スレッドプール実装と同じく要求したバイト数か終端まで読み書きする。
+ * 発行に失敗した要求は投入キューから取り消し、負のエラー番号で完了させる。
+ */
+// ----------------------------------------------------------------------------
+class IoUringIo : public AsyncIo
+{
+public:
+	IoUringIo() : fd_(-1), sqRing_(MAP_FAILED), cqRing_(MAP_FAILED), sqes_(nullptr),
+		sqRingSize_(0), cqRingSize_(0), sqesSize_(0), tail_(0), kernel_(0), inflight_(0), depth_(0) {}
+	~IoUringIo() {
+		// カーネルに渡した要求はバッファを参照しているため、完了を待つ
+		while (fd_ >= 0 && kernel_ > 0) {
+			if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				break;
+			}
+			collect();
+		}
+		if (sqes_ != nullptr) ::munmap(sqes_, sqesSize_);
+		if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+		if (sqRing_ != MAP_FAILED) ::munmap(sqRing_, sqRingSize_);
+		if (fd_ >= 0) ::close(fd_);
+	}
+
+	//! リングを初期化します。
+	bool init(size_t depth) {
+		io_uring_params p;
+		::memset(&p, 0, sizeof(p));
+		fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned>(depth), &p));
+		if (fd_ < 0) {
+			return false;
+		}
+		sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single && cqRingSize_ > sqRingSize_) sqRingSize_ = cqRingSize_;
+
+		sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			fd_, IORING_OFF_SQ_RING);
+		if (sqRing_ == MAP_FAILED) return false;
+		if (single) {
+			cqRing_ = sqRing_;
+		} else {
+			cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				fd_, IORING_OFF_CQ_RING);
+			if (cqRing_ == MAP_FAILED) return false;
+		}
+		sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			fd_, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) return false;
+		sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+		BYTE* sq = static_cast<BYTE*>(sqRing_);
+		sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+		sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+		sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+		sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+		BYTE* cq = static_cast<BYTE*>(cqRing_);
+		cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+		cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+		cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+		cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+		tail_ = *sqTail_;
+
+		depth_ = (p.sq_entries < depth) ? p.sq_entries : depth;
+		slots_.resize(depth_);
+		freeSlots_.reserve(depth_);
+		for (size_t i = depth_; i > 0; i--) {
+			freeSlots_.push_back(i - 1);
+		}
+		return true;
+	}
+
+	bool push(const AsyncIoRequest& req) {
+		if (inflight_ >= depth_ || freeSlots_.empty()) return false;
+		const size_t slot = freeSlots_.back();
+		freeSlots_.pop_back();
+		Slot& s = slots_[slot];
+		s.fd = static_cast<int>(req.handle);
+		s.buf = static_cast<BYTE*>(req.buf);
+		s.size = req.size;
+		s.offset = req.offset;
+		s.done = 0;
+		s.write = req.write;
+		s.tag = req.tag;
+		queue(slot);
+		inflight_++;
+		return true;
+	}
+	size_t submit() {
+		size_t submitted = 0;
+		size_t rest;
+		while ((rest = queued()) > 0) {
+			__atomic_store_n(sqTail_, tail_, __ATOMIC_RELEASE);
+			const int ret = enter(static_cast<unsigned>(rest), 0, 0);
+			const size_t consumed = rest - queued();
+			kernel_ += consumed;
+			submitted += consumed;
+			if (ret < 0 && errno == EINTR) continue;
+			if (ret > 0 || consumed > 0) continue;
+			if (ret == 0 || errno == EAGAIN || errno == EBUSY) {
+				// 完了キューの空きかカーネルの資源を待つ。完了を回収してから再試行する
+				if (collect() > 0) continue;
+				if (kernel_ > 0) {
+					if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+						failQueued(errno);
+						break;
+					}
+					collect();
+					continue;
+				}
+				failQueued((ret == 0) ? EIO : errno);
+				break;
+			}
+			failQueued(errno);
+			break;
+		}
+		return submitted;
+	}
+	size_t wait(AsyncIoCompletion* out, size_t max, size_t min) {
+		submit();
+		if (min > inflight_) min = inflight_;
+		if (min > max) min = max;
+		collect();
+		size_t n = deliver(out, max);
+		while (n < min) {
+			submit();
+			if (ready_.empty() && kernel_ > 0) {
+				const size_t want = (min - n < kernel_) ? min - n : kernel_;
+				int ret = enter(0, static_cast<unsigned>(want), IORING_ENTER_GETEVENTS);
+				if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+					break;
+				}
+			} else if (ready_.empty() && queued() == 0) {
+				break;
+			}
+			collect();
+			n += deliver(out + n, max - n);
+		}
+		return n;
+	}
+	size_t pending() const { return inflight_; }
+	size_t depth() const { return depth_; }
+	const char* name() const { return "io_uring"; }
+
+private:
+	/**
+	 * @brief 発行中の要求の保持領域
+	 */
+	struct Slot {
+		//! 読み書きの範囲（続きの発行ごとに更新する）
+		iovec iov;
+		//! ファイル記述子
+		int fd;
+		//! 読み込み先または書き出し元のバッファ
+		BYTE* buf;
+		//! 要求のバイトサイズ
+		size_t size;
+		//! 要求のバイトオフセット
+		uint64_t offset;
+		//! 読み書き済みのバイト数
+		size_t done;
+		//! 書き出しなら真
+		bool write;
+		//! 利用者の識別値
+		uint64_t tag;
+	};
+
+	//! リングのファイル記述子
+	int fd_;
+	//! 投入キューのリング
+	void* sqRing_;
+	//! 完了キューのリング
+	void* cqRing_;
+	//! 投入キューのエントリ
+	io_uring_sqe* sqes_;
+	size_t sqRingSize_;
+	size_t cqRingSize_;
+	size_t sqesSize_;
+	unsigned* sqHead_;
+	unsigned* sqTail_;
+	unsigned sqMask_;
+	unsigned* sqArray_;
+	unsigned* cqHead_;
+	unsigned* cqTail_;
+	unsigned cqMask_;
+	io_uring_cqe* cqes_;
+	//! 書き込み済みの投入キューの末尾（カーネルへの公開はsubmitで行う）
+	unsigned tail_;
+	//! カーネルが受け取り、完了を回収していない要求数
+	size_t kernel_;
+	//! push済みで利用者に完了を返していない要求数
+	size_t inflight_;
+	//! 同時要求数
+	size_t depth_;
+	//! 発行中の要求の保持領域
+	std::vector<Slot> slots_;
+	//! 空きの保持領域
+	std::vector<size_t> freeSlots_;
+	//! 回収済みで利用者に返していない完了通知
+	std::deque<AsyncIoCompletion> ready_;
+
+	//! カーネルが受け取っていない投入キューのエントリ数
+	size_t queued() const {
+		return tail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+	}
+	//! 保持領域の未処理の範囲を投入キューに書き込みます。
+	void queue(size_t slot) {
+		Slot& s = slots_[slot];
+		s.iov.iov_base = s.buf + s.done;
+		s.iov.iov_len = s.size - s.done;
+		const unsigned index = tail_ & sqMask_;
+		io_uring_sqe* sqe = &sqes_[index];
+		::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = s.write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd = s.fd;
+		sqe->addr = reinterpret_cast<uint64_t>(&s.iov);
+		sqe->len = 1;
+		sqe->off = s.offset + s.done;
+		sqe->user_data = slot;
+		sqArray_[index] = index;
+		tail_++;
+	}
+	//! カーネルが受け取っていない要求を取り消し、エラーとして完了させます。
+	void failQueued(int err) {
+		const unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+		for (unsigned i = head; i != tail_; i++) {
+			const size_t slot = static_cast<size_t>(sqes_[i & sqMask_].user_data);
+			AsyncIoCompletion c = { slots_[slot].tag, -static_cast<int64_t>(err) };
+			ready_.push_back(c);
+			freeSlots_.push_back(slot);
+		}
+		tail_ = head;
+		__atomic_store_n(sqTail_, tail_, __ATOMIC_RELEASE);
+	}
+	//! io_uring_enterを呼び出します。
+	int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+		return static_cast<int>(::syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags, nullptr, 0));
+	}
+	//! 完了キューを全て回収します。途中までの読み書きは続きを投入キューに書き込みます。
+	size_t collect() {
+		unsigned head = *cqHead_;
+		const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+		size_t n = 0;
+		while (head != tail) {
+			const io_uring_cqe& cqe = cqes_[head & cqMask_];
+			const size_t slot = static_cast<size_t>(cqe.user_data);
+			Slot& s = slots_[slot];
+			head++;
+			n++;
+			kernel_--;
+			if (cqe.res == -EINTR || cqe.res == -EAGAIN
+				|| (cqe.res > 0 && s.done + static_cast<size_t>(cqe.res) < s.size)) {
+				// スレッドプール実装と同じく、要求したバイト数に達するか終端まで続ける
+				if (cqe.res > 0) {
+					s.done += static_cast<size_t>(cqe.res);
+				}
+				queue(slot);
+				continue;
+			}
+			AsyncIoCompletion c = { s.tag, (cqe.res < 0) ? cqe.res : static_cast<int64_t>(s.done + cqe.res) };
+			ready_.push_back(c);
+			freeSlots_.push_back(slot);
+		}
+		__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+		return n;
+	}
+	//! 回収済みの完了を利用者に返します。
+	size_t deliver(AsyncIoCompletion* out, size_t max) {
+		size_t n = 0;
+		while (n < max && !ready_.empty()) {
+			out[n++] = ready_.front();
+			ready_.pop_front();
+		}
+		inflight_ -= n;
+		return n;
+	}
+};
+#endif
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// 利用可能な最速の実装を生成します。
+/**
+ * io_uringが使えればio_uring実装を、使えなければスレッドプール実装を生成します。
+ *
+ * @param[in]	depth	同時要求数
+ * @param[in]	pool	スレッドプール実装で使うスレッドプール。nullptrなら内部で生成する。
+ * @return	生成した実装
+ */
+// ----------------------------------------------------------------------------
+std::unique_ptr<AsyncIo> AsyncIo::create(size_t depth, ThreadPool* pool)
+{
+	if (depth == 0) {
+		depth = DefaultDepth;
+	}
+#ifdef WAVE11_HAVE_IO_URING
+	std::unique_ptr<IoUringIo> ring(new IoUringIo());
+	if (ring->init(depth)) {
+		return std::unique_ptr<AsyncIo>(ring.release());
+	}
+#endif
+	return createThreadPool(depth, pool);
+}
+// ----------------------------------------------------------------------------
+// スレッドプール実装を生成します。
+/**
+ * @param[in]	depth	同時要求数
+ * @param[in]	pool	入出力を行うスレッドプール。nullptrなら内部で生成する。
+ * @return	生成した実装
+ */
+// ----------------------------------------------------------------------------
+std::unique_ptr<AsyncIo> AsyncIo::createThreadPool(size_t depth, ThreadPool* pool)
+{
+	if (depth == 0) {
+		depth = DefaultDepth;
+	}
+	return std::unique_ptr<AsyncIo>(new ThreadPoolIo(depth, pool));
+}
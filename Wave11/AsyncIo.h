@@ -0,0 +1,134 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AsyncIo.h
+ * @brief	位置指定の非同期一括入出力のヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _ASYNCIO_H_
+#define _ASYNCIO_H_
+
+#include <cstdint>
+#include <memory>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 非同期入出力の要求
+ */
+// ----------------------------------------------------------------------------
+struct AsyncIoRequest {
+	//! POSIXではファイル記述子、WindowsではHANDLE
+	intptr_t handle;
+	//! 読み込み先または書き出し元のバッファ。完了まで保持すること。
+	void* buf;
+	//! バイトサイズ
+	size_t size;
+	//! ファイル先頭からのバイトオフセット
+	uint64_t offset;
+	//! 書き出しなら真
+	bool write;
+	//! 完了通知で返される利用者の識別値
+	uint64_t tag;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 非同期入出力の完了通知
+ */
+// ----------------------------------------------------------------------------
+struct AsyncIoCompletion {
+	//! 要求に指定した識別値
+	uint64_t tag;
+	//! 読み書きしたバイト数。エラー時は負のエラー番号。
+	int64_t result;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 位置指定の非同期一括入出力のIF
+ *
+ * pushで要求を溜め、submitでまとめて発行し、waitで完了を回収する。
+ * Linuxではio_uringを使い、多数のファイルへの要求を一つのリングで
+ * 一度のシステムコールにまとめて発行する。io_uringが使えない環境では
+ * スレッドプール上で同期入出力を行う実装に切り替わる。
+ *
+ * 一つのインスタンスを複数スレッドから同時に使ってはならない。
+ */
+// ----------------------------------------------------------------------------
+class AsyncIo : private Noncopyable
+{
+public:
+	//! 既定の同時要求数
+	static const size_t DefaultDepth = 256;
+
+	virtual ~AsyncIo() {}
+
+	/**
+	 * @brief	要求を溜める
+	 * @param[in]	req	要求
+	 * @return	受け付けたら真。未回収の要求が同時要求数に達していれば偽。
+	 */
+	virtual bool push(const AsyncIoRequest& req) = 0;
+	/**
+	 * @brief	溜めた要求をまとめて発行する
+	 * @return	発行した要求数
+	 */
+	virtual size_t submit() = 0;
+	/**
+	 * @brief	完了を回収する
+	 *
+	 * 未発行の要求があれば先に発行する。
+	 * @param[out]	out		完了通知を格納する配列
+	 * @param[in]	max		outに格納できる最大数
+	 * @param[in]	min		最低限待つ完了数。未回収の要求数を上限とする。
+	 * @return	回収した完了数
+	 */
+	virtual size_t wait(AsyncIoCompletion* out, size_t max, size_t min) = 0;
+	/**
+	 * @brief	未回収の要求数を取得する
+	 * @return	push済みで完了を回収していない要求数
+	 */
+	virtual size_t pending() const = 0;
+	/**
+	 * @brief	同時要求数を取得する
+	 * @return	未回収のまま保持できる最大要求数
+	 */
+	virtual size_t depth() const = 0;
+	/**
+	 * @brief	実装名を取得する
+	 * @return	"io_uring"または"threadpool"
+	 */
+	virtual const char* name() const = 0;
+
+	//! 利用可能な最速の実装を生成します。
+	static std::unique_ptr<AsyncIo> create(size_t = DefaultDepth, ThreadPool* = nullptr);
+	//! スレッドプール実装を生成します。
+	static std::unique_ptr<AsyncIo> createThreadPool(size_t = DefaultDepth, ThreadPool* = nullptr);
+};
+
+#endif // !_ASYNCIO_H_
@@ -0,0 +1,169 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AsyncWavBatch.cpp
+ * @brief	複数WAVファイルの一括非同期読み込みクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "AsyncWavBatch.h"
+#include "BufferPool.h"
+#include "RiffWavParser.h"
+
+// ----------------------------------------------------------------------------
+// 複数ファイルのヘッダーを一括して解析します。
+/**
+ * ファイルサイズはfstatで求め、各ファイル先頭のRiffWavParser::DefaultWindowバイトを
+ * まとめて発行し、完了したものから解析を進めます。続きが必要なファイルは次の位置を再発行します。
+ * 解析に成功したファイルはRiffWavReader::prepare(const RiffWavInfo&)で
+ * 読み込みの準備まで行います。
+ *
+ * @param[in]	readers	open済みの読み込み元
+ * @param[out]	ok		ファイルごとの成否
+ * @return	解析に成功したファイル数
+ */
+// ----------------------------------------------------------------------------
+size_t AsyncWavBatch::prepareAll(const std::vector<RiffWavReader*>& readers, std::vector<bool>& ok)
+{
+	const size_t count = readers.size();
+	const size_t window = RiffWavParser::DefaultWindow;
+	ok.assign(count, false);
+	if (count == 0) {
+		return 0;
+	}
+
+	std::vector<RiffWavParser> parsers(count);
+	std::vector<uint64_t> fileEnd(count, 0);
+	std::vector<uint64_t> base(count, 0);
+	PooledBuffer windows(count * window);
+	BYTE* buf = windows.as<BYTE>();
+
+	// 投入待ちのファイル
+	std::vector<size_t> todo;
+	todo.reserve(count);
+	for (size_t i = count; i > 0; i--) {
+		RiffWavReader* r = readers[i - 1];
+		// fstatで求め、読み込み位置を動かすシステムコールを発行しない
+		const int64_t end = (r == nullptr) ? -1 : r->size();
+		if (end < 0) {
+			continue;
+		}
+		fileEnd[i - 1] = static_cast<uint64_t>(end);
+		parsers[i - 1].reset(fileEnd[i - 1]);
+		todo.push_back(i - 1);
+	}
+
+	size_t succeeded = 0;
+	std::vector<AsyncIoCompletion> done(io_.depth());
+	while (!todo.empty() || io_.pending() > 0) {
+		while (!todo.empty()) {
+			const size_t i = todo.back();
+			AsyncIoRequest req = { readers[i]->nativeHandle(), buf + i * window, window, base[i], false, i };
+			if (!io_.push(req)) {
+				break;
+			}
+			todo.pop_back();
+		}
+		const size_t n = io_.wait(&done[0], done.size(), 1);
+		if (n == 0 && todo.empty()) {
+			break;
+		}
+		for (size_t k = 0; k < n; k++) {
+			const size_t i = static_cast<size_t>(done[k].tag);
+			if (done[k].result < 0) {
+				continue;
+			}
+			RiffWavParser& parser = parsers[i];
+			RiffWavParser::Status status = parser.feed(buf + i * window, static_cast<size_t>(done[k].result), base[i]);
+			if (status == RiffWavParser::PARSE_DONE) {
+				ok[i] = readers[i]->prepare(parser.info());
+				if (ok[i]) succeeded++;
+			} else if (status == RiffWavParser::PARSE_NEED_MORE) {
+				// 続きが読めない場合は途中で切れたファイル
+				if (parser.nextOffset() > base[i] && parser.nextOffset() < fileEnd[i]) {
+					base[i] = parser.nextOffset();
+					todo.push_back(i);
+				}
+			}
+		}
+	}
+	return succeeded;
+}
+// ----------------------------------------------------------------------------
+// 複数のデータブロックを一括して読み込みます。
+/**
+ * 各ブロックのファイル位置をストリーム先頭とブロックアラインから求め、
+ * まとめて発行します。ストリーム終端を越える分は切り詰めます。
+ * 結果は各ブロックのresultに読み込んだフレーム数として格納します。
+ * RIFX・AIFFのサンプルはRiffWavReader::getStreamと同じくdecodeSamplesで変換します。
+ *
+ * @param[in,out]	blocks	読み込むブロック
+ * @return	エラーにならなかったブロック数
+ */
+// ----------------------------------------------------------------------------
+size_t AsyncWavBatch::readBlocks(std::vector<AsyncWavBlock>& blocks)
+{
+	const size_t count = blocks.size();
+	size_t next = 0;
+	size_t succeeded = 0;
+	std::vector<AsyncIoCompletion> done(io_.depth());
+	while (next < count || io_.pending() > 0) {
+		while (next < count) {
+			AsyncWavBlock& b = blocks[next];
+			const uint64_t align = b.reader->getBlockAlign();
+			const uint64_t length = b.reader->getLength();
+			uint64_t begin = b.frame * align;
+			uint64_t size = static_cast<uint64_t>(b.frames) * align;
+			if (begin > length) begin = length;
+			if (size > length - begin) size = length - begin;
+			if (align == 0 || size == 0) {
+				b.result = (align == 0) ? -1 : 0;
+				if (align != 0) succeeded++;
+				next++;
+				continue;
+			}
+			AsyncIoRequest req = { b.reader->nativeHandle(), b.buf, static_cast<size_t>(size),
+				static_cast<uint64_t>(b.reader->getStreamOffset()) + begin, false, next };
+			if (!io_.push(req)) {
+				break;
+			}
+			next++;
+		}
+		if (io_.pending() == 0) {
+			continue;
+		}
+		const size_t n = io_.wait(&done[0], done.size(), 1);
+		for (size_t k = 0; k < n; k++) {
+			AsyncWavBlock& b = blocks[static_cast<size_t>(done[k].tag)];
+			if (done[k].result < 0) {
+				b.result = done[k].result;
+			} else {
+				b.result = done[k].result / b.reader->getBlockAlign();
+				b.reader->decodeSamples(b.buf, static_cast<size_t>(done[k].result) / (b.reader->getBitPerSample() / 8));
+				succeeded++;
+			}
+		}
+	}
+	return succeeded;
+}
@@ -0,0 +1,89 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AsyncWavBatch.h
+ * @brief	複数WAVファイルの一括非同期読み込みクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _ASYNCWAVBATCH_H_
+#define _ASYNCWAVBATCH_H_
+
+#include <vector>
+#include "AsyncIo.h"
+#include "RiffWavReader.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 一括読み込みするデータブロック
+ */
+// ----------------------------------------------------------------------------
+struct AsyncWavBlock {
+	//! prepare済みの読み込み元
+	RiffWavReader* reader;
+	//! ストリーム先頭からのフレーム位置
+	uint64_t frame;
+	//! 読み込むフレーム数
+	size_t frames;
+	//! 読み込み先。frames * ブロックアラインのバイト数が必要。
+	void* buf;
+	//! 読み込んだフレーム数。エラー時は負。
+	int64_t result;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 複数WAVファイルの一括非同期読み込みクラス
+ *
+ * 多数のファイルのヘッダー解析やデータブロック読み込みを
+ * AsyncIoにまとめて発行し、ファイルごとの往復待ちを重ねて隠蔽する。
+ * 読み込み位置は要求ごとに指定するため、各RiffWavReaderの
+ * ストリーム読み込み位置は変化しない。
+ *
+ * 効果があるのはストレージやネットワークの往復待ちがある場合で、ページキャッシュにない
+ * 小さなファイルではRiffWavReaderで1ファイルずつ読むより数倍速い。全てページキャッシュに
+ * あるファイルでは隠す待ちがなく、ファイルごとのシステムコールが多い分だけ
+ * 1ファイルずつ読むより遅くなる（make benchのsmall files段で比べられる）。
+ */
+// ----------------------------------------------------------------------------
+class AsyncWavBatch : private Noncopyable
+{
+public:
+	/**
+	 * @brief	コンストラクタ
+	 * @param[in]	io	要求を発行する非同期入出力
+	 */
+	explicit AsyncWavBatch(AsyncIo& io) : io_(io) {}
+
+	//! 複数ファイルのヘッダーを一括して解析します。
+	size_t prepareAll(const std::vector<RiffWavReader*>&, std::vector<bool>&);
+	//! 複数のデータブロックを一括して読み込みます。
+	size_t readBlocks(std::vector<AsyncWavBlock>&);
+
+private:
+	//! 要求を発行する非同期入出力
+	AsyncIo& io_;
+};
+
+#endif // !_ASYNCWAVBATCH_H_
@@ -0,0 +1,188 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AudioRingAdapter.cpp
+ * @brief	オーディオリングバッファと入出力クラスの接続の実装
+ */
+// ----------------------------------------------------------------------------
+#include "AudioRingAdapter.h"
+#include <cstring>
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	生成したサンプルを全チャンネルに書き込む
+ * @param[out]	dst			書き込み先
+ * @param[in]	frames		フレーム数
+ * @param[in]	channels	チャンネル数
+ * @param[in]	gen			波形生成器
+ * @param[in]	wave		波形生成メソッド
+ * @param[in]	gain		振幅
+ */
+// ----------------------------------------------------------------------------
+void generate(float* dst, size_t frames, size_t channels, WaveGenerator& gen, AudioRingAdapter::Wave wave, float gain)
+{
+	for (size_t i = 0; i < frames; i++) {
+		const float v = (gen.*wave)() * gain;
+		for (size_t ch = 0; ch < channels; ch++) {
+			*dst++ = v;
+		}
+	}
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// 読み込み元からリングバッファへ転送します。
+/**
+ * リングバッファのフレームサイズは読み込み元のブロックアラインと一致していること。
+ *
+ * @param[in,out]	ring	転送先
+ * @param[in,out]	reader	prepare済みの読み込み元
+ * @param[in]		frames	転送する最大フレーム数
+ * @return	転送したフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingAdapter::fromReader(AudioRingBuffer& ring, RiffWavReader& reader, size_t frames)
+{
+	if (ring.frameBytes() != reader.getBlockAlign()) {
+		return 0;
+	}
+	const size_t space = ring.writable();
+	if (frames > space) {
+		frames = space;
+	}
+	// RING_MPSCで予約した領域は取り消せないため、残りのフレーム数を超えて予約しない
+	const uint64_t remain = reader.getFrames() - reader.tellFrame();
+	if (frames > remain) {
+		frames = static_cast<size_t>(remain);
+	}
+	if (frames == 0) {
+		return 0;
+	}
+
+	AudioRingRegion r;
+	if (ring.mode() == AudioRingBuffer::RING_SPSC) {
+		ring.beginWrite(frames, r);
+	} else {
+		ring.reserveWrite(frames, r);
+	}
+	size_t total = 0;
+	size_t got = 0;
+	if (reader.getSamples(r.data1, r.frames1, got) >= 0) {
+		total = got;
+		if (got == r.frames1 && r.frames2 > 0 && reader.getSamples(r.data2, r.frames2, got) >= 0) {
+			total += got;
+		}
+	}
+	if (ring.mode() == AudioRingBuffer::RING_SPSC) {
+		ring.commitWrite(total);
+		return total;
+	}
+
+	// 読み込みエラーで埋まらなかった予約分は無音として公開する
+	const size_t fb = ring.frameBytes();
+	if (total < r.frames1) {
+		::memset(static_cast<BYTE*>(r.data1) + total * fb, 0, (r.frames1 - total) * fb);
+		::memset(r.data2, 0, r.frames2 * fb);
+	} else if (total < r.frames()) {
+		const size_t done = total - r.frames1;
+		::memset(static_cast<BYTE*>(r.data2) + done * fb, 0, (r.frames2 - done) * fb);
+	}
+	ring.publishWrite(r);
+	return total;
+}
+// ----------------------------------------------------------------------------
+// リングバッファから書き出し先へ転送します。
+/**
+ * リングバッファのフレームサイズは書き出し先のブロックアラインと一致していること。
+ *
+ * @param[in,out]	ring	転送元
+ * @param[in,out]	writer	prepare済みの書き出し先
+ * @param[in]		frames	転送する最大フレーム数
+ * @return	転送したフレーム数
+ * @exception	WavIoException	書き出しエラー発生
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingAdapter::toWriter(AudioRingBuffer& ring, RiffWavWriter& writer, size_t frames) WAVE11_THROWS(WavIoException)
+{
+	const size_t avail = ring.readable();
+	if (frames > avail) {
+		frames = avail;
+	}
+	AudioRingRegion r;
+	ring.beginRead(frames, r);
+	const size_t fb = ring.frameBytes();
+	size_t total = writer.writeBytes(r.data1, r.frames1 * fb) / fb;
+	if (total == r.frames1 && r.frames2 > 0) {
+		total += writer.writeBytes(r.data2, r.frames2 * fb) / fb;
+	}
+	ring.commitRead(total);
+	return total;
+}
+// ----------------------------------------------------------------------------
+// 波形を生成してリングバッファへ書き込みます。
+/**
+ * リングバッファは32bit floatのインターリーブ形式とし、
+ * フレームサイズからチャンネル数を求めて全チャンネルに同じ値を書き込みます。
+ *
+ * @param[in,out]	ring	書き込み先
+ * @param[in,out]	gen		波形生成器
+ * @param[in]		wave	波形生成メソッド。例えば&WaveGenerator::SinSample
+ * @param[in]		frames	生成する最大フレーム数
+ * @param[in]		gain	振幅
+ * @return	書き込んだフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingAdapter::fromGenerator(AudioRingBuffer& ring, WaveGenerator& gen, Wave wave, size_t frames, float gain)
+{
+	const size_t channels = ring.frameBytes() / sizeof(float);
+	if (channels == 0 || channels * sizeof(float) != ring.frameBytes() || wave == nullptr) {
+		return 0;
+	}
+	const size_t space = ring.writable();
+	if (frames > space) {
+		frames = space;
+	}
+	if (frames == 0) {
+		return 0;
+	}
+
+	AudioRingRegion r;
+	if (ring.mode() == AudioRingBuffer::RING_SPSC) {
+		ring.beginWrite(frames, r);
+	} else {
+		ring.reserveWrite(frames, r);
+	}
+	generate(static_cast<float*>(r.data1), r.frames1, channels, gen, wave, gain);
+	generate(static_cast<float*>(r.data2), r.frames2, channels, gen, wave, gain);
+	if (ring.mode() == AudioRingBuffer::RING_SPSC) {
+		ring.commitWrite(r.frames());
+	} else {
+		ring.publishWrite(r);
+	}
+	return r.frames();
+}
@@ -0,0 +1,67 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AudioRingAdapter.h
+ * @brief	オーディオリングバッファと入出力クラスの接続のヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _AUDIORINGADAPTER_H_
+#define _AUDIORINGADAPTER_H_
+
+#include "AudioRingBuffer.h"
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+#include "WaveGenerator.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief オーディオリングバッファと入出力クラスの接続
+ *
+ * リングバッファの領域へ直接読み書きする。RING_MPSCの場合は書き込む領域を
+ * 先に予約してから読み込み元・波形生成器を進めるため、他の書き込みと競合しても
+ * 取り出したフレームが失われることはない。
+ * いずれもリングバッファの空き、またはデータの範囲でのみ処理するため、
+ * 溢れ・不足は計数されない。ただしRING_MPSCで他の書き込みと空きを奪い合った場合は、
+ * 予約できなかった分が溢れとして計数される。
+ */
+// ----------------------------------------------------------------------------
+class AudioRingAdapter
+{
+public:
+	//! WaveGeneratorの波形生成メソッド
+	typedef float (WaveGenerator::*Wave)();
+
+	//! 読み込み元からリングバッファへ転送します。
+	static size_t fromReader(AudioRingBuffer&, RiffWavReader&, size_t);
+	//! リングバッファから書き出し先へ転送します。
+	static size_t toWriter(AudioRingBuffer&, RiffWavWriter&, size_t) WAVE11_THROWS(WavIoException);
+	//! 波形を生成してリングバッファへ書き込みます。
+	static size_t fromGenerator(AudioRingBuffer&, WaveGenerator&, Wave, size_t, float = 1.f);
+
+private:
+	AudioRingAdapter();
+};
+
+#endif // !_AUDIORINGADAPTER_H_
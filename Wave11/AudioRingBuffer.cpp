@@ -0,0 +1,322 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AudioRingBuffer.cpp
+ * @brief	ロックフリーのオーディオリングバッファの実装
+ */
+// ----------------------------------------------------------------------------
+#include "AudioRingBuffer.h"
+#include <cstring>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WAVE11_SPIN_PAUSE()	_mm_pause()
+#else
+#define WAVE11_SPIN_PAUSE()	((void)0)
+#endif
+
+namespace {
+
+//! 公開待ちでスレッドを譲るまでの空回り回数
+const int SpinLimit = 64;
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	frameBytes	1フレームのバイトサイズ
+ * @param[in]	frames		最低限保持するフレーム数。2の冪に切り上げる。
+ * @param[in]	mode		書き込み側の並行性
+ */
+// ----------------------------------------------------------------------------
+AudioRingBuffer::AudioRingBuffer(size_t frameBytes, size_t frames, Mode mode)
+	: frameBytes_((frameBytes == 0) ? 1 : frameBytes),
+	capacity_([frames]() { size_t n = 1; while (n < frames) n <<= 1; return n; }()),
+	mask_(capacity_ - 1), mode_(mode), buffer_(capacity_ * frameBytes_),
+	reserve_(0), commit_(0), read_(0), overflow_(0), underflow_(0)
+{
+}
+// ----------------------------------------------------------------------------
+// 読み込み可能なフレーム数を取得します。
+/**
+ * @return	公開済みで未読のフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::readable() const
+{
+	const uint64_t r = read_.load(std::memory_order_relaxed);
+	return static_cast<size_t>(commit_.load(std::memory_order_acquire) - r);
+}
+// ----------------------------------------------------------------------------
+// 書き込み可能なフレーム数を取得します。
+/**
+ * @return	予約されていない空きフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::writable() const
+{
+	const uint64_t w = reserve_.load(std::memory_order_relaxed);
+	return capacity_ - static_cast<size_t>(w - read_.load(std::memory_order_acquire));
+}
+// ----------------------------------------------------------------------------
+// フレームを書き込みます。
+/**
+ * 空きが足りない場合は書き込める分だけ書き込み、残りは溢れとして計数します。
+ * RING_MPSCでは先に予約した書き込みの公開を待つことがあります。
+ *
+ * @param[in]	src		書き込むフレーム
+ * @param[in]	frames	フレーム数
+ * @return	書き込んだフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::write(const void* src, size_t frames)
+{
+	if (src == nullptr) {
+		return 0;
+	}
+	AudioRingRegion r;
+	const size_t n = reserveWrite(frames, r);
+	if (n == 0) {
+		return 0;
+	}
+	const BYTE* p = static_cast<const BYTE*>(src);
+	::memcpy(r.data1, p, r.frames1 * frameBytes_);
+	if (r.frames2 > 0) {
+		::memcpy(r.data2, p + r.frames1 * frameBytes_, r.frames2 * frameBytes_);
+	}
+	publishWrite(r);
+	return n;
+}
+// ----------------------------------------------------------------------------
+// フレームを読み込みます。
+/**
+ * 公開済みのフレームが足りない場合は読み込める分だけ読み込み、
+ * 残りは不足として計数します。
+ *
+ * @param[out]	dst		読み込み先
+ * @param[in]	frames	フレーム数
+ * @return	読み込んだフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::read(void* dst, size_t frames)
+{
+	if (dst == nullptr) {
+		return 0;
+	}
+	AudioRingRegion r;
+	const size_t n = beginRead(frames, r);
+	BYTE* p = static_cast<BYTE*>(dst);
+	::memcpy(p, r.data1, r.frames1 * frameBytes_);
+	if (r.frames2 > 0) {
+		::memcpy(p + r.frames1 * frameBytes_, r.data2, r.frames2 * frameBytes_);
+	}
+	commitRead(n);
+	return n;
+}
+// ----------------------------------------------------------------------------
+// フレームを読み捨てます。
+/**
+ * @param[in]	frames	フレーム数
+ * @return	読み捨てたフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::skip(size_t frames)
+{
+	AudioRingRegion r;
+	const size_t n = beginRead(frames, r);
+	commitRead(n);
+	return n;
+}
+// ----------------------------------------------------------------------------
+// 書き込み可能な領域を取得します。
+/**
+ * 領域へ直接書き込んだ後にcommitWriteで確定します。
+ * RING_MPSCでは使用できず、常に0を返します。
+ *
+ * @param[in]	frames	書き込みたいフレーム数
+ * @param[out]	r		書き込み可能な領域
+ * @return	書き込み可能なフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::beginWrite(size_t frames, AudioRingRegion& r)
+{
+	if (mode_ != RING_SPSC) {
+		region(0, 0, r);
+		return 0;
+	}
+	const size_t space = writable();
+	const size_t n = (frames < space) ? frames : space;
+	if (n < frames) {
+		overflow_.fetch_add(frames - n, std::memory_order_relaxed);
+	}
+	region(reserve_.load(std::memory_order_relaxed), n, r);
+	return n;
+}
+// ----------------------------------------------------------------------------
+// beginWriteで取得した領域の書き込みを確定します。
+/**
+ * @param[in]	frames	確定するフレーム数。beginWriteの戻り値以下であること。
+ */
+// ----------------------------------------------------------------------------
+void AudioRingBuffer::commitWrite(size_t frames)
+{
+	if (mode_ != RING_SPSC || frames == 0) {
+		return;
+	}
+	const uint64_t w = reserve_.load(std::memory_order_relaxed) + frames;
+	reserve_.store(w, std::memory_order_relaxed);
+	commit_.store(w, std::memory_order_release);
+}
+// ----------------------------------------------------------------------------
+// 書き込む領域を予約します。
+/**
+ * 予約した領域は他の書き込みと重ならないため、書き込み側が複数あっても
+ * 直接書き込める。空きが足りない場合は予約できる分だけ予約し、残りは溢れとして計数します。
+ * 予約した領域は書き込みの成否にかかわらず、全てpublishWriteで公開すること。
+ *
+ * @param[in]	frames	予約したいフレーム数
+ * @param[out]	r		予約した領域
+ * @return	予約したフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::reserveWrite(size_t frames, AudioRingRegion& r)
+{
+	uint64_t w = reserve_.load(std::memory_order_relaxed);
+	size_t n;
+	while (1) {
+		const size_t space = capacity_ - static_cast<size_t>(w - read_.load(std::memory_order_acquire));
+		n = (frames < space) ? frames : space;
+		if (n == 0) {
+			break;
+		}
+		if (mode_ == RING_SPSC) {
+			reserve_.store(w + n, std::memory_order_relaxed);
+			break;
+		}
+		// 書き込み側が複数ある場合は予約位置を奪い合う
+		if (reserve_.compare_exchange_weak(w, w + n, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+	if (n < frames) {
+		overflow_.fetch_add(frames - n, std::memory_order_relaxed);
+	}
+	region(w, n, r);
+	return n;
+}
+// ----------------------------------------------------------------------------
+// reserveWriteで予約した領域を公開します。
+/**
+ * RING_MPSCでは先に予約した領域が公開されるまで待機します。
+ *
+ * @param[in]	r	reserveWriteで予約した領域
+ */
+// ----------------------------------------------------------------------------
+void AudioRingBuffer::publishWrite(const AudioRingRegion& r)
+{
+	if (r.frames() == 0) {
+		return;
+	}
+	if (mode_ != RING_SPSC) {
+		// 先に予約した書き込みの公開を待ち、予約順に公開する
+		// 単一コアでは先行スレッドが横取りされていることがあるため、一定回数で譲る
+		for (int spin = 0; commit_.load(std::memory_order_acquire) != r.position; spin++) {
+			if (spin < SpinLimit) {
+				WAVE11_SPIN_PAUSE();
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+	commit_.store(r.position + r.frames(), std::memory_order_release);
+}
+// ----------------------------------------------------------------------------
+// 読み込み可能な領域を取得します。
+/**
+ * 領域から直接読み込んだ後にcommitReadで確定します。
+ * 公開済みのフレームが足りない場合は不足として計数します。
+ *
+ * @param[in]	frames	読み込みたいフレーム数
+ * @param[out]	r		読み込み可能な領域
+ * @return	読み込み可能なフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t AudioRingBuffer::beginRead(size_t frames, AudioRingRegion& r)
+{
+	const size_t avail = readable();
+	const size_t n = (frames < avail) ? frames : avail;
+	if (n < frames) {
+		underflow_.fetch_add(frames - n, std::memory_order_relaxed);
+	}
+	region(read_.load(std::memory_order_relaxed), n, r);
+	return n;
+}
+// ----------------------------------------------------------------------------
+// beginReadで取得した領域の読み込みを確定します。
+/**
+ * @param[in]	frames	確定するフレーム数。beginReadの戻り値以下であること。
+ */
+// ----------------------------------------------------------------------------
+void AudioRingBuffer::commitRead(size_t frames)
+{
+	if (frames == 0) {
+		return;
+	}
+	read_.store(read_.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+// ----------------------------------------------------------------------------
+// 内容と計数を初期化します。
+/**
+ * 読み書きのどちらも行われていない時に呼び出すこと。
+ */
+// ----------------------------------------------------------------------------
+void AudioRingBuffer::reset()
+{
+	reserve_.store(0, std::memory_order_relaxed);
+	commit_.store(0, std::memory_order_relaxed);
+	read_.store(0, std::memory_order_relaxed);
+	overflow_.store(0, std::memory_order_relaxed);
+	underflow_.store(0, std::memory_order_release);
+}
+// ----------------------------------------------------------------------------
+// 位置から連続領域を求めます。
+/**
+ * @param[in]	pos		フレーム位置
+ * @param[in]	frames	フレーム数。容量以下であること。
+ * @param[out]	r		連続領域
+ */
+// ----------------------------------------------------------------------------
+void AudioRingBuffer::region(uint64_t pos, size_t frames, AudioRingRegion& r) const
+{
+	BYTE* base = buffer_.as<BYTE>();
+	r.position = pos;
+	const size_t index = static_cast<size_t>(pos) & mask_;
+	const size_t first = capacity_ - index;
+	r.data1 = base + index * frameBytes_;
+	r.frames1 = (frames < first) ? frames : first;
+	r.data2 = base;
+	r.frames2 = frames - r.frames1;
+}
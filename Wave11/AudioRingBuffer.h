@@ -0,0 +1,186 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	AudioRingBuffer.h
+ * @brief	ロックフリーのオーディオリングバッファのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _AUDIORINGBUFFER_H_
+#define _AUDIORINGBUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "BufferPool.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief リングバッファ上の連続領域
+ *
+ * 領域がバッファ末尾で折り返す場合は2つに分かれる。
+ */
+// ----------------------------------------------------------------------------
+struct AudioRingRegion {
+	//! 領域の先頭のフレーム位置
+	uint64_t position;
+	//! 1つ目の領域の先頭
+	void* data1;
+	//! 1つ目の領域のフレーム数
+	size_t frames1;
+	//! 折り返し後の領域の先頭
+	void* data2;
+	//! 折り返し後の領域のフレーム数
+	size_t frames2;
+
+	/**
+	 * @brief	合計フレーム数を取得する
+	 * @return	2つの領域のフレーム数の合計
+	 */
+	size_t frames() const { return frames1 + frames2; }
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ロックフリーのオーディオリングバッファ
+ *
+ * フレーム単位で読み書きするリングバッファ。メモリ確保は生成時にのみ行う。
+ * 容量は2の冪のフレーム数に切り上げる。
+ *
+ * RING_SPSCでは書き込み側・読み込み側とも1スレッドに限る。読み書きとも待機しないため、
+ * どちらもリアルタイムスレッドから呼び出せる。
+ * RING_MPSCでは書き込み側を複数スレッドから呼び出せる。読み込み側は待機しないが、
+ * 書き込みは予約した順に公開されるため、先に予約したスレッドの公開を待つことがある。
+ * リアルタイムスレッドから書き込む場合はRING_SPSCを使うこと。
+ * beginWrite/commitWriteはRING_SPSCでのみ使用できる。予約した領域へ直接書き込む場合、
+ * RING_MPSCではreserveWrite/publishWriteを使う。
+ *
+ * 書き込み・読み込みの索引は別のキャッシュラインに置き、偽共有を避ける。
+ */
+// ----------------------------------------------------------------------------
+class AudioRingBuffer : private Noncopyable
+{
+public:
+	//! 書き込み側の並行性
+	enum Mode {
+		RING_SPSC,	//!< 単一書き込み・単一読み込み
+		RING_MPSC	//!< 複数書き込み・単一読み込み
+	};
+
+	//! コンストラクタ
+	AudioRingBuffer(size_t, size_t, Mode = RING_SPSC);
+
+	/**
+	 * @brief	容量を取得する
+	 * @return	保持できる最大フレーム数
+	 */
+	size_t capacity() const { return capacity_; }
+	/**
+	 * @brief	フレームのバイトサイズを取得する
+	 * @return	1フレームのバイトサイズ
+	 */
+	size_t frameBytes() const { return frameBytes_; }
+	/**
+	 * @brief	書き込み側の並行性を取得する
+	 * @return	生成時に指定した並行性
+	 */
+	Mode mode() const { return mode_; }
+	//! 読み込み可能なフレーム数を取得します。
+	size_t readable() const;
+	//! 書き込み可能なフレーム数を取得します。
+	size_t writable() const;
+
+	//! フレームを書き込みます。
+	size_t write(const void*, size_t);
+	//! フレームを読み込みます。
+	size_t read(void*, size_t);
+	//! フレームを読み捨てます。
+	size_t skip(size_t);
+
+	//! 書き込み可能な領域を取得します。
+	size_t beginWrite(size_t, AudioRingRegion&);
+	//! beginWriteで取得した領域の書き込みを確定します。
+	void commitWrite(size_t);
+	//! 書き込む領域を予約します。
+	size_t reserveWrite(size_t, AudioRingRegion&);
+	//! reserveWriteで予約した領域を公開します。
+	void publishWrite(const AudioRingRegion&);
+	//! 読み込み可能な領域を取得します。
+	size_t beginRead(size_t, AudioRingRegion&);
+	//! beginReadで取得した領域の読み込みを確定します。
+	void commitRead(size_t);
+
+	/**
+	 * @brief	溢れたフレーム数を取得する
+	 * @return	空きが足りず書き込めなかったフレーム数の累計
+	 */
+	uint64_t overflows() const { return overflow_.load(std::memory_order_relaxed); }
+	/**
+	 * @brief	不足したフレーム数を取得する
+	 * @return	データが足りず読み込めなかったフレーム数の累計
+	 */
+	uint64_t underflows() const { return underflow_.load(std::memory_order_relaxed); }
+	//! 内容と計数を初期化します。
+	void reset();
+
+private:
+	//! キャッシュラインのバイトサイズ
+	static const size_t CacheLine = 64;
+
+	//! 1フレームのバイトサイズ
+	const size_t frameBytes_;
+	//! 容量のフレーム数
+	const size_t capacity_;
+	//! 索引のマスク
+	const size_t mask_;
+	//! 書き込み側の並行性
+	const Mode mode_;
+	//! 格納領域
+	PooledBuffer buffer_;
+
+	// 索引は間に詰め物を挟み、別のキャッシュラインに置く。
+	// C++11のnewは64バイト境界を保証しないため、alignasではなく詰め物で分離する。
+	char pad0_[CacheLine];
+	//! 書き込みを予約したフレーム位置
+	std::atomic<uint64_t> reserve_;
+	char pad1_[CacheLine - sizeof(std::atomic<uint64_t>)];
+	//! 書き込みを公開したフレーム位置
+	std::atomic<uint64_t> commit_;
+	char pad2_[CacheLine - sizeof(std::atomic<uint64_t>)];
+	//! 読み込みを終えたフレーム位置
+	std::atomic<uint64_t> read_;
+	char pad3_[CacheLine - sizeof(std::atomic<uint64_t>)];
+	//! 溢れたフレーム数
+	std::atomic<uint64_t> overflow_;
+	//! 不足したフレーム数
+	std::atomic<uint64_t> underflow_;
+	char pad4_[CacheLine - 2 * sizeof(std::atomic<uint64_t>)];
+
+	//! 位置から連続領域を求めます。
+	void region(uint64_t, size_t, AudioRingRegion&) const;
+};
+
+#endif // !_AUDIORINGBUFFER_H_
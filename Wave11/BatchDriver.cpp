@@ -0,0 +1,342 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	BatchDriver.cpp
+ * @brief	分散一括処理の実行クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "BatchDriver.h"
+#include <memory>
+#include "WavTranscoder.h"
+#if defined(_WIN32) && defined(_MSC_VER)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+//! ジャーナルの成功の記録
+const tstring JournalOk = _T("OK\t");
+//! ジャーナルの失敗の記録
+const tstring JournalNg = _T("NG\t");
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	ファイル全体を行に分けて読み込む
+ *
+ * 改行で終わっていない最後の行は書き込み途中とみなして含めない。
+ * 行末のCRは取り除く。
+ *
+ * @param[in]	path		ファイルのパス
+ * @param[out]	lines		行
+ * @param[out]	complete	ファイルが空か改行で終わっていれば真
+ * @return	読み込めれば真
+ */
+// ----------------------------------------------------------------------------
+bool readLines(const tstring& path, std::vector<tstring>& lines, bool& complete)
+{
+	FILE* fp = ::_tfopen(path.c_str(), _T("rb"));
+	if (fp == nullptr) {
+		return false;
+	}
+	tstring text;
+	TCHAR buf[4096];
+	size_t n;
+	while ((n = ::fread(buf, sizeof(TCHAR), sizeof(buf) / sizeof(TCHAR), fp)) > 0) {
+		text.append(buf, n);
+	}
+	const bool ok = (::ferror(fp) == 0);
+	::fclose(fp);
+
+	lines.clear();
+	size_t begin = 0;
+	size_t end;
+	while ((end = text.find(_T('\n'), begin)) != tstring::npos) {
+		size_t last = end;
+		if (last > begin && text[last - 1] == _T('\r')) {
+			last--;
+		}
+		lines.push_back(text.substr(begin, last - begin));
+		begin = end + 1;
+	}
+	complete = (begin == text.size());
+	return ok;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	コンストラクタ
+ * @param[in]	shard	自ノードのシャード番号（0～shards-1）
+ * @param[in]	shards	シャード数（ノード数）
+ * @param[in]	pool	ジョブの処理に使うスレッドプール。nullptrなら逐次処理。
+ */
+// ----------------------------------------------------------------------------
+BatchDriver::BatchDriver(size_t shard, size_t shards, ThreadPool* pool)
+: shard_((shards == 0) ? 0 : shard % shards),
+  shards_((shards == 0) ? 1 : shards),
+  pool_(pool),
+  journal_(nullptr),
+  durable_(false),
+  stop_(false)
+{
+}
+// ----------------------------------------------------------------------------
+/**
+ * @brief	デストラクタ
+ * ジャーナルを閉じます。
+ */
+// ----------------------------------------------------------------------------
+BatchDriver::~BatchDriver()
+{
+	if (journal_ != nullptr) {
+		::fclose(journal_);
+	}
+}
+// ----------------------------------------------------------------------------
+// マニフェストを読み込みます。
+/**
+ * 1行に1件、入力パスと出力パスをタブで区切って記述します。出力パスは省略できます。
+ * 空行と#で始まる行は読み飛ばします。全ノードで同じ内容を与えること。
+ *
+ * @param[in]	path	マニフェストのパス
+ * @param[out]	jobs	ジョブ
+ * return	読み込めれば真
+ */
+// ----------------------------------------------------------------------------
+bool BatchDriver::loadManifest(const tstring& path, std::vector<BatchJob>& jobs)
+{
+	std::vector<tstring> lines;
+	bool complete;
+	if (!readLines(path, lines, complete)) {
+		return false;
+	}
+	jobs.clear();
+	for (size_t i = 0; i < lines.size(); i++) {
+		const tstring& line = lines[i];
+		if (line.empty() || line[0] == _T('#')) {
+			continue;
+		}
+		BatchJob job;
+		const size_t tab = line.find(_T('\t'));
+		job.src = line.substr(0, tab);
+		if (tab != tstring::npos) {
+			job.dst = line.substr(tab + 1);
+		}
+		jobs.push_back(job);
+	}
+	// 改行で終わらない最後の行もマニフェストでは有効
+	return true;
+}
+// ----------------------------------------------------------------------------
+// パスのシャード振り分け用ハッシュ値を求めます。
+/**
+ * FNV-1a（64bit）に最終の撹拌を加えたものです。文字コード単位の値だけに依存し、
+ * 実行環境やプロセスによらず同じ値になります。ASCIIのパスは文字型の幅によらず
+ * 同じ値になります。
+ *
+ * @param[in]	path	パス
+ * return	ハッシュ値
+ */
+// ----------------------------------------------------------------------------
+uint64_t BatchDriver::shardHash(const tstring& path)
+{
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < path.size(); i++) {
+		uint64_t u = static_cast<uint64_t>(path[i]) & 0xFFFFFFFFULL;
+		do {
+			h ^= (u & 0xFF);
+			h *= 0x100000001B3ULL;
+			u >>= 8;
+		} while (u != 0);
+	}
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
+// ----------------------------------------------------------------------------
+// 入力を変換して出力に書き出す処理関数を生成します。
+/**
+ * ジョブのsrcをRiffWavReaderで読み、WavTranscoderで変換してdstへ
+ * RiffWavWriterで書き出します。dstが空のジョブは失敗とします。
+ * ジョブ単位でスレッドプールに分散されるため、変換自体は逐次処理します。
+ *
+ * @param[in]	qbit	出力の量子化ビット数
+ * @param[in]	fmt		出力の量子化フォーマット（真が整数型PCM）
+ * @param[in]	fs		出力のサンプリングレート。0なら入力と同じ。
+ * return	処理関数
+ */
+// ----------------------------------------------------------------------------
+BatchDriver::Task BatchDriver::transcodeTask(WORD qbit, bool fmt, DWORD fs)
+{
+	std::shared_ptr<WavTranscoder> transcoder = std::make_shared<WavTranscoder>(qbit, fmt, fs);
+	return [transcoder](const BatchJob& job) {
+		return !job.dst.empty() && transcoder->transcode(job.src, job.dst);
+	};
+}
+// ----------------------------------------------------------------------------
+// ジャーナルを開き、記録済みの完了を読み込みます。
+/**
+ * ファイルがなければ作ります。最後の行が書き込み途中で切れていれば、
+ * 以降の記録がその行に続かないよう改行を補います。
+ *
+ * @param[in]	path	ジャーナルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool BatchDriver::openJournal(const tstring& path)
+{
+	if (journal_ != nullptr) {
+		::fclose(journal_);
+		journal_ = nullptr;
+	}
+	done_.clear();
+
+	std::vector<tstring> lines;
+	bool complete = true;
+	if (readLines(path, lines, complete)) {
+		for (size_t i = 0; i < lines.size(); i++) {
+			const tstring& line = lines[i];
+			if (line.compare(0, JournalOk.size(), JournalOk) == 0) {
+				done_.insert(line.substr(JournalOk.size()));
+			} else if (line.compare(0, JournalNg.size(), JournalNg) == 0) {
+				// 後から失敗が記録されたら再処理の対象に戻す
+				done_.erase(line.substr(JournalNg.size()));
+			}
+		}
+	}
+
+	if ((journal_ = ::_tfopen(path.c_str(), _T("ab"))) == nullptr) {
+		return false;
+	}
+	if (!complete) {
+		const TCHAR nl = _T('\n');
+		if (::fwrite(&nl, sizeof(TCHAR), 1, journal_) != 1 || ::fflush(journal_) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 担当分の未完了のジョブを処理します。
+/**
+ * 自ノードのシャードに属し、ジャーナルに成功が記録されていないジョブを
+ * マニフェストの順に処理し、結果を記録します。openJournalを呼んでいなければ
+ * 記録せずに処理します。記録に失敗したジョブは失敗として数え、
+ * 未着手のジョブは始めずに終了します。
+ *
+ * @param[in]	jobs	マニフェストの全ジョブ
+ * @param[in]	task	1件の処理関数
+ * return	集計
+ */
+// ----------------------------------------------------------------------------
+BatchStats BatchDriver::run(const std::vector<BatchJob>& jobs, const Task& task)
+{
+	BatchStats stats = { 0, 0, 0, 0 };
+	std::vector<const BatchJob*> pending;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		if (!isMine(jobs[i])) {
+			continue;
+		}
+		stats.assigned++;
+		if (isDone(jobs[i])) {
+			stats.skipped++;
+		} else {
+			pending.push_back(&jobs[i]);
+		}
+	}
+
+	std::atomic<size_t> succeeded(0);
+	std::atomic<size_t> failed(0);
+	auto work = [&](size_t i) {
+		if (stop_) {
+			return;
+		}
+		bool ok;
+		try {
+			ok = task(*pending[i]);
+		} catch (const std::exception&) {
+			ok = false;
+		}
+		if (!record(*pending[i], ok)) {
+			// 記録できなければ再起動時にやり直すため失敗とし、以降のジョブも記録できないので止める
+			ok = false;
+			stop_ = true;
+		}
+		if (ok) {
+			succeeded++;
+		} else {
+			failed++;
+		}
+	};
+	if (pool_ != nullptr && pending.size() > 1) {
+		pool_->parallelFor(pending.size(), work);
+	} else {
+		for (size_t i = 0; i < pending.size(); i++) {
+			work(i);
+		}
+	}
+	stats.succeeded = succeeded;
+	stats.failed = failed;
+	return stats;
+}
+// ----------------------------------------------------------------------------
+// ジョブの結果をジャーナルに記録します。
+/**
+ * 1行を1回の書き込みで追記し、フラッシュします。
+ * 成功は記録できた場合だけ完了済みに加えます。
+ *
+ * @param[in]	job	ジョブ
+ * @param[in]	ok	成功なら真
+ * return	記録できれば真
+ */
+// ----------------------------------------------------------------------------
+bool BatchDriver::record(const BatchJob& job, bool ok)
+{
+	const tstring line = (ok ? JournalOk : JournalNg) + job.src + _T("\n");
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (journal_ != nullptr) {
+		if (::fwrite(line.data(), sizeof(TCHAR), line.size(), journal_) != line.size() || ::fflush(journal_) != 0) {
+			return false;
+		}
+#if defined(_WIN32) && defined(_MSC_VER)
+		const bool synced = !durable_ || ::_commit(::_fileno(journal_)) == 0;
+#else
+		const bool synced = !durable_ || ::fsync(::fileno(journal_)) == 0;
+#endif
+		if (!synced) {
+			return false;
+		}
+	}
+	if (ok) {
+		done_.insert(job.src);
+	}
+	return true;
+}
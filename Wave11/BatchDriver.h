@@ -0,0 +1,158 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	BatchDriver.h
+ * @brief	分散一括処理の実行クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _BATCHDRIVER_H_
+#define _BATCHDRIVER_H_
+
+#include <cstdio>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 一括処理の1件
+ */
+// ----------------------------------------------------------------------------
+struct BatchJob {
+	//! 入力ファイルのパス。ジョブの識別にも使う。
+	tstring src;
+	//! 出力ファイルのパス。省略時は空。
+	tstring dst;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 一括処理の集計
+ */
+// ----------------------------------------------------------------------------
+struct BatchStats {
+	//! 担当分のジョブ数
+	size_t assigned;
+	//! ジャーナルに完了が記録済みで飛ばしたジョブ数
+	size_t skipped;
+	//! 今回成功したジョブ数
+	size_t succeeded;
+	//! 今回失敗したジョブ数
+	size_t failed;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 複数ノードで分担し、中断後に再開できる一括処理クラス
+ *
+ * マニフェストのジョブを入力パスのハッシュ値で決定的にシャードへ振り分け、
+ * 自ノードのシャードだけをスレッドプールで処理する。ハッシュ値は環境に
+ * 依存しないため、全ノードが同じマニフェストを読めば重複も漏れもなく分担できる。
+ *
+ * 完了したジョブは追記専用のジャーナルに1行ずつ記録し、記録ごとにフラッシュする。
+ * 再起動時はジャーナルを読んで成功済みのジョブを飛ばすため、途中で停止しても
+ * 未完了のジョブからやり直せる。失敗したジョブと書き込み途中の行は未完了として扱う。
+ * ジャーナルはノード（シャード）ごとに別のファイルにすること。
+ * ジャーナルに記録できなかった場合はそのジョブを失敗として数え、以降のジョブは始めない。
+ *
+ * 処理関数は同じジョブで繰り返し呼ばれても同じ結果になるよう、
+ * 出力を上書きする作りにすること。
+ */
+// ----------------------------------------------------------------------------
+class BatchDriver : private Noncopyable
+{
+public:
+	//! 1件の処理関数。成功なら真を返す。複数スレッドから同時に呼ばれる。
+	typedef std::function<bool(const BatchJob&)> Task;
+
+	BatchDriver(size_t, size_t, ThreadPool* = nullptr);
+	virtual ~BatchDriver();
+
+	//! マニフェストを読み込みます。
+	static bool loadManifest(const tstring&, std::vector<BatchJob>&);
+	//! パスのシャード振り分け用ハッシュ値を求めます。
+	static uint64_t shardHash(const tstring&);
+	//! 入力を変換して出力に書き出す処理関数を生成します。
+	static Task transcodeTask(WORD, bool = true, DWORD = 0);
+	/**
+	 * @brief	自ノードの担当か判定する
+	 * @param[in]	job	ジョブ
+	 * @return	担当なら真
+	 */
+	bool isMine(const BatchJob& job) const { return shardHash(job.src) % shards_ == shard_; }
+	/**
+	 * @brief	記録ごとにストレージへの書き込みを待つか設定する
+	 *
+	 * 真ならOSの異常終了や電源断でも記録が残るが、記録ごとに同期書き込みとなる。
+	 * 既定は偽（プロセスの異常終了に対してのみ記録が残る）。
+	 * @param[in]	durable	同期書き込みするなら真
+	 */
+	void setDurable(bool durable) { durable_ = durable; }
+	//! ジャーナルを開き、記録済みの完了を読み込みます。
+	bool openJournal(const tstring&);
+	/**
+	 * @brief	完了済みか判定する
+	 * @param[in]	job	ジョブ
+	 * @return	ジャーナルに成功が記録されていれば真
+	 */
+	bool isDone(const BatchJob& job) const { return done_.count(job.src) != 0; }
+	//! 担当分の未完了のジョブを処理します。
+	BatchStats run(const std::vector<BatchJob>&, const Task&);
+	/**
+	 * @brief	処理の中止を要求する
+	 *
+	 * 実行中のジョブは最後まで処理し、未着手のジョブは始めない。
+	 * シグナルハンドラーから呼んでもよい。
+	 */
+	void requestStop() { stop_ = true; }
+
+private:
+	//! 自ノードのシャード番号
+	const size_t shard_;
+	//! シャード数
+	const size_t shards_;
+	//! ジョブの処理に使うスレッドプール
+	ThreadPool* pool_;
+	//! 追記用に開いたジャーナル
+	FILE* journal_;
+	//! 記録ごとに同期書き込みするなら真
+	bool durable_;
+	//! 中止が要求されたら真
+	std::atomic<bool> stop_;
+	//! 成功が記録済みの入力パス
+	std::unordered_set<tstring> done_;
+	//! ジャーナルへの記録の排他
+	std::mutex mutex_;
+
+	//! ジョブの結果をジャーナルに記録します。
+	bool record(const BatchJob&, bool);
+};
+
+#endif // !_BATCHDRIVER_H_
@@ -32,6 +32,18 @@
 
 #include "WavIoType.h"
 #include <exception>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+// 2GB以上のファイルを扱うための64bit版fseek/ftell
+#if defined(_MSC_VER)
+#define WAVE11_FSEEK	_fseeki64
+#define WAVE11_FTELL	_ftelli64
+#else
+#define WAVE11_FSEEK	fseeko
+#define WAVE11_FTELL	ftello
+#endif
 
 // ----------------------------------------------------------------------------
 /**
@@ -63,12 +75,12 @@ public:
 	 * @param[in] origin	fseekの移動モード指定。SEEK_CUR/SEEK_END/SEEK_SETの3種。
 	 * @return	移動に成功すれば真。
 	 */
-	virtual bool seek(long offs, int origin) = 0;
+	virtual bool seek(int64_t offs, int origin) = 0;
 	/**
 	 * @brief	ファイルのバイトオフセットを取得
 	 * @return	ファイルのバイトオフセット。エラー発生時は-1。
 	 */
-	virtual long tell() = 0;
+	virtual int64_t tell() = 0;
 	/**
 	 * @brief	処理エンディアン設定
 	 * @param[in] le	リトルエンディアン指定時は真
@@ -80,6 +92,48 @@ public:
 	 */
 	bool isLittleEndian() const { return isLittleEndian_; }
 
+	/**
+	 * @brief	80bit拡張倍精度浮動小数点数（ビッグエンディアン）を変換する
+	 *
+	 * AIFFのサンプリングレートの形式。符号1bit・指数15bit・整数ビットを含む仮数64bit。
+	 * @param[in]	b	10バイトのバイト列の先頭のポインタ
+	 * @return	変換した値
+	 */
+	static double fromExtended(const BYTE* b) {
+		const int exponent = ((b[0] & 0x7F) << 8) | b[1];
+		uint64_t mantissa = 0;
+		for (int i = 2; i < 10; i++) {
+			mantissa = (mantissa << 8) | b[i];
+		}
+		if (exponent == 0 && mantissa == 0) {
+			return 0.0;
+		}
+		const double v = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+		return (b[0] & 0x80) ? -v : v;
+	}
+	/**
+	 * @brief	値を80bit拡張倍精度浮動小数点数（ビッグエンディアン）に変換する
+	 * @param[out]	b	10バイトのバイト列を格納可能なバッファのポインタ
+	 * @param[in]	v	変換する値。0以下は0とする。
+	 */
+	static void toExtended(BYTE* b, double v) {
+		for (int i = 0; i < 10; i++) {
+			b[i] = 0;
+		}
+		if (!(v > 0.0)) {
+			return;
+		}
+		int e;
+		const double f = std::frexp(v, &e);	// v = f * 2^e、0.5 <= f < 1
+		const uint64_t mantissa = static_cast<uint64_t>(std::ldexp(f, 64));
+		const int exponent = e - 1 + 16383;
+		b[0] = static_cast<BYTE>((exponent >> 8) & 0x7F);
+		b[1] = static_cast<BYTE>(exponent);
+		for (int i = 0; i < 8; i++) {
+			b[9 - i] = static_cast<BYTE>(mantissa >> (i * 8));
+		}
+	}
+
 protected:
 	/**
 	 * @brief	4byteのバイト列をエンディアンに従って32bit符号なし整数型に変換
@@ -101,6 +155,18 @@ protected:
 				| (static_cast<DWORD>(b[0]) << 24));
 		}
 	}
+	/**
+	 * @brief	8byteのバイト列をエンディアンに従って64bit符号なし整数型に変換
+	 * @param[in]	b	8バイトのバイト列の先頭のポインタ
+	 * @return	変換した64bit符号なし整数値
+	 *
+	 * @attention	引数のエラーチェック等は一切ない。
+	 */
+	uint64_t toQWORD(const BYTE* b) {
+		const uint64_t lo = toDWORD(isLittleEndian_ ? b : b + 4);
+		const uint64_t hi = toDWORD(isLittleEndian_ ? b + 4 : b);
+		return lo | (hi << 32);
+	}
 	/**
 	 * @brief	2byteのバイト列をエンディアンに従って16bit符号なし整数型に変換
 	 * @param[in]	b	2バイトのバイト列の先頭のポインタ
@@ -139,6 +205,19 @@ protected:
 		}
 		return b;
 	}
+	/**
+	 * @brief	64bit符号なし整数値をエンディアンに従って8バイトのバイト列に変換
+	 * @param[in,out]	b	8バイトのバイト列を格納可能なバッファのポインタ
+	 * @param[in]		n	変換する64bit符号なし整数値
+	 * @return	8バイトのバイト列
+	 *
+	 * @attention	引数のエラーチェック等は一切ない。
+	 */
+	BYTE* toBytes(BYTE* b, uint64_t n) {
+		toBytes(isLittleEndian_ ? b : b + 4, static_cast<DWORD>(n));
+		toBytes(isLittleEndian_ ? b + 4 : b, static_cast<DWORD>(n >> 32));
+		return b;
+	}
 	/**
 	 * @brief	16bit符号なし整数値をエンディアンに従って2バイトのバイト列に変換
 	 * @param[in,out]	b	2バイトのバイト列を格納可能なバッファのポインタ
@@ -31,14 +31,36 @@
 #define _BINARYREADER_H_
 
 #include <cstdio>
+#include <cstdint>
+#if defined(_WIN32) && defined(_MSC_VER)
+#include <io.h>
+#else
+#include <sys/stat.h>
+#endif
 #include "BinaryIO.h"
 #include "Noncopyable.h"
+#include "Metrics.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ファイルの同一性と更新の有無を判定するための属性
+ */
+// ----------------------------------------------------------------------------
+struct FileStamp {
+	//! デバイス番号
+	uint64_t device;
+	//! iノード番号。取得できない環境では0。
+	uint64_t inode;
+	//! ファイルのバイトサイズ
+	int64_t size;
+	//! 最終更新時刻（エポックからのナノ秒、分解能は環境依存）
+	int64_t mtime;
+};
 
 // ----------------------------------------------------------------------------
 /**
  * @brief バイナリ読み込みクラス
  * 読み込み対象はファイルのみ
- * @attention 2GB以上のファイル読み込みは正常動作しない。
  */
 // ----------------------------------------------------------------------------
 class BinaryReader : public BinaryIo, private Noncopyable
@@ -50,10 +72,13 @@ public:
 
 	/**
 	 * @brief	読み込み対象のファイルをオープンする
+	 * オープン中のファイルがあればクローズしてから開くため、
+	 * 同じインスタンスを複数のファイルに使い回せる。
 	 * @param[in] path ファイルのパス
 	 * @return	オープンに成功すれば真
 	 */
 	bool open(const tstring& path) {
+		close();
 		if ((fp_ = ::_tfopen(path.c_str(), _T("rb"))) == nullptr) {
 			return false;
 		}
@@ -73,10 +98,14 @@ public:
 	 * @return	実際に読み込んだバイトサイズ
 	 * @exception	WavIoException	ファイル未オープン
 	 */
-	size_t readBytes(void* buf, size_t size) throw(WavIoException) {
+	size_t readBytes(void* buf, size_t size) WAVE11_THROWS(WavIoException) {
 		if (buf == nullptr || size == 0) return 0;
 		if (fp_ == nullptr) throw WavIoException("file isn't opened.");
-		return ::fread(buf, 1, size, fp_);
+		WAVE11_METRIC_TIMER(timer, METRIC_READ_NS);
+		size_t ret = ::fread(buf, 1, size, fp_);
+		WAVE11_METRIC_ADD(METRIC_READ_CALLS, 1);
+		WAVE11_METRIC_ADD(METRIC_BYTES_READ, ret);
+		return ret;
 	}
 	/**
 	 * @brief	ファイルの読み書き位置を設定
@@ -84,15 +113,91 @@ public:
 	 * @param[in] origin	fseekの移動モード指定。SEEK_CUR/SEEK_END/SEEK_SETの3種。
 	 * @return	移動に成功すれば真。
 	 */
-	bool seek(long offs, int origin) {
-		return (fp_ == nullptr) ? false : (::fseek(fp_, offs, origin) == 0);
+	bool seek(int64_t offs, int origin) {
+		if (fp_ == nullptr) return false;
+		WAVE11_METRIC_TIMER(timer, METRIC_SEEK_NS);
+		WAVE11_METRIC_ADD(METRIC_SEEK_CALLS, 1);
+		return ::WAVE11_FSEEK(fp_, offs, origin) == 0;
 	}
 	/**
 	 * @brief	ファイルのバイトオフセットを取得
 	 * @return	ファイルのバイトオフセット。エラー発生時は-1。
 	 */
-	long tell() {
-		return (fp_ == nullptr) ? -1 : ::ftell(fp_);
+	int64_t tell() {
+		if (fp_ == nullptr) return -1;
+		WAVE11_METRIC_ADD(METRIC_TELL_CALLS, 1);
+		return ::WAVE11_FTELL(fp_);
+	}
+	/**
+	 * @brief	ファイルサイズを取得する
+	 *
+	 * 読み込み位置やFILEのバッファには影響しない。他のプロセスが追記中のファイルでは
+	 * 呼び出すたびにその時点のサイズを返す。
+	 * @return	ファイルのバイトサイズ。エラー発生時は-1。
+	 */
+	int64_t size() const {
+		if (fp_ == nullptr) return -1;
+#if defined(_WIN32) && defined(_MSC_VER)
+		return ::_filelengthi64(::_fileno(fp_));
+#else
+		struct stat st;
+		if (::fstat(::fileno(fp_), &st) != 0) return -1;
+		return static_cast<int64_t>(st.st_size);
+#endif
+	}
+	/**
+	 * @brief	ファイルの属性を取得する
+	 *
+	 * 開いているファイルに対して問い合わせるため、パスの差し替えの影響を受けない。
+	 * @param[out]	stamp	ファイルの属性
+	 * @return	取得に成功すれば真
+	 */
+	bool getStamp(FileStamp& stamp) const {
+		if (fp_ == nullptr) return false;
+#if defined(_WIN32) && defined(_MSC_VER)
+		struct _stat64 st;
+		if (::_fstat64(::_fileno(fp_), &st) != 0) return false;
+		stamp.mtime = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+		struct stat st;
+		if (::fstat(::fileno(fp_), &st) != 0) return false;
+#if defined(__linux__)
+		stamp.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+		stamp.mtime = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#endif
+#endif
+		stamp.device = static_cast<uint64_t>(st.st_dev);
+		stamp.inode = static_cast<uint64_t>(st.st_ino);
+		stamp.size = static_cast<int64_t>(st.st_size);
+		return true;
+	}
+	/**
+	 * @brief	OSのファイルハンドルを取得する
+	 *
+	 * 位置指定の非同期読み込みに使う。FILEのバッファや読み込み位置には影響しない。
+	 * @return	POSIXではファイル記述子、WindowsではHANDLE。未オープンなら-1。
+	 */
+	intptr_t nativeHandle() const {
+		if (fp_ == nullptr) return -1;
+#if defined(_WIN32) && defined(_MSC_VER)
+		return ::_get_osfhandle(::_fileno(fp_));
+#else
+		return ::fileno(fp_);
+#endif
+	}
+	/**
+	 * @brief	64bit長のデータを64bit符号なし整数値として読み込む。
+	 * データの読み込みができない場合は例外を投入する。
+	 * @return	読み取った64bit符号なし整数
+	 * @exception	WavIoException	読み込みエラー発生
+	 */
+	uint64_t readQWORD() WAVE11_THROWS(WavIoException) {
+		BYTE buf[8];
+		if (readBytes(buf, 8) != 8) {
+			throw WavIoException("stdio read error.");
+		}
+		return toQWORD(buf);
 	}
 	/**
 	 * @brief	32bit長のデータを32bit符号なし整数値として読み込む。
@@ -100,7 +205,7 @@ public:
 	 * @return	読み取った32bit符号なし整数
 	 * @exception	WavIoException	読み込みエラー発生
 	 */
-	DWORD readDWORD() throw (WavIoException) {
+	DWORD readDWORD() WAVE11_THROWS(WavIoException) {
 		BYTE buf[4];
 		if (readBytes(buf, 4) != 4) {
 			throw WavIoException("stdio read error.");
@@ -113,7 +218,7 @@ public:
 	 * @return	読み取った16bit符号なし整数
 	 * @exception	WavIoException	読み込みエラー発生
 	 */
-	WORD readWORD() throw (WavIoException) {
+	WORD readWORD() WAVE11_THROWS(WavIoException) {
 		BYTE buf[2];
 		if (readBytes(buf, 2) != 2) {
 			throw WavIoException("stdio read error.");
@@ -126,7 +231,7 @@ public:
 	 * @return	読み取った8bit符号なし整数
 	 * @exception	WavIoException	読み込みエラー発生
 	 */
-	WORD readBYTE() throw (WavIoException) {
+	WORD readBYTE() WAVE11_THROWS(WavIoException) {
 		BYTE buf;
 		if (readBytes(&buf, 1) != 1) {
 			throw WavIoException("stdio read error.");
@@ -33,12 +33,18 @@
 #include <cstdio>
 #include "BinaryIO.h"
 #include "Noncopyable.h"
+#include "Metrics.h"
+#include "BufferPool.h"
+#include "PositionalFile.h"
+#if defined(__linux__)
+#include <cerrno>
+#include <unistd.h>
+#endif
 
 // ----------------------------------------------------------------------------
 /**
  * @brief バイナリ書き出しクラス
  * 書き出し対象はファイルのみ
- * @attention 2GB以上のファイル書き出しは正常動作しない。
  */
 // ----------------------------------------------------------------------------
 class BinaryWriter : public BinaryIo, private Noncopyable
@@ -50,10 +56,13 @@ public:
 
 	/**
 	 * @brief	書き出し対象のファイルをオープンする。書き出しは常に新規ファイル。
+	 * オープン中のファイルがあればクローズしてから開くため、
+	 * 同じインスタンスを複数のファイルに使い回せる。
 	 * @param[in] path ファイルのパス
 	 * @return	オープンに成功すれば真
 	 */
 	bool open(const tstring& path) {
+		close();
 		if ((fp_ = ::_tfopen(path.c_str(), _T("wb"))) == nullptr) {
 			return false;
 		}
@@ -73,10 +82,70 @@ public:
 	 * @return	実際に書き出したバイトサイズ
 	 * @exception	WavIoException	ファイル未オープン
 	 */
-	size_t writeBytes(const void* buf, size_t size) throw(WavIoException) {
+	size_t writeBytes(const void* buf, size_t size) WAVE11_THROWS(WavIoException) {
 		if (buf == nullptr || size == 0) return 0;
 		if (fp_ == nullptr) throw WavIoException("file isn't opened.");
-		return ::fwrite(buf, 1, size, fp_);
+		WAVE11_METRIC_TIMER(timer, METRIC_WRITE_NS);
+		size_t ret = ::fwrite(buf, 1, size, fp_);
+		WAVE11_METRIC_ADD(METRIC_WRITE_CALLS, 1);
+		WAVE11_METRIC_ADD(METRIC_BYTES_WRITTEN, ret);
+		return ret;
+	}
+	/**
+	 * @brief	他のファイルの指定範囲をそのまま書き出す
+	 *
+	 * Linuxではcopy_file_rangeでカーネル内で複写し、ユーザー空間のバッファを経由しない
+	 * （対応するファイルシステムではデータブロックを共有する）。使えない場合や
+	 * 他の環境では位置指定読み込みとwriteBytesで複写する。
+	 * @param[in] src		複写元のファイル
+	 * @param[in] offset	複写元のバイトオフセット
+	 * @param[in] size		複写するバイトサイズ
+	 * @return	実際に書き出したバイトサイズ
+	 * @exception	WavIoException	ファイル未オープン、または読み込みエラー発生
+	 */
+	uint64_t copyFrom(PositionalFile& src, uint64_t offset, uint64_t size) WAVE11_THROWS(WavIoException) {
+		if (fp_ == nullptr) throw WavIoException("file isn't opened.");
+		uint64_t done = 0;
+#if defined(__linux__)
+		if (size > 0 && ::fflush(fp_) == 0) {
+			WAVE11_METRIC_TIMER(timer, METRIC_WRITE_NS);
+			loff_t in = static_cast<loff_t>(offset);
+			while (done < size) {
+				const uint64_t rest = size - done;
+				const size_t n = (rest < (static_cast<uint64_t>(1) << 30)) ? static_cast<size_t>(rest) : (static_cast<size_t>(1) << 30);
+				const ssize_t ret = ::copy_file_range(src.handle(), &in, ::fileno(fp_), nullptr, n, 0);
+				if (ret < 0 && errno == EINTR) continue;
+				if (ret <= 0) break;
+				done += static_cast<uint64_t>(ret);
+				WAVE11_METRIC_ADD(METRIC_WRITE_CALLS, 1);
+				WAVE11_METRIC_ADD(METRIC_BYTES_WRITTEN, ret);
+			}
+			// 記述子側で進んだ位置をFILEに反映する
+			if (done > 0 && ::WAVE11_FSEEK(fp_, 0, SEEK_END) != 0) {
+				throw WavIoException("stdio seek error.");
+			}
+		}
+#endif
+		if (done < size) {
+			const size_t chunk = 1 << 20;
+			PooledBuffer buf(static_cast<size_t>((size - done < chunk) ? size - done : chunk));
+			while (done < size) {
+				const size_t n = static_cast<size_t>((size - done < chunk) ? size - done : chunk);
+				const size_t got = src.readAt(buf.data(), n, offset + done);
+				if (got == 0) break;
+				const size_t wrote = writeBytes(buf.data(), got);
+				done += wrote;
+				if (wrote != got) break;
+			}
+		}
+		return done;
+	}
+	/**
+	 * @brief	バッファリングされたデータをファイルへ書き出す
+	 * @return	成功すれば真
+	 */
+	bool flush() {
+		return (fp_ == nullptr) ? false : (::fflush(fp_) == 0);
 	}
 	/**
 	 * @brief	ファイルの書き出し位置を設定
@@ -84,22 +153,39 @@ public:
 	 * @param[in] origin	fseekの移動モード指定。SEEK_CUR/SEEK_END/SEEK_SETの3種。
 	 * @return	移動に成功すれば真。
 	 */
-	bool seek(long offs, int origin) {
-		return (fp_ == nullptr) ? false : (::fseek(fp_, offs, origin) == 0);
+	bool seek(int64_t offs, int origin) {
+		if (fp_ == nullptr) return false;
+		WAVE11_METRIC_TIMER(timer, METRIC_SEEK_NS);
+		WAVE11_METRIC_ADD(METRIC_SEEK_CALLS, 1);
+		return ::WAVE11_FSEEK(fp_, offs, origin) == 0;
 	}
 	/**
 	 * @brief	ファイルのバイトオフセットを取得
 	 * @return	ファイルのバイトオフセット。エラー発生時は-1。
 	 */
-	long tell() {
-		return (fp_ == nullptr) ? -1 : ::ftell(fp_);
+	int64_t tell() {
+		if (fp_ == nullptr) return -1;
+		WAVE11_METRIC_ADD(METRIC_TELL_CALLS, 1);
+		return ::WAVE11_FTELL(fp_);
+	}
+	/**
+	 * @brief	64bit長のデータを64bit符号なし整数値として書き出す。
+	 * データの書き出しができない場合は例外を投入する。
+	 * @exception	WavIoException	書き出しエラー発生
+	 */
+	void writeQWORD(uint64_t n) WAVE11_THROWS(WavIoException) {
+		BYTE buf[8];
+		BYTE* p = toBytes(buf, n);
+		if (writeBytes(p, 8) != 8) {
+			throw WavIoException("stdio write error.");
+		}
 	}
 	/**
 	 * @brief	32bit長のデータを32bit符号なし整数値として書き出す。
 	 * データの書き出しができない場合は例外を投入する。
 	 * @exception	WavIoException	書き出しエラー発生
 	 */
-	void writeDWORD(DWORD n) throw (WavIoException) {
+	void writeDWORD(DWORD n) WAVE11_THROWS(WavIoException) {
 		BYTE buf[4];
 		BYTE* p = toBytes(buf, n);
 		if (writeBytes(p, 4) != 4) {
@@ -111,7 +197,7 @@ public:
 	 * データの書き出しができない場合は例外を投入する。
 	 * @exception	WavIoException	書き出しエラー発生
 	 */
-	void writeWORD(WORD n) throw (WavIoException) {
+	void writeWORD(WORD n) WAVE11_THROWS(WavIoException) {
 		BYTE buf[2];
 		BYTE* p = toBytes(buf, n);
 		if (writeBytes(p, 2) != 2) {
@@ -123,7 +209,7 @@ public:
 	* データの書き出しができない場合は例外を投入する。
 	* @exception	WavIoException	書き出しエラー発生
 	*/
-	void writeBYTE(BYTE b) throw (WavIoException) {
+	void writeBYTE(BYTE b) WAVE11_THROWS(WavIoException) {
 		if (writeBytes(&b, 1) != 1) {
 			throw WavIoException("stdio write error.");
 		}
@@ -0,0 +1,321 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	BlockCache.cpp
+ * @brief	変換済みサンプルブロックの共有キャッシュクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include <cstring>
+#include <functional>
+#include "BlockCache.h"
+#include "BufferPool.h"
+#include "HeaderCache.h"
+#include "SampleConverter.h"
+
+// ----------------------------------------------------------------------------
+// ファイルを開きます。
+/**
+ * ヘッダーを解析して形式とファイルの属性を取得し、位置指定読み込み用に開き直します。
+ *
+ * @param[in]	path	ファイルのパス
+ * @param[in]	cache	ヘッダーの解析結果キャッシュ。nullptrなら毎回解析する。
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool BlockSource::open(const tstring& path, HeaderCache* cache)
+{
+	file_.close();
+	const bool prepared = (cache != nullptr) ? cache->open(reader_, path)
+		: (reader_.open(path) && reader_.prepare());
+	if (!prepared || !reader_.getStamp(stamp_)
+		|| !SampleConverter::isSupported(reader_.getBitPerSample(), reader_.getFormatTag() == 1)) {
+		reader_.close();
+		return false;
+	}
+	reader_.close();
+	if (stamp_.inode == 0) {
+		stamp_.inode = static_cast<uint64_t>(std::hash<tstring>()(path));
+	}
+	// 解析後に差し替えられたファイルは開かない
+	return file_.openRead(path) && file_.size() == stamp_.size;
+}
+// ----------------------------------------------------------------------------
+// フレーム列を読み込み、32bit floatに変換します。
+/**
+ * キャッシュを通さずに読み込みます。複数のスレッドから同時に呼び出してよい。
+ *
+ * @param[in]	first	先頭のフレーム位置
+ * @param[in]	frames	フレーム数
+ * @param[out]	dst		frames×チャンネル数のサンプルを格納可能なバッファ
+ * return	読み込んだフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t BlockSource::decode(uint64_t first, size_t frames, float* dst) const
+{
+	const uint64_t total = getFrames();
+	if (first >= total) {
+		return 0;
+	}
+	if (total - first < frames) {
+		frames = static_cast<size_t>(total - first);
+	}
+	const size_t align = reader_.getBlockAlign();
+	const size_t count = frames * reader_.getChannels();
+	PooledBuffer raw(frames * align);
+	size_t got;
+	try {
+		got = file_.readAt(raw.data(), frames * align,
+			static_cast<uint64_t>(reader_.getStreamOffset()) + first * align);
+	} catch (const WavIoException&) {
+		return 0;
+	}
+	if (got < frames * align) {
+		::memset(raw.as<BYTE>() + got, 0, frames * align - got);
+	}
+	reader_.decodeFloat(raw.data(), dst, count);
+	return got / align;
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	コンストラクタ
+ * @param[in]	budget		保持するブロックのメモリ予算（バイト）
+ * @param[in]	blockFrames	1ブロックあたりのフレーム数
+ */
+// ----------------------------------------------------------------------------
+BlockCache::BlockCache(size_t budget, size_t blockFrames)
+: shardBudget_(budget / ShardCount),
+  blockFrames_((blockFrames == 0) ? DefaultBlockFrames : blockFrames),
+  prefetch_(DefaultPrefetch),
+  hits_(0),
+  misses_(0),
+  prefetched_(0),
+  evictions_(0)
+{
+}
+// ----------------------------------------------------------------------------
+// プロセス共通のインスタンスを取得します。
+/**
+ * 既定のメモリ予算とブロック長で初回の呼び出し時に構築します。
+ *
+ * return	プロセス共通のインスタンス
+ */
+// ----------------------------------------------------------------------------
+BlockCache& BlockCache::instance()
+{
+	static BlockCache cache;
+	return cache;
+}
+// ----------------------------------------------------------------------------
+// ブロックを取得します。
+/**
+ * 未登録なら読み込んで変換し、登録します。その際、後続の未登録ブロックを
+ * 先読みブロック数まで同じ読み込みでまとめて変換し、登録します。
+ *
+ * @param[in]	src		読み込むファイル
+ * @param[in]	index	ブロック番号
+ * return	ブロック。範囲外または読み込みエラーならnullptr。
+ */
+// ----------------------------------------------------------------------------
+BlockCache::Block BlockCache::getBlock(const BlockSource& src, uint64_t index)
+{
+	const uint64_t total = src.getFrames();
+	const uint64_t blocks = (total + blockFrames_ - 1) / blockFrames_;
+	if (index >= blocks) {
+		return Block();
+	}
+	Key key = { src.getStamp(), index };
+	Block block = find(key, true);
+	if (block) {
+		hits_++;
+		return block;
+	}
+	misses_++;
+
+	// 続けて未登録のブロックをまとめて読み込む
+	const size_t prefetch = prefetch_;
+	size_t run = 1;
+	while (run <= prefetch && index + run < blocks) {
+		Key next = { src.getStamp(), index + run };
+		if (find(next, false)) {
+			break;
+		}
+		run++;
+	}
+	const uint64_t first = index * blockFrames_;
+	const size_t frames = static_cast<size_t>((total - first < run * blockFrames_) ? total - first : run * blockFrames_);
+	const size_t ch = src.getChannels();
+	PooledBuffer decoded(frames * ch * sizeof(float));
+	const size_t got = src.decode(first, frames, decoded.as<float>());
+	if (got == 0) {
+		return Block();
+	}
+
+	Block result;
+	for (size_t i = 0; i * blockFrames_ < got; i++) {
+		const size_t n = (got - i * blockFrames_ < blockFrames_) ? got - i * blockFrames_ : blockFrames_;
+		const float* p = decoded.as<float>() + i * blockFrames_ * ch;
+		key.index = index + i;
+		Block b = insert(key, std::make_shared<const std::vector<float> >(p, p + n * ch));
+		if (i == 0) {
+			result = b;
+		} else {
+			prefetched_++;
+		}
+	}
+	return result;
+}
+// ----------------------------------------------------------------------------
+// フレーム列を32bit floatで読み込みます。
+/**
+ * 区間にかかるブロックをgetBlockで取得し、該当部分を複写します。
+ *
+ * @param[in]	src		読み込むファイル
+ * @param[in]	frame	先頭のフレーム位置
+ * @param[out]	dst		frames×チャンネル数のサンプルを格納可能なバッファ
+ * @param[in]	frames	フレーム数
+ * return	読み込んだフレーム数。ファイル終端では要求より少ない。
+ */
+// ----------------------------------------------------------------------------
+size_t BlockCache::read(const BlockSource& src, uint64_t frame, float* dst, size_t frames)
+{
+	const size_t ch = src.getChannels();
+	size_t done = 0;
+	while (done < frames) {
+		const uint64_t pos = frame + done;
+		Block block = getBlock(src, pos / blockFrames_);
+		if (!block) {
+			break;
+		}
+		const size_t offset = static_cast<size_t>(pos % blockFrames_);
+		const size_t avail = block->size() / ch;
+		if (offset >= avail) {
+			break;
+		}
+		const size_t n = (avail - offset < frames - done) ? avail - offset : frames - done;
+		::memcpy(dst + done * ch, block->data() + offset * ch, n * ch * sizeof(float));
+		done += n;
+	}
+	return done;
+}
+// ----------------------------------------------------------------------------
+// 統計値を取得します。
+/**
+ * return	統計値
+ */
+// ----------------------------------------------------------------------------
+BlockCache::Stats BlockCache::stats() const
+{
+	Stats s;
+	s.hits = hits_;
+	s.misses = misses_;
+	s.prefetched = prefetched_;
+	s.evictions = evictions_;
+	s.bytes = 0;
+	s.blocks = 0;
+	for (size_t i = 0; i < ShardCount; i++) {
+		const Shard& shard = shards_[i];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		s.bytes += shard.bytes;
+		s.blocks += shard.lru.size();
+	}
+	return s;
+}
+// ----------------------------------------------------------------------------
+// キャッシュを空にします。
+/**
+ * 貸し出し中のブロックは返却されるまで有効です。統計値も0に戻します。
+ */
+// ----------------------------------------------------------------------------
+void BlockCache::clear()
+{
+	for (size_t i = 0; i < ShardCount; i++) {
+		std::lock_guard<std::mutex> lock(shards_[i].mutex);
+		shards_[i].lru.clear();
+		shards_[i].index.clear();
+		shards_[i].bytes = 0;
+	}
+	hits_ = 0;
+	misses_ = 0;
+	prefetched_ = 0;
+	evictions_ = 0;
+}
+// ----------------------------------------------------------------------------
+// 登録済みのブロックを検索します。
+/**
+ * @param[in]	key		キー
+ * @param[in]	touch	見つかった項目を最新にするなら真
+ * return	ブロック。未登録ならnullptr。
+ */
+// ----------------------------------------------------------------------------
+BlockCache::Block BlockCache::find(const Key& key, bool touch)
+{
+	Shard& shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.index.find(key);
+	if (it == shard.index.end()) {
+		return Block();
+	}
+	if (touch) {
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+	}
+	return it->second->block;
+}
+// ----------------------------------------------------------------------------
+// ブロックを登録します。
+/**
+ * 他のスレッドが先に登録していればそちらを返します。登録後、シャードの予算を
+ * 越えた分を古い順に追い出します。登録したブロック自体は追い出しません。
+ *
+ * @param[in]	key		キー
+ * @param[in]	block	ブロック
+ * return	登録されているブロック
+ */
+// ----------------------------------------------------------------------------
+BlockCache::Block BlockCache::insert(const Key& key, const Block& block)
+{
+	Shard& shard = shardOf(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.index.find(key);
+	if (it != shard.index.end()) {
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+		return it->second->block;
+	}
+	Entry e;
+	e.key = key;
+	e.block = block;
+	e.bytes = block->size() * sizeof(float) + sizeof(Entry) + sizeof(std::vector<float>);
+	shard.lru.push_front(e);
+	shard.index[key] = shard.lru.begin();
+	shard.bytes += e.bytes;
+	while (shard.bytes > shardBudget_ && shard.lru.size() > 1) {
+		const Entry& victim = shard.lru.back();
+		shard.bytes -= victim.bytes;
+		shard.index.erase(victim.key);
+		shard.lru.pop_back();
+		evictions_++;
+	}
+	return block;
+}
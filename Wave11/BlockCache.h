@@ -0,0 +1,258 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	BlockCache.h
+ * @brief	変換済みサンプルブロックの共有キャッシュクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _BLOCKCACHE_H_
+#define _BLOCKCACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "PositionalFile.h"
+#include "RiffWavReader.h"
+
+class HeaderCache;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief BlockCacheから読み込むファイル
+ *
+ * ヘッダーを解析した後は位置指定読み込みだけを使うため、
+ * 同じインスタンスを複数のスレッドから同時に読み込んでよい。
+ */
+// ----------------------------------------------------------------------------
+class BlockSource : private Noncopyable
+{
+public:
+	BlockSource() : stamp_() {}
+	virtual ~BlockSource() {}
+
+	//! ファイルを開きます。
+	bool open(const tstring&, HeaderCache* = nullptr);
+	//! ファイルを閉じます。
+	void close() { file_.close(); }
+	/**
+	 * @brief	チャンネル数を取得する
+	 * @return	チャンネル数
+	 */
+	WORD getChannels() const { return reader_.getChannels(); }
+	/**
+	 * @brief	サンプリングレートを取得する
+	 * @return	サンプリングレート
+	 */
+	DWORD getSamplesPerSec() const { return reader_.getSamplesPerSec(); }
+	/**
+	 * @brief	フレーム数を取得する
+	 * @return	読み込み可能なフレーム数
+	 */
+	uint64_t getFrames() const { return reader_.getFrames(); }
+	/**
+	 * @brief	ファイルの属性を取得する
+	 * @return	open時のファイルの属性
+	 */
+	const FileStamp& getStamp() const { return stamp_; }
+	//! フレーム列を読み込み、32bit floatに変換します。
+	size_t decode(uint64_t, size_t, float*) const;
+
+private:
+	//! 形式とサンプル列の変換に使う読み込みクラス（ファイルは閉じている）
+	RiffWavReader reader_;
+	//! 位置指定読み込み用のファイル
+	mutable PositionalFile file_;
+	//! open時のファイルの属性
+	FileStamp stamp_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 32bit floatに変換したサンプルブロックの共有LRUキャッシュ
+ *
+ * ファイルの属性（デバイス・iノード・サイズ・最終更新時刻）とブロック番号を
+ * キーに、固定フレーム数のブロックを変換済みの形で保持する。同じファイルの
+ * 重なった区間を複数のクライアントに返す場合、読み込みと変換はブロックごとに
+ * 1回で済む。
+ *
+ * キーのハッシュ値で分けたシャードごとにロックとLRUリストを持ち、
+ * メモリ予算もシャードごとに等分して管理する。ブロックはshared_ptrで貸し出すため、
+ * 追い出された後も利用中のブロックは有効なままである。
+ *
+ * 未登録のブロックを読み込む際は、後続の未登録ブロックを先読み数まで
+ * 1回の位置指定読み込みでまとめて読み込み、登録する。
+ * このクラスはスレッドセーフである。
+ */
+// ----------------------------------------------------------------------------
+class BlockCache : private Noncopyable
+{
+public:
+	//! シャード数
+	static const size_t ShardCount = 16;
+	//! 既定のブロック長（フレーム数）
+	static const size_t DefaultBlockFrames = 16384;
+	//! 既定のメモリ予算（バイト）
+	static const size_t DefaultBudget = static_cast<size_t>(256) << 20;
+	//! 既定の先読みブロック数
+	static const size_t DefaultPrefetch = 2;
+
+	//! 変換済みのブロック（インターリーブ形式）
+	typedef std::shared_ptr<const std::vector<float> > Block;
+
+	/**
+	 * @brief 統計値
+	 */
+	struct Stats {
+		//! キャッシュから返したブロック数
+		uint64_t hits;
+		//! 読み込んで変換したブロック数（先読み分を除く）
+		uint64_t misses;
+		//! 先読みで登録したブロック数
+		uint64_t prefetched;
+		//! 予算超過で追い出したブロック数
+		uint64_t evictions;
+		//! 保持しているバイト数
+		uint64_t bytes;
+		//! 保持しているブロック数
+		uint64_t blocks;
+	};
+
+	BlockCache(size_t = DefaultBudget, size_t = DefaultBlockFrames);
+	virtual ~BlockCache() {}
+
+	//! プロセス共通のインスタンスを取得します。
+	static BlockCache& instance();
+
+	/**
+	 * @brief	ブロック長を取得する
+	 * @return	1ブロックあたりのフレーム数
+	 */
+	size_t blockFrames() const { return blockFrames_; }
+	/**
+	 * @brief	先読みブロック数を設定する
+	 * @param[in]	blocks	未登録ブロックの読み込み時に続けて読み込むブロック数。0で先読みなし。
+	 */
+	void setPrefetch(size_t blocks) { prefetch_ = blocks; }
+	//! ブロックを取得します。
+	Block getBlock(const BlockSource&, uint64_t);
+	//! フレーム列を32bit floatで読み込みます。
+	size_t read(const BlockSource&, uint64_t, float*, size_t);
+	//! 統計値を取得します。
+	Stats stats() const;
+	//! キャッシュを空にします。
+	void clear();
+
+private:
+	/**
+	 * @brief ブロックを識別するキー
+	 */
+	struct Key {
+		//! ファイルの属性
+		FileStamp stamp;
+		//! ブロック番号
+		uint64_t index;
+
+		bool operator ==(const Key& rhs) const {
+			return index == rhs.index && stamp.inode == rhs.stamp.inode && stamp.device == rhs.stamp.device
+				&& stamp.size == rhs.stamp.size && stamp.mtime == rhs.stamp.mtime;
+		}
+	};
+	/**
+	 * @brief キーのハッシュ関数
+	 */
+	struct KeyHash {
+		size_t operator ()(const Key& k) const {
+			uint64_t h = k.stamp.inode * 0x9E3779B97F4A7C15ULL;
+			h ^= k.stamp.device + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+			h ^= static_cast<uint64_t>(k.stamp.mtime) + (h << 6) + (h >> 2);
+			h ^= k.index * 0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+			return static_cast<size_t>(h ^ (h >> 31));
+		}
+	};
+	/**
+	 * @brief キャッシュの項目
+	 */
+	struct Entry {
+		//! キー
+		Key key;
+		//! 変換済みのブロック
+		Block block;
+		//! 見積もりバイト数
+		size_t bytes;
+	};
+	typedef std::list<Entry> EntryList;
+	/**
+	 * @brief シャード
+	 */
+	struct Shard {
+		//! 排他制御
+		mutable std::mutex mutex;
+		//! 最近使った順の項目（先頭が最新）
+		EntryList lru;
+		//! キーから項目への索引
+		std::unordered_map<Key, EntryList::iterator, KeyHash> index;
+		//! 保持しているバイト数
+		size_t bytes;
+
+		Shard() : bytes(0) {}
+	};
+
+	//! シャードごとのメモリ予算
+	const size_t shardBudget_;
+	//! 1ブロックあたりのフレーム数
+	const size_t blockFrames_;
+	//! 先読みブロック数
+	std::atomic<size_t> prefetch_;
+	//! シャード
+	Shard shards_[ShardCount];
+	//! キャッシュから返したブロック数
+	std::atomic<uint64_t> hits_;
+	//! 読み込んで変換したブロック数
+	std::atomic<uint64_t> misses_;
+	//! 先読みで登録したブロック数
+	std::atomic<uint64_t> prefetched_;
+	//! 追い出したブロック数
+	std::atomic<uint64_t> evictions_;
+
+	/**
+	 * @brief	キーのシャードを求める
+	 * @param[in]	key	キー
+	 * @return	シャード
+	 */
+	Shard& shardOf(const Key& key) {
+		return shards_[KeyHash()(key) % ShardCount];
+	}
+	//! 登録済みのブロックを検索します。
+	Block find(const Key&, bool);
+	//! ブロックを登録します。
+	Block insert(const Key&, const Block&);
+};
+
+#endif // !_BLOCKCACHE_H_
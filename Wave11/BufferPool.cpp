@@ -0,0 +1,332 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	BufferPool.cpp
+ * @brief	サンプルバッファのプールの実装
+ */
+// ----------------------------------------------------------------------------
+#include "BufferPool.h"
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32) && defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace {
+
+//! 最小のサイズクラスのバイトサイズ
+const size_t MinClassSize = 256;
+
+//! バイトサイズからサイズクラスを求める
+size_t classOf(size_t size) {
+	size_t cls = 0;
+	size_t cap = MinClassSize;
+	while (cap < size && cls < BufferPool::ClassCount) {
+		cap <<= 1;
+		cls++;
+	}
+	return cls;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief スレッドごとのキャッシュ
+ *
+ * スレッド終了時に保持しているブロックを共有の解放リストへ戻す。
+ */
+// ----------------------------------------------------------------------------
+struct BufferPool::ThreadCache {
+	//! サイズクラスごとのブロック列
+	Header* head[ClassCount];
+	//! サイズクラスごとのブロック数
+	size_t count[ClassCount];
+
+	ThreadCache() {
+		for (size_t i = 0; i < ClassCount; i++) {
+			head[i] = nullptr;
+			count[i] = 0;
+		}
+	}
+	~ThreadCache() { flush(); }
+
+	//! 全ブロックを共有の解放リストへ戻す
+	void flush() {
+		BufferPool& pool = BufferPool::instance();
+		for (size_t i = 0; i < ClassCount; i++) {
+			if (head[i] == nullptr) continue;
+			Header* tail = head[i];
+			while (tail->next != nullptr) tail = tail->next;
+			pool.pushShared(i, head[i], tail, count[i]);
+			head[i] = nullptr;
+			count[i] = 0;
+		}
+	}
+};
+
+// ----------------------------------------------------------------------------
+// プロセス共通のインスタンスを取得します。
+/**
+ * インスタンスはプロセス終了まで破棄されないため、
+ * 静的オブジェクトのデストラクタやスレッド終了処理から使ってもよい。
+ *
+ * @return	BufferPoolのインスタンス
+ */
+// ----------------------------------------------------------------------------
+BufferPool& BufferPool::instance()
+{
+	static BufferPool* pool = new BufferPool();
+	return *pool;
+}
+// ----------------------------------------------------------------------------
+BufferPool::BufferPool()
+: systemAllocations_(0),
+  systemFrees_(0),
+  acquisitions_(0),
+  pooledBytes_(0)
+{
+	for (size_t i = 0; i < ClassCount; i++) {
+		freeList_[i] = nullptr;
+	}
+}
+// ----------------------------------------------------------------------------
+BufferPool::~BufferPool()
+{
+	trim();
+}
+// ----------------------------------------------------------------------------
+// 呼び出しスレッドのキャッシュを取得します。
+// ----------------------------------------------------------------------------
+BufferPool::ThreadCache& BufferPool::threadCache()
+{
+	static thread_local ThreadCache cache;
+	return cache;
+}
+// ----------------------------------------------------------------------------
+// バッファを確保します。
+/**
+ * スレッドローカルのキャッシュ、共有の解放リスト、システムの順に確保を試みます。
+ *
+ * @param[in]	size	バイトサイズ
+ * @return	64バイト境界に揃ったバッファ。sizeが0ならnullptr。
+ * @exception	std::bad_alloc	メモリ不足
+ */
+// ----------------------------------------------------------------------------
+void* BufferPool::allocate(size_t size)
+{
+	if (size == 0) {
+		return nullptr;
+	}
+	acquisitions_.fetch_add(1, std::memory_order_relaxed);
+
+	const size_t cls = classOf(size);
+	if (cls >= ClassCount) {
+		return reinterpret_cast<BYTE*>(systemAllocate(size, ClassCount)) + Alignment;
+	}
+
+	ThreadCache& tc = threadCache();
+	Header* h = tc.head[cls];
+	if (h != nullptr) {
+		tc.head[cls] = h->next;
+		tc.count[cls]--;
+	} else {
+		h = popShared(cls);
+		if (h == nullptr) {
+			h = systemAllocate(MinClassSize << cls, cls);
+		}
+	}
+	h->next = nullptr;
+	return reinterpret_cast<BYTE*>(h) + Alignment;
+}
+// ----------------------------------------------------------------------------
+// バッファを返却します。
+/**
+ * スレッドローカルのキャッシュに空きがあればそこへ、なければ共有の解放リストへ戻します。
+ *
+ * @param[in]	p	allocateで確保したバッファ。nullptrなら何もしない。
+ */
+// ----------------------------------------------------------------------------
+void BufferPool::release(void* p)
+{
+	if (p == nullptr) {
+		return;
+	}
+	Header* h = headerOf(p);
+	const size_t cls = h->cls;
+	if (cls >= ClassCount) {
+		systemFree(h);
+		return;
+	}
+
+	ThreadCache& tc = threadCache();
+	if (tc.count[cls] < ThreadCacheDepth) {
+		h->next = tc.head[cls];
+		tc.head[cls] = h;
+		tc.count[cls]++;
+	} else {
+		h->next = nullptr;
+		pushShared(cls, h, h, 1);
+	}
+}
+// ----------------------------------------------------------------------------
+// 確保したブロックの実際のバイトサイズを取得します。
+/**
+ * @param[in]	p	allocateで確保したバッファ
+ * @return	サイズクラスに切り上げたバイトサイズ
+ */
+// ----------------------------------------------------------------------------
+size_t BufferPool::capacity(const void* p)
+{
+	return (p == nullptr) ? 0 : headerOf(p)->capacity;
+}
+// ----------------------------------------------------------------------------
+// 呼び出しスレッドのキャッシュを共有の解放リストへ戻します。
+/**
+ * 長時間待機するスレッドが保持しているブロックを他のスレッドへ回す場合に使います。
+ */
+// ----------------------------------------------------------------------------
+void BufferPool::flushThreadCache()
+{
+	threadCache().flush();
+}
+// ----------------------------------------------------------------------------
+// 共有の解放リストのブロックをシステムへ返却します。
+/**
+ * 各スレッドのキャッシュに保持されているブロックは返却されません。
+ */
+// ----------------------------------------------------------------------------
+void BufferPool::trim()
+{
+	Header* lists[ClassCount];
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (size_t i = 0; i < ClassCount; i++) {
+			lists[i] = freeList_[i];
+			freeList_[i] = nullptr;
+		}
+		pooledBytes_ = 0;
+	}
+	for (size_t i = 0; i < ClassCount; i++) {
+		while (lists[i] != nullptr) {
+			Header* next = lists[i]->next;
+			systemFree(lists[i]);
+			lists[i] = next;
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// 統計値を取得します。
+/**
+ * 定常状態の読み書きループでsystemAllocationsが増えないことを確認できます。
+ *
+ * @return	統計値
+ */
+// ----------------------------------------------------------------------------
+BufferPool::Stats BufferPool::stats() const
+{
+	Stats s;
+	s.systemAllocations = systemAllocations_.load();
+	s.systemFrees = systemFrees_.load();
+	s.acquisitions = acquisitions_.load();
+	std::lock_guard<std::mutex> lock(mutex_);
+	s.pooledBytes = pooledBytes_;
+	return s;
+}
+// ----------------------------------------------------------------------------
+// システムからブロックを確保します。
+/**
+ * @param[in]	capacity	ペイロードのバイトサイズ
+ * @param[in]	cls			サイズクラス
+ * @return	管理領域を初期化したブロック
+ * @exception	std::bad_alloc	メモリ不足
+ */
+// ----------------------------------------------------------------------------
+BufferPool::Header* BufferPool::systemAllocate(size_t capacity, size_t cls)
+{
+	void* raw = nullptr;
+#if defined(_WIN32) && defined(_MSC_VER)
+	raw = ::_aligned_malloc(Alignment + capacity, Alignment);
+#else
+	if (::posix_memalign(&raw, Alignment, Alignment + capacity) != 0) {
+		raw = nullptr;
+	}
+#endif
+	if (raw == nullptr) {
+		throw std::bad_alloc();
+	}
+	systemAllocations_.fetch_add(1, std::memory_order_relaxed);
+	Header* h = static_cast<Header*>(raw);
+	h->next = nullptr;
+	h->capacity = capacity;
+	h->cls = cls;
+	return h;
+}
+// ----------------------------------------------------------------------------
+// システムへブロックを返却します。
+// ----------------------------------------------------------------------------
+void BufferPool::systemFree(Header* h)
+{
+	systemFrees_.fetch_add(1, std::memory_order_relaxed);
+#if defined(_WIN32) && defined(_MSC_VER)
+	::_aligned_free(h);
+#else
+	::free(h);
+#endif
+}
+// ----------------------------------------------------------------------------
+// 共有の解放リストからブロックを取り出します。
+/**
+ * @param[in]	cls	サイズクラス
+ * @return	ブロック。空ならnullptr。
+ */
+// ----------------------------------------------------------------------------
+BufferPool::Header* BufferPool::popShared(size_t cls)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Header* h = freeList_[cls];
+	if (h != nullptr) {
+		freeList_[cls] = h->next;
+		pooledBytes_ -= h->capacity;
+	}
+	return h;
+}
+// ----------------------------------------------------------------------------
+// 共有の解放リストへブロック列を戻します。
+/**
+ * @param[in]	cls		サイズクラス
+ * @param[in]	head	ブロック列の先頭
+ * @param[in]	tail	ブロック列の末尾
+ * @param[in]	count	ブロック数
+ */
+// ----------------------------------------------------------------------------
+void BufferPool::pushShared(size_t cls, Header* head, Header* tail, size_t count)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	tail->next = freeList_[cls];
+	freeList_[cls] = head;
+	pooledBytes_ += static_cast<uint64_t>(count) * (MinClassSize << cls);
+}
@@ -0,0 +1,224 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	BufferPool.h
+ * @brief	サンプルバッファのプールのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _BUFFERPOOL_H_
+#define _BUFFERPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief プロセス共通のサンプルバッファプール
+ *
+ * 256バイトから始まる2のべき乗のサイズクラスごとに解放済みブロックを保持し、
+ * 次の確保要求で再利用する。ブロックの先頭は64バイト境界に揃う。
+ * 各スレッドはサイズクラスごとに少数のブロックをスレッドローカルに保持するため、
+ * 同じスレッドでの確保・解放の繰り返しはロックもヒープ確保も行わない。
+ *
+ * 最大のサイズクラスを超える要求はプールを通さず直接確保・解放する。
+ * このクラスはスレッドセーフである。
+ */
+// ----------------------------------------------------------------------------
+class BufferPool : private Noncopyable
+{
+public:
+	//! ブロック先頭のアラインメント
+	static const size_t Alignment = 64;
+	//! サイズクラス数（256B～128MiB）
+	static const size_t ClassCount = 20;
+	//! スレッドローカルにサイズクラスごとに保持するブロック数
+	static const size_t ThreadCacheDepth = 8;
+
+	/**
+	 * @brief 統計値
+	 */
+	struct Stats {
+		//! システムから確保したブロック数
+		uint64_t systemAllocations;
+		//! システムへ返却したブロック数
+		uint64_t systemFrees;
+		//! プールから貸し出した回数
+		uint64_t acquisitions;
+		//! 共有の解放リストに保持しているバイト数
+		uint64_t pooledBytes;
+	};
+
+	//! プロセス共通のインスタンスを取得します。
+	static BufferPool& instance();
+
+	//! バッファを確保します。
+	void* allocate(size_t);
+	//! バッファを返却します。
+	void release(void*);
+	//! 確保したブロックの実際のバイトサイズを取得します。
+	static size_t capacity(const void*);
+	//! 呼び出しスレッドのキャッシュを共有の解放リストへ戻します。
+	void flushThreadCache();
+	//! 共有の解放リストのブロックをシステムへ返却します。
+	void trim();
+	//! 統計値を取得します。
+	Stats stats() const;
+
+private:
+	/**
+	 * @brief ブロック先頭の管理領域（64バイト）
+	 */
+	struct Header {
+		//! 解放リストの次のブロック
+		Header* next;
+		//! ペイロードのバイトサイズ
+		size_t capacity;
+		//! サイズクラス。ClassCountならプール対象外。
+		size_t cls;
+	};
+
+	//! スレッドごとのキャッシュ
+	struct ThreadCache;
+	friend struct ThreadCache;
+
+	//! サイズクラスごとの共有の解放リスト
+	Header* freeList_[ClassCount];
+	//! 共有の解放リストの排他
+	mutable std::mutex mutex_;
+	//! システムから確保したブロック数
+	std::atomic<uint64_t> systemAllocations_;
+	//! システムへ返却したブロック数
+	std::atomic<uint64_t> systemFrees_;
+	//! プールから貸し出した回数
+	std::atomic<uint64_t> acquisitions_;
+	//! 共有の解放リストに保持しているバイト数
+	uint64_t pooledBytes_;
+
+	BufferPool();
+	~BufferPool();
+
+	//! 呼び出しスレッドのキャッシュを取得します。
+	static ThreadCache& threadCache();
+	//! システムからブロックを確保します。
+	Header* systemAllocate(size_t, size_t);
+	//! システムへブロックを返却します。
+	void systemFree(Header*);
+	//! 共有の解放リストからブロックを取り出します。
+	Header* popShared(size_t);
+	//! 共有の解放リストへブロック列を戻します。
+	void pushShared(size_t, Header*, Header*, size_t);
+	//! ペイロードから管理領域を求めます。
+	static Header* headerOf(const void* p) {
+		return reinterpret_cast<Header*>(const_cast<BYTE*>(static_cast<const BYTE*>(p)) - Alignment);
+	}
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief BufferPoolから確保したバッファを保持するクラス
+ *
+ * スコープを抜けるとバッファをプールへ返却する。ムーブは可能、コピーは不可。
+ */
+// ----------------------------------------------------------------------------
+class PooledBuffer
+{
+public:
+	PooledBuffer() : data_(nullptr), size_(0) {}
+	/**
+	 * @param[in]	size	バイトサイズ
+	 */
+	explicit PooledBuffer(size_t size) : data_(nullptr), size_(0) { resize(size); }
+	PooledBuffer(PooledBuffer&& other) : data_(other.data_), size_(other.size_) {
+		other.data_ = nullptr;
+		other.size_ = 0;
+	}
+	PooledBuffer& operator =(PooledBuffer&& other) {
+		if (this != &other) {
+			reset();
+			data_ = other.data_;
+			size_ = other.size_;
+			other.data_ = nullptr;
+			other.size_ = 0;
+		}
+		return *this;
+	}
+	~PooledBuffer() { reset(); }
+
+	/**
+	 * @brief	バイトサイズを変更する
+	 *
+	 * 現在のブロックに収まる場合は再確保しない。再確保した場合、内容は保持されない。
+	 *
+	 * @param[in]	size	バイトサイズ
+	 */
+	void resize(size_t size) {
+		if (data_ == nullptr || BufferPool::capacity(data_) < size) {
+			reset();
+			if (size > 0) {
+				data_ = BufferPool::instance().allocate(size);
+			}
+		}
+		size_ = size;
+	}
+	//! バッファをプールへ返却する
+	void reset() {
+		if (data_ != nullptr) {
+			BufferPool::instance().release(data_);
+			data_ = nullptr;
+		}
+		size_ = 0;
+	}
+	/**
+	 * @brief	バッファの先頭を取得する
+	 * @return	64バイト境界に揃ったバッファの先頭
+	 */
+	void* data() const { return data_; }
+	/**
+	 * @brief	型を指定してバッファの先頭を取得する
+	 * @return	バッファの先頭
+	 */
+	template <class T>
+	T* as() const { return static_cast<T*>(data_); }
+	/**
+	 * @brief	バイトサイズを取得する
+	 * @return	resizeで指定したバイトサイズ
+	 */
+	size_t size() const { return size_; }
+
+private:
+	//! バッファの先頭
+	void* data_;
+	//! バイトサイズ
+	size_t size_;
+
+	PooledBuffer(const PooledBuffer&) = delete;
+	PooledBuffer& operator =(const PooledBuffer&) = delete;
+};
+
+#endif // !_BUFFERPOOL_H_
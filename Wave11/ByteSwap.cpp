@@ -0,0 +1,250 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ByteSwap.cpp
+ * @brief	サンプル列のバイト順反転クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "ByteSwap.h"
+#include "Metrics.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BYTESWAP_USE_SSE2
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define BYTESWAP_USE_SSSE3
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BYTESWAP_USE_AVX2
+#endif
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	1サンプルずつバイト順を反転する
+ *
+ * 入力と出力が同じ領域でもよい。
+ */
+// ----------------------------------------------------------------------------
+void copyScalar(const BYTE* s, BYTE* d, size_t count, size_t width)
+{
+	for (size_t i = 0; i < count; i++, s += width, d += width) {
+		for (size_t b = 0; b < width / 2; b++) {
+			const BYTE lo = s[b];
+			const BYTE hi = s[width - 1 - b];
+			d[b] = hi;
+			d[width - 1 - b] = lo;
+		}
+		if (width & 1) {
+			d[width / 2] = s[width / 2];
+		}
+	}
+}
+
+#if defined(BYTESWAP_USE_SSSE3)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	幅ごとのpshufbのマスクを作る
+ *
+ * 2/4/8バイト幅用。16バイトに含まれる全サンプルを反転する。
+ */
+// ----------------------------------------------------------------------------
+__m128i shuffleMask(size_t width)
+{
+	BYTE mask[16];
+	for (size_t i = 0; i < 16; i++) {
+		mask[i] = static_cast<BYTE>(i / width * width + width - 1 - i % width);
+	}
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+}
+// ----------------------------------------------------------------------------
+/**
+ * @brief	3バイト幅の48バイト（16サンプル）分のpshufbのマスクを作る
+ *
+ * 出力の16バイトoごとに、入力の16バイトiから取るバイトの位置を格納する。
+ * 取らない位置は0x80（結果は0）で、入力3つ分の結果の論理和が出力になる。
+ */
+// ----------------------------------------------------------------------------
+void shuffleMask24(__m128i (&masks)[3][3])
+{
+	for (size_t o = 0; o < 3; o++) {
+		for (size_t i = 0; i < 3; i++) {
+			BYTE mask[16];
+			for (size_t b = 0; b < 16; b++) {
+				const size_t p = o * 16 + b;
+				const size_t from = p / 3 * 3 + 2 - p % 3;
+				mask[b] = (from / 16 == i) ? static_cast<BYTE>(from % 16) : 0x80;
+			}
+			masks[o][i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+		}
+	}
+}
+#endif
+
+#if defined(BYTESWAP_USE_SSE2) && !defined(BYTESWAP_USE_SSSE3)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	3バイト幅の48バイト（16サンプル）分のSSE2用の選択マスクを作る
+ *
+ * 出力の16バイトoごとに、2バイト後ろ・同じ位置・2バイト前の各バイトを
+ * 取る位置を0xFFとする。サンプルの先頭は2バイト後ろ、中央はそのまま、
+ * 末尾は2バイト前のバイトを取る。
+ */
+// ----------------------------------------------------------------------------
+void selectMask24(__m128i (&masks)[3][3])
+{
+	for (size_t o = 0; o < 3; o++) {
+		BYTE mask[3][16];
+		for (size_t b = 0; b < 16; b++) {
+			const size_t r = (o * 16 + b) % 3;
+			for (size_t k = 0; k < 3; k++) {
+				mask[k][b] = (r == k) ? 0xFF : 0;
+			}
+		}
+		for (size_t k = 0; k < 3; k++) {
+			masks[o][k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask[k]));
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+/**
+ * @brief	選択マスクで3つのベクトルからバイトを選ぶ
+ */
+// ----------------------------------------------------------------------------
+inline __m128i select24(__m128i next, __m128i self, __m128i prev, const __m128i (&mask)[3])
+{
+	return _mm_or_si128(_mm_or_si128(_mm_and_si128(next, mask[0]), _mm_and_si128(self, mask[1])),
+		_mm_and_si128(prev, mask[2]));
+}
+#endif
+
+#if defined(BYTESWAP_USE_SSE2)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	16bitの各要素のバイト順を反転する
+ */
+// ----------------------------------------------------------------------------
+inline __m128i swap16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// サンプル列のバイト順を反転して複写します。
+/**
+ * 入力と出力は同じ領域でもよいが、ずれて重なってはならない。
+ *
+ * @param[in]	src		入力のサンプル列
+ * @param[out]	dst		出力先。count * widthバイトが必要。
+ * @param[in]	count	サンプル数
+ * @param[in]	width	1サンプルのバイトサイズ。1以下なら複写のみ。
+ */
+// ----------------------------------------------------------------------------
+void ByteSwap::copy(const void* src, void* dst, size_t count, size_t width)
+{
+	WAVE11_METRIC_TIMER(timer, METRIC_CONVERT_NS);
+	const BYTE* s = static_cast<const BYTE*>(src);
+	BYTE* d = static_cast<BYTE*>(dst);
+	if (width <= 1) {
+		if (s != d) {
+			for (size_t i = 0; i < count * width; i++) {
+				d[i] = s[i];
+			}
+		}
+		return;
+	}
+	size_t bytes = count * width;
+
+#if defined(BYTESWAP_USE_SSSE3)
+	if (width == 3) {
+		__m128i m[3][3];
+		shuffleMask24(m);
+		for (; bytes >= 48; bytes -= 48, s += 48, d += 48) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+			const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+			const __m128i o0 = _mm_or_si128(_mm_shuffle_epi8(a, m[0][0]), _mm_shuffle_epi8(b, m[0][1]));
+			const __m128i o1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m[1][0]), _mm_shuffle_epi8(b, m[1][1])),
+				_mm_shuffle_epi8(c, m[1][2]));
+			const __m128i o2 = _mm_or_si128(_mm_shuffle_epi8(b, m[2][1]), _mm_shuffle_epi8(c, m[2][2]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), o0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16), o1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 32), o2);
+		}
+	} else if (width == 2 || width == 4 || width == 8) {
+		const __m128i mask = shuffleMask(width);
+#if defined(BYTESWAP_USE_AVX2)
+		const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+		for (; bytes >= 32; bytes -= 32, s += 32, d += 32) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(d), _mm256_shuffle_epi8(v, mask2));
+		}
+#endif
+		for (; bytes >= 16; bytes -= 16, s += 16, d += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_shuffle_epi8(v, mask));
+		}
+	}
+#elif defined(BYTESWAP_USE_SSE2)
+	if (width == 3) {
+		// 48バイト内のバイトシフトで前後2バイトずらしたベクトルを作り、選択する
+		__m128i m[3][3];
+		selectMask24(m);
+		for (; bytes >= 48; bytes -= 48, s += 48, d += 48) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+			const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+			const __m128i o0 = select24(_mm_or_si128(_mm_srli_si128(a, 2), _mm_slli_si128(b, 14)), a,
+				_mm_slli_si128(a, 2), m[0]);
+			const __m128i o1 = select24(_mm_or_si128(_mm_srli_si128(b, 2), _mm_slli_si128(c, 14)), b,
+				_mm_or_si128(_mm_slli_si128(b, 2), _mm_srli_si128(a, 14)), m[1]);
+			const __m128i o2 = select24(_mm_srli_si128(c, 2), c,
+				_mm_or_si128(_mm_slli_si128(c, 2), _mm_srli_si128(b, 14)), m[2]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), o0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16), o1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 32), o2);
+		}
+	} else if (width == 2 || width == 4 || width == 8) {
+		for (; bytes >= 16; bytes -= 16, s += 16, d += 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+			if (width == 4) {
+				v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			} else if (width == 8) {
+				v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), swap16(v));
+		}
+	}
+#endif
+
+	copyScalar(s, d, bytes / width, width);
+}
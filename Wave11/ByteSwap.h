@@ -0,0 +1,61 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ByteSwap.h
+ * @brief	サンプル列のバイト順反転クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _BYTESWAP_H_
+#define _BYTESWAP_H_
+
+#include "WavIoType.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief サンプル列のバイト順反転クラス
+ *
+ * ビッグエンディアンのストリーム（RIFXなど）とリトルエンディアンのストリームを
+ * 相互に変換する。2/3/4/8バイト幅に対応し、SSE2・SSSE3・AVX2が使える場合は
+ * 16/32バイト単位でまとめて反転する。
+ */
+// ----------------------------------------------------------------------------
+class ByteSwap
+{
+public:
+	//! サンプル列のバイト順を反転して複写します。
+	static void copy(const void*, void*, size_t, size_t);
+	/**
+	 * @brief	サンプル列のバイト順をその場で反転する
+	 * @param[in,out]	buf		サンプル列
+	 * @param[in]		count	サンプル数
+	 * @param[in]		width	1サンプルのバイトサイズ
+	 */
+	static void swap(void* buf, size_t count, size_t width) { copy(buf, buf, count, width); }
+
+private:
+	ByteSwap();
+};
+
+#endif // !_BYTESWAP_H_
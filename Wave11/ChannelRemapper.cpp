@@ -0,0 +1,293 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ChannelRemapper.cpp
+ * @brief	チャンネルの抽出・並べ替えクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "ChannelRemapper.h"
+#include <cstring>
+#include <memory>
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+#include "BufferPool.h"
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define CHANNELREMAPPER_USE_SSSE3
+#endif
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	サンプル幅を固定したチャンネル収集
+ *
+ * 幅が定数のためmemcpyは1回のロード・ストアになる。
+ */
+// ----------------------------------------------------------------------------
+template <size_t W>
+void gatherFixed(const BYTE* src, size_t srcCh, BYTE* dst, const WORD* map, size_t dstCh, size_t frames)
+{
+	const size_t srcFrame = srcCh * W;
+	for (size_t i = 0; i < frames; i++) {
+		for (size_t c = 0; c < dstCh; c++) {
+			::memcpy(dst + c * W, src + map[c] * W, W);
+		}
+		src += srcFrame;
+		dst += dstCh * W;
+	}
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	3バイト幅のチャンネル収集
+ *
+ * 各サンプルを4バイトで読み書きし、余分な1バイトは次のサンプルで上書きする。
+ * 3バイトの複写は2回のロード・ストアになるため、1回にまとめる。
+ * 4バイトの読み書きが入出力の終端を越えないよう、最後のフレームは3バイトで複写する。
+ */
+// ----------------------------------------------------------------------------
+void gather3(const BYTE* src, size_t srcCh, BYTE* dst, const WORD* map, size_t dstCh, size_t frames)
+{
+	if (frames == 0) {
+		return;
+	}
+	const size_t srcFrame = srcCh * 3;
+	for (size_t i = 0; i + 1 < frames; i++) {
+		for (size_t c = 0; c < dstCh; c++) {
+			uint32_t v;
+			::memcpy(&v, src + map[c] * 3, 4);
+			::memcpy(dst + c * 3, &v, 4);
+		}
+		src += srcFrame;
+		dst += dstCh * 3;
+	}
+	gatherFixed<3>(src, srcCh, dst, map, dstCh, 1);
+}
+
+#if defined(CHANNELREMAPPER_USE_SSSE3)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	16バイトに複数フレームが収まる場合のpshufbによるチャンネル収集
+ *
+ * 入力の1フレームが16の約数のバイトサイズで、出力のフレームが入力以下の場合に、
+ * 16バイトに含まれる全フレームを1回のシャッフルで並べ替える。
+ *
+ * @return	処理したフレーム数。残りは呼び出し側で処理する。
+ */
+// ----------------------------------------------------------------------------
+size_t gatherShuffle(const BYTE* src, size_t srcCh, BYTE* dst, const WORD* map, size_t dstCh, size_t width, size_t frames)
+{
+	const size_t srcFrame = srcCh * width;
+	const size_t dstFrame = dstCh * width;
+	if (srcFrame > 16 || 16 % srcFrame != 0 || dstFrame > srcFrame) {
+		return 0;
+	}
+	const size_t per = 16 / srcFrame;
+	BYTE mask[16];
+	::memset(mask, 0x80, sizeof(mask));
+	for (size_t j = 0; j < per; j++) {
+		for (size_t c = 0; c < dstCh; c++) {
+			for (size_t b = 0; b < width; b++) {
+				mask[j * dstFrame + c * width + b] = static_cast<BYTE>(j * srcFrame + map[c] * width + b);
+			}
+		}
+	}
+	const __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+
+	// 16バイトのストアが出力の終端を越えない範囲
+	size_t i = 0;
+	for (; i + per <= frames && (i * dstFrame + 16) <= frames * dstFrame; i += per) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * srcFrame));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * dstFrame), _mm_shuffle_epi8(v, m));
+	}
+	return i;
+}
+#endif
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// インターリーブ形式のフレームからチャンネルを集めます。
+/**
+ * 2・4バイト幅は幅を固定した複写、3バイト幅は4バイトの重ね書き、SSSE3が使える場合
+ * （-mssse3、-march=x86-64-v2以降）は16バイトに複数フレームが収まる形式
+ * （2チャンネル16bitの入れ替えなど）をシャッフル命令で処理します。
+ * 1フレームが16バイトを超える形式は、16バイトに組み立ててからストアしても
+ * 幅を固定した複写より速くならないため、SIMD命令を使いません。
+ *
+ * @param[in]	src		入力のインターリーブ形式のフレーム
+ * @param[in]	srcCh	入力のチャンネル数
+ * @param[out]	dst		出力先。frames * dstCh * widthバイトが必要。
+ * @param[in]	map		出力の各チャンネルに対応する入力チャンネル番号
+ * @param[in]	dstCh	出力のチャンネル数
+ * @param[in]	width	1サンプルのバイトサイズ
+ * @param[in]	frames	フレーム数
+ */
+// ----------------------------------------------------------------------------
+void ChannelRemapper::gather(const void* src, size_t srcCh, void* dst, const WORD* map, size_t dstCh, size_t width, size_t frames)
+{
+	const BYTE* s = static_cast<const BYTE*>(src);
+	BYTE* d = static_cast<BYTE*>(dst);
+#if defined(CHANNELREMAPPER_USE_SSSE3)
+	const size_t done = gatherShuffle(s, srcCh, d, map, dstCh, width, frames);
+	s += done * srcCh * width;
+	d += done * dstCh * width;
+	frames -= done;
+#endif
+	switch (width) {
+	case 2:
+		gatherFixed<2>(s, srcCh, d, map, dstCh, frames);
+		break;
+	case 3:
+		gather3(s, srcCh, d, map, dstCh, frames);
+		break;
+	case 4:
+		gatherFixed<4>(s, srcCh, d, map, dstCh, frames);
+		break;
+	case 1:
+		gatherFixed<1>(s, srcCh, d, map, dstCh, frames);
+		break;
+	default:
+		for (size_t i = 0; i < frames; i++) {
+			for (size_t c = 0; c < dstCh; c++) {
+				::memcpy(d + c * width, s + map[c] * width, width);
+			}
+			s += srcCh * width;
+			d += dstCh * width;
+		}
+		break;
+	}
+}
+// ----------------------------------------------------------------------------
+// チャンネルを選んで書き出します。
+/**
+ * 入力を一定サイズのブロックで先頭から一度だけ読み込み、ブロックごとに
+ * 全出力のチャンネル収集と書き出しを行います。出力のコンテナ形式・量子化形式・
+ * サンプリングレートは入力と同じです。
+ *
+ * @param[in]	src		入力ファイルのパス
+ * @param[in]	outs	出力ファイルとチャンネルの並び
+ * return	正常終了で真。チャンネル番号が範囲外の場合も偽。
+ */
+// ----------------------------------------------------------------------------
+bool ChannelRemapper::remap(const tstring& src, const std::vector<ChannelOutput>& outs)
+{
+	RiffWavReader reader;
+	if (outs.empty() || !reader.open(src) || !reader.prepare()) {
+		return false;
+	}
+	const WORD ch = reader.getChannels();
+	const WORD qbit = reader.getBitPerSample();
+	const size_t width = qbit / 8;
+	const size_t inBlock = reader.getBlockAlign();
+	for (size_t k = 0; k < outs.size(); k++) {
+		if (outs[k].channels.empty()) {
+			return false;
+		}
+		for (size_t c = 0; c < outs[k].channels.size(); c++) {
+			if (outs[k].channels[c] >= ch) {
+				return false;
+			}
+		}
+	}
+
+	// 出力の準備（AIFFは浮動小数点型を表せないためAIFF-Cで書き出す）
+	const WavContainer container = (reader.getContainer() == CONTAINER_AIFF && reader.getFormatTag() != 1)
+		? CONTAINER_AIFC : reader.getContainer();
+	std::vector<std::unique_ptr<RiffWavWriter> > writers(outs.size());
+	for (size_t k = 0; k < outs.size(); k++) {
+		writers[k].reset(new RiffWavWriter(qbit, static_cast<WORD>(outs[k].channels.size()),
+			reader.getSamplesPerSec(), reader.getFormatTag() == 1));
+		writers[k]->setContainer(container);
+		writers[k]->setSowt(!reader.isBigEndian());
+		if (!writers[k]->open(outs[k].path) || !writers[k]->prepare()) {
+			return false;
+		}
+	}
+
+	const size_t blockFrames = (blockBytes_ / inBlock == 0) ? 1 : blockBytes_ / inBlock;
+	PooledBuffer in(blockFrames * inBlock);
+	std::vector<PooledBuffer> out;
+	out.reserve(outs.size());
+	for (size_t k = 0; k < outs.size(); k++) {
+		out.push_back(PooledBuffer(blockFrames * outs[k].channels.size() * width));
+	}
+
+	bool ok = true;
+	try {
+		while (ok) {
+			size_t got = 0;
+			if (reader.getStream(in.data(), blockFrames * inBlock, got) < 0 || got < inBlock) {
+				break;
+			}
+			const size_t frames = got / inBlock;
+			std::vector<char> written(outs.size(), 0);
+			auto task = [&](size_t k) {
+				const size_t bytes = frames * outs[k].channels.size() * width;
+				gather(in.data(), ch, out[k].data(), outs[k].channels.data(), outs[k].channels.size(), width, frames);
+				written[k] = (writers[k]->writeBytes(out[k].data(), bytes) == bytes) ? 1 : 0;
+			};
+			if (pool_ != nullptr && outs.size() > 1) {
+				pool_->parallelFor(outs.size(), task);
+			} else {
+				for (size_t k = 0; k < outs.size(); k++) {
+					task(k);
+				}
+			}
+			for (size_t k = 0; k < outs.size(); k++) {
+				ok = ok && (written[k] != 0);
+			}
+		}
+	} catch (const WavIoException&) {
+		ok = false;
+	}
+
+	for (size_t k = 0; k < outs.size(); k++) {
+		ok = writers[k]->riffFinalize() && ok;
+	}
+	return ok;
+}
+// ----------------------------------------------------------------------------
+// チャンネルごとのファイルに分割します。
+/**
+ * 入力のチャンネル番号順に、各パスへモノラルで書き出します。
+ * パスの数が入力のチャンネル数より少ない場合は、残りのチャンネルを書き出しません。
+ *
+ * @param[in]	src		入力ファイルのパス
+ * @param[in]	paths	チャンネルごとの出力ファイルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool ChannelRemapper::split(const tstring& src, const std::vector<tstring>& paths)
+{
+	std::vector<ChannelOutput> outs(paths.size());
+	for (size_t k = 0; k < paths.size(); k++) {
+		outs[k].path = paths[k];
+		outs[k].channels.assign(1, static_cast<WORD>(k));
+	}
+	return remap(src, outs);
+}
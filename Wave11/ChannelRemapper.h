@@ -0,0 +1,96 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ChannelRemapper.h
+ * @brief	チャンネルの抽出・並べ替えクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _CHANNELREMAPPER_H_
+#define _CHANNELREMAPPER_H_
+
+#include <vector>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 出力ファイルと、そこへ書き出す入力チャンネルの並び
+ */
+// ----------------------------------------------------------------------------
+struct ChannelOutput {
+	//! 出力ファイルのパス
+	tstring path;
+	//! 出力の各チャンネルに対応する入力チャンネル番号（0始まり、重複可）
+	std::vector<WORD> channels;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 多チャンネルのRIFF-WAVからのチャンネル抽出・並べ替えクラス
+ *
+ * 入力のインターリーブ形式のフレームを大きなブロック単位で一度だけ読み込み、
+ * 出力ごとに選んだチャンネルを集めてRiffWavWriterで書き出す。
+ * 出力を複数与えると、1回の読み込みから全出力（例えばチャンネルごとのファイル）を作る。
+ * スレッドプールを与えると、ブロックごとに出力単位で並列に処理する。
+ *
+ * サンプルは変換せずバイト列のまま複写するため、量子化形式は入力と同じになる。
+ */
+// ----------------------------------------------------------------------------
+class ChannelRemapper : private Noncopyable
+{
+public:
+	//! 既定の1ブロックあたりの読み込みバイトサイズ
+	static const size_t DefaultBlockBytes = 4 * 1024 * 1024;
+
+	/**
+	 * @brief	コンストラクタ
+	 * @param[in]	pool	出力ごとの処理に使うスレッドプール。nullptrなら逐次処理。
+	 */
+	explicit ChannelRemapper(ThreadPool* pool = nullptr) : pool_(pool), blockBytes_(DefaultBlockBytes) {}
+	virtual ~ChannelRemapper() {}
+
+	/**
+	 * @brief	1ブロックあたりの読み込みバイトサイズを設定する
+	 * @param[in]	bytes	バイトサイズ。1フレームに満たない場合も1フレームずつ読み込む。
+	 */
+	void setBlockBytes(size_t bytes) { blockBytes_ = (bytes == 0) ? DefaultBlockBytes : bytes; }
+
+	//! チャンネルを選んで書き出します。
+	bool remap(const tstring&, const std::vector<ChannelOutput>&);
+	//! チャンネルごとのファイルに分割します。
+	bool split(const tstring&, const std::vector<tstring>&);
+
+	//! インターリーブ形式のフレームからチャンネルを集めます。
+	static void gather(const void*, size_t, void*, const WORD*, size_t, size_t, size_t);
+
+private:
+	//! 出力ごとの処理に使うスレッドプール
+	ThreadPool* pool_;
+	//! 1ブロックあたりの読み込みバイトサイズ
+	size_t blockBytes_;
+};
+
+#endif // !_CHANNELREMAPPER_H_
@@ -0,0 +1,403 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Checksum.cpp
+ * @brief	ストリームのチェックサム計算クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "Checksum.h"
+#include <cstring>
+
+namespace {
+
+const uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+const uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const BYTE* p) {
+	return static_cast<uint64_t>(p[0]) | static_cast<uint64_t>(p[1]) << 8
+		| static_cast<uint64_t>(p[2]) << 16 | static_cast<uint64_t>(p[3]) << 24
+		| static_cast<uint64_t>(p[4]) << 32 | static_cast<uint64_t>(p[5]) << 40
+		| static_cast<uint64_t>(p[6]) << 48 | static_cast<uint64_t>(p[7]) << 56;
+}
+
+inline DWORD read32(const BYTE* p) {
+	return static_cast<DWORD>(p[0]) | static_cast<DWORD>(p[1]) << 8
+		| static_cast<DWORD>(p[2]) << 16 | static_cast<DWORD>(p[3]) << 24;
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input) {
+	acc += input * Prime64_2;
+	acc = rotl64(acc, 31);
+	return acc * Prime64_1;
+}
+
+inline uint64_t xxhMerge(uint64_t acc, uint64_t val) {
+	acc ^= xxhRound(0, val);
+	return acc * Prime64_1 + Prime64_4;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// 計算状態を初期化します。
+/**
+ * @param[in]	seed	ハッシュのシード値
+ */
+// ----------------------------------------------------------------------------
+void Xxh64::reset(uint64_t seed)
+{
+	seed_ = seed;
+	acc_[0] = seed + Prime64_1 + Prime64_2;
+	acc_[1] = seed + Prime64_2;
+	acc_[2] = seed;
+	acc_[3] = seed - Prime64_1;
+	total_ = 0;
+	bufSize_ = 0;
+}
+// ----------------------------------------------------------------------------
+// バイト列を追加します。
+/**
+ * @param[in]	data	バイト列
+ * @param[in]	size	バイトサイズ
+ */
+// ----------------------------------------------------------------------------
+void Xxh64::update(const void* data, size_t size)
+{
+	if (data == nullptr || size == 0) {
+		return;
+	}
+	const BYTE* p = static_cast<const BYTE*>(data);
+	const BYTE* end = p + size;
+	total_ += size;
+
+	// 保持領域の残りを埋める
+	if (bufSize_ > 0) {
+		size_t n = 32 - bufSize_;
+		if (n > size) n = size;
+		::memcpy(buf_ + bufSize_, p, n);
+		bufSize_ += n;
+		p += n;
+		if (bufSize_ < 32) {
+			return;
+		}
+		acc_[0] = xxhRound(acc_[0], read64(buf_));
+		acc_[1] = xxhRound(acc_[1], read64(buf_ + 8));
+		acc_[2] = xxhRound(acc_[2], read64(buf_ + 16));
+		acc_[3] = xxhRound(acc_[3], read64(buf_ + 24));
+		bufSize_ = 0;
+	}
+
+	// 32バイト単位で4レーンを更新する
+	uint64_t v1 = acc_[0], v2 = acc_[1], v3 = acc_[2], v4 = acc_[3];
+	while (end - p >= 32) {
+		v1 = xxhRound(v1, read64(p));
+		v2 = xxhRound(v2, read64(p + 8));
+		v3 = xxhRound(v3, read64(p + 16));
+		v4 = xxhRound(v4, read64(p + 24));
+		p += 32;
+	}
+	acc_[0] = v1; acc_[1] = v2; acc_[2] = v3; acc_[3] = v4;
+
+	if (p < end) {
+		bufSize_ = static_cast<size_t>(end - p);
+		::memcpy(buf_, p, bufSize_);
+	}
+}
+// ----------------------------------------------------------------------------
+// 現在までのバイト列のハッシュ値を取得します。
+/**
+ * 計算状態は変化しないため、続けてupdateしてもよい。
+ *
+ * @return	ハッシュ値
+ */
+// ----------------------------------------------------------------------------
+uint64_t Xxh64::digest() const
+{
+	uint64_t h;
+	if (total_ >= 32) {
+		h = rotl64(acc_[0], 1) + rotl64(acc_[1], 7) + rotl64(acc_[2], 12) + rotl64(acc_[3], 18);
+		h = xxhMerge(h, acc_[0]);
+		h = xxhMerge(h, acc_[1]);
+		h = xxhMerge(h, acc_[2]);
+		h = xxhMerge(h, acc_[3]);
+	} else {
+		h = seed_ + Prime64_5;
+	}
+	h += total_;
+
+	const BYTE* p = buf_;
+	const BYTE* end = buf_ + bufSize_;
+	while (end - p >= 8) {
+		h ^= xxhRound(0, read64(p));
+		h = rotl64(h, 27) * Prime64_1 + Prime64_4;
+		p += 8;
+	}
+	if (end - p >= 4) {
+		h ^= static_cast<uint64_t>(read32(p)) * Prime64_1;
+		h = rotl64(h, 23) * Prime64_2 + Prime64_3;
+		p += 4;
+	}
+	while (p < end) {
+		h ^= static_cast<uint64_t>(*p) * Prime64_5;
+		h = rotl64(h, 11) * Prime64_1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= Prime64_2;
+	h ^= h >> 29;
+	h *= Prime64_3;
+	h ^= h >> 32;
+	return h;
+}
+// ----------------------------------------------------------------------------
+// 計算状態を初期化します。
+// ----------------------------------------------------------------------------
+void Md5::reset()
+{
+	state_[0] = 0x67452301;
+	state_[1] = 0xefcdab89;
+	state_[2] = 0x98badcfe;
+	state_[3] = 0x10325476;
+	total_ = 0;
+}
+// ----------------------------------------------------------------------------
+// バイト列を追加します。
+/**
+ * @param[in]	data	バイト列
+ * @param[in]	size	バイトサイズ
+ */
+// ----------------------------------------------------------------------------
+void Md5::update(const void* data, size_t size)
+{
+	if (data == nullptr || size == 0) {
+		return;
+	}
+	const BYTE* p = static_cast<const BYTE*>(data);
+	size_t fill = static_cast<size_t>(total_ & 63);
+	total_ += size;
+
+	if (fill > 0) {
+		size_t n = 64 - fill;
+		if (n > size) n = size;
+		::memcpy(buf_ + fill, p, n);
+		p += n;
+		size -= n;
+		if (fill + n < 64) {
+			return;
+		}
+		transform(state_, buf_);
+	}
+	while (size >= 64) {
+		transform(state_, p);
+		p += 64;
+		size -= 64;
+	}
+	if (size > 0) {
+		::memcpy(buf_, p, size);
+	}
+}
+// ----------------------------------------------------------------------------
+// 現在までのバイト列のハッシュ値を取得します。
+/**
+ * 計算状態は変化しないため、続けてupdateしてもよい。
+ *
+ * @param[out]	out	16バイトのハッシュ値を格納するバッファ
+ */
+// ----------------------------------------------------------------------------
+void Md5::digest(BYTE* out) const
+{
+	DWORD state[4] = { state_[0], state_[1], state_[2], state_[3] };
+	BYTE block[128] = { 0 };
+	size_t fill = static_cast<size_t>(total_ & 63);
+	::memcpy(block, buf_, fill);
+	block[fill] = 0x80;
+	size_t blocks = (fill < 56) ? 1 : 2;
+	uint64_t bits = total_ * 8;
+	for (int i = 0; i < 8; i++) {
+		block[blocks * 64 - 8 + i] = static_cast<BYTE>(bits >> (8 * i));
+	}
+	for (size_t i = 0; i < blocks; i++) {
+		transform(state, block + i * 64);
+	}
+	for (int i = 0; i < 4; i++) {
+		out[i * 4] = static_cast<BYTE>(state[i]);
+		out[i * 4 + 1] = static_cast<BYTE>(state[i] >> 8);
+		out[i * 4 + 2] = static_cast<BYTE>(state[i] >> 16);
+		out[i * 4 + 3] = static_cast<BYTE>(state[i] >> 24);
+	}
+}
+// ----------------------------------------------------------------------------
+// 現在までのバイト列のハッシュ値を16進文字列で取得します。
+/**
+ * @return	32文字の小文字16進文字列
+ */
+// ----------------------------------------------------------------------------
+std::string Md5::hexDigest() const
+{
+	static const char hex[] = "0123456789abcdef";
+	BYTE d[16];
+	digest(d);
+	std::string s(32, '0');
+	for (int i = 0; i < 16; i++) {
+		s[i * 2] = hex[d[i] >> 4];
+		s[i * 2 + 1] = hex[d[i] & 0x0F];
+	}
+	return s;
+}
+// ----------------------------------------------------------------------------
+// 64バイトのブロックを処理します。
+/**
+ * @param[in,out]	state	内部状態
+ * @param[in]		block	64バイトのブロック
+ */
+// ----------------------------------------------------------------------------
+void Md5::transform(DWORD* state, const BYTE* block)
+{
+	static const DWORD k[64] = {
+		0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+		0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+		0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+		0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+		0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+		0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+		0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+		0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+	};
+	static const int r[64] = {
+		7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+		5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+		4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+		6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+	};
+
+	DWORD m[16];
+	for (int i = 0; i < 16; i++) {
+		m[i] = read32(block + i * 4);
+	}
+	DWORD a = state[0], b = state[1], c = state[2], d = state[3];
+	for (int i = 0; i < 64; i++) {
+		DWORD f;
+		int g;
+		if (i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if (i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) & 15;
+		} else if (i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) & 15;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) & 15;
+		}
+		DWORD t = d;
+		d = c;
+		c = b;
+		DWORD x = a + f + k[i] + m[g];
+		b = b + ((x << r[i]) | (x >> (32 - r[i])));
+		a = t;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+// ----------------------------------------------------------------------------
+// 計算するチェックサムの種類を設定し、状態を初期化します。
+/**
+ * @param[in]	types		ChecksumTypeの論理和。0で無効。
+ * @param[in]	blockSize	CHECKSUM_BLOCKSのブロック長
+ */
+// ----------------------------------------------------------------------------
+void PayloadChecksum::reset(int types, size_t blockSize)
+{
+	types_ = types;
+	blockSize_ = (blockSize == 0) ? DefaultBlockSize : blockSize;
+	xxh_.reset();
+	md5_.reset();
+	block_.reset();
+	blockFill_ = 0;
+	blocks_.clear();
+	size_ = 0;
+}
+// ----------------------------------------------------------------------------
+// ペイロードのバイト列を追加します。
+/**
+ * @param[in]	data	バイト列
+ * @param[in]	size	バイトサイズ
+ */
+// ----------------------------------------------------------------------------
+void PayloadChecksum::update(const void* data, size_t size)
+{
+	if (types_ == 0 || data == nullptr || size == 0) {
+		return;
+	}
+	size_ += size;
+	if (types_ & CHECKSUM_XXH64) {
+		xxh_.update(data, size);
+	}
+	if (types_ & CHECKSUM_MD5) {
+		md5_.update(data, size);
+	}
+	if (types_ & CHECKSUM_BLOCKS) {
+		const BYTE* p = static_cast<const BYTE*>(data);
+		while (size > 0) {
+			size_t n = blockSize_ - blockFill_;
+			if (n > size) n = size;
+			block_.update(p, n);
+			blockFill_ += n;
+			p += n;
+			size -= n;
+			if (blockFill_ == blockSize_) {
+				blocks_.push_back(block_.digest());
+				block_.reset();
+				blockFill_ = 0;
+			}
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// ブロックごとのハッシュ値を取得します。
+/**
+ * 末尾のブロック長に満たない部分も1ブロックとして含めます。
+ *
+ * @return	ペイロード先頭からのブロック順のハッシュ値
+ */
+// ----------------------------------------------------------------------------
+std::vector<uint64_t> PayloadChecksum::blockHashes() const
+{
+	std::vector<uint64_t> ret(blocks_);
+	if (blockFill_ > 0) {
+		ret.push_back(block_.digest());
+	}
+	return ret;
+}
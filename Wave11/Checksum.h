@@ -0,0 +1,198 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Checksum.h
+ * @brief	ストリームのチェックサム計算クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+#include <cstdint>
+#include <vector>
+#include "WavIoType.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief XXH64ハッシュの逐次計算クラス
+ *
+ * 任意の長さに分割して与えたバイト列から、一括計算と同じ値を得られる。
+ */
+// ----------------------------------------------------------------------------
+class Xxh64
+{
+public:
+	/**
+	 * @param[in]	seed	ハッシュのシード値
+	 */
+	explicit Xxh64(uint64_t seed = 0) { reset(seed); }
+
+	//! 計算状態を初期化します。
+	void reset(uint64_t = 0);
+	//! バイト列を追加します。
+	void update(const void*, size_t);
+	//! 現在までのバイト列のハッシュ値を取得します。
+	uint64_t digest() const;
+
+	/**
+	 * @brief	バイト列のハッシュ値を一括計算する
+	 * @param[in]	data	バイト列
+	 * @param[in]	size	バイトサイズ
+	 * @param[in]	seed	シード値
+	 * @return	ハッシュ値
+	 */
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 0) {
+		Xxh64 h(seed);
+		h.update(data, size);
+		return h.digest();
+	}
+
+private:
+	//! レーンごとの累積値
+	uint64_t acc_[4];
+	//! シード値
+	uint64_t seed_;
+	//! 入力済みの総バイト数
+	uint64_t total_;
+	//! 32バイトに満たない入力の保持領域
+	BYTE buf_[32];
+	//! 保持領域中の有効バイト数
+	size_t bufSize_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief MD5ハッシュの逐次計算クラス
+ *
+ * 既存のアーカイブ台帳との互換用。XXH64より遅い。
+ */
+// ----------------------------------------------------------------------------
+class Md5
+{
+public:
+	Md5() { reset(); }
+
+	//! 計算状態を初期化します。
+	void reset();
+	//! バイト列を追加します。
+	void update(const void*, size_t);
+	//! 現在までのバイト列のハッシュ値を取得します。
+	void digest(BYTE*) const;
+	//! 現在までのバイト列のハッシュ値を16進文字列で取得します。
+	std::string hexDigest() const;
+
+private:
+	//! 内部状態
+	DWORD state_[4];
+	//! 入力済みの総バイト数
+	uint64_t total_;
+	//! 64バイトに満たない入力の保持領域
+	BYTE buf_[64];
+
+	//! 64バイトのブロックを処理します。
+	static void transform(DWORD*, const BYTE*);
+};
+
+//! チェックサムの種類
+enum ChecksumType {
+	CHECKSUM_XXH64 = 1,		//!< ペイロード全体のXXH64
+	CHECKSUM_MD5 = 2,		//!< ペイロード全体のMD5
+	CHECKSUM_BLOCKS = 4		//!< 固定長ブロックごとのXXH64
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief オーディオペイロードのチェックサム計算クラス
+ *
+ * dataチャンクのバイト列を順に与えると、指定した種類のチェックサムを同時に計算する。
+ * CHECKSUM_BLOCKSを指定した場合はペイロード先頭から固定長に区切ったブロックごとの
+ * ハッシュ値も記録し、ContentHashIndexによる重複検出に使える。
+ */
+// ----------------------------------------------------------------------------
+class PayloadChecksum
+{
+public:
+	//! 既定のブロック長（64KiB）
+	static const size_t DefaultBlockSize = 65536;
+
+	PayloadChecksum() : types_(0), blockSize_(DefaultBlockSize), blockFill_(0), size_(0) {}
+
+	//! 計算するチェックサムの種類を設定し、状態を初期化します。
+	void reset(int, size_t = DefaultBlockSize);
+	//! ペイロードのバイト列を追加します。
+	void update(const void*, size_t);
+	/**
+	 * @brief	計算対象のチェックサムの種類を取得する
+	 * @return	ChecksumTypeの論理和。0なら無効。
+	 */
+	int types() const { return types_; }
+	/**
+	 * @brief	チェックサム計算が有効か判定する
+	 * @return	いずれかの種類が有効なら真
+	 */
+	bool enabled() const { return types_ != 0; }
+	/**
+	 * @brief	追加済みのペイロードのバイトサイズを取得する
+	 * @return	バイトサイズ
+	 */
+	uint64_t size() const { return size_; }
+	/**
+	 * @brief	ペイロード全体のXXH64を取得する
+	 * @return	ハッシュ値
+	 */
+	uint64_t xxh64() const { return xxh_.digest(); }
+	/**
+	 * @brief	ペイロード全体のMD5を16進文字列で取得する
+	 * @return	ハッシュ値
+	 */
+	std::string md5() const { return md5_.hexDigest(); }
+	/**
+	 * @brief	ブロック長を取得する
+	 * @return	ブロックのバイトサイズ
+	 */
+	size_t blockSize() const { return blockSize_; }
+	//! ブロックごとのハッシュ値を取得します。
+	std::vector<uint64_t> blockHashes() const;
+
+private:
+	//! 計算対象のチェックサムの種類
+	int types_;
+	//! ペイロード全体のXXH64
+	Xxh64 xxh_;
+	//! ペイロード全体のMD5
+	Md5 md5_;
+	//! ブロック長
+	size_t blockSize_;
+	//! 計算中のブロックのXXH64
+	Xxh64 block_;
+	//! 計算中のブロックの入力済みバイト数
+	size_t blockFill_;
+	//! 確定したブロックのハッシュ値
+	std::vector<uint64_t> blocks_;
+	//! 入力済みのペイロードのバイトサイズ
+	uint64_t size_;
+};
+
+#endif // !_CHECKSUM_H_
@@ -0,0 +1,128 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ContentHashIndex.cpp
+ * @brief	ブロック単位のオーディオ内容ハッシュ索引の実装
+ */
+// ----------------------------------------------------------------------------
+#include "ContentHashIndex.h"
+
+// ----------------------------------------------------------------------------
+// ファイルのチェックサムを登録します。
+/**
+ * @param[in]	name	ファイル名
+ * @param[in]	sum		CHECKSUM_BLOCKSを有効にして計算したチェックサム
+ * @return	登録したファイル番号
+ * @exception	WavIoException	ブロックハッシュが計算されていない
+ */
+// ----------------------------------------------------------------------------
+size_t ContentHashIndex::addFile(const tstring& name, const PayloadChecksum& sum)
+{
+	if ((sum.types() & CHECKSUM_BLOCKS) == 0) {
+		throw WavIoException("block hashes are not enabled.");
+	}
+
+	FileEntry entry;
+	entry.name = name;
+	entry.size = sum.size();
+	entry.blockSize = sum.blockSize();
+	entry.blocks = sum.blockHashes();
+	// ブロックハッシュ列とサイズから指紋を作る
+	Xxh64 h(entry.blockSize);
+	if (!entry.blocks.empty()) {
+		h.update(&entry.blocks[0], entry.blocks.size() * sizeof(uint64_t));
+	}
+	h.update(&entry.size, sizeof(entry.size));
+	entry.fingerprint = h.digest();
+
+	const size_t id = files_.size();
+	for (size_t i = 0; i < entry.blocks.size(); i++) {
+		ContentBlockRef ref = { id, i };
+		blockIndex_.insert(std::make_pair(entry.blocks[i], ref));
+	}
+	fileIndex_.insert(std::make_pair(entry.fingerprint, id));
+	files_.push_back(entry);
+	return id;
+}
+// ----------------------------------------------------------------------------
+// ペイロード全体が一致するファイルを検索します。
+/**
+ * @param[in]	id	ファイル番号
+ * @return	ペイロードのサイズと全ブロックのハッシュが一致する他のファイル番号
+ */
+// ----------------------------------------------------------------------------
+std::vector<size_t> ContentHashIndex::findDuplicateFiles(size_t id) const
+{
+	std::vector<size_t> ret;
+	if (id >= files_.size()) {
+		return ret;
+	}
+	const FileEntry& self = files_[id];
+	auto range = fileIndex_.equal_range(self.fingerprint);
+	for (auto it = range.first; it != range.second; ++it) {
+		const FileEntry& other = files_[it->second];
+		if (it->second != id && other.size == self.size
+			&& other.blockSize == self.blockSize && other.blocks == self.blocks) {
+			ret.push_back(it->second);
+		}
+	}
+	return ret;
+}
+// ----------------------------------------------------------------------------
+// 他のファイルと一致するブロックを検索します。
+/**
+ * ブロック長の異なるファイル同士は比較しません。
+ *
+ * @param[in]	id	ファイル番号
+ * @return	自ファイルのブロック番号と、ハッシュが一致した他ファイルのブロック位置の組
+ */
+// ----------------------------------------------------------------------------
+std::vector<std::pair<size_t, ContentBlockRef> > ContentHashIndex::findDuplicateBlocks(size_t id) const
+{
+	std::vector<std::pair<size_t, ContentBlockRef> > ret;
+	if (id >= files_.size()) {
+		return ret;
+	}
+	const FileEntry& self = files_[id];
+	for (size_t i = 0; i < self.blocks.size(); i++) {
+		auto range = blockIndex_.equal_range(self.blocks[i]);
+		for (auto it = range.first; it != range.second; ++it) {
+			const ContentBlockRef& ref = it->second;
+			if (ref.file != id && files_[ref.file].blockSize == self.blockSize) {
+				ret.push_back(std::make_pair(i, ref));
+			}
+		}
+	}
+	return ret;
+}
+// ----------------------------------------------------------------------------
+// 索引を空にします。
+// ----------------------------------------------------------------------------
+void ContentHashIndex::clear()
+{
+	files_.clear();
+	blockIndex_.clear();
+	fileIndex_.clear();
+}
@@ -0,0 +1,114 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ContentHashIndex.h
+ * @brief	ブロック単位のオーディオ内容ハッシュ索引のヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _CONTENTHASHINDEX_H_
+#define _CONTENTHASHINDEX_H_
+
+#include <vector>
+#include <unordered_map>
+#include "Checksum.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 索引中のブロックの位置
+ */
+// ----------------------------------------------------------------------------
+struct ContentBlockRef {
+	//! ファイル番号
+	size_t file;
+	//! ペイロード先頭からのブロック番号
+	size_t block;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief オーディオ内容の重複検出用ハッシュ索引
+ *
+ * CHECKSUM_BLOCKSを有効にしたPayloadChecksumの結果をファイルごとに登録し、
+ * ペイロード全体が一致するファイルや、一致するブロックを持つファイルを検索する。
+ * 読み込み・書き出しと同時に計算したハッシュを使うため、
+ * 重複検出のためにファイルを再度読み込む必要はない。
+ *
+ * ハッシュ値の一致は重複の候補であり、厳密な判定が必要ならバイト列を比較すること。
+ * ブロックはペイロード先頭からの固定長区切りなので、ブロック長の倍数でない
+ * オフセットにずれた重複は検出できない。
+ */
+// ----------------------------------------------------------------------------
+class ContentHashIndex
+{
+public:
+	ContentHashIndex() {}
+	virtual ~ContentHashIndex() {}
+
+	//! ファイルのチェックサムを登録します。
+	size_t addFile(const tstring&, const PayloadChecksum&);
+	/**
+	 * @brief	登録済みファイル数を取得する
+	 * @return	ファイル数
+	 */
+	size_t files() const { return files_.size(); }
+	/**
+	 * @brief	登録時のファイル名を取得する
+	 * @param[in]	id	ファイル番号
+	 * @return	ファイル名
+	 */
+	const tstring& fileName(size_t id) const { return files_[id].name; }
+	//! ペイロード全体が一致するファイルを検索します。
+	std::vector<size_t> findDuplicateFiles(size_t) const;
+	//! 他のファイルと一致するブロックを検索します。
+	std::vector<std::pair<size_t, ContentBlockRef> > findDuplicateBlocks(size_t) const;
+	//! 索引を空にします。
+	void clear();
+
+private:
+	/**
+	 * @brief 登録済みファイルの情報
+	 */
+	struct FileEntry {
+		//! ファイル名
+		tstring name;
+		//! ペイロードのバイトサイズ
+		uint64_t size;
+		//! ブロック長
+		size_t blockSize;
+		//! ブロックハッシュ列から求めたペイロード全体の指紋
+		uint64_t fingerprint;
+		//! ブロックごとのハッシュ値
+		std::vector<uint64_t> blocks;
+	};
+
+	//! 登録済みファイル
+	std::vector<FileEntry> files_;
+	//! ブロックハッシュから位置への索引
+	std::unordered_multimap<uint64_t, ContentBlockRef> blockIndex_;
+	//! ペイロード指紋からファイル番号への索引
+	std::unordered_multimap<uint64_t, size_t> fileIndex_;
+};
+
+#endif // !_CONTENTHASHINDEX_H_
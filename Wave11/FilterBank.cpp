@@ -0,0 +1,536 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	FilterBank.cpp
+ * @brief	バイクアッドIIRフィルター・FIRフィルタークラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "FilterBank.h"
+#include "Metrics.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILTERBANK_USE_SSE
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FILTERBANK_USE_AVX
+#endif
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+//! これより小さい状態は0にする
+const float DenormalLimit = 1e-30f;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 処理中だけFTZ/DAZを有効にするクラス
+ */
+// ----------------------------------------------------------------------------
+class DenormalGuard
+{
+public:
+#if defined(FILTERBANK_USE_SSE)
+	DenormalGuard() : saved_(_mm_getcsr()) { _mm_setcsr(saved_ | 0x8040); }
+	~DenormalGuard() { _mm_setcsr(saved_); }
+
+private:
+	//! 変更前のMXCSR
+	const unsigned int saved_;
+#endif
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	a0で正規化した係数を作る
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs normalize(double b0, double b1, double b2, double a0, double a1, double a2)
+{
+	BiquadCoeffs c;
+	c.b0 = static_cast<float>(b0 / a0);
+	c.b1 = static_cast<float>(b1 / a0);
+	c.b2 = static_cast<float>(b2 / a0);
+	c.a1 = static_cast<float>(a1 / a0);
+	c.a2 = static_cast<float>(a2 / a0);
+	return c;
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	1チャンネルを1段分スカラーで処理する
+ */
+// ----------------------------------------------------------------------------
+void biquadScalar(float* p, size_t frames, size_t stride, const BiquadCoeffs& k, float& z1, float& z2)
+{
+	float s1 = z1;
+	float s2 = z2;
+	for (size_t i = 0; i < frames; i++, p += stride) {
+		const float x = *p;
+		const float y = k.b0 * x + s1;
+		s1 = k.b1 * x - k.a1 * y + s2;
+		s2 = k.b2 * x - k.a2 * y;
+		*p = y;
+	}
+	z1 = s1;
+	z2 = s2;
+}
+
+#if defined(FILTERBANK_USE_SSE)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	隣り合う4チャンネルを1段分処理する
+ */
+// ----------------------------------------------------------------------------
+void biquadSse(float* p, size_t frames, size_t stride, const BiquadCoeffs& k, float* z1, float* z2)
+{
+	const __m128 b0 = _mm_set1_ps(k.b0);
+	const __m128 b1 = _mm_set1_ps(k.b1);
+	const __m128 b2 = _mm_set1_ps(k.b2);
+	const __m128 a1 = _mm_set1_ps(k.a1);
+	const __m128 a2 = _mm_set1_ps(k.a2);
+	__m128 s1 = _mm_loadu_ps(z1);
+	__m128 s2 = _mm_loadu_ps(z2);
+	for (size_t i = 0; i < frames; i++, p += stride) {
+		const __m128 x = _mm_loadu_ps(p);
+		const __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+		s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+		s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+		_mm_storeu_ps(p, y);
+	}
+	_mm_storeu_ps(z1, s1);
+	_mm_storeu_ps(z2, s2);
+}
+#endif
+
+#if defined(FILTERBANK_USE_AVX)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	隣り合う8チャンネルを1段分処理する
+ */
+// ----------------------------------------------------------------------------
+void biquadAvx(float* p, size_t frames, size_t stride, const BiquadCoeffs& k, float* z1, float* z2)
+{
+	const __m256 b0 = _mm256_set1_ps(k.b0);
+	const __m256 b1 = _mm256_set1_ps(k.b1);
+	const __m256 b2 = _mm256_set1_ps(k.b2);
+	const __m256 a1 = _mm256_set1_ps(k.a1);
+	const __m256 a2 = _mm256_set1_ps(k.a2);
+	__m256 s1 = _mm256_loadu_ps(z1);
+	__m256 s2 = _mm256_loadu_ps(z2);
+	for (size_t i = 0; i < frames; i++, p += stride) {
+		const __m256 x = _mm256_loadu_ps(p);
+		const __m256 y = _mm256_add_ps(_mm256_mul_ps(b0, x), s1);
+		s1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x), _mm256_mul_ps(a1, y)), s2);
+		s2 = _mm256_sub_ps(_mm256_mul_ps(b2, x), _mm256_mul_ps(a2, y));
+		_mm256_storeu_ps(p, y);
+	}
+	_mm256_storeu_ps(z1, s1);
+	_mm256_storeu_ps(z2, s2);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	窓関数法で低域通過フィルターの係数を作る（Blackman窓）
+ */
+// ----------------------------------------------------------------------------
+std::vector<float> windowedSinc(size_t taps, double fc)
+{
+	std::vector<float> h(taps);
+	const double mid = (taps - 1) / 2.0;
+	double sum = 0.0;
+	std::vector<double> v(taps);
+	for (size_t i = 0; i < taps; i++) {
+		const double t = i - mid;
+		const double sinc = (t == 0.0) ? 2.0 * fc : std::sin(2.0 * Pi * fc * t) / (Pi * t);
+		const double w = (taps == 1) ? 1.0
+			: 0.42 - 0.5 * std::cos(2.0 * Pi * i / (taps - 1)) + 0.08 * std::cos(4.0 * Pi * i / (taps - 1));
+		v[i] = sinc * w;
+		sum += v[i];
+	}
+	for (size_t i = 0; i < taps; i++) {
+		h[i] = static_cast<float>(v[i] / sum);
+	}
+	return h;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// 低域通過フィルターを設計します。
+/**
+ * @param[in]	fs	サンプリングレート
+ * @param[in]	f0	遮断周波数
+ * @param[in]	q	Q値
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::lowpass(double fs, double f0, double q)
+{
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double alpha = std::sin(w0) / (2.0 * q);
+	return normalize((1.0 - cs) / 2.0, 1.0 - cs, (1.0 - cs) / 2.0, 1.0 + alpha, -2.0 * cs, 1.0 - alpha);
+}
+// ----------------------------------------------------------------------------
+// 高域通過フィルターを設計します。
+/**
+ * @param[in]	fs	サンプリングレート
+ * @param[in]	f0	遮断周波数
+ * @param[in]	q	Q値
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::highpass(double fs, double f0, double q)
+{
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double alpha = std::sin(w0) / (2.0 * q);
+	return normalize((1.0 + cs) / 2.0, -(1.0 + cs), (1.0 + cs) / 2.0, 1.0 + alpha, -2.0 * cs, 1.0 - alpha);
+}
+// ----------------------------------------------------------------------------
+// 帯域通過フィルター（ピーク利得0dB）を設計します。
+/**
+ * @param[in]	fs	サンプリングレート
+ * @param[in]	f0	中心周波数
+ * @param[in]	q	Q値
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::bandpass(double fs, double f0, double q)
+{
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double alpha = std::sin(w0) / (2.0 * q);
+	return normalize(alpha, 0.0, -alpha, 1.0 + alpha, -2.0 * cs, 1.0 - alpha);
+}
+// ----------------------------------------------------------------------------
+// 帯域阻止フィルターを設計します。
+/**
+ * @param[in]	fs	サンプリングレート
+ * @param[in]	f0	中心周波数
+ * @param[in]	q	Q値
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::notch(double fs, double f0, double q)
+{
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double alpha = std::sin(w0) / (2.0 * q);
+	return normalize(1.0, -2.0 * cs, 1.0, 1.0 + alpha, -2.0 * cs, 1.0 - alpha);
+}
+// ----------------------------------------------------------------------------
+// ピーキングイコライザーを設計します。
+/**
+ * @param[in]	fs		サンプリングレート
+ * @param[in]	f0		中心周波数
+ * @param[in]	q		Q値
+ * @param[in]	gainDb	中心周波数での利得（dB）
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::peaking(double fs, double f0, double q, double gainDb)
+{
+	const double a = std::pow(10.0, gainDb / 40.0);
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double alpha = std::sin(w0) / (2.0 * q);
+	return normalize(1.0 + alpha * a, -2.0 * cs, 1.0 - alpha * a, 1.0 + alpha / a, -2.0 * cs, 1.0 - alpha / a);
+}
+// ----------------------------------------------------------------------------
+// 低域シェルビングフィルターを設計します。
+/**
+ * @param[in]	fs		サンプリングレート
+ * @param[in]	f0		転移周波数
+ * @param[in]	gainDb	低域の利得（dB）
+ * @param[in]	q		Q値
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::lowShelf(double fs, double f0, double gainDb, double q)
+{
+	const double a = std::pow(10.0, gainDb / 40.0);
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double sq = 2.0 * std::sqrt(a) * std::sin(w0) / (2.0 * q);
+	return normalize(
+		a * ((a + 1.0) - (a - 1.0) * cs + sq),
+		2.0 * a * ((a - 1.0) - (a + 1.0) * cs),
+		a * ((a + 1.0) - (a - 1.0) * cs - sq),
+		(a + 1.0) + (a - 1.0) * cs + sq,
+		-2.0 * ((a - 1.0) + (a + 1.0) * cs),
+		(a + 1.0) + (a - 1.0) * cs - sq);
+}
+// ----------------------------------------------------------------------------
+// 高域シェルビングフィルターを設計します。
+/**
+ * @param[in]	fs		サンプリングレート
+ * @param[in]	f0		転移周波数
+ * @param[in]	gainDb	高域の利得（dB）
+ * @param[in]	q		Q値
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::highShelf(double fs, double f0, double gainDb, double q)
+{
+	const double a = std::pow(10.0, gainDb / 40.0);
+	const double w0 = 2.0 * Pi * f0 / fs;
+	const double cs = std::cos(w0);
+	const double sq = 2.0 * std::sqrt(a) * std::sin(w0) / (2.0 * q);
+	return normalize(
+		a * ((a + 1.0) + (a - 1.0) * cs + sq),
+		-2.0 * a * ((a - 1.0) + (a + 1.0) * cs),
+		a * ((a + 1.0) + (a - 1.0) * cs - sq),
+		(a + 1.0) - (a - 1.0) * cs + sq,
+		2.0 * ((a - 1.0) - (a + 1.0) * cs),
+		(a + 1.0) - (a - 1.0) * cs - sq);
+}
+// ----------------------------------------------------------------------------
+// 直流除去フィルター（1次高域通過）を設計します。
+/**
+ * y[n] = x[n] - x[n-1] + R y[n-1]、R = exp(-2πfc/fs)。
+ *
+ * @param[in]	fs	サンプリングレート
+ * @param[in]	fc	遮断周波数
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+BiquadCoeffs BiquadCoeffs::dcBlock(double fs, double fc)
+{
+	const double r = std::exp(-2.0 * Pi * fc / fs);
+	return normalize(1.0, -1.0, 0.0, 1.0, -r, 0.0);
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	channels	チャンネル数
+ */
+// ----------------------------------------------------------------------------
+BiquadCascade::BiquadCascade(WORD channels)
+	: channels_((channels == 0) ? 1 : channels)
+{
+}
+// ----------------------------------------------------------------------------
+// 段を追加します。
+/**
+ * 追加した段の状態は0から始まります。
+ *
+ * @param[in]	c	係数
+ */
+// ----------------------------------------------------------------------------
+void BiquadCascade::addStage(const BiquadCoeffs& c)
+{
+	coeffs_.push_back(c);
+	z1_.resize(coeffs_.size() * channels_, 0.f);
+	z2_.resize(coeffs_.size() * channels_, 0.f);
+}
+// ----------------------------------------------------------------------------
+// 段の係数を変更します。
+/**
+ * 状態は引き継ぎます。
+ *
+ * @param[in]	stage	段の番号
+ * @param[in]	c		係数
+ */
+// ----------------------------------------------------------------------------
+void BiquadCascade::setStage(size_t stage, const BiquadCoeffs& c)
+{
+	if (stage < coeffs_.size()) {
+		coeffs_[stage] = c;
+	}
+}
+// ----------------------------------------------------------------------------
+// 状態を0に戻します。
+// ----------------------------------------------------------------------------
+void BiquadCascade::reset()
+{
+	std::fill(z1_.begin(), z1_.end(), 0.f);
+	std::fill(z2_.begin(), z2_.end(), 0.f);
+}
+// ----------------------------------------------------------------------------
+// フレーム列をその場で処理します。
+/**
+ * 段ごとに、8チャンネル・4チャンネル・1チャンネルの順に幅を狭めながら
+ * 全フレームを処理します。
+ *
+ * @param[in,out]	buf		インターリーブ形式のフレーム列
+ * @param[in]		frames	フレーム数
+ */
+// ----------------------------------------------------------------------------
+void BiquadCascade::process(float* buf, size_t frames)
+{
+	WAVE11_METRIC_TIMER(timer, METRIC_CONVERT_NS);
+	DenormalGuard guard;
+	const size_t ch = channels_;
+	for (size_t s = 0; s < coeffs_.size(); s++) {
+		const BiquadCoeffs& k = coeffs_[s];
+		float* z1 = &z1_[s * ch];
+		float* z2 = &z2_[s * ch];
+		size_t c = 0;
+#if defined(FILTERBANK_USE_AVX)
+		for (; c + 8 <= ch; c += 8) {
+			biquadAvx(buf + c, frames, ch, k, z1 + c, z2 + c);
+		}
+#endif
+#if defined(FILTERBANK_USE_SSE)
+		for (; c + 4 <= ch; c += 4) {
+			biquadSse(buf + c, frames, ch, k, z1 + c, z2 + c);
+		}
+#endif
+		for (; c < ch; c++) {
+			biquadScalar(buf + c, frames, ch, k, z1[c], z2[c]);
+		}
+	}
+	for (size_t i = 0; i < z1_.size(); i++) {
+		if (std::fabs(z1_[i]) < DenormalLimit) {
+			z1_[i] = 0.f;
+		}
+		if (std::fabs(z2_[i]) < DenormalLimit) {
+			z2_[i] = 0.f;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	channels	チャンネル数
+ * @param[in]	taps		係数。空なら素通し。
+ */
+// ----------------------------------------------------------------------------
+FirFilter::FirFilter(WORD channels, const std::vector<float>& taps)
+	: channels_((channels == 0) ? 1 : channels),
+	taps_(taps.rbegin(), taps.rend())
+{
+	if (taps_.empty()) {
+		taps_.push_back(1.f);
+	}
+	work_.assign((taps_.size() - 1) * channels_, 0.f);
+}
+// ----------------------------------------------------------------------------
+// 窓関数法で低域通過フィルターの係数を設計します。
+/**
+ * Blackman窓を掛けた理想低域通過フィルターのインパルス応答を、
+ * 直流利得が1になるよう正規化します。群遅延は(taps-1)/2フレームです。
+ *
+ * @param[in]	taps	タップ数
+ * @param[in]	fs		サンプリングレート
+ * @param[in]	fc		遮断周波数
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+std::vector<float> FirFilter::designLowpass(size_t taps, double fs, double fc)
+{
+	return windowedSinc((taps == 0) ? 1 : taps, fc / fs);
+}
+// ----------------------------------------------------------------------------
+// 窓関数法で高域通過フィルターの係数を設計します。
+/**
+ * 同じ遮断周波数の低域通過フィルターをインパルスから引きます（スペクトル反転）。
+ * タップ数は奇数に切り上げます。
+ *
+ * @param[in]	taps	タップ数
+ * @param[in]	fs		サンプリングレート
+ * @param[in]	fc		遮断周波数
+ * @return	係数
+ */
+// ----------------------------------------------------------------------------
+std::vector<float> FirFilter::designHighpass(size_t taps, double fs, double fc)
+{
+	std::vector<float> h = windowedSinc(taps | 1, fc / fs);
+	for (size_t i = 0; i < h.size(); i++) {
+		h[i] = -h[i];
+	}
+	h[h.size() / 2] += 1.f;
+	return h;
+}
+// ----------------------------------------------------------------------------
+// 状態を0に戻します。
+// ----------------------------------------------------------------------------
+void FirFilter::reset()
+{
+	work_.assign((taps_.size() - 1) * channels_, 0.f);
+}
+// ----------------------------------------------------------------------------
+// フレーム列をその場で処理します。
+/**
+ * 作業領域の直前の入力に続けて今回の入力を複写し、そこから畳み込みます。
+ * 連続する8（AVX）または4（SSE）サンプルを1命令で計算します。
+ *
+ * @param[in,out]	buf		インターリーブ形式のフレーム列
+ * @param[in]		frames	フレーム数
+ */
+// ----------------------------------------------------------------------------
+void FirFilter::process(float* buf, size_t frames)
+{
+	WAVE11_METRIC_TIMER(timer, METRIC_CONVERT_NS);
+	DenormalGuard guard;
+	const size_t ch = channels_;
+	const size_t taps = taps_.size();
+	const size_t history = (taps - 1) * ch;
+	work_.resize(history + frames * ch);
+	::memcpy(&work_[history], buf, frames * ch * sizeof(float));
+
+	// 出力のi番目のサンプルはwork_[i + k * ch]とh[k]の積和なので、
+	// チャンネル数によらずインターリーブのまま連続するサンプルをまとめて計算できる
+	const float* h = &taps_[0];
+	const float* x = &work_[0];
+	const size_t count = frames * ch;
+	size_t i = 0;
+#if defined(FILTERBANK_USE_AVX)
+	for (; i + 8 <= count; i += 8) {
+		__m256 acc = _mm256_setzero_ps();
+		for (size_t k = 0; k < taps; k++) {
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(h[k]), _mm256_loadu_ps(x + i + k * ch)));
+		}
+		_mm256_storeu_ps(buf + i, acc);
+	}
+#endif
+#if defined(FILTERBANK_USE_SSE)
+	for (; i + 4 <= count; i += 4) {
+		__m128 acc = _mm_setzero_ps();
+		for (size_t k = 0; k < taps; k++) {
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[k]), _mm_loadu_ps(x + i + k * ch)));
+		}
+		_mm_storeu_ps(buf + i, acc);
+	}
+#endif
+	for (; i < count; i++) {
+		float acc = 0.f;
+		for (size_t k = 0; k < taps; k++) {
+			acc += h[k] * x[i + k * ch];
+		}
+		buf[i] = acc;
+	}
+	// 末尾を次回の履歴として先頭へ移す
+	::memmove(&work_[0], &work_[frames * ch], history * sizeof(float));
+}
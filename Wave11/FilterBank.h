@@ -0,0 +1,164 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	FilterBank.h
+ * @brief	バイクアッドIIRフィルター・FIRフィルタークラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _FILTERBANK_H_
+#define _FILTERBANK_H_
+
+#include <cstddef>
+#include <vector>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief バイクアッドフィルターの係数
+ *
+ * 伝達関数 H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2)。
+ * 設計関数はRBJのAudio EQ Cookbookの式による。周波数はHz、Qは無次元。
+ */
+// ----------------------------------------------------------------------------
+struct BiquadCoeffs {
+	float b0;
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+
+	//! 低域通過フィルターを設計します。
+	static BiquadCoeffs lowpass(double, double, double = 0.70710678118654752);
+	//! 高域通過フィルターを設計します。
+	static BiquadCoeffs highpass(double, double, double = 0.70710678118654752);
+	//! 帯域通過フィルター（ピーク利得0dB）を設計します。
+	static BiquadCoeffs bandpass(double, double, double);
+	//! 帯域阻止フィルターを設計します。
+	static BiquadCoeffs notch(double, double, double);
+	//! ピーキングイコライザーを設計します。
+	static BiquadCoeffs peaking(double, double, double, double);
+	//! 低域シェルビングフィルターを設計します。
+	static BiquadCoeffs lowShelf(double, double, double, double = 0.70710678118654752);
+	//! 高域シェルビングフィルターを設計します。
+	static BiquadCoeffs highShelf(double, double, double, double = 0.70710678118654752);
+	//! 直流除去フィルター（1次高域通過）を設計します。
+	static BiquadCoeffs dcBlock(double, double = 10.0);
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 多チャンネルのバイクアッドフィルターの縦続接続
+ *
+ * 32bit floatのインターリーブ形式のフレーム列をその場で処理する。
+ * 状態（転置直接形IIの2遅延）はチャンネルを連続させたSoA配置で保持し、
+ * 隣り合う8チャンネル（AVX）または4チャンネル（SSE）を1命令で処理する。
+ * 端数のチャンネルはスカラーで処理する。ブロック内では段ごとに状態を
+ * レジスターに置いたまま全フレームを処理するため、ブロックはキャッシュに
+ * 載ったまま全段を通過する。
+ *
+ * 処理中はFTZ/DAZを有効にし、ブロック末尾で極小の状態を0にして、
+ * 無音が続いたときの非正規化数による速度低下を防ぐ。
+ * 全チャンネルに同じ係数を使う。
+ */
+// ----------------------------------------------------------------------------
+class BiquadCascade : private Noncopyable
+{
+public:
+	explicit BiquadCascade(WORD);
+	virtual ~BiquadCascade() {}
+
+	//! 段を追加します。
+	void addStage(const BiquadCoeffs&);
+	//! 段の係数を変更します。
+	void setStage(size_t, const BiquadCoeffs&);
+	/**
+	 * @brief	段数を取得する
+	 * @return	段数
+	 */
+	size_t stages() const { return coeffs_.size(); }
+	/**
+	 * @brief	チャンネル数を取得する
+	 * @return	チャンネル数
+	 */
+	WORD channels() const { return channels_; }
+	//! 状態を0に戻します。
+	void reset();
+	//! フレーム列をその場で処理します。
+	void process(float*, size_t);
+
+private:
+	//! チャンネル数
+	const WORD channels_;
+	//! 段ごとの係数
+	std::vector<BiquadCoeffs> coeffs_;
+	//! 段ごとの1つ目の遅延（段×チャンネル）
+	std::vector<float> z1_;
+	//! 段ごとの2つ目の遅延（段×チャンネル）
+	std::vector<float> z2_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 多チャンネルのFIRフィルター
+ *
+ * 32bit floatのインターリーブ形式のフレーム列をその場で処理する。
+ * 直前のブロックの末尾（タップ数-1フレーム）をインターリーブのまま保持する。
+ * タップkの入力は出力からちょうどkフレーム前にあるため、チャンネル数によらず
+ * インターリーブのまま連続する8（AVX）または4（SSE）サンプルを1命令で計算する。
+ * 全チャンネルに同じ係数を使う。
+ */
+// ----------------------------------------------------------------------------
+class FirFilter : private Noncopyable
+{
+public:
+	FirFilter(WORD, const std::vector<float>&);
+	virtual ~FirFilter() {}
+
+	//! 窓関数法で低域通過フィルターの係数を設計します。
+	static std::vector<float> designLowpass(size_t, double, double);
+	//! 窓関数法で高域通過フィルターの係数を設計します。
+	static std::vector<float> designHighpass(size_t, double, double);
+
+	/**
+	 * @brief	タップ数を取得する
+	 * @return	タップ数
+	 */
+	size_t taps() const { return taps_.size(); }
+	//! 状態を0に戻します。
+	void reset();
+	//! フレーム列をその場で処理します。
+	void process(float*, size_t);
+
+private:
+	//! チャンネル数
+	const WORD channels_;
+	//! 係数（逆順）
+	std::vector<float> taps_;
+	//! 直前の入力（タップ数-1フレーム）と今回の入力の作業領域
+	std::vector<float> work_;
+};
+
+#endif // !_FILTERBANK_H_
@@ -0,0 +1,281 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	HeaderCache.cpp
+ * @brief	RIFF-WAVヘッダーの解析結果キャッシュクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "HeaderCache.h"
+#include "BinaryWriter.h"
+
+namespace {
+
+//! 索引ファイルの識別子
+const char IndexMagic[4] = { 'W', '1', '1', 'H' };
+//! 索引ファイルの版
+const DWORD IndexVersion = 1;
+//! 索引ファイルのヘッダーのバイトサイズ
+const int64_t IndexHeaderSize = 16;
+//! 索引ファイルの1項目のバイトサイズ
+const int64_t IndexRecordSize = 64;
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// ファイルを開き、キャッシュを使ってストリーム読み込みの準備を行います。
+/**
+ * 開いたファイルの属性でキャッシュを検索し、一致すればヘッダーを読まずに
+ * RiffWavReader::prepare(const RiffWavInfo&)で準備します。一致しなければ
+ * RiffWavReader::prepareでヘッダーを解析し、結果を登録します。
+ *
+ * @param[out]	reader	読み込みクラス。復旧モード等の設定は呼び出し前に行うこと。
+ * @param[in]	path	ファイルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool HeaderCache::open(RiffWavReader& reader, const tstring& path)
+{
+	if (!reader.open(path)) {
+		return false;
+	}
+	FileStamp stamp;
+	if (!reader.getStamp(stamp)) {
+		return reader.prepare();
+	}
+	if (stamp.inode == 0) {
+		stamp.inode = static_cast<uint64_t>(std::hash<tstring>()(path));
+	}
+
+	RiffWavInfo info;
+	if (lookup(stamp, info) && reader.prepare(info)) {
+		return true;
+	}
+	if (!reader.prepare()) {
+		return false;
+	}
+	if (!reader.getInfo().inferred) {
+		insert(stamp, reader.getInfo());
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// ファイルの属性に一致する解析結果を検索します。
+/**
+ * 同じファイルでもサイズか最終更新時刻が異なる項目は、書き換えられたとみなして捨てます。
+ *
+ * @param[in]	stamp	ファイルの属性
+ * @param[out]	info	一致した解析結果
+ * return	一致すれば真
+ */
+// ----------------------------------------------------------------------------
+bool HeaderCache::lookup(const FileStamp& stamp, RiffWavInfo& info)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = index_.find(keyOf(stamp));
+	if (it == index_.end()) {
+		misses_++;
+		return false;
+	}
+	const FileStamp& cached = it->second->stamp;
+	if (cached.size != stamp.size || cached.mtime != stamp.mtime) {
+		lru_.erase(it->second);
+		index_.erase(it);
+		misses_++;
+		return false;
+	}
+	lru_.splice(lru_.begin(), lru_, it->second);
+	info = it->second->info;
+	hits_++;
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 解析結果を登録します。
+/**
+ * 同じファイルの項目があれば置き換えます。
+ *
+ * @param[in]	stamp	ファイルの属性
+ * @param[in]	info	ヘッダーの解析結果
+ */
+// ----------------------------------------------------------------------------
+void HeaderCache::insert(const FileStamp& stamp, const RiffWavInfo& info)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	insertLocked(stamp, info);
+}
+// ----------------------------------------------------------------------------
+// キャッシュを空にします。
+/**
+ * 検索の回数も0に戻します。
+ */
+// ----------------------------------------------------------------------------
+void HeaderCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	lru_.clear();
+	index_.clear();
+	hits_ = 0;
+	misses_ = 0;
+}
+// ----------------------------------------------------------------------------
+// 索引ファイルに保存します。
+/**
+ * 16バイトのヘッダー（識別子・版・項目数）に続けて、64バイト固定長の項目を
+ * 古い順に書き出します。数値はリトルエンディアンです。
+ *
+ * @param[in]	path	索引ファイルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool HeaderCache::save(const tstring& path) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	BinaryWriter writer;
+	if (!writer.open(path)) {
+		return false;
+	}
+	try {
+		if (writer.writeBytes(IndexMagic, 4) != 4) {
+			return false;
+		}
+		writer.writeDWORD(IndexVersion);
+		writer.writeQWORD(lru_.size());
+		for (auto it = lru_.rbegin(); it != lru_.rend(); ++it) {
+			const FileStamp& s = it->stamp;
+			const RiffWavInfo& info = it->info;
+			writer.writeQWORD(s.device);
+			writer.writeQWORD(s.inode);
+			writer.writeQWORD(static_cast<uint64_t>(s.size));
+			writer.writeQWORD(static_cast<uint64_t>(s.mtime));
+			writer.writeQWORD(info.dataOffset);
+			writer.writeQWORD(info.dataLength);
+			writer.writeWORD(static_cast<WORD>(info.container));
+			writer.writeWORD(info.format.wFormatTag);
+			writer.writeWORD(info.format.nChannels);
+			writer.writeWORD(info.format.wBitsPerSample);
+			writer.writeDWORD(info.format.nSamplesPerSec);
+			writer.writeWORD(info.format.nBlockAlign);
+			writer.writeWORD(info.bigEndian ? 1 : 0);
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return writer.flush();
+}
+// ----------------------------------------------------------------------------
+// 索引ファイルから復元します。
+/**
+ * saveで書き出した項目を登録します。ファイルが壊れている場合は何も登録しません。
+ * 既存の項目は残り、同じファイルの項目は索引ファイルの内容で置き換えます。
+ *
+ * @param[in]	path	索引ファイルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool HeaderCache::load(const tstring& path)
+{
+	BinaryReader reader;
+	if (!reader.open(path)) {
+		return false;
+	}
+	std::vector<Entry> entries;
+	try {
+		char magic[4];
+		if (reader.readBytes(magic, 4) != 4 || ::memcmp(magic, IndexMagic, 4) != 0
+			|| reader.readDWORD() != IndexVersion) {
+			return false;
+		}
+		const uint64_t count = reader.readQWORD();
+		const int64_t fileSize = reader.size();
+		if (fileSize < IndexHeaderSize || (fileSize - IndexHeaderSize) % IndexRecordSize != 0
+			|| count != static_cast<uint64_t>(fileSize - IndexHeaderSize) / IndexRecordSize) {
+			return false;
+		}
+		entries.resize(static_cast<size_t>(count));
+		for (size_t i = 0; i < entries.size(); i++) {
+			Entry& e = entries[i];
+			::memset(&e.info, 0, sizeof(e.info));
+			e.stamp.device = reader.readQWORD();
+			e.stamp.inode = reader.readQWORD();
+			e.stamp.size = static_cast<int64_t>(reader.readQWORD());
+			e.stamp.mtime = static_cast<int64_t>(reader.readQWORD());
+			e.info.dataOffset = reader.readQWORD();
+			e.info.dataLength = reader.readQWORD();
+			const WORD container = reader.readWORD();
+			WAVEFORMATEX& f = e.info.format;
+			f.wFormatTag = reader.readWORD();
+			f.nChannels = reader.readWORD();
+			f.wBitsPerSample = reader.readWORD();
+			f.nSamplesPerSec = reader.readDWORD();
+			f.nBlockAlign = reader.readWORD();
+			f.nAvgBytesPerSec = f.nSamplesPerSec * f.nBlockAlign;
+			e.info.bigEndian = (reader.readWORD() & 1) != 0;
+			if (container > CONTAINER_AIFC || !RiffWavParser::isValidFormat(f)
+				|| e.info.dataOffset > RiffWavParser::MaxOffset || e.info.dataLength > RiffWavParser::MaxOffset) {
+				return false;
+			}
+			e.info.container = static_cast<WavContainer>(container);
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (size_t i = 0; i < entries.size(); i++) {
+		insertLocked(entries[i].stamp, entries[i].info);
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// ロック取得済みの状態で解析結果を登録します。
+/**
+ * 登録した項目を最新とし、最大項目数を越えた分を古い順に捨てます。
+ *
+ * @param[in]	stamp	ファイルの属性
+ * @param[in]	info	ヘッダーの解析結果
+ */
+// ----------------------------------------------------------------------------
+void HeaderCache::insertLocked(const FileStamp& stamp, const RiffWavInfo& info)
+{
+	const Key key = keyOf(stamp);
+	auto it = index_.find(key);
+	if (it != index_.end()) {
+		it->second->stamp = stamp;
+		it->second->info = info;
+		lru_.splice(lru_.begin(), lru_, it->second);
+		return;
+	}
+	Entry e;
+	e.stamp = stamp;
+	e.info = info;
+	lru_.push_front(e);
+	index_[key] = lru_.begin();
+	while (lru_.size() > capacity_) {
+		index_.erase(keyOf(lru_.back().stamp));
+		lru_.pop_back();
+	}
+}
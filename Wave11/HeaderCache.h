@@ -0,0 +1,169 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	HeaderCache.h
+ * @brief	RIFF-WAVヘッダーの解析結果キャッシュクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _HEADERCACHE_H_
+#define _HEADERCACHE_H_
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "RiffWavReader.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief RIFF-WAVヘッダーの解析結果のLRUキャッシュ
+ *
+ * デバイス番号とiノード番号をキーにRiffWavInfoを保持し、ファイルサイズと
+ * 最終更新時刻が一致する場合だけ再利用する。既知のファイルはopenとfstatと
+ * ハッシュ表の検索だけで開け、ヘッダーの読み込みとチャンクの走査を省ける。
+ * 上限を越えると最も長く使われていない項目から捨てる。
+ *
+ * saveとloadで固定長レコードの索引ファイルに保存・復元でき、
+ * プロセスの再起動後もキャッシュを引き継げる。
+ * iノード番号を取得できない環境ではパスのハッシュ値で代用する。
+ *
+ * 復旧モード・追従モードでサイズを推定したヘッダーは登録しない。
+ * このクラスはスレッドセーフである。
+ */
+// ----------------------------------------------------------------------------
+class HeaderCache : private Noncopyable
+{
+public:
+	//! 既定の最大項目数
+	static const size_t DefaultCapacity = 65536;
+
+	/**
+	 * @brief	コンストラクタ
+	 * @param[in]	capacity	最大項目数
+	 */
+	explicit HeaderCache(size_t capacity = DefaultCapacity)
+		: capacity_((capacity == 0) ? 1 : capacity), hits_(0), misses_(0) {}
+	virtual ~HeaderCache() {}
+
+	//! ファイルを開き、キャッシュを使ってストリーム読み込みの準備を行います。
+	bool open(RiffWavReader&, const tstring&);
+	//! ファイルの属性に一致する解析結果を検索します。
+	bool lookup(const FileStamp&, RiffWavInfo&);
+	//! 解析結果を登録します。
+	void insert(const FileStamp&, const RiffWavInfo&);
+	//! キャッシュを空にします。
+	void clear();
+	//! 索引ファイルに保存します。
+	bool save(const tstring&) const;
+	//! 索引ファイルから復元します。
+	bool load(const tstring&);
+
+	/**
+	 * @brief	登録済みの項目数を取得する
+	 * @return	項目数
+	 */
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return lru_.size();
+	}
+	/**
+	 * @brief	検索が一致した回数を取得する
+	 * @return	一致した回数
+	 */
+	uint64_t hits() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return hits_;
+	}
+	/**
+	 * @brief	検索が一致しなかった回数を取得する
+	 * @return	一致しなかった回数
+	 */
+	uint64_t misses() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return misses_;
+	}
+
+private:
+	/**
+	 * @brief キャッシュの項目
+	 */
+	struct Entry {
+		//! ファイルの属性
+		FileStamp stamp;
+		//! ヘッダーの解析結果
+		RiffWavInfo info;
+	};
+	/**
+	 * @brief ファイルを識別するキー
+	 */
+	struct Key {
+		//! デバイス番号
+		uint64_t device;
+		//! iノード番号
+		uint64_t inode;
+
+		bool operator ==(const Key& rhs) const {
+			return device == rhs.device && inode == rhs.inode;
+		}
+	};
+	/**
+	 * @brief キーのハッシュ関数
+	 */
+	struct KeyHash {
+		size_t operator ()(const Key& k) const {
+			uint64_t h = k.inode * 0x9E3779B97F4A7C15ULL ^ k.device;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+	};
+	typedef std::list<Entry> EntryList;
+
+	//! 最大項目数
+	const size_t capacity_;
+	//! 最近使った順の項目（先頭が最新）
+	EntryList lru_;
+	//! キーから項目への索引
+	std::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+	//! 検索が一致した回数
+	uint64_t hits_;
+	//! 検索が一致しなかった回数
+	uint64_t misses_;
+	//! 排他制御
+	mutable std::mutex mutex_;
+
+	/**
+	 * @brief	ファイルの属性からキーを作る
+	 * @param[in]	stamp	ファイルの属性
+	 * @return	キー
+	 */
+	static Key keyOf(const FileStamp& stamp) {
+		Key k = { stamp.device, stamp.inode };
+		return k;
+	}
+	//! ロック取得済みの状態で解析結果を登録します。
+	void insertLocked(const FileStamp&, const RiffWavInfo&);
+};
+
+#endif // !_HEADERCACHE_H_
@@ -0,0 +1,530 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	LoudnessMeter.cpp
+ * @brief	ラウドネス・トゥルーピーク計測クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "LoudnessMeter.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "SampleConverter.h"
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LOUDNESS_USE_SSE2
+#endif
+
+namespace {
+
+//! 絶対ゲート（LUFS）
+const double AbsoluteGate = -70.0;
+//! 統合ラウドネスの相対ゲート（LU）
+const double IntegratedGate = -10.0;
+//! ラウドネスレンジの相対ゲート（LU）
+const double RangeGate = -20.0;
+//! onStreamで一度に変換するフレーム数
+const size_t ConvertFrames = 1024;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	平均二乗エネルギーをラウドネスに変換する
+ * @param[in]	e	重み付き平均二乗エネルギー
+ * @return	ラウドネス（LUFS）。無音なら負の無限大。
+ */
+// ----------------------------------------------------------------------------
+double toLufs(double e)
+{
+	if (e <= 0.0) {
+		return -std::numeric_limits<double>::infinity();
+	}
+	return -0.691 + 10.0 * std::log10(e);
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	ラウドネスを平均二乗エネルギーに変換する
+ * @param[in]	lufs	ラウドネス（LUFS）
+ * @return	重み付き平均二乗エネルギー
+ */
+// ----------------------------------------------------------------------------
+double toEnergy(double lufs)
+{
+	return std::pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// チャンネル数とサンプリングレートを設定し、計測を初期化します。
+/**
+ * Kウェイティングの係数はBS.1770のアナログ原型から双一次変換で求めるため、
+ * 48kHz以外のサンプリングレートにも対応します。
+ *
+ * @param[in]	channels	チャンネル数
+ * @param[in]	fs			サンプリングレート
+ */
+// ----------------------------------------------------------------------------
+void LoudnessMeter::reset(WORD channels, DWORD fs)
+{
+	channels_ = (channels == 0) ? 1 : channels;
+	fs_ = (fs == 0) ? 48000 : fs;
+	lanes_ = (channels_ + 3) & ~static_cast<size_t>(3);
+	blockFrames_ = (fs_ + 5) / 10;
+	blockPos_ = 0;
+	frames_ = 0;
+
+	// 1段目: 頭部の音響効果を模した高域シェルフ
+	{
+		const double f0 = 1681.974450955533;
+		const double g = 3.999843853973347;
+		const double q = 0.7071752369554196;
+		const double k = std::tan(M_PI * f0 / fs_);
+		const double vh = std::pow(10.0, g / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+		shelf_[0] = (vh + vb * k / q + k * k) / a0;
+		shelf_[1] = 2.0 * (k * k - vh) / a0;
+		shelf_[2] = (vh - vb * k / q + k * k) / a0;
+		shelf_[3] = 2.0 * (k * k - 1.0) / a0;
+		shelf_[4] = (1.0 - k / q + k * k) / a0;
+	}
+	// 2段目: RLB重み付けの高域通過
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+		const double k = std::tan(M_PI * f0 / fs_);
+		const double a0 = 1.0 + k / q + k * k;
+		highpass_[0] = 1.0;
+		highpass_[1] = -2.0;
+		highpass_[2] = 1.0;
+		highpass_[3] = 2.0 * (k * k - 1.0) / a0;
+		highpass_[4] = (1.0 - k / q + k * k) / a0;
+	}
+	state_.assign(lanes_ * 4, 0.0);
+	energy_.assign(lanes_, 0.0);
+
+	// 5.1chではLFEを除き、サラウンドを+1.5dB重み付けする
+	weight_.assign(lanes_, 0.0);
+	for (size_t ch = 0; ch < channels_; ch++) {
+		weight_[ch] = 1.0;
+	}
+	if (channels_ == 6) {
+		weight_[3] = 0.0;
+		weight_[4] = 1.41;
+		weight_[5] = 1.41;
+	}
+
+	// 4倍補間の多相FIR（Blackman窓のsinc、相ごとに直流利得を1に正規化）
+	const double half = Taps / 2.0;
+	for (size_t p = 0; p < Oversample; p++) {
+		double sum = 0.0;
+		double h[Taps];
+		for (size_t j = 0; j < Taps; j++) {
+			const double d = (half - 1.0) + static_cast<double>(p) / Oversample - static_cast<double>(j);
+			const double sinc = (d == 0.0) ? 1.0 : std::sin(M_PI * d) / (M_PI * d);
+			const double w = 0.42 + 0.5 * std::cos(M_PI * d / half) + 0.08 * std::cos(2.0 * M_PI * d / half);
+			h[j] = sinc * w;
+			sum += h[j];
+		}
+		for (size_t j = 0; j < Taps; j++) {
+			interp_[p][j] = static_cast<float>(h[j] / sum);
+		}
+	}
+	history_.assign(lanes_ * Taps * 2, 0.f);
+	historyPos_ = 0;
+	peak_.assign(lanes_, 0.f);
+	frame_.assign(lanes_, 0.f);
+
+	recent_.clear();
+	momentaryBlocks_.clear();
+	shortTermBlocks_.clear();
+
+	streamBits_ = 16;
+	streamPcm_ = true;
+	streamFrameBytes_ = 2 * channels_;
+	carry_.clear();
+}
+// ----------------------------------------------------------------------------
+// 32bit floatのフレームを計測します。
+/**
+ * 100ms区間の境界で区切り、区間内はチャンネルの組ごとに
+ * フィルタ状態をレジスタに保持したままフレームを処理します。
+ *
+ * @param[in]	src		インターリーブ形式のフレーム
+ * @param[in]	frames	フレーム数
+ */
+// ----------------------------------------------------------------------------
+void LoudnessMeter::process(const float* src, size_t frames)
+{
+	if (src == nullptr) {
+		return;
+	}
+	const size_t ch = channels_;
+	while (frames > 0) {
+		const size_t n = std::min(frames, blockFrames_ - blockPos_);
+
+		// Kウェイティングと二乗和（2チャンネルずつ）
+		for (size_t g = 0; g < ch; g += 2) {
+			const bool pair = (g + 1 < ch);
+			double* s = &state_[g];
+#ifdef LOUDNESS_USE_SSE2
+			const __m128d b0 = _mm_set1_pd(shelf_[0]), b1 = _mm_set1_pd(shelf_[1]), b2 = _mm_set1_pd(shelf_[2]);
+			const __m128d a1 = _mm_set1_pd(shelf_[3]), a2 = _mm_set1_pd(shelf_[4]);
+			const __m128d c1 = _mm_set1_pd(highpass_[1]);
+			const __m128d d1 = _mm_set1_pd(highpass_[3]), d2 = _mm_set1_pd(highpass_[4]);
+			__m128d s1 = _mm_loadu_pd(s), s2 = _mm_loadu_pd(s + lanes_);
+			__m128d t1 = _mm_loadu_pd(s + lanes_ * 2), t2 = _mm_loadu_pd(s + lanes_ * 3);
+			__m128d acc = _mm_setzero_pd();
+			const float* p = src + g;
+			for (size_t i = 0; i < n; i++, p += ch) {
+				const __m128d x = _mm_set_pd(pair ? p[1] : 0.0, p[0]);
+				const __m128d y = _mm_add_pd(_mm_mul_pd(b0, x), s1);
+				s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), s2);
+				s2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+				// 2段目の分子は1,-2,1
+				const __m128d z = _mm_add_pd(y, t1);
+				t1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(c1, y), _mm_mul_pd(d1, z)), t2);
+				t2 = _mm_sub_pd(y, _mm_mul_pd(d2, z));
+				acc = _mm_add_pd(acc, _mm_mul_pd(z, z));
+			}
+			_mm_storeu_pd(s, s1);
+			_mm_storeu_pd(s + lanes_, s2);
+			_mm_storeu_pd(s + lanes_ * 2, t1);
+			_mm_storeu_pd(s + lanes_ * 3, t2);
+			double e[2];
+			_mm_storeu_pd(e, acc);
+			energy_[g] += e[0];
+			energy_[g + 1] += e[1];
+#else
+			for (size_t c = g; c < g + (pair ? 2 : 1); c++) {
+				double s1 = state_[c], s2 = state_[c + lanes_];
+				double t1 = state_[c + lanes_ * 2], t2 = state_[c + lanes_ * 3];
+				double acc = 0.0;
+				const float* p = src + c;
+				for (size_t i = 0; i < n; i++, p += ch) {
+					const double x = *p;
+					const double y = shelf_[0] * x + s1;
+					s1 = shelf_[1] * x - shelf_[3] * y + s2;
+					s2 = shelf_[2] * x - shelf_[4] * y;
+					const double z = y + t1;
+					t1 = highpass_[1] * y - highpass_[3] * z + t2;
+					t2 = y - highpass_[4] * z;
+					acc += z * z;
+				}
+				state_[c] = s1;
+				state_[c + lanes_] = s2;
+				state_[c + lanes_ * 2] = t1;
+				state_[c + lanes_ * 3] = t2;
+				energy_[c] += acc;
+			}
+#endif
+		}
+
+		// トゥルーピーク（4チャンネルずつ）
+		for (size_t g = 0; g < lanes_; g += 4) {
+			float* hist = &history_[g * Taps * 2];
+			const size_t width = std::min(ch - g, static_cast<size_t>(4));
+			size_t pos = historyPos_;
+			const float* p = src + g;
+#ifdef LOUDNESS_USE_SSE2
+			__m128 peak = _mm_loadu_ps(&peak_[g]);
+			const __m128 sign = _mm_set1_ps(-0.f);
+			for (size_t i = 0; i < n; i++, p += ch) {
+				float x[4] = { 0.f, 0.f, 0.f, 0.f };
+				for (size_t c = 0; c < width; c++) {
+					x[c] = p[c];
+				}
+				const __m128 v = _mm_loadu_ps(x);
+				_mm_storeu_ps(hist + pos * 4, v);
+				_mm_storeu_ps(hist + (pos + Taps) * 4, v);
+				pos = (pos + 1 == Taps) ? 0 : pos + 1;
+				const float* w = hist + pos * 4;
+				for (size_t ph = 0; ph < Oversample; ph++) {
+					__m128 acc = _mm_setzero_ps();
+					for (size_t k = 0; k < Taps; k++) {
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(interp_[ph][k]), _mm_loadu_ps(w + k * 4)));
+					}
+					peak = _mm_max_ps(peak, _mm_andnot_ps(sign, acc));
+				}
+			}
+			_mm_storeu_ps(&peak_[g], peak);
+#else
+			for (size_t i = 0; i < n; i++, p += ch) {
+				for (size_t c = 0; c < 4; c++) {
+					const float v = (c < width) ? p[c] : 0.f;
+					hist[pos * 4 + c] = v;
+					hist[(pos + Taps) * 4 + c] = v;
+				}
+				pos = (pos + 1 == Taps) ? 0 : pos + 1;
+				const float* w = hist + pos * 4;
+				for (size_t ph = 0; ph < Oversample; ph++) {
+					for (size_t c = 0; c < 4; c++) {
+						float acc = 0.f;
+						for (size_t k = 0; k < Taps; k++) {
+							acc += interp_[ph][k] * w[k * 4 + c];
+						}
+						peak_[g + c] = std::max(peak_[g + c], std::fabs(acc));
+					}
+				}
+			}
+#endif
+		}
+		historyPos_ = (historyPos_ + n) % Taps;
+
+		src += n * ch;
+		frames -= n;
+		frames_ += n;
+		blockPos_ += n;
+		if (blockPos_ == blockFrames_) {
+			closeBlock();
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// 100ms区間を締めます。
+/**
+ * 区間の重み付きエネルギーから400msブロックと3sブロックを100msごとに求めます。
+ */
+// ----------------------------------------------------------------------------
+void LoudnessMeter::closeBlock()
+{
+	double e = 0.0;
+	for (size_t ch = 0; ch < channels_; ch++) {
+		e += weight_[ch] * energy_[ch];
+		energy_[ch] = 0.0;
+	}
+	recent_.push_back(e / blockFrames_);
+	if (recent_.size() > ShortTermBlocks) {
+		recent_.pop_front();
+	}
+	blockPos_ = 0;
+
+	if (recent_.size() >= MomentaryBlocks) {
+		momentaryBlocks_.push_back(recentEnergy(MomentaryBlocks));
+	}
+	if (recent_.size() >= ShortTermBlocks) {
+		shortTermBlocks_.push_back(recentEnergy(ShortTermBlocks));
+	}
+}
+// ----------------------------------------------------------------------------
+// 直近のn区間の平均エネルギーを求めます。
+/**
+ * @param[in]	n	100ms区間の数
+ * @return	平均エネルギー
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::recentEnergy(size_t n) const
+{
+	double e = 0.0;
+	for (size_t i = recent_.size() - n; i < recent_.size(); i++) {
+		e += recent_[i];
+	}
+	return e / n;
+}
+// ----------------------------------------------------------------------------
+// ゲーティングしたブロックの平均エネルギーを求めます。
+/**
+ * 絶対ゲートを通過したブロックの平均から相対ゲートを求め、
+ * 両方のゲートを通過したブロックを平均します。
+ *
+ * @param[in]	blocks		ブロックのエネルギー
+ * @param[in]	relative	相対ゲート（LU）
+ * @param[out]	passed		両方のゲートを通過したブロック。不要ならnullptr。
+ * @return	平均エネルギー。通過したブロックがなければ0。
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::gatedMean(const std::vector<double>& blocks, double relative, std::vector<double>* passed)
+{
+	const double absGate = toEnergy(AbsoluteGate);
+	double sum = 0.0;
+	size_t count = 0;
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (blocks[i] > absGate) {
+			sum += blocks[i];
+			count++;
+		}
+	}
+	if (count == 0) {
+		return 0.0;
+	}
+	const double relGate = toEnergy(toLufs(sum / count) + relative);
+	sum = 0.0;
+	count = 0;
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (blocks[i] > absGate && blocks[i] > relGate) {
+			sum += blocks[i];
+			count++;
+			if (passed != nullptr) {
+				passed->push_back(blocks[i]);
+			}
+		}
+	}
+	return (count == 0) ? 0.0 : sum / count;
+}
+// ----------------------------------------------------------------------------
+// 統合ラウドネスを取得します。
+/**
+ * @return	統合ラウドネス（LUFS）。ゲートを通過したブロックがなければ負の無限大。
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::integrated() const
+{
+	return toLufs(gatedMean(momentaryBlocks_, IntegratedGate, nullptr));
+}
+// ----------------------------------------------------------------------------
+// ラウドネスレンジを取得します。
+/**
+ * EBU Tech 3342に従い、ゲーティングしたショートタームラウドネスの
+ * 10パーセンタイルから95パーセンタイルまでの幅を求めます。
+ *
+ * @return	ラウドネスレンジ（LU）。3秒未満なら0。
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::loudnessRange() const
+{
+	std::vector<double> passed;
+	gatedMean(shortTermBlocks_, RangeGate, &passed);
+	if (passed.empty()) {
+		return 0.0;
+	}
+	std::sort(passed.begin(), passed.end());
+	const size_t last = passed.size() - 1;
+	const double lo = passed[static_cast<size_t>(last * 0.10 + 0.5)];
+	const double hi = passed[static_cast<size_t>(last * 0.95 + 0.5)];
+	return toLufs(hi) - toLufs(lo);
+}
+// ----------------------------------------------------------------------------
+// モーメンタリーラウドネスを取得します。
+/**
+ * @return	直近400msのラウドネス（LUFS）。400ms未満なら負の無限大。
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::momentary() const
+{
+	if (recent_.size() < MomentaryBlocks) {
+		return -std::numeric_limits<double>::infinity();
+	}
+	return toLufs(recentEnergy(MomentaryBlocks));
+}
+// ----------------------------------------------------------------------------
+// ショートタームラウドネスを取得します。
+/**
+ * @return	直近3sのラウドネス（LUFS）。3s未満なら負の無限大。
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::shortTerm() const
+{
+	if (recent_.size() < ShortTermBlocks) {
+		return -std::numeric_limits<double>::infinity();
+	}
+	return toLufs(recentEnergy(ShortTermBlocks));
+}
+// ----------------------------------------------------------------------------
+// トゥルーピークを取得します。
+/**
+ * @return	全チャンネルのトゥルーピーク（線形、フルスケールが1）
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::truePeak() const
+{
+	float peak = 0.f;
+	for (size_t ch = 0; ch < channels_; ch++) {
+		peak = std::max(peak, peak_[ch]);
+	}
+	return peak;
+}
+// ----------------------------------------------------------------------------
+// チャンネルごとのトゥルーピークを取得します。
+/**
+ * @param[in]	ch	チャンネル番号
+ * @return	トゥルーピーク（線形、フルスケールが1）
+ */
+// ----------------------------------------------------------------------------
+double LoudnessMeter::truePeak(WORD ch) const
+{
+	return (ch < channels_) ? peak_[ch] : 0.0;
+}
+// ----------------------------------------------------------------------------
+// ストリームの開始を通知します。
+/**
+ * ストリームの形式に合わせて計測を初期化します。
+ *
+ * @param[in]	format	ストリームの形式
+ */
+// ----------------------------------------------------------------------------
+void LoudnessMeter::onStreamBegin(const WAVEFORMATEX& format)
+{
+	reset(format.nChannels, format.nSamplesPerSec);
+	streamBits_ = format.wBitsPerSample;
+	streamPcm_ = (format.wFormatTag == 1);
+	streamFrameBytes_ = format.nBlockAlign;
+}
+// ----------------------------------------------------------------------------
+// 読み書きしたペイロードを通知します。
+/**
+ * ペイロードを32bit floatに変換して計測します。
+ * フレーム境界をまたいだバイトは次の通知まで保持します。
+ *
+ * @param[in]	buf		ペイロード
+ * @param[in]	size	バイトサイズ
+ */
+// ----------------------------------------------------------------------------
+void LoudnessMeter::onStream(const void* buf, size_t size)
+{
+	if (buf == nullptr || streamFrameBytes_ == 0 || !SampleConverter::isSupported(streamBits_, streamPcm_)) {
+		return;
+	}
+	const BYTE* p = static_cast<const BYTE*>(buf);
+	scratch_.resize(ConvertFrames * channels_);
+
+	// 前回の端数を1フレームにする
+	if (!carry_.empty()) {
+		const size_t need = std::min(streamFrameBytes_ - carry_.size(), size);
+		carry_.insert(carry_.end(), p, p + need);
+		p += need;
+		size -= need;
+		if (carry_.size() < streamFrameBytes_) {
+			return;
+		}
+		SampleConverter::toFloat(&carry_[0], &scratch_[0], channels_, streamBits_, streamPcm_);
+		process(&scratch_[0], 1);
+		carry_.clear();
+	}
+
+	while (size >= streamFrameBytes_) {
+		const size_t n = std::min(size / streamFrameBytes_, ConvertFrames);
+		SampleConverter::toFloat(p, &scratch_[0], n * channels_, streamBits_, streamPcm_);
+		process(&scratch_[0], n);
+		p += n * streamFrameBytes_;
+		size -= n * streamFrameBytes_;
+	}
+	carry_.assign(p, p + size);
+}
@@ -0,0 +1,169 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	LoudnessMeter.h
+ * @brief	ラウドネス・トゥルーピーク計測クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _LOUDNESSMETER_H_
+#define _LOUDNESSMETER_H_
+
+#include <vector>
+#include <deque>
+#include "StreamObserver.h"
+#include "Noncopyable.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ラウドネス・トゥルーピーク計測クラス
+ *
+ * ITU-R BS.1770-4 / EBU R128に従い、統合ラウドネス・ラウドネスレンジ・
+ * モーメンタリー・ショートタームラウドネスとトゥルーピークを逐次計測する。
+ *
+ * Kウェイティングの2段のbiquadはサンプリングレートから係数を求め、
+ * チャンネル方向に2チャンネルずつSSE2の倍精度で処理する。
+ * トゥルーピークは4倍オーバーサンプリングの多相FIRで補間し、
+ * チャンネル方向に4チャンネルずつSSEの単精度で処理する。
+ *
+ * StreamObserverとしてRiffWavReader/RiffWavWriterに登録すると、
+ * 読み書きしたペイロードから形式を判別して計測する。
+ * このクラスはスレッドセーフではない。
+ */
+// ----------------------------------------------------------------------------
+class LoudnessMeter : public StreamObserver, private Noncopyable
+{
+public:
+	LoudnessMeter() { reset(2, 48000); }
+	/**
+	 * @param[in]	channels	チャンネル数
+	 * @param[in]	fs			サンプリングレート
+	 */
+	LoudnessMeter(WORD channels, DWORD fs) { reset(channels, fs); }
+	virtual ~LoudnessMeter() {}
+
+	//! チャンネル数とサンプリングレートを設定し、計測を初期化します。
+	void reset(WORD, DWORD);
+	//! 32bit floatのフレームを計測します。
+	void process(const float*, size_t);
+
+	//! 統合ラウドネスを取得します。
+	double integrated() const;
+	//! ラウドネスレンジを取得します。
+	double loudnessRange() const;
+	//! モーメンタリーラウドネスを取得します。
+	double momentary() const;
+	//! ショートタームラウドネスを取得します。
+	double shortTerm() const;
+	//! トゥルーピークを取得します。
+	double truePeak() const;
+	//! チャンネルごとのトゥルーピークを取得します。
+	double truePeak(WORD) const;
+	/**
+	 * @brief	計測したフレーム数を取得する
+	 * @return	processに与えたフレーム数の累計
+	 */
+	uint64_t frames() const { return frames_; }
+	/**
+	 * @brief	チャンネル数を取得する
+	 * @return	チャンネル数
+	 */
+	WORD channels() const { return channels_; }
+
+	// StreamObserver
+	void onStreamBegin(const WAVEFORMATEX&);
+	void onStream(const void*, size_t);
+
+private:
+	//! トゥルーピークの補間倍率
+	static const size_t Oversample = 4;
+	//! トゥルーピークの多相FIRの1相あたりのタップ数
+	static const size_t Taps = 12;
+	//! ショートタームの100ms区間数
+	static const size_t ShortTermBlocks = 30;
+	//! モーメンタリーの100ms区間数
+	static const size_t MomentaryBlocks = 4;
+
+	//! チャンネル数
+	WORD channels_;
+	//! サンプリングレート
+	DWORD fs_;
+	//! SIMDの幅に切り上げたチャンネル数
+	size_t lanes_;
+	//! 100ms区間のフレーム数
+	size_t blockFrames_;
+	//! 現在の100ms区間に加算したフレーム数
+	size_t blockPos_;
+	//! 計測したフレーム数
+	uint64_t frames_;
+
+	//! 1段目（高域シェルフ）の係数 b0,b1,b2,a1,a2
+	double shelf_[5];
+	//! 2段目（高域通過）の係数 b0,b1,b2,a1,a2
+	double highpass_[5];
+	//! チャンネルごとのbiquadの状態（1段目s1,s2、2段目s1,s2の順に各lanes_個）
+	std::vector<double> state_;
+	//! チャンネルごとの現在の100ms区間の二乗和
+	std::vector<double> energy_;
+	//! チャンネルの重み
+	std::vector<double> weight_;
+
+	//! トゥルーピーク補間の係数 [相][タップ]
+	float interp_[Oversample][Taps];
+	//! 補間用の入力履歴。Taps*2フレーム分を二重に書き込む。
+	std::vector<float> history_;
+	//! 入力履歴の書き込み位置
+	size_t historyPos_;
+	//! チャンネルごとのトゥルーピーク（線形）
+	std::vector<float> peak_;
+	//! 入力フレームの作業領域
+	std::vector<float> frame_;
+
+	//! 直近の100ms区間の重み付きエネルギー
+	std::deque<double> recent_;
+	//! 400msブロックの重み付きエネルギー（100msごと）
+	std::vector<double> momentaryBlocks_;
+	//! 3sブロックの重み付きエネルギー（100msごと）
+	std::vector<double> shortTermBlocks_;
+
+	//! onStreamのサンプル形式の量子化ビット数
+	WORD streamBits_;
+	//! onStreamのサンプル形式が整数型PCMなら真
+	bool streamPcm_;
+	//! onStreamのフレームサイズ
+	size_t streamFrameBytes_;
+	//! onStreamでフレーム境界をまたいだバイト
+	std::vector<BYTE> carry_;
+	//! onStreamの変換先
+	std::vector<float> scratch_;
+
+	//! 100ms区間を締めます。
+	void closeBlock();
+	//! 直近のn区間の平均エネルギーを求めます。
+	double recentEnergy(size_t) const;
+	//! ゲーティングしたブロックの平均エネルギーを求めます。
+	static double gatedMean(const std::vector<double>&, double, std::vector<double>*);
+};
+
+#endif // !_LOUDNESSMETER_H_
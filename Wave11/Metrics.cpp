@@ -0,0 +1,236 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Metrics.cpp
+ * @brief	入出力の計測カウンターの実装
+ */
+// ----------------------------------------------------------------------------
+#include "Metrics.h"
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief スレッドごとの計測値
+ *
+ * 書き込むのは所有スレッドのみで、集計スレッドからは読み込みのみ行う。
+ */
+// ----------------------------------------------------------------------------
+struct ThreadMetrics {
+	std::atomic<uint64_t> values[METRIC_COUNT];
+
+	ThreadMetrics();
+	~ThreadMetrics();
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 全スレッドの計測値の登録先
+ *
+ * プロセス終了時のスレッド終了処理からも参照されるため破棄しない。
+ */
+// ----------------------------------------------------------------------------
+struct Registry {
+	std::mutex mutex;
+	std::vector<ThreadMetrics*> threads;
+	//! 終了したスレッドの計測値
+	uint64_t retired[METRIC_COUNT];
+
+	Registry() {
+		for (int i = 0; i < METRIC_COUNT; i++) retired[i] = 0;
+	}
+	static Registry& instance() {
+		static Registry* r = new Registry();
+		return *r;
+	}
+};
+
+ThreadMetrics::ThreadMetrics()
+{
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		values[i].store(0, std::memory_order_relaxed);
+	}
+	Registry& r = Registry::instance();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.threads.push_back(this);
+}
+
+ThreadMetrics::~ThreadMetrics()
+{
+	Registry& r = Registry::instance();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		r.retired[i] += values[i].load(std::memory_order_relaxed);
+	}
+	r.threads.erase(std::remove(r.threads.begin(), r.threads.end(), this), r.threads.end());
+}
+
+ThreadMetrics& threadMetrics()
+{
+	static thread_local ThreadMetrics m;
+	return m;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// 呼び出しスレッドの計測値に加算します。
+/**
+ * ロックは取らず、スレッドローカルの値を更新するだけです。
+ *
+ * @param[in]	id	計測項目
+ * @param[in]	n	加算する値
+ */
+// ----------------------------------------------------------------------------
+void Metrics::add(MetricId id, uint64_t n)
+{
+	std::atomic<uint64_t>& v = threadMetrics().values[id];
+	v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+// ----------------------------------------------------------------------------
+// 全スレッドの計測値を集計します。
+/**
+ * @return	終了したスレッドを含む全スレッドの累積値
+ */
+// ----------------------------------------------------------------------------
+MetricsSnapshot Metrics::snapshot()
+{
+	MetricsSnapshot s;
+	Registry& r = Registry::instance();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		s.values[i] = r.retired[i];
+	}
+	for (size_t t = 0; t < r.threads.size(); t++) {
+		for (int i = 0; i < METRIC_COUNT; i++) {
+			s.values[i] += r.threads[t]->values[i].load(std::memory_order_relaxed);
+		}
+	}
+	return s;
+}
+// ----------------------------------------------------------------------------
+// 全スレッドの計測値を0に戻します。
+/**
+ * 他のスレッドが同時に加算している値は失われることがあります。
+ */
+// ----------------------------------------------------------------------------
+void Metrics::reset()
+{
+	Registry& r = Registry::instance();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		r.retired[i] = 0;
+	}
+	for (size_t t = 0; t < r.threads.size(); t++) {
+		for (int i = 0; i < METRIC_COUNT; i++) {
+			r.threads[t]->values[i].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// 計測項目の名前を取得します。
+/**
+ * @param[in]	id	計測項目
+ * @return	計測項目の名前
+ */
+// ----------------------------------------------------------------------------
+const char* Metrics::name(MetricId id)
+{
+	static const char* const names[METRIC_COUNT] = {
+		"bytes_read",
+		"bytes_written",
+		"read_calls",
+		"write_calls",
+		"seek_calls",
+		"tell_calls",
+		"read_ns",
+		"write_ns",
+		"seek_ns",
+		"header_parse_ns",
+		"convert_ns"
+	};
+	return (id >= 0 && id < METRIC_COUNT) ? names[id] : "unknown";
+}
+// ----------------------------------------------------------------------------
+// 全スレッドの計測値を1行で出力します。
+/**
+ * "name=value"を空白区切りで並べた1行を出力します。
+ *
+ * @param[in]	out	出力先
+ */
+// ----------------------------------------------------------------------------
+void Metrics::dump(FILE* out)
+{
+	if (out == nullptr) {
+		return;
+	}
+	MetricsSnapshot s = snapshot();
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		::fprintf(out, "%s%s=%llu", (i == 0) ? "" : " ",
+			name(static_cast<MetricId>(i)), static_cast<unsigned long long>(s.values[i]));
+	}
+	::fprintf(out, "\n");
+	::fflush(out);
+}
+// ----------------------------------------------------------------------------
+// 出力間隔と出力先を指定して定期出力を開始します。
+/**
+ * @param[in]	intervalMs	出力間隔（ミリ秒）
+ * @param[in]	out			出力先
+ */
+// ----------------------------------------------------------------------------
+MetricsDumper::MetricsDumper(unsigned int intervalMs, FILE* out)
+: intervalMs_(intervalMs),
+  out_(out),
+  stop_(false)
+{
+	thread_ = std::thread(&MetricsDumper::run, this);
+}
+// ----------------------------------------------------------------------------
+// 定期出力を終了します。
+// ----------------------------------------------------------------------------
+MetricsDumper::~MetricsDumper()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+	thread_.join();
+}
+// ----------------------------------------------------------------------------
+// 出力スレッドの本体
+// ----------------------------------------------------------------------------
+void MetricsDumper::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!stop_) {
+		cond_.wait_for(lock, std::chrono::milliseconds(intervalMs_), [this]() { return stop_; });
+		Metrics::dump(out_);
+	}
+}
@@ -0,0 +1,174 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Metrics.h
+ * @brief	入出力の計測カウンターのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Noncopyable.h"
+
+//! 計測項目
+enum MetricId {
+	METRIC_BYTES_READ,		//!< 読み込みバイト数
+	METRIC_BYTES_WRITTEN,	//!< 書き出しバイト数
+	METRIC_READ_CALLS,		//!< 読み込み呼び出し回数
+	METRIC_WRITE_CALLS,		//!< 書き出し呼び出し回数
+	METRIC_SEEK_CALLS,		//!< シーク呼び出し回数
+	METRIC_TELL_CALLS,		//!< 位置取得呼び出し回数
+	METRIC_READ_NS,			//!< 読み込みでブロックした時間（ナノ秒）
+	METRIC_WRITE_NS,		//!< 書き出しでブロックした時間（ナノ秒）
+	METRIC_SEEK_NS,			//!< シークでブロックした時間（ナノ秒）
+	METRIC_HEADER_PARSE_NS,	//!< ヘッダー解析時間（ナノ秒）
+	METRIC_CONVERT_NS,		//!< サンプル形式変換時間（ナノ秒）
+	METRIC_COUNT			//!< 計測項目数
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 計測値のスナップショット
+ */
+// ----------------------------------------------------------------------------
+struct MetricsSnapshot {
+	//! 計測項目ごとの累積値
+	uint64_t values[METRIC_COUNT];
+
+	/**
+	 * @brief	計測値を取得する
+	 * @param[in]	id	計測項目
+	 * @return	累積値
+	 */
+	uint64_t operator [](MetricId id) const { return values[id]; }
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 入出力の計測カウンター
+ *
+ * 計測値はスレッドごとに加算し、snapshotの呼び出し時に全スレッド分を集計する。
+ * 終了したスレッドの値は集計済みの値に繰り入れられる。
+ *
+ * ライブラリ内部の計測箇所はWAVE11_METRICSを定義してビルドした場合にのみ有効となり、
+ * 未定義の場合は計測処理自体がコンパイルされない（snapshotは常に0を返す）。
+ */
+// ----------------------------------------------------------------------------
+class Metrics
+{
+public:
+	//! 呼び出しスレッドの計測値に加算します。
+	static void add(MetricId, uint64_t);
+	//! 全スレッドの計測値を集計します。
+	static MetricsSnapshot snapshot();
+	//! 全スレッドの計測値を0に戻します。
+	static void reset();
+	//! 計測項目の名前を取得します。
+	static const char* name(MetricId);
+	//! 全スレッドの計測値を1行で出力します。
+	static void dump(FILE*);
+
+private:
+	Metrics();
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief スコープの経過時間を計測項目に加算するクラス
+ */
+// ----------------------------------------------------------------------------
+class MetricsTimer : private Noncopyable
+{
+public:
+	/**
+	 * @param[in]	id	加算先の計測項目
+	 */
+	explicit MetricsTimer(MetricId id) : id_(id), start_(std::chrono::steady_clock::now()) {}
+	~MetricsTimer() {
+		std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - start_;
+		Metrics::add(id_, static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+	}
+
+private:
+	//! 加算先の計測項目
+	const MetricId id_;
+	//! 計測開始時刻
+	const std::chrono::steady_clock::time_point start_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 計測値を定期的に出力するクラス
+ *
+ * 構築すると専用スレッドで一定間隔ごとにMetrics::dumpを呼び出す。
+ * 破棄時に最後の1回を出力してスレッドを終了する。
+ */
+// ----------------------------------------------------------------------------
+class MetricsDumper : private Noncopyable
+{
+public:
+	//! 出力間隔と出力先を指定して定期出力を開始します。
+	MetricsDumper(unsigned int, FILE*);
+	//! 定期出力を終了します。
+	~MetricsDumper();
+
+private:
+	//! 出力間隔（ミリ秒）
+	const unsigned int intervalMs_;
+	//! 出力先
+	FILE* out_;
+	//! 終了要求
+	bool stop_;
+	//! 終了要求の排他
+	std::mutex mutex_;
+	//! 終了要求の通知
+	std::condition_variable cond_;
+	//! 出力スレッド
+	std::thread thread_;
+
+	//! 出力スレッドの本体
+	void run();
+
+	MetricsDumper();
+};
+
+#ifdef WAVE11_METRICS
+//! 計測項目に値を加算する
+#define WAVE11_METRIC_ADD(id, n)		Metrics::add((id), (n))
+//! スコープの経過時間を計測項目に加算する
+#define WAVE11_METRIC_TIMER(var, id)	MetricsTimer var(id)
+#else
+#define WAVE11_METRIC_ADD(id, n)		((void)0)
+#define WAVE11_METRIC_TIMER(var, id)	((void)0)
+#endif
+
+#endif // !_METRICS_H_
@@ -0,0 +1,341 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	PositionalFile.cpp
+ * @brief	位置指定で読み書きするファイルクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "PositionalFile.h"
+#include "Metrics.h"
+
+#if !(defined(_WIN32) && defined(_MSC_VER))
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(_WIN32) && defined(_MSC_VER)
+// ----------------------------------------------------------------------------
+PositionalFile::PositionalFile()
+: handle_(INVALID_HANDLE_VALUE)
+{
+}
+// ----------------------------------------------------------------------------
+// 読み込み用にファイルをオープンします。
+/**
+ * @param[in]	path	ファイルのパス
+ * @return	オープンに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool PositionalFile::openRead(const tstring& path)
+{
+	close();
+	handle_ = ::CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	return handle_ != INVALID_HANDLE_VALUE;
+}
+// ----------------------------------------------------------------------------
+// 読み書き用にファイルをオープンします。
+/**
+ * 他のハンドルで開いているファイル（ヘッダーを書き出し中のRiffWavWriterなど）も開けるよう、
+ * 読み書きとも共有を許可します。
+ *
+ * @param[in]	path		ファイルのパス
+ * @param[in]	truncate	真なら既存の内容を破棄する。ファイルがなければ作成する。
+ * @return	オープンに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool PositionalFile::openWrite(const tstring& path, bool truncate)
+{
+	close();
+	handle_ = ::CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	return handle_ != INVALID_HANDLE_VALUE;
+}
+// ----------------------------------------------------------------------------
+// ファイルのクローズ
+// ----------------------------------------------------------------------------
+void PositionalFile::close()
+{
+	if (handle_ != INVALID_HANDLE_VALUE) {
+		::CloseHandle(handle_);
+		handle_ = INVALID_HANDLE_VALUE;
+	}
+}
+// ----------------------------------------------------------------------------
+bool PositionalFile::isOpen() const
+{
+	return handle_ != INVALID_HANDLE_VALUE;
+}
+// ----------------------------------------------------------------------------
+// 指定位置から読み込みます。
+/**
+ * @param[out]	buf		読み込んだデータを格納するバッファ
+ * @param[in]	size	読み込むバイトサイズ
+ * @param[in]	offset	ファイル先頭からのバイトオフセット
+ * @return	実際に読み込んだバイトサイズ。終端を越えた分は含まない。
+ * @exception	WavIoException	ファイル未オープンまたは読み込みエラー
+ */
+// ----------------------------------------------------------------------------
+size_t PositionalFile::readAt(void* buf, size_t size, uint64_t offset) WAVE11_THROWS(WavIoException)
+{
+	if (buf == nullptr || size == 0) return 0;
+	if (handle_ == INVALID_HANDLE_VALUE) throw WavIoException("file isn't opened.");
+	WAVE11_METRIC_TIMER(timer, METRIC_READ_NS);
+
+	size_t done = 0;
+	while (done < size) {
+		OVERLAPPED ov = {};
+		uint64_t pos = offset + done;
+		ov.Offset = static_cast<DWORD>(pos);
+		ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+		DWORD n = 0;
+		DWORD want = (size - done > 0x40000000) ? 0x40000000 : static_cast<DWORD>(size - done);
+		WAVE11_METRIC_ADD(METRIC_READ_CALLS, 1);
+		if (!::ReadFile(handle_, static_cast<BYTE*>(buf) + done, want, &n, &ov)) {
+			if (::GetLastError() == ERROR_HANDLE_EOF) break;
+			throw WavIoException("positional read error.");
+		}
+		if (n == 0) break;
+		done += n;
+	}
+	WAVE11_METRIC_ADD(METRIC_BYTES_READ, done);
+	return done;
+}
+// ----------------------------------------------------------------------------
+// 指定位置へ書き出します。
+/**
+ * @param[in]	buf		書き出しデータバッファ
+ * @param[in]	size	書き出しデータのバイトサイズ
+ * @param[in]	offset	ファイル先頭からのバイトオフセット
+ * @return	実際に書き出したバイトサイズ
+ * @exception	WavIoException	ファイル未オープンまたは書き出しエラー
+ */
+// ----------------------------------------------------------------------------
+size_t PositionalFile::writeAt(const void* buf, size_t size, uint64_t offset) WAVE11_THROWS(WavIoException)
+{
+	if (buf == nullptr || size == 0) return 0;
+	if (handle_ == INVALID_HANDLE_VALUE) throw WavIoException("file isn't opened.");
+	WAVE11_METRIC_TIMER(timer, METRIC_WRITE_NS);
+
+	size_t done = 0;
+	while (done < size) {
+		OVERLAPPED ov = {};
+		uint64_t pos = offset + done;
+		ov.Offset = static_cast<DWORD>(pos);
+		ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+		DWORD n = 0;
+		DWORD want = (size - done > 0x40000000) ? 0x40000000 : static_cast<DWORD>(size - done);
+		WAVE11_METRIC_ADD(METRIC_WRITE_CALLS, 1);
+		if (!::WriteFile(handle_, static_cast<const BYTE*>(buf) + done, want, &n, &ov) || n == 0) {
+			throw WavIoException("positional write error.");
+		}
+		done += n;
+	}
+	WAVE11_METRIC_ADD(METRIC_BYTES_WRITTEN, done);
+	return done;
+}
+// ----------------------------------------------------------------------------
+// ファイルサイズを取得します。
+/**
+ * @return	ファイルのバイトサイズ。エラー発生時は-1。
+ */
+// ----------------------------------------------------------------------------
+int64_t PositionalFile::size() const
+{
+	LARGE_INTEGER li;
+	if (handle_ == INVALID_HANDLE_VALUE || !::GetFileSizeEx(handle_, &li)) {
+		return -1;
+	}
+	return li.QuadPart;
+}
+// ----------------------------------------------------------------------------
+// ファイルの領域を事前に確保します。
+/**
+ * ファイルサイズを指定サイズまで拡張します。現在より小さい場合は何もしません。
+ *
+ * @param[in]	bytes	確保するファイルサイズ
+ * @return	成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool PositionalFile::allocate(uint64_t bytes)
+{
+	int64_t cur = size();
+	if (cur < 0) return false;
+	if (static_cast<uint64_t>(cur) >= bytes) return true;
+	LARGE_INTEGER li;
+	li.QuadPart = static_cast<LONGLONG>(bytes);
+	return ::SetFilePointerEx(handle_, li, nullptr, FILE_BEGIN) && ::SetEndOfFile(handle_);
+}
+
+#else
+// ----------------------------------------------------------------------------
+PositionalFile::PositionalFile()
+: fd_(-1)
+{
+}
+// ----------------------------------------------------------------------------
+// 読み込み用にファイルをオープンします。
+/**
+ * @param[in]	path	ファイルのパス
+ * @return	オープンに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool PositionalFile::openRead(const tstring& path)
+{
+	close();
+	fd_ = ::open(path.c_str(), O_RDONLY);
+	return fd_ >= 0;
+}
+// ----------------------------------------------------------------------------
+// 読み書き用にファイルをオープンします。
+/**
+ * @param[in]	path		ファイルのパス
+ * @param[in]	truncate	真なら既存の内容を破棄する。ファイルがなければ作成する。
+ * @return	オープンに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool PositionalFile::openWrite(const tstring& path, bool truncate)
+{
+	close();
+	fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+	return fd_ >= 0;
+}
+// ----------------------------------------------------------------------------
+// ファイルのクローズ
+// ----------------------------------------------------------------------------
+void PositionalFile::close()
+{
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+// ----------------------------------------------------------------------------
+bool PositionalFile::isOpen() const
+{
+	return fd_ >= 0;
+}
+// ----------------------------------------------------------------------------
+// 指定位置から読み込みます。
+/**
+ * @param[out]	buf		読み込んだデータを格納するバッファ
+ * @param[in]	size	読み込むバイトサイズ
+ * @param[in]	offset	ファイル先頭からのバイトオフセット
+ * @return	実際に読み込んだバイトサイズ。終端を越えた分は含まない。
+ * @exception	WavIoException	ファイル未オープンまたは読み込みエラー
+ */
+// ----------------------------------------------------------------------------
+size_t PositionalFile::readAt(void* buf, size_t size, uint64_t offset) WAVE11_THROWS(WavIoException)
+{
+	if (buf == nullptr || size == 0) return 0;
+	if (fd_ < 0) throw WavIoException("file isn't opened.");
+	WAVE11_METRIC_TIMER(timer, METRIC_READ_NS);
+
+	size_t done = 0;
+	while (done < size) {
+		WAVE11_METRIC_ADD(METRIC_READ_CALLS, 1);
+		ssize_t n = ::pread(fd_, static_cast<BYTE*>(buf) + done, size - done,
+			static_cast<off_t>(offset + done));
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			throw WavIoException("positional read error.");
+		}
+		if (n == 0) break;
+		done += static_cast<size_t>(n);
+	}
+	WAVE11_METRIC_ADD(METRIC_BYTES_READ, done);
+	return done;
+}
+// ----------------------------------------------------------------------------
+// 指定位置へ書き出します。
+/**
+ * @param[in]	buf		書き出しデータバッファ
+ * @param[in]	size	書き出しデータのバイトサイズ
+ * @param[in]	offset	ファイル先頭からのバイトオフセット
+ * @return	実際に書き出したバイトサイズ
+ * @exception	WavIoException	ファイル未オープンまたは書き出しエラー
+ */
+// ----------------------------------------------------------------------------
+size_t PositionalFile::writeAt(const void* buf, size_t size, uint64_t offset) WAVE11_THROWS(WavIoException)
+{
+	if (buf == nullptr || size == 0) return 0;
+	if (fd_ < 0) throw WavIoException("file isn't opened.");
+	WAVE11_METRIC_TIMER(timer, METRIC_WRITE_NS);
+
+	size_t done = 0;
+	while (done < size) {
+		WAVE11_METRIC_ADD(METRIC_WRITE_CALLS, 1);
+		ssize_t n = ::pwrite(fd_, static_cast<const BYTE*>(buf) + done, size - done,
+			static_cast<off_t>(offset + done));
+		if (n < 0 && errno == EINTR) continue;
+		// 0バイトの書き出しは進まないため、エラーとして扱う
+		if (n <= 0) {
+			throw WavIoException("positional write error.");
+		}
+		done += static_cast<size_t>(n);
+	}
+	WAVE11_METRIC_ADD(METRIC_BYTES_WRITTEN, done);
+	return done;
+}
+// ----------------------------------------------------------------------------
+// ファイルサイズを取得します。
+/**
+ * @return	ファイルのバイトサイズ。エラー発生時は-1。
+ */
+// ----------------------------------------------------------------------------
+int64_t PositionalFile::size() const
+{
+	struct stat st;
+	if (fd_ < 0 || ::fstat(fd_, &st) != 0) {
+		return -1;
+	}
+	return static_cast<int64_t>(st.st_size);
+}
+// ----------------------------------------------------------------------------
+// ファイルの領域を事前に確保します。
+/**
+ * ファイルサイズを指定サイズまで拡張し、ディスク領域を確保します。
+ * 現在より小さい場合は何もしません。posix_fallocateに対応しない
+ * ファイルシステムではftruncateでサイズのみ拡張します。
+ *
+ * @param[in]	bytes	確保するファイルサイズ
+ * @return	成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool PositionalFile::allocate(uint64_t bytes)
+{
+	int64_t cur = size();
+	if (cur < 0) return false;
+	if (static_cast<uint64_t>(cur) >= bytes) return true;
+#if defined(__linux__)
+	if (::posix_fallocate(fd_, 0, static_cast<off_t>(bytes)) == 0) {
+		return true;
+	}
+#endif
+	return ::ftruncate(fd_, static_cast<off_t>(bytes)) == 0;
+}
+#endif
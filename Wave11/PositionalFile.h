@@ -0,0 +1,99 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	PositionalFile.h
+ * @brief	位置指定で読み書きするファイルクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _POSITIONALFILE_H_
+#define _POSITIONALFILE_H_
+
+#include <cstdint>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 位置指定で読み書きするファイルクラス
+ *
+ * 読み書きのたびにオフセットを指定し、ファイル位置を共有しない
+ * （POSIXのpread/pwrite、WindowsのOVERLAPPED指定のReadFile/WriteFile）。
+ * そのため一つのインスタンスに複数スレッドから同時に読み書きしてよい。
+ * オフセットは64bitで、2GB以上のファイルも扱える。
+ */
+// ----------------------------------------------------------------------------
+class PositionalFile : private Noncopyable
+{
+public:
+	PositionalFile();
+	/** デストラクタでファイルは自動クローズする */
+	virtual ~PositionalFile() { close(); }
+
+	//! 読み込み用にファイルをオープンします。
+	bool openRead(const tstring&);
+	//! 読み書き用にファイルをオープンします。
+	bool openWrite(const tstring&, bool = false);
+	//! ファイルのクローズ
+	void close();
+	/**
+	 * @brief	オープン中か判定する
+	 * @return	オープン中なら真
+	 */
+	bool isOpen() const;
+
+	//! 指定位置から読み込みます。
+	size_t readAt(void*, size_t, uint64_t) WAVE11_THROWS(WavIoException);
+	//! 指定位置へ書き出します。
+	size_t writeAt(const void*, size_t, uint64_t) WAVE11_THROWS(WavIoException);
+	//! ファイルサイズを取得します。
+	int64_t size() const;
+	//! ファイルの領域を事前に確保します。
+	bool allocate(uint64_t);
+
+#if defined(_WIN32) && defined(_MSC_VER)
+	/**
+	 * @brief	ファイルハンドルを取得する
+	 * @return	ファイルハンドル
+	 */
+	HANDLE handle() const { return handle_; }
+#else
+	/**
+	 * @brief	ファイル記述子を取得する
+	 * @return	ファイル記述子。未オープンなら-1。
+	 */
+	int handle() const { return fd_; }
+#endif
+
+private:
+#if defined(_WIN32) && defined(_MSC_VER)
+	//! ファイルハンドル
+	HANDLE handle_;
+#else
+	//! ファイル記述子
+	int fd_;
+#endif
+};
+
+#endif // !_POSITIONALFILE_H_
@@ -0,0 +1,195 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	RealFft.cpp
+ * @brief	実数入力FFTクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "RealFft.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define REALFFT_USE_SSE
+#endif
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+// ----------------------------------------------------------------------------
+// FFT点数を指定して構築します。
+/**
+ * 回転因子とビット反転表を事前計算します。
+ *
+ * @param[in]	n	FFT点数。4以上の2のべき乗であること。
+ * @exception	WavIoException	FFT点数が不正
+ */
+// ----------------------------------------------------------------------------
+RealFft::RealFft(size_t n)
+: size_(n),
+  half_(n / 2)
+{
+	if (n < 4 || (n & (n - 1)) != 0) {
+		throw WavIoException("FFT size must be a power of two.");
+	}
+
+	// ビット反転表
+	size_t bits = 0;
+	while ((static_cast<size_t>(1) << bits) < half_) bits++;
+	bitrev_.resize(half_);
+	for (size_t i = 0; i < half_; i++) {
+		size_t r = 0;
+		for (size_t b = 0; b < bits; b++) {
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		bitrev_[i] = r;
+	}
+
+	// 段ごとの回転因子。半区間長hの段はオフセットh-1から始まる。
+	twRe_.resize(half_ > 1 ? half_ - 1 : 1);
+	twIm_.resize(twRe_.size());
+	for (size_t h = 1; h < half_; h <<= 1) {
+		for (size_t j = 0; j < h; j++) {
+			double a = -M_PI * static_cast<double>(j) / static_cast<double>(h);
+			twRe_[h - 1 + j] = static_cast<float>(::cos(a));
+			twIm_[h - 1 + j] = static_cast<float>(::sin(a));
+		}
+	}
+
+	// 実数化後処理の回転因子 exp(-2πik/N)
+	postRe_.resize(half_ + 1);
+	postIm_.resize(half_ + 1);
+	for (size_t k = 0; k <= half_; k++) {
+		double a = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size_);
+		postRe_[k] = static_cast<float>(::cos(a));
+		postIm_[k] = static_cast<float>(::sin(a));
+	}
+
+	workRe_.resize(half_);
+	workIm_.resize(half_);
+	specIm_.resize(half_ + 1);
+}
+// ----------------------------------------------------------------------------
+// 作業領域上で複素FFTを行います。
+/**
+ * ビット反転済みの作業領域に対して基数2のバタフライを適用します。
+ */
+// ----------------------------------------------------------------------------
+void RealFft::complexFft()
+{
+	float* re = &workRe_[0];
+	float* im = &workIm_[0];
+
+	for (size_t h = 1; h < half_; h <<= 1) {
+		const float* wr = &twRe_[h - 1];
+		const float* wi = &twIm_[h - 1];
+		for (size_t i = 0; i < half_; i += 2 * h) {
+			float* ar = re + i;
+			float* ai = im + i;
+			float* br = re + i + h;
+			float* bi = im + i + h;
+			size_t j = 0;
+#ifdef REALFFT_USE_SSE
+			for (; j + 4 <= h; j += 4) {
+				__m128 vwr = _mm_loadu_ps(wr + j);
+				__m128 vwi = _mm_loadu_ps(wi + j);
+				__m128 vbr = _mm_loadu_ps(br + j);
+				__m128 vbi = _mm_loadu_ps(bi + j);
+				__m128 tr = _mm_sub_ps(_mm_mul_ps(vbr, vwr), _mm_mul_ps(vbi, vwi));
+				__m128 ti = _mm_add_ps(_mm_mul_ps(vbr, vwi), _mm_mul_ps(vbi, vwr));
+				__m128 var = _mm_loadu_ps(ar + j);
+				__m128 vai = _mm_loadu_ps(ai + j);
+				_mm_storeu_ps(br + j, _mm_sub_ps(var, tr));
+				_mm_storeu_ps(bi + j, _mm_sub_ps(vai, ti));
+				_mm_storeu_ps(ar + j, _mm_add_ps(var, tr));
+				_mm_storeu_ps(ai + j, _mm_add_ps(vai, ti));
+			}
+#endif
+			for (; j < h; j++) {
+				float tr = br[j] * wr[j] - bi[j] * wi[j];
+				float ti = br[j] * wi[j] + bi[j] * wr[j];
+				br[j] = ar[j] - tr;
+				bi[j] = ai[j] - ti;
+				ar[j] += tr;
+				ai[j] += ti;
+			}
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// 順変換を行います。
+/**
+ * 実数列をN/2+1個の複素スペクトルに変換します。
+ *
+ * @param[in]	in		N点の実数入力
+ * @param[out]	outRe	N/2+1点のスペクトル実部
+ * @param[out]	outIm	N/2+1点のスペクトル虚部
+ */
+// ----------------------------------------------------------------------------
+void RealFft::forward(const float* in, float* outRe, float* outIm)
+{
+	// 偶数番目を実部、奇数番目を虚部に詰めてビット反転順に並べる
+	for (size_t i = 0; i < half_; i++) {
+		size_t r = bitrev_[i];
+		workRe_[r] = in[2 * i];
+		workIm_[r] = in[2 * i + 1];
+	}
+	complexFft();
+
+	// Z[k]からX[k]を復元する
+	const float* zr = &workRe_[0];
+	const float* zi = &workIm_[0];
+	outRe[0] = zr[0] + zi[0];
+	outIm[0] = 0.f;
+	outRe[half_] = zr[0] - zi[0];
+	outIm[half_] = 0.f;
+	for (size_t k = 1; k < half_; k++) {
+		size_t m = half_ - k;
+		// 偶数部 E = (Z[k] + conj(Z[m])) / 2、奇数部 O = (Z[k] - conj(Z[m])) / 2i
+		float er = 0.5f * (zr[k] + zr[m]);
+		float ei = 0.5f * (zi[k] - zi[m]);
+		float or_ = 0.5f * (zi[k] + zi[m]);
+		float oi = -0.5f * (zr[k] - zr[m]);
+		// X[k] = E + W^k * O
+		outRe[k] = er + postRe_[k] * or_ - postIm_[k] * oi;
+		outIm[k] = ei + postRe_[k] * oi + postIm_[k] * or_;
+	}
+}
+// ----------------------------------------------------------------------------
+// 順変換を行い振幅スペクトルを求めます。
+/**
+ * @param[in]	in		N点の実数入力
+ * @param[out]	mag		N/2+1点の振幅スペクトル
+ */
+// ----------------------------------------------------------------------------
+void RealFft::magnitude(const float* in, float* mag)
+{
+	float* im = &specIm_[0];
+	forward(in, mag, im);
+	for (size_t k = 0; k <= half_; k++) {
+		mag[k] = ::sqrt(mag[k] * mag[k] + im[k] * im[k]);
+	}
+}
@@ -0,0 +1,99 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	RealFft.h
+ * @brief	実数入力FFTクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _REALFFT_H_
+#define _REALFFT_H_
+
+#include <vector>
+#include "WavIoType.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 実数入力の高速フーリエ変換クラス
+ *
+ * N点の実数列をN/2点の複素FFT（基数2、時間間引き）と後処理で変換する。
+ * 回転因子とビット反転表は構築時に計算する。
+ * 複素データは実部と虚部を別配列に持ち、バタフライはSSEで4並列に処理する。
+ *
+ * 変換時の作業領域はインスタンスが保持するため、このクラスはスレッドセーフではない。
+ * 並列処理ではスレッドごとにインスタンスを用意すること。
+ */
+// ----------------------------------------------------------------------------
+class RealFft
+{
+public:
+	//! FFT点数を指定して構築します。
+	explicit RealFft(size_t);
+	virtual ~RealFft() {}
+
+	/**
+	 * @brief	FFT点数を取得する
+	 * @return	FFT点数
+	 */
+	size_t size() const { return size_; }
+	/**
+	 * @brief	出力ビン数を取得する
+	 * @return	直流からナイキストまでのビン数（N/2+1）
+	 */
+	size_t bins() const { return size_ / 2 + 1; }
+
+	//! 順変換を行います。
+	void forward(const float*, float*, float*);
+	//! 順変換を行い振幅スペクトルを求めます。
+	void magnitude(const float*, float*);
+
+private:
+	//! FFT点数
+	const size_t size_;
+	//! 複素FFT点数（N/2）
+	const size_t half_;
+	//! ビット反転表
+	std::vector<size_t> bitrev_;
+	//! 各段の回転因子の実部（段ごとに連続配置）
+	std::vector<float> twRe_;
+	//! 各段の回転因子の虚部（段ごとに連続配置）
+	std::vector<float> twIm_;
+	//! 実数化後処理用の回転因子の実部
+	std::vector<float> postRe_;
+	//! 実数化後処理用の回転因子の虚部
+	std::vector<float> postIm_;
+	//! 複素FFTの作業領域（実部）
+	std::vector<float> workRe_;
+	//! 複素FFTの作業領域（虚部）
+	std::vector<float> workIm_;
+	//! 振幅計算時のスペクトル虚部
+	std::vector<float> specIm_;
+
+	//! 作業領域上で複素FFTを行います。
+	void complexFft();
+
+	RealFft();
+};
+
+#endif // !_REALFFT_H_
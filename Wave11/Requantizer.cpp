@@ -0,0 +1,362 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Requantizer.cpp
+ * @brief	ディザー付き再量子化クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "Requantizer.h"
+#include <cmath>
+#include <algorithm>
+#include "SampleConverter.h"
+#include "Metrics.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REQUANTIZER_USE_SSE2
+#endif
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	量子化ビット数ごとの変換定数
+ */
+// ----------------------------------------------------------------------------
+struct QuantRange {
+	//! フルスケール
+	float scale;
+	//! 下限値
+	float lo;
+	//! 上限値
+	float hi;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	量子化ビット数から変換定数を取得する
+ * @param[in]	bits	量子化ビット数
+ * @return	変換定数
+ */
+// ----------------------------------------------------------------------------
+QuantRange rangeOf(WORD bits)
+{
+	switch (bits) {
+	case 8:
+		return QuantRange{ 128.f, -128.f, 127.f };
+	case 24:
+		return QuantRange{ 8388608.f, -8388608.f, 8388607.f };
+	default:
+		return QuantRange{ 32768.f, -32768.f, 32767.f };
+	}
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	整数値を量子化ビット数に応じてリトルエンディアンで書き出す
+ * @param[in]	v		整数値
+ * @param[in]	bits	量子化ビット数
+ * @param[out]	d		書き出し先
+ * @return	次の書き出し先
+ */
+// ----------------------------------------------------------------------------
+BYTE* putSample(int v, WORD bits, BYTE* d)
+{
+	switch (bits) {
+	case 8:
+		*d++ = static_cast<BYTE>(v + 128);
+		break;
+	case 24:
+		*d++ = static_cast<BYTE>(v);
+		*d++ = static_cast<BYTE>(v >> 8);
+		*d++ = static_cast<BYTE>(v >> 16);
+		break;
+	default:
+		*d++ = static_cast<BYTE>(v);
+		*d++ = static_cast<BYTE>(v >> 8);
+		break;
+	}
+	return d;
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	スケーリング済みの値を整数値に丸める
+ *
+ * SampleConverter::fromFloatと同じくfloor(v + 0.5)で丸めてクリッピングする。
+ * 乱数が0ならSampleConverter::fromFloatと同じ結果になる。
+ *
+ * @param[in]	v	スケーリング済みの値
+ * @param[in]	r	変換定数
+ * @return	整数値
+ */
+// ----------------------------------------------------------------------------
+int quantize(double v, const QuantRange& r)
+{
+	const double q = std::floor(v + 0.5);
+	return static_cast<int>((q < r.lo) ? r.lo : ((q > r.hi) ? r.hi : q));
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	チャンネルごとの乱数の初期状態を求める
+ * @param[in]	seed	乱数シード
+ * @param[in]	ch		チャンネル番号
+ * @return	0以外の初期状態
+ */
+// ----------------------------------------------------------------------------
+uint32_t seedOf(uint32_t seed, size_t ch)
+{
+	uint32_t x = seed + static_cast<uint32_t>(ch) * 0x9E3779B9u;
+	x ^= x >> 16;
+	x *= 0x85EBCA6Bu;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35u;
+	x ^= x >> 16;
+	return (x == 0) ? 0x6D2B79F5u : x;
+}
+
+//! ノイズシェーピングの誤差帰還係数
+const float ShapeCoeffs[][3] = {
+	{ 0.f, 0.f, 0.f },
+	{ 1.f, 0.f, 0.f },
+	{ 1.623f, -0.982f, 0.109f },
+};
+
+//! 誤差帰還する量子化誤差の上限（LSB）。クリッピング時の発散を防ぐ。
+const float ErrorLimit = 2.f;
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	channels	チャンネル数
+ * @param[in]	bits		出力の量子化ビット数
+ * @param[in]	pcm			出力が整数型PCMなら真
+ * @param[in]	dither		ディザーの種類
+ * @param[in]	shape		ノイズシェーピングの種類
+ * @param[in]	seed		乱数シード
+ */
+// ----------------------------------------------------------------------------
+Requantizer::Requantizer(WORD channels, WORD bits, bool pcm, DitherType dither, NoiseShape shape, uint32_t seed)
+	: channels_((channels == 0) ? 1 : channels), bits_(bits), pcm_(pcm),
+	dither_(dither), shape_(shape), seed_(seed), channel_(0),
+	rng_(channels_), error_(channels_ * Taps)
+{
+	reset();
+}
+// ----------------------------------------------------------------------------
+// ディザーとノイズシェーピングを設定します。
+/**
+ * 設定後は乱数と誤差履歴を初期化します。
+ *
+ * @param[in]	dither	ディザーの種類
+ * @param[in]	shape	ノイズシェーピングの種類
+ * @param[in]	seed	乱数シード
+ */
+// ----------------------------------------------------------------------------
+void Requantizer::configure(DitherType dither, NoiseShape shape, uint32_t seed)
+{
+	dither_ = dither;
+	shape_ = shape;
+	seed_ = seed;
+	reset();
+}
+// ----------------------------------------------------------------------------
+// 乱数と誤差履歴を初期化します。
+// ----------------------------------------------------------------------------
+void Requantizer::reset()
+{
+	for (size_t ch = 0; ch < rng_.size(); ch++) {
+		rng_[ch] = seedOf(seed_, ch);
+	}
+	std::fill(error_.begin(), error_.end(), 0.f);
+	channel_ = 0;
+}
+// ----------------------------------------------------------------------------
+// ディザーを適用する形式か判定します。
+/**
+ * @param[in]	bits	量子化ビット数
+ * @param[in]	pcm		整数型PCMなら真
+ * @return	8/16/24bit整数型PCMなら真
+ */
+// ----------------------------------------------------------------------------
+bool Requantizer::isDitherable(WORD bits, bool pcm)
+{
+	return pcm && (bits == 8 || bits == 16 || bits == 24);
+}
+// ----------------------------------------------------------------------------
+// フレームを再量子化します。
+/**
+ * ディザーもノイズシェーピングも行わない場合と、ディザーを適用しない形式の場合は
+ * SampleConverter::fromFloatと同じ結果になります。
+ *
+ * @param[in]	src		32bit floatのインターリーブ形式のサンプル
+ * @param[out]	dst		出力形式のサンプルの格納先
+ * @param[in]	frames	フレーム数
+ */
+// ----------------------------------------------------------------------------
+void Requantizer::process(const float* src, void* dst, size_t frames)
+{
+	const size_t count = frames * channels_;
+	if (!isDitherable(bits_, pcm_) || (dither_ == DITHER_NONE && shape_ == SHAPE_NONE)) {
+		SampleConverter::fromFloat(src, dst, count, bits_, pcm_);
+		return;
+	}
+	WAVE11_METRIC_TIMER(timer, METRIC_CONVERT_NS);
+	BYTE* d = static_cast<BYTE*>(dst);
+	if (shape_ != SHAPE_NONE) {
+		processShaped(src, d, count);
+		return;
+	}
+
+	const size_t bytes = bits_ / 8;
+	float noise[Block];
+	for (size_t i = 0; i < count; i += Block) {
+		const size_t n = (count - i < Block) ? count - i : Block;
+		fillNoise(noise, n);
+		store(src + i, noise, d + i * bytes, n);
+	}
+}
+// ----------------------------------------------------------------------------
+// 三角分布の乱数を生成します。
+/**
+ * 1回のxorshift32の上位・下位16bitをそれぞれ一様乱数とし、
+ * その和から±1LSBの三角分布を得ます。
+ *
+ * @param[out]	noise	乱数の格納先（LSB単位）
+ * @param[in]	count	サンプル数
+ */
+// ----------------------------------------------------------------------------
+void Requantizer::fillNoise(float* noise, size_t count)
+{
+	const float k = 1.f / 65536.f;
+	size_t ch = channel_;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t x = rng_[ch];
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		rng_[ch] = x;
+		noise[i] = static_cast<float>(static_cast<int>(x & 0xFFFF) + static_cast<int>(x >> 16) - 65535) * k;
+		if (++ch == channels_) ch = 0;
+	}
+	channel_ = ch;
+}
+// ----------------------------------------------------------------------------
+// 加算済みの値を丸めて書き出します。
+/**
+ * スケーリング・乱数の加算・丸め・クリッピングを行い、リトルエンディアンで書き出します。
+ * 8/16bitはfloatで加算してSSEで処理する。24bitは乱数の刻みがfloatの精度を下回るため、
+ * doubleで加算して逐次処理する。
+ *
+ * @param[in]	src		入力サンプル
+ * @param[in]	noise	加算する乱数（LSB単位）
+ * @param[out]	d		書き出し先
+ * @param[in]	count	サンプル数
+ */
+// ----------------------------------------------------------------------------
+void Requantizer::store(const float* src, const float* noise, BYTE* d, size_t count) const
+{
+	const QuantRange r = rangeOf(bits_);
+	size_t i = 0;
+	if (bits_ == 24) {
+		for (; i < count; i++) {
+			d = putSample(quantize(static_cast<double>(src[i]) * r.scale + noise[i], r), bits_, d);
+		}
+		return;
+	}
+#ifdef REQUANTIZER_USE_SSE2
+	const __m128 scale = _mm_set1_ps(r.scale);
+	const __m128 lo = _mm_set1_ps(r.lo);
+	const __m128 hi = _mm_set1_ps(r.hi);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	// floor(v + 0.5)をfloatのまま求めると加算で丸めが起きるため、
+	// 切り捨てた値と端数から求める。端数はfloatで誤差なく求まる。
+	auto roundPs = [&](__m128 v) -> __m128i {
+		v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+		__m128 f = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		f = _mm_sub_ps(f, _mm_and_ps(_mm_cmpgt_ps(f, v), one));
+		f = _mm_add_ps(f, _mm_and_ps(_mm_cmpge_ps(_mm_sub_ps(v, f), half), one));
+		return _mm_cvttps_epi32(f);
+	};
+	for (; i + 8 <= count; i += 8) {
+		__m128i ia = roundPs(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), _mm_loadu_ps(noise + i)));
+		__m128i ib = roundPs(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), _mm_loadu_ps(noise + i + 4)));
+		if (bits_ == 8) {
+			__m128i w = _mm_add_epi16(_mm_packs_epi32(ia, ib), _mm_set1_epi16(128));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(d), _mm_packus_epi16(w, w));
+			d += 8;
+		} else {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_packs_epi32(ia, ib));
+			d += 16;
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		const float v = src[i] * r.scale + noise[i];
+		d = putSample(quantize(v, r), bits_, d);
+	}
+}
+// ----------------------------------------------------------------------------
+// ノイズシェーピングしながら書き出します。
+/**
+ * 誤差帰還型で、出力の量子化雑音のスペクトルは1 - Σh[k]z^-(k+1)となります。
+ *
+ * @param[in]	src		入力サンプル
+ * @param[out]	d		書き出し先
+ * @param[in]	count	サンプル数
+ */
+// ----------------------------------------------------------------------------
+void Requantizer::processShaped(const float* src, BYTE* d, size_t count)
+{
+	const QuantRange r = rangeOf(bits_);
+	const float* h = ShapeCoeffs[shape_];
+	float noise[Block];
+	for (size_t i = 0; i < count; i += Block) {
+		const size_t n = (count - i < Block) ? count - i : Block;
+		size_t ch = channel_;
+		if (dither_ == DITHER_TPDF) {
+			fillNoise(noise, n);
+		} else {
+			std::fill(noise, noise + n, 0.f);
+		}
+		for (size_t k = 0; k < n; k++) {
+			float* e = &error_[ch * Taps];
+			const double v = static_cast<double>(src[i + k]) * r.scale - (h[0] * e[0] + h[1] * e[1] + h[2] * e[2]);
+			const int q = quantize(v + noise[k], r);
+			double err = q - v;
+			err = (err < -ErrorLimit) ? -ErrorLimit : ((err > ErrorLimit) ? ErrorLimit : err);
+			e[2] = e[1];
+			e[1] = e[0];
+			e[0] = static_cast<float>(err);
+			d = putSample(q, bits_, d);
+			if (++ch == channels_) ch = 0;
+		}
+		channel_ = ch;
+	}
+}
@@ -0,0 +1,130 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Requantizer.h
+ * @brief	ディザー付き再量子化クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _REQUANTIZER_H_
+#define _REQUANTIZER_H_
+
+#include <cstdint>
+#include <vector>
+#include "WavIoType.h"
+
+//! ディザーの種類
+enum DitherType {
+	DITHER_NONE,	//!< ディザーなし（最近接丸め）
+	DITHER_TPDF		//!< 三角分布ディザー（振幅±1LSB）
+};
+
+//! ノイズシェーピングの種類
+enum NoiseShape {
+	SHAPE_NONE,			//!< ノイズシェーピングなし
+	SHAPE_FIRST_ORDER,	//!< 1次の誤差帰還（1 - z^-1）
+	SHAPE_F_WEIGHTED	//!< Wannamakerの3タップF特性重み付け
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ディザー付き再量子化クラス
+ *
+ * 32bit floatのインターリーブ形式を8/16/24bit整数型PCMへ変換する。
+ * 乱数はチャンネルごとに独立したxorshift32で生成し、同じシードと同じ入力からは
+ * 呼び出しの区切り方によらず同じ出力を得る。
+ *
+ * 丸めはSampleConverterと同じくfloor(v + 0.5)とする。
+ * ノイズシェーピングなしの8/16bitでは、乱数をまとめて生成した後にスケーリング・加算・
+ * 丸め・クリッピング・パッキングをSSEで4サンプルずつまとめて行う。
+ * 24bitは乱数の刻みを保つためdoubleで逐次処理する。
+ * ノイズシェーピングありの場合は誤差帰還がサンプル間で依存するため、doubleで逐次処理となる。
+ * 32bit整数型PCMと浮動小数点型はディザーを加えずSampleConverterで変換する。
+ *
+ * このクラスはスレッドセーフではない。
+ */
+// ----------------------------------------------------------------------------
+class Requantizer
+{
+public:
+	//! 既定の乱数シード
+	static const uint32_t DefaultSeed = 0x57415645u;
+
+	//! コンストラクタ
+	Requantizer(WORD, WORD, bool = true, DitherType = DITHER_NONE, NoiseShape = SHAPE_NONE, uint32_t = DefaultSeed);
+
+	//! ディザーとノイズシェーピングを設定します。
+	void configure(DitherType, NoiseShape = SHAPE_NONE, uint32_t = DefaultSeed);
+	//! 乱数と誤差履歴を初期化します。
+	void reset();
+	//! フレームを再量子化します。
+	void process(const float*, void*, size_t);
+
+	/**
+	 * @brief	ディザーの種類を取得する
+	 * @return	ディザーの種類
+	 */
+	DitherType dither() const { return dither_; }
+	/**
+	 * @brief	ノイズシェーピングの種類を取得する
+	 * @return	ノイズシェーピングの種類
+	 */
+	NoiseShape shape() const { return shape_; }
+	//! ディザーを適用する形式か判定します。
+	static bool isDitherable(WORD, bool);
+
+private:
+	//! まとめて処理するサンプル数
+	static const size_t Block = 256;
+	//! 誤差帰還の最大タップ数
+	static const size_t Taps = 3;
+
+	//! チャンネル数
+	const WORD channels_;
+	//! 量子化ビット数
+	const WORD bits_;
+	//! 整数型PCMなら真
+	const bool pcm_;
+	//! ディザーの種類
+	DitherType dither_;
+	//! ノイズシェーピングの種類
+	NoiseShape shape_;
+	//! 乱数シード
+	uint32_t seed_;
+	//! 次に処理するサンプルのチャンネル
+	size_t channel_;
+	//! チャンネルごとの乱数状態
+	std::vector<uint32_t> rng_;
+	//! チャンネルごとの量子化誤差の履歴（新しい順）
+	std::vector<float> error_;
+
+	//! 三角分布の乱数を生成します。
+	void fillNoise(float*, size_t);
+	//! 加算済みの値を丸めて書き出します。
+	void store(const float*, const float*, BYTE*, size_t) const;
+	//! ノイズシェーピングしながら書き出します。
+	void processShaped(const float*, BYTE*, size_t);
+};
+
+#endif // !_REQUANTIZER_H_
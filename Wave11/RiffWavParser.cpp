@@ -0,0 +1,359 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	RiffWavParser.cpp
+ * @brief	RIFF-WAVヘッダーのメモリ上での解析クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "RiffWavParser.h"
+#include <cstring>
+#include "BinaryIO.h"
+
+namespace {
+
+inline DWORD le32(const BYTE* b) {
+	return static_cast<DWORD>(b[0]) | (static_cast<DWORD>(b[1]) << 8)
+		| (static_cast<DWORD>(b[2]) << 16) | (static_cast<DWORD>(b[3]) << 24);
+}
+
+inline WORD le16(const BYTE* b) {
+	return static_cast<WORD>(b[0] | (b[1] << 8));
+}
+
+inline DWORD be32(const BYTE* b) {
+	return static_cast<DWORD>(b[3]) | (static_cast<DWORD>(b[2]) << 8)
+		| (static_cast<DWORD>(b[1]) << 16) | (static_cast<DWORD>(b[0]) << 24);
+}
+
+inline WORD be16(const BYTE* b) {
+	return static_cast<WORD>(b[1] | (b[0] << 8));
+}
+
+inline uint64_t le64(const BYTE* b) {
+	return static_cast<uint64_t>(le32(b)) | (static_cast<uint64_t>(le32(b + 4)) << 32);
+}
+
+} // namespace
+
+const uint64_t RiffWavParser::MaxOffset;
+const BYTE RiffWavParser::W64Riff[16] = {
+	'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00
+};
+const BYTE RiffWavParser::W64Wave[16] = {
+	'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A
+};
+const BYTE RiffWavParser::W64Fmt[16] = {
+	'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A
+};
+const BYTE RiffWavParser::W64Data[16] = {
+	'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A
+};
+
+// ----------------------------------------------------------------------------
+// 解析状態を初期化します。
+/**
+ * @param[in]	fileSize	ファイルサイズ。0なら不明として扱う。
+ */
+// ----------------------------------------------------------------------------
+void RiffWavParser::reset(uint64_t fileSize)
+{
+	stage_ = STAGE_RIFF;
+	pos_ = 0;
+	fileSize_ = fileSize;
+	hasFormat_ = false;
+	hasData_ = false;
+	commFrames_ = 0;
+	::memset(&info_, 0, sizeof(info_));
+}
+// ----------------------------------------------------------------------------
+// ファイルの一部を与えて解析を進めます。
+/**
+ * @param[in]	buf		ファイルのbase位置からのバイト列
+ * @param[in]	size	バイト列のサイズ
+ * @param[in]	base	バイト列の先頭のファイル位置
+ * return	解析状態
+ */
+// ----------------------------------------------------------------------------
+RiffWavParser::Status RiffWavParser::feed(const BYTE* buf, size_t size, uint64_t base)
+{
+	while (1) {
+		if (stage_ == STAGE_DONE) return PARSE_DONE;
+		if (stage_ == STAGE_INVALID) return PARSE_INVALID;
+
+		// 現在の要素の解析に必要なバイトがバッファ内にあるか
+		const bool w64 = (info_.container == CONTAINER_W64);
+		const bool aiff = (info_.container == CONTAINER_AIFF || info_.container == CONTAINER_AIFC);
+		const bool be = (info_.container == CONTAINER_RIFX || aiff);
+		size_t need;
+		if (stage_ == STAGE_RIFF) {
+			need = 12;
+			if (pos_ >= base && pos_ - base + 4 <= size && buf != nullptr && ::memcmp(buf + (pos_ - base), W64Riff, 4) == 0) {
+				need = 40;
+			}
+		} else {
+			need = w64 ? 24 : 8;
+		}
+		if (pos_ < base || pos_ - base + need > size) {
+			return PARSE_NEED_MORE;
+		}
+		const BYTE* p = (buf == nullptr) ? nullptr : buf + (pos_ - base);
+
+		if (stage_ == STAGE_RIFF) {
+			if (::memcmp(p, "RIFF", 4) == 0 && ::memcmp(p + 8, "WAVE", 4) == 0) {
+				info_.container = CONTAINER_RIFF;
+			} else if (::memcmp(p, "RIFX", 4) == 0 && ::memcmp(p + 8, "WAVE", 4) == 0) {
+				info_.container = CONTAINER_RIFX;
+				info_.bigEndian = true;
+			} else if (::memcmp(p, "FORM", 4) == 0 && ::memcmp(p + 8, "AIFF", 4) == 0) {
+				info_.container = CONTAINER_AIFF;
+			} else if (::memcmp(p, "FORM", 4) == 0 && ::memcmp(p + 8, "AIFC", 4) == 0) {
+				info_.container = CONTAINER_AIFC;
+			} else if (need == 40 && ::memcmp(p, W64Riff, 16) == 0 && ::memcmp(p + 24, W64Wave, 16) == 0) {
+				info_.container = CONTAINER_W64;
+			} else {
+				stage_ = STAGE_INVALID;
+				continue;
+			}
+			// 全体サイズは読み込みサイズで判定するので無視
+			pos_ = need;
+			stage_ = STAGE_CHUNK;
+			continue;
+		}
+
+		// チャンクヘッダーの解釈（Wave64のサイズはヘッダーを含む）
+		const size_t header = need;
+		uint64_t cksize;
+		bool isFmt;
+		bool isData;
+		if (w64) {
+			cksize = le64(p + 16);
+			isFmt = (::memcmp(p, W64Fmt, 16) == 0);
+			isData = (::memcmp(p, W64Data, 16) == 0);
+			if (cksize >= header) {
+				cksize -= header;
+			} else if (recovery_ && isData) {
+				cksize = 0;	// 未確定のサイズは復旧時に推定する
+			} else {
+				stage_ = STAGE_INVALID;
+				continue;
+			}
+		} else {
+			cksize = be ? be32(p + 4) : le32(p + 4);
+			isFmt = (::memcmp(p, aiff ? "COMM" : "fmt ", 4) == 0);
+			isData = (::memcmp(p, aiff ? "SSND" : "data", 4) == 0);
+		}
+
+		// 扱えるファイル位置を越えるサイズは壊れたヘッダー（加算の桁あふれで後退させない）
+		if (cksize > MaxOffset) {
+			if (!(recovery_ && isData)) {
+				stage_ = STAGE_INVALID;
+				continue;
+			}
+			cksize = 0;
+		}
+
+		if (isFmt) {
+			const size_t body = !aiff ? 16 : (info_.container == CONTAINER_AIFC) ? 22 : 18;
+			if (cksize < body) {
+				stage_ = STAGE_INVALID;
+				continue;
+			}
+			if (pos_ - base + header + body > size) {
+				return PARSE_NEED_MORE;
+			}
+			const BYTE* q = p + header;
+			WAVEFORMATEX& f = info_.format;
+			if (aiff) {
+				if (!parseComm(q)) {
+					stage_ = STAGE_INVALID;
+					continue;
+				}
+			} else {
+				f.wFormatTag = be ? be16(q) : le16(q);
+				f.nChannels = be ? be16(q + 2) : le16(q + 2);
+				f.nSamplesPerSec = be ? be32(q + 4) : le32(q + 4);
+				f.nAvgBytesPerSec = be ? be32(q + 8) : le32(q + 8);
+				f.nBlockAlign = be ? be16(q + 12) : le16(q + 12);
+				f.wBitsPerSample = be ? be16(q + 14) : le16(q + 14);
+			}
+			if (!isValidFormat(f)) {
+				stage_ = STAGE_INVALID;
+				continue;
+			}
+			hasFormat_ = true;
+			if (hasData_) {
+				finish();
+				continue;
+			}
+		} else if (isData) {
+			if (aiff) {
+				// SSNDチャンクはoffsetとblockSizeの後、offsetバイト先からサンプルが始まる
+				if (pos_ - base + header + 8 > size) {
+					return PARSE_NEED_MORE;
+				}
+				const uint64_t offset = be32(p + header);
+				info_.dataOffset = pos_ + header + 8 + offset;
+				info_.dataLength = (cksize >= 8 + offset) ? cksize - 8 - offset : 0;
+			} else {
+				info_.dataOffset = pos_ + header;
+				info_.dataLength = cksize;
+			}
+			if (hasFormat_) {
+				finish();
+				continue;
+			}
+			// AIFFはSSNDチャンクがCOMMチャンクより前にあってもよい
+			if (!aiff) {
+				stage_ = STAGE_INVALID;
+				continue;
+			}
+			hasData_ = true;
+		}
+
+		// 次のチャンクへ（RIFF・RIFX・AIFFは奇数サイズのチャンクの後に詰め物が1バイト、Wave64は8バイト境界）
+		pos_ += header + cksize;
+		if (w64) {
+			pos_ = (pos_ + 7) & ~static_cast<uint64_t>(7);
+		} else {
+			pos_ += (cksize & 1);
+		}
+		if ((fileSize_ != 0 && pos_ >= fileSize_) || pos_ > MaxOffset) {
+			stage_ = STAGE_INVALID;
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// dataチャンクの位置が決まった後の解析を終えます。
+/**
+ * AIFFではCOMMチャンクのフレーム数でペイロード長を制限します。
+ * 復旧モードではファイルサイズからペイロード長を推定します。
+ */
+// ----------------------------------------------------------------------------
+void RiffWavParser::finish()
+{
+	if (commFrames_ != 0) {
+		const uint64_t length = static_cast<uint64_t>(commFrames_) * info_.format.nBlockAlign;
+		if (length < info_.dataLength) {
+			info_.dataLength = length;
+		}
+	}
+	if (recovery_ && fileSize_ != 0) {
+		infer();
+	}
+	stage_ = STAGE_DONE;
+}
+// ----------------------------------------------------------------------------
+// AIFFのCOMMチャンクを解析します。
+/**
+ * チャンネル数・フレーム数・サンプルビット数・80bit拡張精度のサンプリングレートと、
+ * AIFF-Cでは圧縮形式を読み、WAVEFORMATEXに読み替えます。
+ * 1サンプルはバイト境界に切り上げた幅の左詰めなので、20bitは24bitとして扱います。
+ *
+ * @param[in]	q	COMMチャンクの本体
+ * return	対応する形式なら真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavParser::parseComm(const BYTE* q)
+{
+	const WORD channels = be16(q);
+	const DWORD frames = be32(q + 2);
+	const WORD bits = be16(q + 6);
+	const double rate = BinaryIo::fromExtended(q + 8);
+	if (!(rate >= 1.0 && rate < 4294967296.0)) {
+		return false;
+	}
+
+	bool pcm = true;
+	bool bigEndian = true;
+	if (info_.container == CONTAINER_AIFC) {
+		const BYTE* type = q + 18;
+		if (::memcmp(type, "NONE", 4) == 0 || ::memcmp(type, "twos", 4) == 0) {
+			// ビッグエンディアンの整数型PCM
+		} else if (::memcmp(type, "sowt", 4) == 0) {
+			bigEndian = false;
+		} else if ((::memcmp(type, "fl32", 4) == 0 || ::memcmp(type, "FL32", 4) == 0) && bits == 32) {
+			pcm = false;
+		} else {
+			return false;
+		}
+	}
+
+	const WORD bytes = static_cast<WORD>((bits + 7) / 8);
+	WAVEFORMATEX& f = info_.format;
+	f.wFormatTag = pcm ? 1 : 3;
+	f.nChannels = channels;
+	f.nSamplesPerSec = static_cast<DWORD>(rate + 0.5);
+	f.wBitsPerSample = static_cast<WORD>(bytes * 8);
+	f.nBlockAlign = static_cast<WORD>(bytes * channels);
+	f.nAvgBytesPerSec = f.nSamplesPerSec * f.nBlockAlign;
+	info_.bigEndian = bigEndian;
+	commFrames_ = frames;
+	return true;
+}
+// ----------------------------------------------------------------------------
+// ファイルサイズからペイロード長を推定します。
+/**
+ * 記録されたサイズが0、ファイル終端を越える、またはフレーム境界に揃っていない場合、
+ * ファイル終端までのフレーム境界に揃った長さをペイロード長とします。
+ * 記録途中で終了した書き出し（RiffWavWriter::prepare直後のヘッダー）や、
+ * 途中で切れたファイルがこれに該当します。
+ */
+// ----------------------------------------------------------------------------
+void RiffWavParser::infer()
+{
+	const uint64_t align = info_.format.nBlockAlign;
+	if (align == 0 || info_.dataOffset > fileSize_) {
+		return;
+	}
+	const uint64_t avail = fileSize_ - info_.dataOffset;
+	const uint64_t length = info_.dataLength;
+	if (length == 0 || length > avail || length % align != 0) {
+		const uint64_t base = (length == 0 || length > avail) ? avail : length;
+		info_.dataLength = base - base % align;
+		info_.inferred = true;
+	}
+}
+// ----------------------------------------------------------------------------
+// 対応するフォーマットか判定します。
+/**
+ * @param[in]	f	fmtチャンクの内容
+ * return	整数型PCMまたは32bit浮動小数点型で、各値に矛盾がなければ真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavParser::isValidFormat(const WAVEFORMATEX& f)
+{
+	// フレームサイズが0になる値は不正
+	if (f.nChannels == 0 || f.wBitsPerSample < 8 || f.wBitsPerSample % 8 != 0) {
+		return false;
+	}
+	// 浮動小数点の場合
+	if (f.wFormatTag == 3 && f.wBitsPerSample / 8 == 4) {
+		return (f.nBlockAlign == (f.wBitsPerSample / 8 * f.nChannels)	// フレームサイズ
+			&& f.nAvgBytesPerSec == (f.nSamplesPerSec * f.nBlockAlign));	// データレート
+	}
+	return (f.wFormatTag == 1	// ストリーム形式
+		&& f.nBlockAlign == (f.wBitsPerSample / 8 * f.nChannels)	// フレームサイズ
+		&& f.nAvgBytesPerSec == (f.nSamplesPerSec * f.nBlockAlign));	// データレート
+}
@@ -0,0 +1,188 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	RiffWavParser.h
+ * @brief	RIFF-WAVヘッダーのメモリ上での解析クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _RIFFWAVPARSER_H_
+#define _RIFFWAVPARSER_H_
+
+#include <cstdint>
+#include "WavIoType.h"
+
+#if !(defined(_MSC_VER) && defined(_WAVEFORMATEX_))
+// ----------------------------------------------------------------------------
+/**
+ * @brief WAVEFORMATEX構造体
+ * いわゆるWAVEFORMATEXで、外部で定義されていることもある。
+ */
+// ----------------------------------------------------------------------------
+typedef struct {
+	WORD wFormatTag;
+	WORD nChannels;
+	DWORD nSamplesPerSec;
+	DWORD nAvgBytesPerSec;
+	WORD nBlockAlign;
+	WORD wBitsPerSample;
+	WORD cbSize;
+} WAVEFORMATEX;
+#endif
+
+//! コンテナ形式
+enum WavContainer {
+	CONTAINER_RIFF,	//!< RIFF-WAV（FourCCと32bitチャンクサイズ）
+	CONTAINER_W64,	//!< Sony Wave64（GUIDと64bitチャンクサイズ、8バイト境界）
+	CONTAINER_RIFX,	//!< RIFX（RIFF-WAVのヘッダーとサンプルをビッグエンディアンにしたもの）
+	CONTAINER_AIFF,	//!< AIFF（ビッグエンディアンの整数型PCM）
+	CONTAINER_AIFC	//!< AIFF-C（非圧縮のNONE/twos/sowt/fl32）
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief RIFF-WAVヘッダーの解析結果
+ */
+// ----------------------------------------------------------------------------
+struct RiffWavInfo {
+	//! コンテナ形式
+	WavContainer container;
+	//! fmtチャンクの内容
+	WAVEFORMATEX format;
+	//! dataチャンクのペイロード先頭のバイトオフセット
+	uint64_t dataOffset;
+	//! dataチャンクのペイロードのバイトサイズ
+	uint64_t dataLength;
+	//! 記録されたサイズが壊れていて、ファイルサイズから推定したなら真
+	bool inferred;
+	//! サンプルがファイル上でビッグエンディアンなら真
+	bool bigEndian;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief RIFF-WAVヘッダーのメモリ上での解析クラス
+ *
+ * ファイルの一部を読み込んだバッファを順に与えてチャンクを辿る。
+ * 解析に必要なバイトがバッファにない場合は、次に読み込むべきファイル位置を示して
+ * 中断し、続きのバッファを与えると再開する。ファイルの読み込み方法に依存しないため、
+ * 同期読み込み・非同期読み込みのどちらからも使える。
+ *
+ * 解析位置はチャンクごとに必ず前進し、サイズ欄がどんな値でも後退しないため、
+ * 処理量はチャンク数に比例する。信頼できない入力を与えてもよい。
+ *
+ * RIFF-WAV・RIFX・Wave64・AIFF・AIFF-Cのいずれも同じ手順で辿る。コンテナ形式は
+ * 先頭の識別子で判別し、チャンクの識別子・サイズ・境界・バイト順の違いだけを切り替える。
+ * AIFFのCOMMチャンクはWAVEFORMATEXに読み替え、SSNDチャンクをdataチャンクとして扱う。
+ */
+// ----------------------------------------------------------------------------
+class RiffWavParser
+{
+public:
+	//! 解析状態
+	enum Status {
+		PARSE_DONE,			//!< dataチャンクまで解析した
+		PARSE_NEED_MORE,	//!< nextOffsetから続きのバイトが必要
+		PARSE_INVALID		//!< RIFF-WAVではない
+	};
+
+	//! 1回の読み込みで与えることを想定したバイトサイズ
+	static const size_t DefaultWindow = 4096;
+	//! 解析するファイル位置とチャンクサイズの上限。これを越えるサイズ欄は壊れているとみなす。
+	static const uint64_t MaxOffset = static_cast<uint64_t>(1) << 62;
+	//! Wave64のriffチャンクのGUID
+	static const BYTE W64Riff[16];
+	//! Wave64のwaveのGUID
+	static const BYTE W64Wave[16];
+	//! Wave64のfmtチャンクのGUID
+	static const BYTE W64Fmt[16];
+	//! Wave64のdataチャンクのGUID
+	static const BYTE W64Data[16];
+
+	RiffWavParser() : recovery_(false) { reset(); }
+
+	//! 解析状態を初期化します。
+	void reset(uint64_t = 0);
+	//! ファイルの一部を与えて解析を進めます。
+	Status feed(const BYTE*, size_t, uint64_t);
+	/**
+	 * @brief	次に読み込むべきファイル位置を取得する
+	 * @return	PARSE_NEED_MORE時に続きとして与えるバッファの先頭位置
+	 */
+	uint64_t nextOffset() const { return pos_; }
+	/**
+	 * @brief	解析結果を取得する
+	 * @return	PARSE_DONE後の解析結果
+	 */
+	const RiffWavInfo& info() const { return info_; }
+
+	/**
+	 * @brief	復旧モードを設定する
+	 *
+	 * 復旧モードでは、dataチャンクのサイズが0・ファイル終端超過・フレーム境界外の
+	 * 場合に、ファイルサイズとフレームサイズからペイロード長を推定する。
+	 * 推定にはresetで与えるファイルサイズが必要。
+	 *
+	 * @param[in]	recovery	復旧モードなら真
+	 */
+	void setRecovery(bool recovery) { recovery_ = recovery; }
+
+	//! 対応するフォーマットか判定します。
+	static bool isValidFormat(const WAVEFORMATEX&);
+
+private:
+	//! 解析段階
+	enum Stage {
+		STAGE_RIFF,		//!< RIFFヘッダー
+		STAGE_CHUNK,	//!< WAVEチャンク内のサブチャンク
+		STAGE_DONE,		//!< 解析完了
+		STAGE_INVALID	//!< 解析失敗
+	};
+
+	//! 解析段階
+	Stage stage_;
+	//! 次に解析するファイル位置
+	uint64_t pos_;
+	//! ファイルサイズ。0なら不明。
+	uint64_t fileSize_;
+	//! fmtチャンクを解析済みなら真
+	bool hasFormat_;
+	//! AIFFでCOMMチャンクより前にSSNDチャンクを解析済みなら真
+	bool hasData_;
+	//! AIFFのCOMMチャンクのフレーム数
+	DWORD commFrames_;
+	//! 復旧モードなら真
+	bool recovery_;
+	//! 解析結果
+	RiffWavInfo info_;
+
+	//! ファイルサイズからペイロード長を推定します。
+	void infer();
+	//! AIFFのCOMMチャンクを解析します。
+	bool parseComm(const BYTE*);
+	//! dataチャンクの位置が決まった後の解析を終えます。
+	void finish();
+};
+
+#endif // !_RIFFWAVPARSER_H_
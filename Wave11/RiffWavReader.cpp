@@ -28,6 +28,8 @@
  */
 // ----------------------------------------------------------------------------
 #include "RiffWavReader.h"
+#include "ByteSwap.h"
+#include "SampleConverter.h"
 
 // ----------------------------------------------------------------------------
 // ストリーム読み込みの準備を行います。
@@ -38,88 +40,184 @@
 // ----------------------------------------------------------------------------
 bool RiffWavReader::prepare()
 {
+	WAVE11_METRIC_TIMER(timer, METRIC_HEADER_PARSE_NS);
+
 	// ファイルサイズ取得
 	this->seek(0, SEEK_END);
-	long fileEnd = this->tell();
+	int64_t fileEnd = this->tell();
 	if (fileEnd < 0) {
 		return false;
 	}
-	this->seek(0, SEEK_SET);
 
+	// 解析に必要な範囲を一定サイズずつ読み込んでチャンクを辿る
+	RiffWavParser parser;
+	parser.reset(static_cast<uint64_t>(fileEnd));
+	parser.setRecovery(recovery_ || follow_);
+	BYTE window[RiffWavParser::DefaultWindow];
+	uint64_t base = 0;
 	try {
-		char buf[5] = { 0 };
-		size_t size = this->readBytes(buf, 4);
-		if (size != 4 || strncmp(buf, "RIFF", 4) != 0) {
-			return false;
-		}
-		
-		// 全体サイズは読み込みサイズで判定するので無視
-		if (!this->seek(4, SEEK_CUR)) {
-			return false;
-		}
-
-		size = this->readBytes(buf, 4);
-		if (size != 4 || strncmp(buf, "WAVE", 4) != 0) {
-			return false;
-		}
-
-		// WAVEチャンク内にfmtチャンクが見つかるまでチャンクを読み捨てる
 		while (1) {
-			::memset(buf, 0, sizeof(buf));
-			size = this->readBytes(buf, 4);
-			if (size != 4) {
+			if (!this->seek(static_cast<int64_t>(base), SEEK_SET)) {
 				return false;
 			}
-			if (strncmp(buf, "fmt ", 4) == 0) {
+			size_t size = this->readBytes(window, sizeof(window));
+			RiffWavParser::Status status = parser.feed(window, size, base);
+			if (status == RiffWavParser::PARSE_DONE) {
 				break;
-			} else {
-				DWORD skipsize = this->readDWORD();
-				this->seek(skipsize, SEEK_CUR);
 			}
-		}
-
-		// ヘッダー読み込み
-		DWORD cksize = this->readDWORD();
-		hdr_.wFormatTag = this->readWORD();
-		hdr_.nChannels = this->readWORD();
-		hdr_.nSamplesPerSec = this->readDWORD();
-		hdr_.nAvgBytesPerSec = this->readDWORD();
-		hdr_.nBlockAlign = this->readWORD();
-		hdr_.wBitsPerSample = this->readWORD();
-
-		// 有効PCM判定
-		if (!isRiffWav()) {
-			return false;
-		}
-
-		// 不要データの読み飛ばし
-		if (cksize > 16) {
-			if (!this->seek(cksize - 16, SEEK_CUR)) {
+			if (status == RiffWavParser::PARSE_INVALID) {
+				return false;
+			}
+			// 続きが読めない場合は途中で切れたファイル
+			if (parser.nextOffset() <= base || parser.nextOffset() >= static_cast<uint64_t>(fileEnd)) {
 				return false;
 			}
+			base = parser.nextOffset();
 		}
+	} catch (const WavIoException&) {
+		return false;
+	}
 
-		// ストリーム開始位置確認
-		::memset(buf, 0, sizeof(buf));
-		size = this->readBytes(buf, 4);
-		if (size != 4 || strncmp(buf, "data", 4) != 0) {
-			return false;
-		}
+	return prepare(parser.info());
+}
+// ----------------------------------------------------------------------------
+// 解析済みのヘッダーでストリーム読み込みの準備を行います。
+/**
+ * RiffWavParserで別途解析したヘッダー、またはgetInfoで保存したヘッダーを取り込み、
+ * 読み込み位置をストリーム先頭に合わせます。ストリーム長はファイル終端で切り詰めます。
+ * ヘッダーは読み込まず、ファイルサイズの問い合わせと1回のシークだけを行います。
+ *
+ * @param[in]	info	解析済みのヘッダー
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavReader::prepare(const RiffWavInfo& info)
+{
+	if (!RiffWavParser::isValidFormat(info.format)) {
+		return false;
+	}
+	const int64_t fileEnd = this->size();
+	if (fileEnd < 0 || info.dataOffset > static_cast<uint64_t>(fileEnd)) {
+		return false;
+	}
+
+	info_ = info;
+	hdr_ = info.format;
+	container_ = info.container;
+	bigEndian_ = info.bigEndian;
+	streamOffset_ = static_cast<int64_t>(info.dataOffset);
+	if (info.dataOffset + info.dataLength > static_cast<uint64_t>(fileEnd)) {
+		streamLength_ = static_cast<uint64_t>(fileEnd - streamOffset_);
+	} else {
+		streamLength_ = info.dataLength;
+	}
+	if ((recovery_ || follow_) && hdr_.nBlockAlign != 0) {
+		streamLength_ -= streamLength_ % hdr_.nBlockAlign;
+	}
+	growing_ = follow_ && info.inferred;
+	recovered_ = info.inferred || streamLength_ != info.dataLength;
+	streamPos_ = 0;
+	checksum_.reset(checksum_.types(), checksum_.blockSize());
+	if (observer_ != nullptr) {
+		observer_->onStreamBegin(hdr_);
+	}
 
-		// 有効ストリームサイズ取得
-		cksize = this->readDWORD();
-		streamOffset_ = this->tell();
-		if (streamOffset_ + static_cast<long>(cksize) > fileEnd) {
-			streamLength_ = fileEnd - streamOffset_;
-		} else {
-			streamLength_ = static_cast<long>(cksize);
+	return this->seek(streamOffset_, SEEK_SET);
+}
+// ----------------------------------------------------------------------------
+// 追記された分だけ読み込み可能な範囲を延ばします。
+/**
+ * 追従モードでヘッダーのサイズが未確定だった場合に、ファイルサイズを問い合わせ、
+ * フレーム境界までをストリーム長とします。ヘッダーは解析し直しません。
+ * 書き出し側がriffFinalizeした後も、dataチャンクはファイル終端まで続くため
+ * 同じ方法で求まります。
+ *
+ * return	読み込み可能なフレーム数
+ */
+// ----------------------------------------------------------------------------
+uint64_t RiffWavReader::refresh()
+{
+	if (!growing_ || !isRiffWav()) {
+		return getFrames();
+	}
+	const int64_t fileEnd = this->size();
+	if (fileEnd < streamOffset_) {
+		return getFrames();
+	}
+	uint64_t length = static_cast<uint64_t>(fileEnd - streamOffset_);
+	length -= length % hdr_.nBlockAlign;
+	if (length > streamLength_) {
+		streamLength_ = length;
+		// 前回の終端で読み込みが止まっていた場合に備えてFILEの状態を戻す
+		this->seek(streamOffset_ + static_cast<int64_t>(streamPos_), SEEK_SET);
+	}
+	return getFrames();
+}
+// ----------------------------------------------------------------------------
+// ファイル上のサンプル列をリトルエンディアンのRIFF-WAV形式に変換します。
+/**
+ * ビッグエンディアンのサンプルはバイト順を反転し、AIFFの符号付き8bitは
+ * RIFF-WAVの符号なし8bitにします。RIFF-WAV・Wave64では何もしません。
+ * 位置指定で直接読み込んだペイロードにも使えます。
+ *
+ * @param[in,out]	buf		サンプル列
+ * @param[in]		count	サンプル数（フレーム数×チャンネル数）
+ */
+// ----------------------------------------------------------------------------
+void RiffWavReader::decodeSamples(void* buf, size_t count) const
+{
+	const size_t width = hdr_.wBitsPerSample / 8;
+	if (bigEndian_) {
+		ByteSwap::swap(buf, count, width);
+	}
+	if (width == 1 && (container_ == CONTAINER_AIFF || container_ == CONTAINER_AIFC)) {
+		BYTE* b = static_cast<BYTE*>(buf);
+		for (size_t i = 0; i < count; i++) {
+			b[i] ^= 0x80;
 		}
-	} catch (const WavIoException&) {
+	}
+}
+// ----------------------------------------------------------------------------
+// ファイル上のサンプル列を浮動小数点値に変換します。
+/**
+ * decodeSamplesに続けてSampleConverter::toFloatを呼ぶのと同じ結果になります。
+ * ビッグエンディアンのサンプルはバイト順の反転を変換と同じ走査で行い、
+ * bufを書き換えません。AIFFの8bitはdecodeSamplesで書き換えてから変換します。
+ *
+ * @param[in,out]	buf		サンプル列
+ * @param[out]		dst		変換結果を格納するバッファ
+ * @param[in]		count	サンプル数（フレーム数×チャンネル数）
+ */
+// ----------------------------------------------------------------------------
+void RiffWavReader::decodeFloat(void* buf, float* dst, size_t count) const
+{
+	if (!bigEndian_ || hdr_.wBitsPerSample == 8) {
+		decodeSamples(buf, count);
+	}
+	SampleConverter::toFloat(buf, dst, count, hdr_.wBitsPerSample, hdr_.wFormatTag == 1, bigEndian_);
+}
+// ----------------------------------------------------------------------------
+// 読み込み位置をフレーム単位で移動します。
+/**
+ * dataチャンクのペイロード先頭を0とするフレーム位置へ移動します。
+ * ストリーム終端ちょうどへの移動は許可します。
+ *
+ * @param[in]	frame	移動先のフレーム位置
+ * return	正常終了で真。範囲外またはprepare前なら偽。
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavReader::seekFrame(uint64_t frame)
+{
+	if (!isRiffWav() || frame > getFrames()) {
 		return false;
 	}
-
+	const uint64_t pos = frame * hdr_.nBlockAlign;
+	if (!this->seek(streamOffset_ + static_cast<int64_t>(pos), SEEK_SET)) {
+		return false;
+	}
+	streamPos_ = pos;
 	return true;
-}	
+}
 // ----------------------------------------------------------------------------
 // フレーム単位でストリーム読み込みを行います
 /**
@@ -137,7 +235,34 @@ bool RiffWavReader::prepare()
 // ----------------------------------------------------------------------------
 int RiffWavReader::getSamples(void* buf, const size_t& count)
 {
-	return getStream(buf, count * getBlockAlign());
+	size_t a;
+	return getSamples(buf, count, a);
+}
+// ----------------------------------------------------------------------------
+// フレーム単位でストリーム読み込みを行います
+/**
+ * フレーム単位でストリームを読み込みます。
+ *
+ * @param[in]	buf		データを格納する十分なサイズのバッファのポインタ。
+ * @param[in]	count	読み取るフレーム数
+ * @param[out]	frames	実際に読みだしたフレーム数
+ *
+ * retval	0	正常終了
+ * retval	1	ファイル終端到達
+ * retval	-1	RIFF-WAVファイルではない
+ * retval	-2	引数異常
+ * retval	-3	読み込みエラー
+ */
+// ----------------------------------------------------------------------------
+int RiffWavReader::getSamples(void* buf, const size_t& count, size_t& frames)
+{
+	size_t bytes = 0;
+	frames = 0;
+	int ret = getStream(buf, count * getBlockAlign(), bytes);
+	if (getBlockAlign() != 0) {
+		frames = bytes / getBlockAlign();
+	}
+	return ret;
 }
 // ----------------------------------------------------------------------------
 // バイト単位でのストリーム読み込みを行います
@@ -162,7 +287,10 @@ int RiffWavReader::getStream(void* buf, const size_t& count)
 // ----------------------------------------------------------------------------
 // バイト単位でのストリーム読み込みを行います
 /**
- * バイト単位でストリームを読み込みます。
+ * バイト単位でストリームを読み込みます。\n
+ * RIFX・AIFFのサンプルはdecodeSamplesで変換して返します。チェックサムと監視への通知も
+ * 変換後のバイト列が対象です。サンプルの途中から始まる読み込みでは、
+ * 途中のサンプルは変換しません。
  *
  * @param[in]	buf		データを格納する十分なサイズのバッファのポインタ。
  * @param[in]	count	読み取るバイト数
@@ -177,15 +305,34 @@ int RiffWavReader::getStream(void* buf, const size_t& count)
 // ----------------------------------------------------------------------------
 int RiffWavReader::getStream(void* buf, const size_t& count, size_t& result)
 {
+	result = 0;
 	if (!isRiffWav()) return -1;
 	if (count == 0) return 0;
 	if (buf == nullptr) return -2;
 	if (isEnd()) return -3;
 
+	// ストリーム終端以降のチャンクは読み込まない
+	const uint64_t rest = streamLength_ - streamPos_;
+	const size_t want = (count < rest) ? count : static_cast<size_t>(rest);
 	try {
-		result = this->readBytes(buf, count);
+		result = this->readBytes(buf, want);
 	} catch (const WavIoException&) {
 		return -3;
 	}
-	return isEnd() ? 1 : 0;
+	if (bigEndian_ || container_ == CONTAINER_AIFF || container_ == CONTAINER_AIFC) {
+		// 読み込み直後にRIFF-WAV形式へ揃える（サンプル境界から始まる完全なサンプルのみ）
+		const size_t width = hdr_.wBitsPerSample / 8;
+		const size_t skip = static_cast<size_t>((width - streamPos_ % width) % width);
+		if (result > skip) {
+			decodeSamples(static_cast<BYTE*>(buf) + skip, (result - skip) / width);
+		}
+	}
+	streamPos_ += result;
+	if (checksum_.enabled()) {
+		checksum_.update(buf, result);
+	}
+	if (observer_ != nullptr) {
+		observer_->onStream(buf, result);
+	}
+	return (isEnd() || result < want) ? 1 : 0;
 }
@@ -32,24 +32,9 @@
 
 #include <cstring>
 #include "BinaryReader.h"
-
-#if !(defined(_MSC_VER) && defined(_WAVEFORMATEX_))
-// ----------------------------------------------------------------------------
-/**
- * @brief WAVEFORMATEX構造体
- * いわゆるWAVEFORMATEXで、外部で定義されていることもある。
- */
-// ----------------------------------------------------------------------------
-typedef struct {
-	WORD wFormatTag;
-	WORD nChannels;
-	DWORD nSamplesPerSec;
-	DWORD nAvgBytesPerSec;
-	WORD nBlockAlign;
-	WORD wBitsPerSample;
-	WORD cbSize;
-} WAVEFORMATEX;
-#endif
+#include "Checksum.h"
+#include "RiffWavParser.h"
+#include "StreamObserver.h"
 
 // ----------------------------------------------------------------------------
 /**
@@ -60,13 +45,16 @@ typedef struct {
 class RiffWavReader : public BinaryReader
 {
 public:
-	RiffWavReader() : BinaryReader(), hdr_(), streamOffset_(0), streamLength_(0) {
+	RiffWavReader() : BinaryReader(), info_(), hdr_(), container_(CONTAINER_RIFF), bigEndian_(false), streamOffset_(0), streamLength_(0), streamPos_(0), observer_(nullptr), recovery_(false), recovered_(false), follow_(false), growing_(false) {
+		::memset(&info_, 0, sizeof(info_));
 		::memset(&hdr_, 0, sizeof(hdr_));
 	}
 	virtual ~RiffWavReader() {}
 
 	//! ストリーム読み込みの準備を行います。
 	bool prepare();
+	//! 解析済みのヘッダーでストリーム読み込みの準備を行います。
+	bool prepare(const RiffWavInfo&);
 	/**
 	 * @brief	FormatTagを取得する
 	 * @return	WAVEFORMATEXに含まれるFormatTagの値
@@ -96,43 +84,157 @@ public:
 	 * @brief	読み込み可能なストリーム長を取得する
 	 * @return	実際に読み込み可能なストリームのバイトサイズ
 	 */
-	DWORD getLength() const { return streamLength_; }
+	uint64_t getLength() const { return streamLength_; }
+	/**
+	 * @brief	ストリーム開始位置を取得する
+	 * @return	dataチャンクのペイロード先頭のファイル先頭からのバイトオフセット
+	 */
+	int64_t getStreamOffset() const { return streamOffset_; }
+	/**
+	 * @brief	コンテナ形式を取得する
+	 * @return	prepareで判別したコンテナ形式
+	 */
+	WavContainer getContainer() const { return container_; }
+	/**
+	 * @brief	prepareで使ったヘッダーの解析結果を取得する
+	 *
+	 * prepare(const RiffWavInfo&)に与えれば、同じファイルを解析し直さずに開ける。
+	 * @return	ヘッダーの解析結果
+	 */
+	const RiffWavInfo& getInfo() const { return info_; }
+	/**
+	 * @brief	サンプルのファイル上のバイト順を取得する
+	 * @return	RIFX・AIFF・AIFF-C（sowt以外）なら真
+	 */
+	bool isBigEndian() const { return bigEndian_; }
+	//! ファイル上のサンプル列をリトルエンディアンのRIFF-WAV形式に変換します。
+	void decodeSamples(void*, size_t) const;
+	//! ファイル上のサンプル列を浮動小数点値に変換します。
+	void decodeFloat(void*, float*, size_t) const;
+	/**
+	 * @brief	読み込み可能なフレーム数を取得する
+	 * @return	ストリーム長に含まれる完全なフレームの数
+	 */
+	uint64_t getFrames() const {
+		return (hdr_.nBlockAlign == 0) ? 0 : streamLength_ / hdr_.nBlockAlign;
+	}
+	/**
+	 * @brief	読み込み位置をフレーム単位で取得する
+	 *
+	 * 位置は内部で保持しているため、ファイルへの問い合わせは発生しない。
+	 * @return	ストリーム先頭からのフレーム位置
+	 */
+	uint64_t tellFrame() const {
+		return (hdr_.nBlockAlign == 0) ? 0 : streamPos_ / hdr_.nBlockAlign;
+	}
+	//! 読み込み位置をフレーム単位で移動します。
+	bool seekFrame(uint64_t);
 	
 	//! フレーム単位でストリーム読み込みを行います
 	int getSamples(void*, const size_t&);
+	//! フレーム単位でストリーム読み込みを行います
+	int getSamples(void*, const size_t&, size_t&);
 	//! バイト単位でのストリーム読み込みを行います
 	int getStream(void*, const size_t&);
 	//! バイト単位でのストリーム読み込みを行います
 	int getStream(void*, const size_t&, size_t&);
 
+	/**
+	 * @brief	ペイロードのチェックサム計算を有効にする
+	 *
+	 * prepare後にストリーム先頭から順に読み込んだバイト列が対象となる。
+	 * 途中でseekFrameした場合の値は意味を持たない。prepareの前に呼び出すこと。
+	 *
+	 * @param[in]	types		ChecksumTypeの論理和。0で無効。
+	 * @param[in]	blockSize	CHECKSUM_BLOCKSのブロック長
+	 */
+	void enableChecksum(int types, size_t blockSize = PayloadChecksum::DefaultBlockSize) {
+		checksum_.reset(types, blockSize);
+	}
+	/**
+	 * @brief	ペイロードのチェックサムを取得する
+	 * @return	読み込み済みペイロードのチェックサム
+	 */
+	const PayloadChecksum& getChecksum() const { return checksum_; }
+	/**
+	 * @brief	ストリームの監視を登録する
+	 *
+	 * prepare時にストリームの形式を、以降getStreamで読み込んだバイト列を通知する。
+	 * 途中でseekFrameした場合は連続しないバイト列が通知される。
+	 *
+	 * @param[in]	observer	通知先。nullptrで解除。
+	 */
+	void setObserver(StreamObserver* observer) { observer_ = observer; }
+	/**
+	 * @brief	復旧モードを設定する
+	 *
+	 * 書き出し途中で終了した、または途中で切れたファイルについて、
+	 * dataチャンクのサイズをファイルサイズとフレーム境界から推定して読み込む。
+	 * ファイルは変更しない。prepareの前に呼び出すこと。
+	 *
+	 * @param[in]	recovery	復旧モードなら真
+	 */
+	void setRecovery(bool recovery) { recovery_ = recovery; }
+	/**
+	 * @brief	ストリーム長を推定したか
+	 * @return	prepareでヘッダーのサイズを使わずに推定した場合は真
+	 */
+	bool isRecovered() const { return recovered_; }
+	/**
+	 * @brief	追従モードを設定する
+	 *
+	 * 他のプロセスのRiffWavWriterが追記中でヘッダーのサイズが未確定のファイルを、
+	 * ファイル終端までのフレームとして読み込む。以降はrefreshでファイルサイズだけを
+	 * 問い合わせ、ヘッダーを解析し直さずに読み込み可能な範囲を延ばす。
+	 * prepareの前に呼び出すこと。
+	 *
+	 * @param[in]	follow	追従モードなら真
+	 */
+	void setFollow(bool follow) { follow_ = follow; }
+	//! 追記された分だけ読み込み可能な範囲を延ばします。
+	uint64_t refresh();
+
 private:
+	//! ヘッダーの解析結果
+	RiffWavInfo info_;
 	//! WAVEFORMATEXヘッダー
 	WAVEFORMATEX hdr_;
+	//! コンテナ形式
+	WavContainer container_;
+	//! サンプルがファイル上でビッグエンディアンなら真
+	bool bigEndian_;
 	//! ストリーム開始バイトオフセット
-	long streamOffset_;
+	int64_t streamOffset_;
 	//! 実際のストリームのバイトサイズ
-	DWORD streamLength_;
+	uint64_t streamLength_;
+	//! ストリーム先頭からの読み込み位置のバイトオフセット
+	uint64_t streamPos_;
+	//! ペイロードのチェックサム
+	PayloadChecksum checksum_;
+	//! ストリームの監視
+	StreamObserver* observer_;
+	//! 復旧モードなら真
+	bool recovery_;
+	//! ストリーム長を推定したなら真
+	bool recovered_;
+	//! 追従モードなら真
+	bool follow_;
+	//! 追従モードでストリーム長をファイルサイズから求めているなら真
+	bool growing_;
 
 	/**
 	 * @brief	有効RIFF-WAV判定
 	 * @return	有効なRIFF-WAVファイルなら真
 	 */
 	bool isRiffWav() const {
-		// 浮動小数点の場合
-		if (hdr_.wFormatTag == 3 && hdr_.wBitsPerSample / 8 == 4) {
-			return (hdr_.nBlockAlign == (hdr_.wBitsPerSample / 8 * hdr_.nChannels)	// フレームサイズ
-				&& hdr_.nAvgBytesPerSec == (hdr_.nSamplesPerSec * hdr_.nBlockAlign));	// データレート
-		}
-		return (hdr_.wFormatTag == 1	// ストリーム形式
-			&& hdr_.nBlockAlign == (hdr_.wBitsPerSample / 8 * hdr_.nChannels)	// フレームサイズ
-			&& hdr_.nAvgBytesPerSec == (hdr_.nSamplesPerSec * hdr_.nBlockAlign));	// データレート
+		return RiffWavParser::isValidFormat(hdr_);
 	}
 	/**
 	 * @brief	ストリーム終端判定
 	 * @return	読み込み位置がストリーム終端に到達していれば真
 	 */
-	bool isEnd() {
-		return (this->tell() >= streamOffset_ + static_cast<long>(streamLength_));
+	bool isEnd() const {
+		return streamPos_ >= streamLength_;
 	}
 };
 
@@ -27,7 +27,10 @@
  * @brief	RIFF-WAVファイルを書き出すクラスの実装
  */
 // ----------------------------------------------------------------------------
+#include <cstring>
 #include "RiffWavWriter.h"
+#include "BufferPool.h"
+#include "ByteSwap.h"
 
 // ----------------------------------------------------------------------------
 /**
@@ -39,18 +42,26 @@
  * @param[in]	ch		WAVE_FORMAT_PCMなら真、WAVE_FORMAT_IEEE_FLOATなら偽
  */
 // ----------------------------------------------------------------------------
-RiffWavWriter::RiffWavWriter(WORD qbit, WORD ch, WORD fs, bool fmt)
+RiffWavWriter::RiffWavWriter(WORD qbit, WORD ch, DWORD fs, bool fmt)
 : BinaryWriter(),
   qbit_(qbit),
   ch_(ch),
   fs_(fs),
-  fmt_(fmt)
+  fmt_(fmt),
+  container_(CONTAINER_RIFF),
+  sowt_(false),
+  streaming_(false),
+  observer_(nullptr),
+  requantizer_(ch, qbit, fmt)
 {
 }
 // ----------------------------------------------------------------------------
 // ストリーム書き出しの準備を行います。
 /**
  * RIFF-WAVのヘッダーファイルを書き出しします。\n
+ * setContainerでCONTAINER_W64を指定した場合はWave64の、CONTAINER_RIFXを指定した場合は
+ * ビッグエンディアンのRIFXの、CONTAINER_AIFF・CONTAINER_AIFCを指定した場合は
+ * AIFF・AIFF-Cのヘッダーを書き出します。\n
  * ストリームの書き出し前に実行する必要があります。
  *
  * return	書き出しに成功すれば真
@@ -58,49 +69,66 @@ RiffWavWriter::RiffWavWriter(WORD qbit, WORD ch, WORD fs, bool fmt)
 // ----------------------------------------------------------------------------
 bool RiffWavWriter::prepare()
 {
-	const char header[] = {
-		'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ',
-		0x10, 0, 0, 0
-	};
-	const char headerInt[] = {
-		1, 0
-	};
-	const char headerFloat[] = {
-		3, 0
-	};
-	const char dataHeader[] = {
-		'd', 'a', 't', 'a'
-	};
-
-	try {
-		size_t wret = this->writeBytes(header, 20);
-		if (wret != 20) {
+	if (container_ == CONTAINER_W64) {
+		this->setLittleEndian(true);
+		if (!prepareW64()) {
 			return false;
 		}
-
-		wret = this->writeBytes((fmt_ ? headerInt : headerFloat), 2);
-		if (wret != 2) {
+	} else if (container_ == CONTAINER_AIFF || container_ == CONTAINER_AIFC) {
+		this->setLittleEndian(false);
+		if (!prepareAiff()) {
 			return false;
 		}
+	} else {
+		// RIFXはヘッダーの数値もビッグエンディアン
+		const bool rifx = (container_ == CONTAINER_RIFX);
+		this->setLittleEndian(!rifx);
+		try {
+			size_t wret = this->writeBytes(rifx ? "RIFX" : "RIFF", 4);
+			if (wret != 4) {
+				return false;
+			}
+			this->writeDWORD(0);
 
-		this->writeWORD(ch_);
-		this->writeDWORD(fs_);
-		int datav = fs_ * qbit_ / 8 * ch_;
-		this->writeDWORD(datav);
-		short dwBlock = qbit_ / 8 * ch_;
-		this->writeWORD(dwBlock);
-		this->writeWORD(qbit_);
+			wret = this->writeBytes("WAVEfmt ", 8);
+			if (wret != 8) {
+				return false;
+			}
+			this->writeDWORD(16);
+			this->writeWORD(fmt_ ? 1 : 3);
+			this->writeWORD(ch_);
+			this->writeDWORD(fs_);
+			int datav = fs_ * qbit_ / 8 * ch_;
+			this->writeDWORD(datav);
+			short dwBlock = qbit_ / 8 * ch_;
+			this->writeWORD(dwBlock);
+			this->writeWORD(qbit_);
 
-		wret = this->writeBytes(dataHeader, 4);
-		if (wret != 4) {
+			wret = this->writeBytes("data", 4);
+			if (wret != 4) {
+				return false;
+			}
+
+			this->writeDWORD(0);
+		} catch (const WavIoException&) {
 			return false;
 		}
-
-		this->writeDWORD(0);
-	} catch (const WavIoException&) {
-		return false;
 	}
 
+	checksum_.reset(checksum_.types(), checksum_.blockSize());
+	requantizer_.reset();
+	if (observer_ != nullptr) {
+		WAVEFORMATEX f;
+		::memset(&f, 0, sizeof(f));
+		f.wFormatTag = fmt_ ? 1 : 3;
+		f.nChannels = ch_;
+		f.nSamplesPerSec = fs_;
+		f.nBlockAlign = qbit_ / 8 * ch_;
+		f.nAvgBytesPerSec = fs_ * f.nBlockAlign;
+		f.wBitsPerSample = qbit_;
+		observer_->onStreamBegin(f);
+	}
+	streaming_ = true;
 	return true;
 }
 // ----------------------------------------------------------------------------
@@ -115,11 +143,19 @@ bool RiffWavWriter::prepare()
 // ----------------------------------------------------------------------------
 bool RiffWavWriter::riffFinalize()
 {
+	streaming_ = false;
+	if (container_ == CONTAINER_W64) {
+		return finalizeW64();
+	}
+	if (container_ == CONTAINER_AIFF || container_ == CONTAINER_AIFC) {
+		return finalizeAiff();
+	}
+
 	// 終端に移動してファイルサイズ取得
 	if (!this->seek(0, SEEK_END)) {
 		return false;
 	}
-	long fileSize = this->tell();
+	int64_t fileSize = this->tell();
 
 	try {
 		// 全体サイズ書き出し
@@ -127,16 +163,354 @@ bool RiffWavWriter::riffFinalize()
 			return false;
 		}
 		fileSize -= 8;	// チャンクヘッダー分減らす
-		this->writeDWORD(fileSize);
+		this->writeDWORD(static_cast<DWORD>(fileSize));
 
 		// ストリームサイズ書き出し
 		if (!this->seek(40, SEEK_SET)) {
 			return false;
 		}
 		fileSize -= 36;
-		this->writeDWORD(fileSize);
+		this->writeDWORD(static_cast<DWORD>(fileSize));
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// Wave64のヘッダーを書き出します。
+/**
+ * riff・fmt・dataの各チャンクのサイズは8バイト境界に揃えて配置します。
+ * サイズはfinalizeW64で書き込みます。
+ *
+ * return	書き出しに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavWriter::prepareW64()
+{
+	try {
+		if (this->writeBytes(RiffWavParser::W64Riff, 16) != 16) {
+			return false;
+		}
+		this->writeQWORD(0);
+		if (this->writeBytes(RiffWavParser::W64Wave, 16) != 16
+			|| this->writeBytes(RiffWavParser::W64Fmt, 16) != 16) {
+			return false;
+		}
+		this->writeQWORD(24 + 16);
+		this->writeWORD(fmt_ ? 1 : 3);
+		this->writeWORD(ch_);
+		this->writeDWORD(fs_);
+		this->writeDWORD(fs_ * qbit_ / 8 * ch_);
+		this->writeWORD(qbit_ / 8 * ch_);
+		this->writeWORD(qbit_);
+		if (this->writeBytes(RiffWavParser::W64Data, 16) != 16) {
+			return false;
+		}
+		this->writeQWORD(0);
 	} catch (const WavIoException&) {
 		return false;
 	}
 	return true;
 }
+// ----------------------------------------------------------------------------
+// Wave64の書き出しを終了します。
+/**
+ * ファイル末尾を8バイト境界まで0で埋め、riffとdataのチャンクサイズを書き込みます。
+ * Wave64のチャンクサイズはチャンクヘッダーの24バイトを含みます。
+ *
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavWriter::finalizeW64()
+{
+	const int64_t riffSize = 16 + 8 + 16;
+	const int64_t dataChunk = riffSize + 24 + 16;
+
+	if (!this->seek(0, SEEK_END)) {
+		return false;
+	}
+	const int64_t fileEnd = this->tell();
+	if (fileEnd < dataChunk + 24) {
+		return false;
+	}
+
+	try {
+		const BYTE zero[8] = { 0 };
+		const size_t pad = static_cast<size_t>((8 - (fileEnd & 7)) & 7);
+		if (pad > 0 && BinaryWriter::writeBytes(zero, pad) != pad) {
+			return false;
+		}
+		if (!this->seek(16, SEEK_SET)) {
+			return false;
+		}
+		this->writeQWORD(static_cast<uint64_t>(fileEnd) + pad);
+		if (!this->seek(dataChunk + 16, SEEK_SET)) {
+			return false;
+		}
+		this->writeQWORD(static_cast<uint64_t>(fileEnd - dataChunk));
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// AIFF・AIFF-Cのヘッダーを書き出します。
+/**
+ * FORM・（AIFF-CのみFVER）・COMM・SSNDの順に書き出します。ヘッダーの数値は
+ * ビッグエンディアンで、サンプリングレートは80bit拡張倍精度です。
+ * FORMとSSNDのサイズ、COMMのフレーム数はfinalizeAiffで書き込みます。\n
+ * AIFFは浮動小数点型を表せないため、CONTAINER_AIFFで浮動小数点型なら失敗します。
+ *
+ * return	書き出しに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavWriter::prepareAiff()
+{
+	const bool aifc = (container_ == CONTAINER_AIFC);
+	if (!aifc && !fmt_) {
+		return false;
+	}
+	try {
+		if (this->writeBytes("FORM", 4) != 4) {
+			return false;
+		}
+		this->writeDWORD(0);
+		if (this->writeBytes(aifc ? "AIFC" : "AIFF", 4) != 4) {
+			return false;
+		}
+		if (aifc) {
+			if (this->writeBytes("FVER", 4) != 4) {
+				return false;
+			}
+			this->writeDWORD(4);
+			this->writeDWORD(0xA2805140);	// AIFF-C Version 1
+		}
+
+		if (this->writeBytes("COMM", 4) != 4) {
+			return false;
+		}
+		this->writeDWORD(aifc ? 24 : 18);
+		this->writeWORD(ch_);
+		this->writeDWORD(0);
+		this->writeWORD(qbit_);
+		BYTE rate[10];
+		BinaryIo::toExtended(rate, fs_);
+		if (this->writeBytes(rate, 10) != 10) {
+			return false;
+		}
+		if (aifc) {
+			// 圧縮形式と空のpstring（長さ0と埋め草）
+			const char* type = !fmt_ ? "fl32" : (sowt_ ? "sowt" : "NONE");
+			const BYTE name[2] = { 0, 0 };
+			if (this->writeBytes(type, 4) != 4 || this->writeBytes(name, 2) != 2) {
+				return false;
+			}
+		}
+
+		if (this->writeBytes("SSND", 4) != 4) {
+			return false;
+		}
+		this->writeDWORD(0);
+		this->writeDWORD(0);	// offset
+		this->writeDWORD(0);	// blockSize
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// AIFF・AIFF-Cの書き出しを終了します。
+/**
+ * ペイロードが奇数長なら1バイト埋め、FORMとSSNDのチャンクサイズと
+ * COMMのフレーム数を書き込みます。
+ *
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool RiffWavWriter::finalizeAiff()
+{
+	const bool aifc = (container_ == CONTAINER_AIFC);
+	const int64_t comm = aifc ? 24 : 12;
+	const int64_t dataStart = comm + 8 + (aifc ? 24 : 18) + 16;
+
+	if (!this->seek(0, SEEK_END)) {
+		return false;
+	}
+	const int64_t fileEnd = this->tell();
+	if (fileEnd < dataStart) {
+		return false;
+	}
+	const uint64_t dataSize = static_cast<uint64_t>(fileEnd - dataStart);
+	const DWORD block = static_cast<DWORD>(qbit_ / 8 * ch_);
+
+	try {
+		const BYTE zero = 0;
+		const size_t pad = static_cast<size_t>(fileEnd & 1);
+		if (pad > 0 && BinaryWriter::writeBytes(&zero, 1) != 1) {
+			return false;
+		}
+		if (!this->seek(4, SEEK_SET)) {
+			return false;
+		}
+		this->writeDWORD(static_cast<DWORD>(fileEnd + pad - 8));
+		if (!this->seek(comm + 10, SEEK_SET)) {
+			return false;
+		}
+		this->writeDWORD(static_cast<DWORD>((block == 0) ? 0 : dataSize / block));
+		if (!this->seek(dataStart - 12, SEEK_SET)) {
+			return false;
+		}
+		this->writeDWORD(static_cast<DWORD>(dataSize + 8));
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// RIFF-WAV形式のサンプル列をファイル上の形式に変換します。
+/**
+ * RiffWavReader::decodeSamplesの逆変換です。ビッグエンディアンの形式では
+ * バイト順を反転し、AIFF・AIFF-Cの8bitは符号付きにします。
+ *
+ * @param[in]	src		RIFF-WAV形式のサンプル列
+ * @param[out]	dst		変換先。srcと同じでもよい。
+ * @param[in]	count	サンプル数（フレーム数×チャンネル数）
+ */
+// ----------------------------------------------------------------------------
+void RiffWavWriter::encodeSamples(const void* src, void* dst, size_t count) const
+{
+	const size_t width = (qbit_ / 8 == 0) ? 1 : qbit_ / 8;
+	if (isBigEndian()) {
+		if (src == dst) {
+			ByteSwap::swap(dst, count, width);
+		} else {
+			ByteSwap::copy(src, dst, count, width);
+		}
+	} else if (src != dst) {
+		::memcpy(dst, src, count * width);
+	}
+	if (width == 1 && (container_ == CONTAINER_AIFF || container_ == CONTAINER_AIFC)) {
+		BYTE* b = static_cast<BYTE*>(dst);
+		for (size_t i = 0; i < count; i++) {
+			b[i] ^= 0x80;
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// ストリームのバイト列を書き出します。
+/**
+ * BinaryWriter::writeBytesと同じですが、ストリーム書き出し中は
+ * 書き出したバイト列をチェックサムに加えます。\n
+ * RIFX・AIFF・AIFF-CではRIFF-WAV形式のサンプルを与え、encodeSamplesで変換して
+ * 書き出します。チェックサムと監視への通知は変換前のバイト列が対象です。
+ *
+ * @attention	RIFX・AIFF・AIFF-Cでは1回に書き出すバイト列はサンプル境界で区切ること。
+ *
+ * @param[in] buf		書き出しデータバッファ
+ * @param[in] size		書き出しデータのバイトサイズ
+ * @return	実際に書き出したバイトサイズ
+ * @exception	WavIoException	ファイル未オープン
+ */
+// ----------------------------------------------------------------------------
+size_t RiffWavWriter::writeBytes(const void* buf, size_t size) WAVE11_THROWS(WavIoException)
+{
+	size_t ret;
+	if (streaming_ && needsEncode()) {
+		ret = writeEncoded(buf, size);
+	} else {
+		ret = BinaryWriter::writeBytes(buf, size);
+	}
+	if (streaming_) {
+		checksum_.update(buf, ret);
+		if (observer_ != nullptr) {
+			observer_->onStream(buf, ret);
+		}
+	}
+	return ret;
+}
+// ----------------------------------------------------------------------------
+// ファイル上の形式のサンプル列を他のファイルからそのまま書き出します。
+/**
+ * 複写元のバイト列は変換せずにBinaryWriter::copyFromで書き出すため、
+ * Linuxではユーザー空間を経由しません。複写元は書き出し先と同じ量子化ビット数・
+ * チャンネル数・バイト順であること（isBigEndianとRiffWavReader::isBigEndianが一致し、
+ * AIFFの8bitはコンテナも一致すること）。
+ * チェックサムとストリームの監視には通知しません。
+ *
+ * @param[in] src		複写元のファイル
+ * @param[in] offset	複写元のサンプル列のバイトオフセット
+ * @param[in] size		複写するバイトサイズ
+ * @return	実際に書き出したバイトサイズ
+ * @exception	WavIoException	ファイル未オープン、ストリーム書き出し前、または読み込みエラー発生
+ */
+// ----------------------------------------------------------------------------
+uint64_t RiffWavWriter::copySamples(PositionalFile& src, uint64_t offset, uint64_t size) WAVE11_THROWS(WavIoException)
+{
+	if (!streaming_) {
+		throw WavIoException("stream isn't prepared.");
+	}
+	return copyFrom(src, offset, size);
+}
+// ----------------------------------------------------------------------------
+// サンプルをファイル上の形式に変換して書き出します。
+/**
+ * 一定サイズごとに変換用のバッファへencodeSamplesで変換しながら複写し、書き出します。
+ *
+ * @param[in] buf		RIFF-WAV形式のサンプル列
+ * @param[in] size		書き出しデータのバイトサイズ
+ * @return	実際に書き出したバイトサイズ
+ * @exception	WavIoException	ファイル未オープン
+ */
+// ----------------------------------------------------------------------------
+size_t RiffWavWriter::writeEncoded(const void* buf, size_t size) WAVE11_THROWS(WavIoException)
+{
+	const size_t width = (qbit_ / 8 == 0) ? 1 : qbit_ / 8;
+	const size_t chunk = 65536 / width * width;
+	const BYTE* src = static_cast<const BYTE*>(buf);
+	PooledBuffer tmp((size < chunk) ? size : chunk);
+	size_t done = 0;
+	while (done < size) {
+		const size_t n = (size - done < chunk) ? size - done : chunk;
+		encodeSamples(src + done, tmp.data(), n / width);
+		// サンプルに満たない端数はそのまま
+		::memcpy(tmp.as<BYTE>() + n / width * width, src + done + n / width * width, n % width);
+		const size_t wrote = BinaryWriter::writeBytes(tmp.data(), n);
+		done += wrote;
+		if (wrote < n) {
+			break;
+		}
+	}
+	return done;
+}
+// ----------------------------------------------------------------------------
+// 32bit floatのフレームを出力形式に変換して書き出します。
+/**
+ * 整数型PCMへはsetDitherで設定したディザーとノイズシェーピングを適用して
+ * 変換します。変換は一定フレームごとに区切り、書き出しと交互に行います。
+ *
+ * @param[in]	buf		32bit floatのインターリーブ形式のフレーム
+ * @param[in]	frames	フレーム数
+ * @return	書き出したフレーム数
+ * @exception	WavIoException	書き出しエラー発生
+ */
+// ----------------------------------------------------------------------------
+size_t RiffWavWriter::writeFloat(const float* buf, size_t frames) WAVE11_THROWS(WavIoException)
+{
+	const size_t frameBytes = qbit_ / 8 * ch_;
+	if (buf == nullptr || frames == 0 || frameBytes == 0) {
+		return 0;
+	}
+	const size_t chunk = 4096;
+	PooledBuffer out(((frames < chunk) ? frames : chunk) * frameBytes);
+	size_t done = 0;
+	while (done < frames) {
+		const size_t n = (frames - done < chunk) ? frames - done : chunk;
+		requantizer_.process(buf + done * ch_, out.data(), n);
+		const size_t wrote = this->writeBytes(out.data(), n * frameBytes);
+		done += wrote / frameBytes;
+		if (wrote < n * frameBytes) {
+			break;
+		}
+	}
+	return done;
+}
@@ -31,6 +31,9 @@
 #define _RIFFWAVWRITER_H_
 
 #include "BinaryWriter.h"
+#include "Checksum.h"
+#include "Requantizer.h"
+#include "StreamObserver.h"
 
 // ----------------------------------------------------------------------------
 /**
@@ -41,13 +44,99 @@
 class RiffWavWriter : public BinaryWriter
 {
 public:
-	RiffWavWriter(WORD, WORD, WORD, bool = true);
+	RiffWavWriter(WORD, WORD, DWORD, bool = true);
 	virtual ~RiffWavWriter() {}
 
 	//! ストリーム書き出しの準備を行います。
 	bool prepare();
 	//! ストリーム書き出しを終了します。
 	bool riffFinalize();
+	//! ストリームのバイト列を書き出します。
+	size_t writeBytes(const void*, size_t) WAVE11_THROWS(WavIoException);
+	//! ファイル上の形式のサンプル列を他のファイルからそのまま書き出します。
+	uint64_t copySamples(PositionalFile&, uint64_t, uint64_t) WAVE11_THROWS(WavIoException);
+	//! 32bit floatのフレームを出力形式に変換して書き出します。
+	size_t writeFloat(const float*, size_t) WAVE11_THROWS(WavIoException);
+
+	/**
+	 * @brief	writeFloatのディザーとノイズシェーピングを設定する
+	 *
+	 * 8/16/24bit整数型PCMへの書き出しにのみ適用される。既定はディザーなし。
+	 * 乱数と誤差履歴は設定時とprepare時に初期化される。
+	 *
+	 * @param[in]	dither	ディザーの種類
+	 * @param[in]	shape	ノイズシェーピングの種類
+	 * @param[in]	seed	乱数シード
+	 */
+	void setDither(DitherType dither, NoiseShape shape = SHAPE_NONE, uint32_t seed = Requantizer::DefaultSeed) {
+		requantizer_.configure(dither, shape, seed);
+	}
+
+	/**
+	 * @brief	ペイロードのチェックサム計算を有効にする
+	 *
+	 * prepareからriffFinalizeまでにwriteBytesで書き出したバイト列が対象となる。
+	 * prepareの前に呼び出すこと。
+	 *
+	 * @param[in]	types		ChecksumTypeの論理和。0で無効。
+	 * @param[in]	blockSize	CHECKSUM_BLOCKSのブロック長
+	 */
+	void enableChecksum(int types, size_t blockSize = PayloadChecksum::DefaultBlockSize) {
+		checksum_.reset(types, blockSize);
+	}
+	/**
+	 * @brief	ペイロードのチェックサムを取得する
+	 * @return	書き出し済みペイロードのチェックサム
+	 */
+	const PayloadChecksum& getChecksum() const { return checksum_; }
+	/**
+	 * @brief	ストリームの監視を登録する
+	 *
+	 * prepare時にストリームの形式を、以降riffFinalizeまでにwriteBytesで
+	 * 書き出したバイト列を通知する。prepareの前に呼び出すこと。
+	 *
+	 * @param[in]	observer	通知先。nullptrで解除。
+	 */
+	void setObserver(StreamObserver* observer) { observer_ = observer; }
+	/**
+	 * @brief	コンテナ形式を設定する
+	 *
+	 * 既定はCONTAINER_RIFF。CONTAINER_RIFX・CONTAINER_AIFF・CONTAINER_AIFCでは
+	 * writeBytesに与えたRIFF-WAV形式のサンプルをencodeSamplesで変換して書き出す。
+	 * CONTAINER_AIFFは整数型PCMのみ対応する。prepareの前に呼び出すこと。
+	 * @param[in]	container	コンテナ形式
+	 */
+	void setContainer(WavContainer container) { container_ = container; }
+	/**
+	 * @brief	コンテナ形式を取得する
+	 * @return	コンテナ形式
+	 */
+	WavContainer getContainer() const { return container_; }
+	/**
+	 * @brief	AIFF-Cの整数型PCMをリトルエンディアン（sowt）で書き出すか設定する
+	 *
+	 * 真ならサンプルのバイト順の変換を省ける。CONTAINER_AIFC以外では無視する。
+	 * prepareの前に呼び出すこと。
+	 * @param[in]	sowt	sowtで書き出すなら真
+	 */
+	void setSowt(bool sowt) { sowt_ = sowt; }
+	/**
+	 * @brief	サンプルのファイル上のバイト順を取得する
+	 * @return	RIFX・AIFF・AIFF-C（sowt以外）なら真
+	 */
+	bool isBigEndian() const {
+		return container_ == CONTAINER_RIFX || container_ == CONTAINER_AIFF
+			|| (container_ == CONTAINER_AIFC && !(sowt_ && fmt_));
+	}
+	//! RIFF-WAV形式のサンプル列をファイル上の形式に変換します。
+	void encodeSamples(const void*, void*, size_t) const;
+	/**
+	 * @brief	サンプルの変換が必要か判定する
+	 * @return	writeBytesでencodeSamplesを通すなら真
+	 */
+	bool needsEncode() const {
+		return isBigEndian() || (qbit_ == 8 && (container_ == CONTAINER_AIFF || container_ == CONTAINER_AIFC));
+	}
 
 private:
 	//! 量子化ビット数
@@ -58,6 +147,30 @@ private:
 	const DWORD fs_;
 	//! 量子化フォーマット（真が整数型PCM）
 	const bool fmt_;
+	//! コンテナ形式
+	WavContainer container_;
+	//! AIFF-Cの整数型PCMをsowtで書き出すなら真
+	bool sowt_;
+	//! ストリーム書き出し中なら真
+	bool streaming_;
+	//! ペイロードのチェックサム
+	PayloadChecksum checksum_;
+	//! ストリームの監視
+	StreamObserver* observer_;
+	//! writeFloatの再量子化
+	Requantizer requantizer_;
+
+	//! サンプルをファイル上の形式に変換して書き出します。
+	size_t writeEncoded(const void*, size_t) WAVE11_THROWS(WavIoException);
+
+	//! Wave64のヘッダーを書き出します。
+	bool prepareW64();
+	//! Wave64の書き出しを終了します。
+	bool finalizeW64();
+	//! AIFF・AIFF-Cのヘッダーを書き出します。
+	bool prepareAiff();
+	//! AIFF・AIFF-Cの書き出しを終了します。
+	bool finalizeAiff();
 
 	RiffWavWriter();
 };
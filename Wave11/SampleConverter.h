@@ -0,0 +1,237 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SampleConverter.h
+ * @brief	PCMサンプルと浮動小数点サンプルの相互変換のヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _SAMPLECONVERTER_H_
+#define _SAMPLECONVERTER_H_
+
+#include <cstring>
+#include <cmath>
+#include "WavIoType.h"
+#include "Metrics.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief PCMサンプルの変換クラス
+ *
+ * リトルエンディアンのRIFF-WAVストリームと[-1.0, 1.0)の浮動小数点値を相互に変換する。
+ * 対応形式は整数型PCMの8/16/24/32bitと浮動小数点型の32bit。
+ */
+// ----------------------------------------------------------------------------
+class SampleConverter
+{
+public:
+	/**
+	 * @brief	変換可能な形式か判定する
+	 * @param[in]	bits	量子化ビット数
+	 * @param[in]	pcm		整数型PCMなら真、浮動小数点型なら偽
+	 * @return	変換可能なら真
+	 */
+	static bool isSupported(WORD bits, bool pcm) {
+		if (!pcm) return bits == 32;
+		return bits == 8 || bits == 16 || bits == 24 || bits == 32;
+	}
+	/**
+	 * @brief	ストリームのバイト列を浮動小数点サンプルに変換する
+	 *
+	 * bigEndianが真ならRIFX・AIFFのファイル上の形式のまま読み、バイト順の反転を
+	 * 変換と同じ走査で行う。8bitは符号の扱いを含めてリトルエンディアンと同じ。
+	 *
+	 * @param[in]	src			変換元のバイト列
+	 * @param[out]	dst			変換結果を格納するバッファ
+	 * @param[in]	count		変換するサンプル数（フレーム数×チャンネル数）
+	 * @param[in]	bits		量子化ビット数
+	 * @param[in]	pcm			整数型PCMなら真、浮動小数点型なら偽
+	 * @param[in]	bigEndian	変換元がビッグエンディアンなら真
+	 *
+	 * @attention	isSupportedが偽となる形式は何もしない。
+	 */
+	static void toFloat(const void* src, float* dst, size_t count, WORD bits, bool pcm, bool bigEndian = false) {
+		WAVE11_METRIC_TIMER(timer, METRIC_CONVERT_NS);
+		const BYTE* s = static_cast<const BYTE*>(src);
+		if (!pcm) {
+			if (bits != 32) {
+				return;
+			}
+			if (!bigEndian) {
+				::memcpy(dst, s, count * sizeof(float));
+				return;
+			}
+			for (size_t i = 0; i < count; i++, s += 4) {
+				const DWORD v = static_cast<DWORD>(s[0]) << 24
+					| static_cast<DWORD>(s[1]) << 16
+					| static_cast<DWORD>(s[2]) << 8
+					| static_cast<DWORD>(s[3]);
+				::memcpy(&dst[i], &v, sizeof(float));
+			}
+			return;
+		}
+		if (bigEndian && bits != 8) {
+			toFloatBigEndian(s, dst, count, bits);
+			return;
+		}
+		switch (bits) {
+		case 8:
+			for (size_t i = 0; i < count; i++) {
+				dst[i] = (static_cast<int>(s[i]) - 128) * (1.f / 128.f);
+			}
+			break;
+		case 16:
+			for (size_t i = 0; i < count; i++, s += 2) {
+				short v = static_cast<short>(s[0] | (s[1] << 8));
+				dst[i] = v * (1.f / 32768.f);
+			}
+			break;
+		case 24:
+			for (size_t i = 0; i < count; i++, s += 3) {
+				int v = static_cast<int>(static_cast<DWORD>(s[0]) << 8
+					| static_cast<DWORD>(s[1]) << 16
+					| static_cast<DWORD>(s[2]) << 24) >> 8;
+				dst[i] = v * (1.f / 8388608.f);
+			}
+			break;
+		case 32:
+			for (size_t i = 0; i < count; i++, s += 4) {
+				int v = static_cast<int>(static_cast<DWORD>(s[0])
+					| static_cast<DWORD>(s[1]) << 8
+					| static_cast<DWORD>(s[2]) << 16
+					| static_cast<DWORD>(s[3]) << 24);
+				dst[i] = static_cast<float>(v * (1.0 / 2147483648.0));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	/**
+	 * @brief	浮動小数点サンプルをストリームのバイト列に変換する
+	 *
+	 * 整数型PCMへは最近接丸めとクリッピングを行う。
+	 *
+	 * @param[in]	src		変換元のサンプル
+	 * @param[out]	dst		変換結果を格納するバッファ
+	 * @param[in]	count	変換するサンプル数（フレーム数×チャンネル数）
+	 * @param[in]	bits	量子化ビット数
+	 * @param[in]	pcm		整数型PCMなら真、浮動小数点型なら偽
+	 *
+	 * @attention	isSupportedが偽となる形式は何もしない。
+	 */
+	static void fromFloat(const float* src, void* dst, size_t count, WORD bits, bool pcm) {
+		WAVE11_METRIC_TIMER(timer, METRIC_CONVERT_NS);
+		BYTE* d = static_cast<BYTE*>(dst);
+		if (!pcm) {
+			if (bits == 32) {
+				::memcpy(d, src, count * sizeof(float));
+			}
+			return;
+		}
+		switch (bits) {
+		case 8:
+			for (size_t i = 0; i < count; i++) {
+				d[i] = static_cast<BYTE>(quantize(src[i], 128.0, -128, 127) + 128);
+			}
+			break;
+		case 16:
+			for (size_t i = 0; i < count; i++, d += 2) {
+				int v = quantize(src[i], 32768.0, -32768, 32767);
+				d[0] = static_cast<BYTE>(v);
+				d[1] = static_cast<BYTE>(v >> 8);
+			}
+			break;
+		case 24:
+			for (size_t i = 0; i < count; i++, d += 3) {
+				int v = quantize(src[i], 8388608.0, -8388608, 8388607);
+				d[0] = static_cast<BYTE>(v);
+				d[1] = static_cast<BYTE>(v >> 8);
+				d[2] = static_cast<BYTE>(v >> 16);
+			}
+			break;
+		case 32:
+			for (size_t i = 0; i < count; i++, d += 4) {
+				int v = quantize(src[i], 2147483648.0, -2147483647 - 1, 2147483647);
+				d[0] = static_cast<BYTE>(v);
+				d[1] = static_cast<BYTE>(v >> 8);
+				d[2] = static_cast<BYTE>(v >> 16);
+				d[3] = static_cast<BYTE>(v >> 24);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+private:
+	/**
+	 * @brief	ビッグエンディアンの16/24/32bit整数型PCMを浮動小数点サンプルに変換する
+	 */
+	static void toFloatBigEndian(const BYTE* s, float* dst, size_t count, WORD bits) {
+		switch (bits) {
+		case 16:
+			for (size_t i = 0; i < count; i++, s += 2) {
+				short v = static_cast<short>((s[0] << 8) | s[1]);
+				dst[i] = v * (1.f / 32768.f);
+			}
+			break;
+		case 24:
+			for (size_t i = 0; i < count; i++, s += 3) {
+				int v = static_cast<int>(static_cast<DWORD>(s[0]) << 24
+					| static_cast<DWORD>(s[1]) << 16
+					| static_cast<DWORD>(s[2]) << 8) >> 8;
+				dst[i] = v * (1.f / 8388608.f);
+			}
+			break;
+		case 32:
+			for (size_t i = 0; i < count; i++, s += 4) {
+				int v = static_cast<int>(static_cast<DWORD>(s[0]) << 24
+					| static_cast<DWORD>(s[1]) << 16
+					| static_cast<DWORD>(s[2]) << 8
+					| static_cast<DWORD>(s[3]));
+				dst[i] = static_cast<float>(v * (1.0 / 2147483648.0));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	/**
+	 * @brief	浮動小数点値を整数値に丸める
+	 * @param[in]	x		変換元の値
+	 * @param[in]	scale	フルスケール
+	 * @param[in]	lo		下限値
+	 * @param[in]	hi		上限値
+	 * @return	最近接丸めとクリッピングをした整数値
+	 */
+	static int quantize(float x, double scale, int lo, int hi) {
+		double v = ::floor(x * scale + 0.5);
+		if (v < lo) return lo;
+		if (v > hi) return hi;
+		return static_cast<int>(v);
+	}
+};
+
+#endif // !_SAMPLECONVERTER_H_
@@ -0,0 +1,542 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SignalGraph.cpp
+ * @brief	ブロック単位の信号グラフの実装
+ */
+// ----------------------------------------------------------------------------
+#include "SignalGraph.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include "SampleConverter.h"
+
+namespace {
+
+//! 未評価を表すブロック番号
+const uint64_t NoBlock = ~static_cast<uint64_t>(0);
+
+} // namespace
+
+const size_t SignalNode::BlockFrames;
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	channels	出力のチャンネル数
+ */
+// ----------------------------------------------------------------------------
+SignalNode::SignalNode(WORD channels)
+	: channels_((channels == 0) ? 1 : channels),
+	buffer_(BlockFrames * ((channels == 0) ? 1 : channels) * sizeof(float)),
+	block_(NoBlock)
+{
+}
+// ----------------------------------------------------------------------------
+// 指定ブロックを評価して出力を取得します。
+/**
+ * 未評価の入力を先に評価してから自身を評価します。
+ * 評価済みのブロックなら保持している出力をそのまま返します。
+ *
+ * @param[in]	block	ブロック番号
+ * @return	BlockFrames * channels()個のサンプル
+ */
+// ----------------------------------------------------------------------------
+const float* SignalNode::pull(uint64_t block)
+{
+	if (block_ != block) {
+		for (size_t i = 0; i < inputs_.size(); i++) {
+			inputs_[i]->pull(block);
+		}
+		evaluate(block);
+	}
+	return buffer_.as<float>();
+}
+// ----------------------------------------------------------------------------
+// 入力が評価済みの前提で、自身だけを評価します。
+/**
+ * @param[in]	block	ブロック番号
+ */
+// ----------------------------------------------------------------------------
+void SignalNode::evaluate(uint64_t block)
+{
+	if (block_ != block) {
+		render(buffer_.as<float>(), block);
+		block_ = block;
+	}
+}
+// ----------------------------------------------------------------------------
+// 入力のサンプルをチャンネルに合わせて取得します。
+/**
+ * @param[in]	i		入力の番号
+ * @param[in]	frame	ブロック内のフレーム位置
+ * @param[in]	ch		チャンネル番号
+ * @return	1チャンネルの入力なら全チャンネル共通の値、範囲外のチャンネルなら0
+ */
+// ----------------------------------------------------------------------------
+float SignalNode::inputSample(size_t i, size_t frame, WORD ch) const
+{
+	const WORD n = inputs_[i]->channels_;
+	if (n == 1) {
+		return input(i)[frame];
+	}
+	return (ch < n) ? input(i)[frame * n + ch] : 0.f;
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	wave			波形の種類
+ * @param[in]	freq			周波数
+ * @param[in]	samplingRate	サンプリングレート
+ * @param[in]	channels		出力のチャンネル数。全チャンネルに同じ値を出力する。
+ * @param[in]	seed			ホワイトノイズの乱数シード
+ */
+// ----------------------------------------------------------------------------
+GeneratorNode::GeneratorNode(Waveform wave, int freq, int samplingRate, WORD channels, uint32_t seed)
+	: SignalNode(channels), gen_(freq, samplingRate), rng_(seed)
+{
+	switch (wave) {
+	case WAVE_SAW:		wave_ = &WaveGenerator::SawSample; break;
+	case WAVE_PULSE:	wave_ = &WaveGenerator::PulseSample; break;
+	case WAVE_TRIANGLE:	wave_ = &WaveGenerator::TriangleSample; break;
+	case WAVE_NOISE:	wave_ = nullptr; break;
+	default:			wave_ = &WaveGenerator::SinSample; break;
+	}
+}
+// ----------------------------------------------------------------------------
+// ホワイトノイズのサンプルを生成します。
+/**
+ * WaveGenerator::WnoiseSampleと同じく-1.0〜1.0の一様分布とする。
+ * 分布クラスは実装により系列が異なるため、乱数から直接求める。
+ *
+ * @return	生成サンプル
+ */
+// ----------------------------------------------------------------------------
+float GeneratorNode::noise()
+{
+	const double range = static_cast<double>(std::minstd_rand::max() - std::minstd_rand::min());
+	const double u = static_cast<double>(rng_() - std::minstd_rand::min()) / range;
+	return static_cast<float>(2.0 * (u - 0.5));
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void GeneratorNode::render(float* out, uint64_t)
+{
+	const WORD ch = channels();
+	for (size_t i = 0; i < BlockFrames; i++) {
+		const float v = (wave_ == nullptr) ? noise() : (gen_.*wave_)();
+		for (WORD c = 0; c < ch; c++) {
+			*out++ = v;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	mod			変調入力。先頭チャンネルを使う。
+ * @param[in]	carrier		搬送波周波数（Hz）
+ * @param[in]	deviation	変調入力1.0あたりの周波数偏移（Hz）
+ * @param[in]	fs			サンプリングレート
+ */
+// ----------------------------------------------------------------------------
+FmNode::FmNode(SignalNode& mod, double carrier, double deviation, int fs)
+	: SignalNode(1), carrier_(carrier), deviation_(deviation), fs_((fs <= 0) ? 1.0 : fs), phase_(0.0)
+{
+	addInput(&mod);
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void FmNode::render(float* out, uint64_t)
+{
+	for (size_t i = 0; i < BlockFrames; i++) {
+		phase_ += (carrier_ + deviation_ * inputSample(0, i, 0)) / fs_;
+		phase_ -= std::floor(phase_);
+		out[i] = static_cast<float>(std::sin(2.0 * M_PI * phase_));
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	in		入力
+ * @param[in]	gain	利得
+ */
+// ----------------------------------------------------------------------------
+GainNode::GainNode(SignalNode& in, float gain)
+	: SignalNode(in.channels()), gain_(gain), target_(gain), step_(0.0), remain_(0)
+{
+	addInput(&in);
+}
+// ----------------------------------------------------------------------------
+// 利得を直ちに変更します。
+/**
+ * @param[in]	gain	利得
+ */
+// ----------------------------------------------------------------------------
+void GainNode::setGain(float gain)
+{
+	gain_ = target_ = gain;
+	step_ = 0.0;
+	remain_ = 0;
+}
+// ----------------------------------------------------------------------------
+// 利得を直線的に変化させます。
+/**
+ * @param[in]	gain	目標の利得
+ * @param[in]	frames	変化に要するフレーム数。0なら直ちに変更する。
+ */
+// ----------------------------------------------------------------------------
+void GainNode::rampTo(float gain, uint64_t frames)
+{
+	if (frames == 0) {
+		setGain(gain);
+		return;
+	}
+	target_ = gain;
+	step_ = (target_ - gain_) / static_cast<double>(frames);
+	remain_ = frames;
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void GainNode::render(float* out, uint64_t)
+{
+	const WORD ch = channels();
+	const float* in = input(0);
+	size_t i = 0;
+	// 変化中の区間
+	for (; i < BlockFrames && remain_ > 0; i++) {
+		gain_ += step_;
+		if (--remain_ == 0) {
+			gain_ = target_;
+		}
+		for (WORD c = 0; c < ch; c++) {
+			out[i * ch + c] = static_cast<float>(in[i * ch + c] * gain_);
+		}
+	}
+	// 一定の区間
+	const float g = static_cast<float>(gain_);
+	for (size_t k = i * ch; k < BlockFrames * ch; k++) {
+		out[k] = in[k] * g;
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	in		入力
+ * @param[in]	attack	アタックのフレーム数
+ * @param[in]	decay	ディケイのフレーム数
+ * @param[in]	sustain	サステインのレベル
+ * @param[in]	release	リリースのフレーム数
+ * @param[in]	gate	ゲート長のフレーム数
+ */
+// ----------------------------------------------------------------------------
+EnvelopeNode::EnvelopeNode(SignalNode& in, uint64_t attack, uint64_t decay, float sustain, uint64_t release, uint64_t gate)
+	: SignalNode(in.channels()), attack_(attack), decay_(decay), sustain_(sustain),
+	release_(release), gate_(gate), pos_(0)
+{
+	addInput(&in);
+}
+// ----------------------------------------------------------------------------
+// 経過フレーム数におけるレベルを求めます。
+/**
+ * @param[in]	t	経過フレーム数
+ * @return	エンベロープのレベル
+ */
+// ----------------------------------------------------------------------------
+float EnvelopeNode::level(uint64_t t) const
+{
+	if (t >= gate_) {
+		// リリースはゲート終了時点のレベルから0まで
+		const uint64_t r = t - gate_;
+		if (r >= release_) {
+			return 0.f;
+		}
+		return level(gate_ - 1) * (1.f - static_cast<float>(r) / release_);
+	}
+	if (t < attack_) {
+		return static_cast<float>(t + 1) / attack_;
+	}
+	t -= attack_;
+	if (t < decay_) {
+		return 1.f - (1.f - sustain_) * static_cast<float>(t + 1) / decay_;
+	}
+	return sustain_;
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void EnvelopeNode::render(float* out, uint64_t)
+{
+	const WORD ch = channels();
+	const float* in = input(0);
+	for (size_t i = 0; i < BlockFrames; i++, pos_++) {
+		const float g = (gate_ == 0) ? 0.f : level(pos_);
+		for (WORD c = 0; c < ch; c++) {
+			out[i * ch + c] = in[i * ch + c] * g;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	channels	出力のチャンネル数
+ */
+// ----------------------------------------------------------------------------
+SumNode::SumNode(WORD channels) : SignalNode(channels)
+{
+}
+// ----------------------------------------------------------------------------
+// 入力を追加します。
+/**
+ * @param[in]	in		入力
+ * @param[in]	weight	重み
+ */
+// ----------------------------------------------------------------------------
+void SumNode::add(SignalNode& in, float weight)
+{
+	addInput(&in);
+	weights_.push_back(weight);
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void SumNode::render(float* out, uint64_t)
+{
+	const WORD ch = channels();
+	std::fill(out, out + BlockFrames * ch, 0.f);
+	for (size_t k = 0; k < weights_.size(); k++) {
+		const float w = weights_[k];
+		if (inputs()[k]->channels() == ch) {
+			const float* in = input(k);
+			for (size_t i = 0; i < BlockFrames * ch; i++) {
+				out[i] += in[i] * w;
+			}
+		} else {
+			for (size_t i = 0; i < BlockFrames; i++) {
+				for (WORD c = 0; c < ch; c++) {
+					out[i * ch + c] += inputSample(k, i, c) * w;
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * チャンネル数は入力のうち多い方に合わせます。
+ *
+ * @param[in]	a	入力
+ * @param[in]	b	入力
+ */
+// ----------------------------------------------------------------------------
+MultiplyNode::MultiplyNode(SignalNode& a, SignalNode& b)
+	: SignalNode(std::max(a.channels(), b.channels()))
+{
+	addInput(&a);
+	addInput(&b);
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void MultiplyNode::render(float* out, uint64_t)
+{
+	const WORD ch = channels();
+	for (size_t i = 0; i < BlockFrames; i++) {
+		for (WORD c = 0; c < ch; c++) {
+			out[i * ch + c] = inputSample(0, i, c) * inputSample(1, i, c);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	in	入力
+ */
+// ----------------------------------------------------------------------------
+BiquadNode::BiquadNode(SignalNode& in)
+	: SignalNode(in.channels()), filter_(in.channels())
+{
+	addInput(&in);
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void BiquadNode::render(float* out, uint64_t)
+{
+	std::copy(input(0), input(0) + BlockFrames * channels(), out);
+	filter_.process(out, BlockFrames);
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	in		入力
+ * @param[in]	taps	係数
+ */
+// ----------------------------------------------------------------------------
+FirNode::FirNode(SignalNode& in, const std::vector<float>& taps)
+	: SignalNode(in.channels()), filter_(in.channels(), taps)
+{
+	addInput(&in);
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void FirNode::render(float* out, uint64_t)
+{
+	std::copy(input(0), input(0) + BlockFrames * channels(), out);
+	filter_.process(out, BlockFrames);
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * @param[in]	reader	prepare済みの読み込み元
+ */
+// ----------------------------------------------------------------------------
+FileSourceNode::FileSourceNode(RiffWavReader& reader)
+	: SignalNode(reader.getChannels()), reader_(reader),
+	raw_(BlockFrames * ((reader.getBlockAlign() == 0) ? 1 : reader.getBlockAlign()))
+{
+}
+// ----------------------------------------------------------------------------
+// 1ブロックを生成します。
+// ----------------------------------------------------------------------------
+void FileSourceNode::render(float* out, uint64_t)
+{
+	const WORD ch = channels();
+	const WORD bits = reader_.getBitPerSample();
+	const bool pcm = (reader_.getFormatTag() == 1);
+	size_t got = 0;
+	if (SampleConverter::isSupported(bits, pcm) && reader_.getSamples(raw_.data(), BlockFrames, got) >= 0) {
+		SampleConverter::toFloat(raw_.data(), out, got * ch, bits, pcm);
+	} else {
+		got = 0;
+	}
+	std::fill(out + got * ch, out + BlockFrames * ch, 0.f);
+}
+
+// ----------------------------------------------------------------------------
+// コンストラクタ
+/**
+ * 出力ノードから辿れるノードを入力からの深さごとに分類します。
+ *
+ * @param[in]	output	出力ノード
+ * @param[in]	pool	並列評価に使うスレッドプール。nullptrなら逐次評価する。
+ */
+// ----------------------------------------------------------------------------
+SignalGraph::SignalGraph(SignalNode& output, ThreadPool* pool)
+	: output_(output), pool_(pool), block_(0)
+{
+	if (pool_ == nullptr) {
+		return;
+	}
+	// 深さ = 入力の深さの最大値 + 1（入力のないノードは0）
+	std::map<SignalNode*, size_t> depth;
+	std::vector<std::pair<SignalNode*, size_t> > stack;
+	stack.push_back(std::make_pair(&output, 0));
+	while (!stack.empty()) {
+		SignalNode* node = stack.back().first;
+		size_t& next = stack.back().second;
+		if (depth.count(node) != 0) {
+			stack.pop_back();
+			continue;
+		}
+		if (next < node->inputs().size()) {
+			SignalNode* in = node->inputs()[next++];
+			if (depth.count(in) == 0) {
+				stack.push_back(std::make_pair(in, 0));
+			}
+			continue;
+		}
+		size_t d = 0;
+		for (size_t i = 0; i < node->inputs().size(); i++) {
+			d = std::max(d, depth[node->inputs()[i]] + 1);
+		}
+		depth[node] = d;
+		if (levels_.size() <= d) {
+			levels_.resize(d + 1);
+		}
+		levels_[d].push_back(node);
+		stack.pop_back();
+	}
+}
+// ----------------------------------------------------------------------------
+// 次のブロックを評価します。
+/**
+ * @return	出力ノードのBlockFrames * channels()個のサンプル
+ */
+// ----------------------------------------------------------------------------
+const float* SignalGraph::next()
+{
+	const uint64_t block = block_++;
+	if (pool_ == nullptr) {
+		return output_.pull(block);
+	}
+	for (size_t d = 0; d < levels_.size(); d++) {
+		std::vector<SignalNode*>& level = levels_[d];
+		if (level.size() == 1) {
+			level[0]->evaluate(block);
+		} else {
+			pool_->parallelFor(level.size(), [&level, block](size_t i) { level[i]->evaluate(block); });
+		}
+	}
+	return output_.buffer_.as<float>();
+}
+// ----------------------------------------------------------------------------
+// 出力をRiffWavWriterで書き出します。
+/**
+ * 出力ノードのチャンネル数は書き出し先のチャンネル数と一致していること。
+ *
+ * @param[in,out]	writer	prepare済みの書き出し先
+ * @param[in]		frames	書き出すフレーム数
+ * @return	書き出したフレーム数
+ * @exception	WavIoException	書き出しエラー発生
+ */
+// ----------------------------------------------------------------------------
+uint64_t SignalGraph::render(RiffWavWriter& writer, uint64_t frames) WAVE11_THROWS(WavIoException)
+{
+	uint64_t done = 0;
+	while (done < frames) {
+		const float* block = next();
+		const size_t n = static_cast<size_t>(std::min<uint64_t>(frames - done, SignalNode::BlockFrames));
+		const size_t wrote = writer.writeFloat(block, n);
+		done += wrote;
+		if (wrote < n) {
+			break;
+		}
+	}
+	return done;
+}
@@ -0,0 +1,383 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SignalGraph.h
+ * @brief	ブロック単位の信号グラフのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _SIGNALGRAPH_H_
+#define _SIGNALGRAPH_H_
+
+#include <cstdint>
+#include <vector>
+#include <random>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "BufferPool.h"
+#include "ThreadPool.h"
+#include "WaveGenerator.h"
+#include "FilterBank.h"
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 信号グラフのノード
+ *
+ * 固定長ブロック単位で32bit floatのインターリーブ形式の信号を出力する。
+ * 出力バッファは生成時に確保し、以降の評価ではメモリ確保を行わない。
+ *
+ * pullはブロック番号ごとに一度だけ入力を辿って評価し、結果を保持する。
+ * 同じノードを複数の出力先から参照しても評価は一度で済む。
+ * 入力は評価より前に接続し、グラフに循環を作ってはならない。
+ * 1チャンネルの入力は多チャンネルのノードで全チャンネルに複製して使う。
+ */
+// ----------------------------------------------------------------------------
+class SignalNode : private Noncopyable
+{
+public:
+	//! 1ブロックのフレーム数
+	static const size_t BlockFrames = 512;
+
+	explicit SignalNode(WORD);
+	virtual ~SignalNode() {}
+
+	/**
+	 * @brief	チャンネル数を取得する
+	 * @return	出力のチャンネル数
+	 */
+	WORD channels() const { return channels_; }
+	/**
+	 * @brief	入力ノードを取得する
+	 * @return	接続済みの入力ノード
+	 */
+	const std::vector<SignalNode*>& inputs() const { return inputs_; }
+	//! 指定ブロックを評価して出力を取得します。
+	const float* pull(uint64_t);
+
+protected:
+	/**
+	 * @brief	入力ノードを接続する
+	 * @param[in]	node	入力ノード
+	 */
+	void addInput(SignalNode* node) { inputs_.push_back(node); }
+	/**
+	 * @brief	入力ノードの評価済みの出力を取得する
+	 * @param[in]	i	入力の番号
+	 * @return	入力ノードの出力
+	 */
+	const float* input(size_t i) const { return inputs_[i]->buffer_.as<float>(); }
+	//! 入力のサンプルをチャンネルに合わせて取得します。
+	float inputSample(size_t, size_t, WORD) const;
+	/**
+	 * @brief	1ブロックを生成する
+	 *
+	 * 呼び出し時点で全ての入力は同じブロックを評価済みである。
+	 * @param[out]	out		BlockFrames * channels()個のサンプルの格納先
+	 * @param[in]	block	ブロック番号
+	 */
+	virtual void render(float* out, uint64_t block) = 0;
+
+private:
+	friend class SignalGraph;
+
+	//! チャンネル数
+	const WORD channels_;
+	//! 入力ノード
+	std::vector<SignalNode*> inputs_;
+	//! 出力バッファ
+	PooledBuffer buffer_;
+	//! 出力バッファに保持しているブロック番号
+	uint64_t block_;
+
+	//! 入力が評価済みの前提で、自身だけを評価します。
+	void evaluate(uint64_t);
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief WaveGeneratorの波形を出力するノード
+ *
+ * ホワイトノイズはrand()を使わず、ノードごとに持つminstd_randで生成する。
+ * 同じシードからは実行環境やスレッドによらず同じ系列を得る。
+ */
+// ----------------------------------------------------------------------------
+class GeneratorNode : public SignalNode
+{
+public:
+	//! 波形の種類
+	enum Waveform {
+		WAVE_SIN,		//!< 正弦波
+		WAVE_SAW,		//!< ノコギリ波
+		WAVE_PULSE,		//!< 矩形波
+		WAVE_TRIANGLE,	//!< 三角波
+		WAVE_NOISE		//!< ホワイトノイズ
+	};
+
+	GeneratorNode(Waveform, int, int, WORD = 1, uint32_t = std::minstd_rand::default_seed);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! 波形生成器
+	WaveGenerator gen_;
+	//! 波形生成メソッド。ホワイトノイズならnullptr。
+	float (WaveGenerator::*wave_)();
+	//! ホワイトノイズの乱数生成器
+	std::minstd_rand rng_;
+
+	//! ホワイトノイズのサンプルを生成します。
+	float noise();
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 周波数変調の正弦波を出力するノード
+ *
+ * 瞬時周波数は搬送波周波数に変調入力と周波数偏移の積を加えたもの。
+ */
+// ----------------------------------------------------------------------------
+class FmNode : public SignalNode
+{
+public:
+	FmNode(SignalNode&, double, double, int);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! 搬送波周波数（Hz）
+	const double carrier_;
+	//! 周波数偏移（Hz）
+	const double deviation_;
+	//! サンプリングレート
+	const double fs_;
+	//! 位相（周期単位）
+	double phase_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 利得を掛けるノード
+ *
+ * rampToで目標の利得まで指定フレーム数で直線的に変化させる。
+ */
+// ----------------------------------------------------------------------------
+class GainNode : public SignalNode
+{
+public:
+	GainNode(SignalNode&, float = 1.f);
+
+	//! 利得を直ちに変更します。
+	void setGain(float);
+	//! 利得を直線的に変化させます。
+	void rampTo(float, uint64_t);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! 現在の利得
+	double gain_;
+	//! 目標の利得
+	double target_;
+	//! 1フレームあたりの変化量
+	double step_;
+	//! 変化の残りフレーム数
+	uint64_t remain_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ADSRエンベロープを掛けるノード
+ *
+ * 時間はすべてフレーム数で指定する。ゲート長を過ぎるとリリースに移る。
+ */
+// ----------------------------------------------------------------------------
+class EnvelopeNode : public SignalNode
+{
+public:
+	EnvelopeNode(SignalNode&, uint64_t, uint64_t, float, uint64_t, uint64_t);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	const uint64_t attack_;
+	const uint64_t decay_;
+	const float sustain_;
+	const uint64_t release_;
+	//! ゲート長
+	const uint64_t gate_;
+	//! 経過フレーム数
+	uint64_t pos_;
+
+	//! 経過フレーム数におけるレベルを求めます。
+	float level(uint64_t) const;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 入力を重み付きで加算するノード
+ */
+// ----------------------------------------------------------------------------
+class SumNode : public SignalNode
+{
+public:
+	explicit SumNode(WORD = 1);
+
+	//! 入力を追加します。
+	void add(SignalNode&, float = 1.f);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! 入力ごとの重み
+	std::vector<float> weights_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 2つの入力を乗算するノード
+ *
+ * 振幅変調やリング変調に使う。
+ */
+// ----------------------------------------------------------------------------
+class MultiplyNode : public SignalNode
+{
+public:
+	MultiplyNode(SignalNode&, SignalNode&);
+
+protected:
+	void render(float*, uint64_t);
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief バイクアッドフィルターの縦続接続を掛けるノード
+ *
+ * 段はfilterで取得したBiquadCascadeに評価前に追加する。
+ * FileSourceNodeとSignalGraph::renderの間に置けば、読み込み・フィルター・書き出しが
+ * ブロックごとに1回の走査で済む。
+ */
+// ----------------------------------------------------------------------------
+class BiquadNode : public SignalNode
+{
+public:
+	explicit BiquadNode(SignalNode&);
+
+	/**
+	 * @brief	フィルターを取得する
+	 * @return	入力と同じチャンネル数のフィルター
+	 */
+	BiquadCascade& filter() { return filter_; }
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! フィルター
+	BiquadCascade filter_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief FIRフィルターを掛けるノード
+ */
+// ----------------------------------------------------------------------------
+class FirNode : public SignalNode
+{
+public:
+	FirNode(SignalNode&, const std::vector<float>&);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! フィルター
+	FirFilter filter_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief RiffWavReaderから読み込んだ信号を出力するノード
+ *
+ * 読み込み元はprepare済みであること。終端以降は無音を出力する。
+ */
+// ----------------------------------------------------------------------------
+class FileSourceNode : public SignalNode
+{
+public:
+	explicit FileSourceNode(RiffWavReader&);
+
+protected:
+	void render(float*, uint64_t);
+
+private:
+	//! 読み込み元
+	RiffWavReader& reader_;
+	//! 読み込みバッファ
+	PooledBuffer raw_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 信号グラフの評価クラス
+ *
+ * 出力ノードから辿れるノードだけをブロック単位で評価する。
+ * スレッドプールを与えた場合は、入力からの深さが同じノード同士は互いに
+ * 依存しないため、深さごとにまとめて並列に評価する。
+ * 生成後にグラフの接続を変更してはならない。
+ */
+// ----------------------------------------------------------------------------
+class SignalGraph : private Noncopyable
+{
+public:
+	SignalGraph(SignalNode&, ThreadPool* = nullptr);
+
+	//! 次のブロックを評価します。
+	const float* next();
+	/**
+	 * @brief	次に評価するブロック番号を取得する
+	 * @return	評価済みのブロック数
+	 */
+	uint64_t position() const { return block_; }
+	//! 出力をRiffWavWriterで書き出します。
+	uint64_t render(RiffWavWriter&, uint64_t) WAVE11_THROWS(WavIoException);
+
+private:
+	//! 出力ノード
+	SignalNode& output_;
+	//! 評価に使うスレッドプール
+	ThreadPool* pool_;
+	//! 深さごとのノード
+	std::vector<std::vector<SignalNode*> > levels_;
+	//! 次に評価するブロック番号
+	uint64_t block_;
+};
+
+#endif // !_SIGNALGRAPH_H_
@@ -0,0 +1,558 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SilenceScanner.cpp
+ * @brief	無音区間の検出と前後の無音の除去を行うクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include <cmath>
+#include <cstring>
+#include "SilenceScanner.h"
+#include "HeaderCache.h"
+#include "BufferPool.h"
+#include "RiffWavWriter.h"
+#include "SampleConverter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SILENCESCANNER_USE_SSE
+#endif
+
+namespace {
+
+//! サンプルの種類
+enum SampleKind {
+	KIND_U8,	//!< 符号なし8bit整数
+	KIND_S16,	//!< 符号付き16bit整数
+	KIND_S24,	//!< 符号付き24bit整数
+	KIND_S32,	//!< 符号付き32bit整数
+	KIND_F32	//!< 32bit浮動小数点
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief サンプルの形式に合わせて量子化したしきい値
+ */
+// ----------------------------------------------------------------------------
+struct Level {
+	//! サンプルの種類
+	SampleKind kind;
+	//! 1サンプルのバイト数
+	size_t width;
+	//! 整数型のしきい値（8bitは128を引いた値に対するもの）
+	int32_t limit;
+	//! 浮動小数点型のしきい値
+	float flimit;
+};
+
+//! SIMDで一度に判定するバイト数
+const size_t BlockBytes = 64;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	形式としきい値から判定条件を作る
+ * @param[in]	bits		量子化ビット数
+ * @param[in]	pcm			整数型PCMなら真
+ * @param[in]	threshold	しきい値（振幅比）
+ * @return	判定条件
+ */
+// ----------------------------------------------------------------------------
+Level makeLevel(WORD bits, bool pcm, double threshold)
+{
+	Level lv;
+	lv.width = bits / 8;
+	lv.flimit = static_cast<float>(threshold);
+	lv.limit = 0;
+	if (!pcm) {
+		lv.kind = KIND_F32;
+		return lv;
+	}
+	lv.kind = (bits == 8) ? KIND_U8 : (bits == 16) ? KIND_S16 : (bits == 24) ? KIND_S24 : KIND_S32;
+	const double full = ::ldexp(1.0, bits - 1);
+	const double limit = ::floor(threshold * full);
+	lv.limit = static_cast<int32_t>((limit >= full - 1) ? full - 1 : limit);
+	return lv;
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	1サンプルがしきい値を超えるか判定する
+ * @param[in]	p	リトルエンディアンのサンプル
+ * @param[in]	lv	判定条件
+ * @return	しきい値を超えれば真
+ */
+// ----------------------------------------------------------------------------
+inline bool isLoud(const BYTE* p, const Level& lv)
+{
+	switch (lv.kind) {
+	case KIND_U8:
+		return ::abs(static_cast<int>(p[0]) - 128) > lv.limit;
+	case KIND_S16:
+		return ::abs(static_cast<int>(static_cast<short>(p[0] | (p[1] << 8)))) > lv.limit;
+	case KIND_S24: {
+		const int v = ((p[0] | (p[1] << 8) | (p[2] << 16)) ^ 0x800000) - 0x800000;
+		return ::abs(v) > lv.limit;
+	}
+	case KIND_S32: {
+		const uint32_t u = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+		const int64_t v = static_cast<int32_t>(u);
+		return ((v < 0) ? -v : v) > lv.limit;
+	}
+	default: {
+		const uint32_t u = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+		float f;
+		::memcpy(&f, &u, sizeof(f));
+		return ::fabs(f) > lv.flimit;
+	}
+	}
+}
+
+#if defined(SILENCESCANNER_USE_SSE)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	BlockBytesバイトのサンプル列にしきい値を超えるものがあるか判定する
+ *
+ * 24bit以外の形式に使う。
+ * @param[in]	p	リトルエンディアンのサンプル列
+ * @param[in]	lv	判定条件
+ * @return	しきい値を超えるサンプルがあれば真
+ */
+// ----------------------------------------------------------------------------
+inline bool anyLoud(const BYTE* p, const Level& lv)
+{
+	const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+	const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+	const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+	__m128i m;
+	switch (lv.kind) {
+	case KIND_U8: {
+		const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+		const __m128i hi = _mm_set1_epi8(static_cast<char>(lv.limit));
+		const __m128i lo = _mm_set1_epi8(static_cast<char>(-lv.limit));
+		const __m128i x0 = _mm_xor_si128(v0, bias), x1 = _mm_xor_si128(v1, bias);
+		const __m128i x2 = _mm_xor_si128(v2, bias), x3 = _mm_xor_si128(v3, bias);
+		m = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi8(x0, hi), _mm_cmplt_epi8(x0, lo)),
+			_mm_or_si128(_mm_cmpgt_epi8(x1, hi), _mm_cmplt_epi8(x1, lo)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpgt_epi8(x2, hi), _mm_cmplt_epi8(x2, lo)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpgt_epi8(x3, hi), _mm_cmplt_epi8(x3, lo)));
+		break;
+	}
+	case KIND_S16: {
+		const __m128i hi = _mm_set1_epi16(static_cast<short>(lv.limit));
+		const __m128i lo = _mm_set1_epi16(static_cast<short>(-lv.limit));
+		m = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi16(v0, hi), _mm_cmplt_epi16(v0, lo)),
+			_mm_or_si128(_mm_cmpgt_epi16(v1, hi), _mm_cmplt_epi16(v1, lo)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpgt_epi16(v2, hi), _mm_cmplt_epi16(v2, lo)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpgt_epi16(v3, hi), _mm_cmplt_epi16(v3, lo)));
+		break;
+	}
+	case KIND_S32: {
+		const __m128i hi = _mm_set1_epi32(lv.limit);
+		const __m128i lo = _mm_set1_epi32(-lv.limit);
+		m = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(v0, hi), _mm_cmplt_epi32(v0, lo)),
+			_mm_or_si128(_mm_cmpgt_epi32(v1, hi), _mm_cmplt_epi32(v1, lo)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpgt_epi32(v2, hi), _mm_cmplt_epi32(v2, lo)));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpgt_epi32(v3, hi), _mm_cmplt_epi32(v3, lo)));
+		break;
+	}
+	default: {
+		// 符号ビットを落とした絶対値で比較する（NaNは超えない扱い）
+		const __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		const __m128 limit = _mm_set1_ps(lv.flimit);
+		const __m128 c0 = _mm_cmpgt_ps(_mm_and_ps(_mm_castsi128_ps(v0), abs), limit);
+		const __m128 c1 = _mm_cmpgt_ps(_mm_and_ps(_mm_castsi128_ps(v1), abs), limit);
+		const __m128 c2 = _mm_cmpgt_ps(_mm_and_ps(_mm_castsi128_ps(v2), abs), limit);
+		const __m128 c3 = _mm_cmpgt_ps(_mm_and_ps(_mm_castsi128_ps(v3), abs), limit);
+		m = _mm_castps_si128(_mm_or_ps(_mm_or_ps(c0, c1), _mm_or_ps(c2, c3)));
+		break;
+	}
+	}
+	return _mm_movemask_epi8(m) != 0;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	しきい値を超える最初のサンプルを探す
+ * @param[in]	p		リトルエンディアンのサンプル列
+ * @param[in]	count	サンプル数
+ * @param[in]	lv		判定条件
+ * @return	最初のサンプルの番号。なければcount。
+ */
+// ----------------------------------------------------------------------------
+size_t firstLoud(const BYTE* p, size_t count, const Level& lv)
+{
+	const size_t bytes = count * lv.width;
+	size_t i = 0;
+#if defined(SILENCESCANNER_USE_SSE)
+	if (lv.kind != KIND_S24) {
+		for (; i + BlockBytes <= bytes; i += BlockBytes) {
+			if (anyLoud(p + i, lv)) {
+				break;
+			}
+		}
+	}
+#endif
+	for (; i < bytes; i += lv.width) {
+		if (isLoud(p + i, lv)) {
+			return i / lv.width;
+		}
+	}
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	しきい値を超える最後のサンプルを探す
+ * @param[in]	p		リトルエンディアンのサンプル列
+ * @param[in]	count	サンプル数
+ * @param[in]	lv		判定条件
+ * @return	最後のサンプルの番号に1を足した値。なければ0。
+ */
+// ----------------------------------------------------------------------------
+size_t lastLoud(const BYTE* p, size_t count, const Level& lv)
+{
+	const size_t bytes = count * lv.width;
+	size_t blocks = 0;
+#if defined(SILENCESCANNER_USE_SSE)
+	if (lv.kind != KIND_S24) {
+		blocks = bytes / BlockBytes * BlockBytes;
+	}
+#endif
+	// ブロックに満たない末尾から先に調べる
+	for (size_t i = bytes; i > blocks; i -= lv.width) {
+		if (isLoud(p + i - lv.width, lv)) {
+			return i / lv.width;
+		}
+	}
+#if defined(SILENCESCANNER_USE_SSE)
+	for (size_t j = blocks; j > 0; j -= BlockBytes) {
+		if (anyLoud(p + j - BlockBytes, lv)) {
+			for (size_t i = j; i > j - BlockBytes; i -= lv.width) {
+				if (isLoud(p + i - lv.width, lv)) {
+					return i / lv.width;
+				}
+			}
+		}
+	}
+#endif
+	return 0;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	コンストラクタ
+ */
+// ----------------------------------------------------------------------------
+SilenceScanner::SilenceScanner()
+: threshold_(0),
+  chunkFrames_(DefaultChunkFrames)
+{
+	setThreshold(DefaultThreshold);
+}
+// ----------------------------------------------------------------------------
+// ファイルを開きます。
+/**
+ * ヘッダーを解析した後は位置指定読み込みだけを使います。
+ *
+ * @param[in]	path	ファイルのパス
+ * @param[in]	cache	ヘッダーの解析結果のキャッシュ。nullptrなら毎回解析する。
+ * return	対応する形式のファイルを開ければ真
+ */
+// ----------------------------------------------------------------------------
+bool SilenceScanner::open(const tstring& path, HeaderCache* cache)
+{
+	file_.close();
+	const bool prepared = (cache != nullptr) ? cache->open(reader_, path)
+		: (reader_.open(path) && reader_.prepare());
+	if (!prepared || reader_.getChannels() == 0
+		|| !SampleConverter::isSupported(reader_.getBitPerSample(), reader_.getFormatTag() == 1)) {
+		reader_.close();
+		return false;
+	}
+	reader_.close();
+	return file_.openRead(path);
+}
+// ----------------------------------------------------------------------------
+// 無音とみなすしきい値を設定します。
+/**
+ * 全チャンネルのサンプルの絶対値がしきい値以下のフレームを無音とします。
+ * 整数型PCMではフルスケールに対する比を量子化した値以下を無音とします。
+ *
+ * @param[in]	dbfs	しきい値（dBFS）。既定はDefaultThreshold。0以上はフルスケール。
+ */
+// ----------------------------------------------------------------------------
+void SilenceScanner::setThreshold(double dbfs)
+{
+	threshold_ = (dbfs >= 0) ? 1.0 : ::pow(10.0, dbfs / 20.0);
+}
+// ----------------------------------------------------------------------------
+// フレーム列をファイル上の形式からリトルエンディアンに変換して読み込みます。
+/**
+ * @param[in]	first	先頭のフレーム位置
+ * @param[in]	frames	フレーム数
+ * @param[out]	buf		frames×nBlockAlignバイトを格納可能なバッファ
+ * @exception	WavIoException	ファイル未オープン、または読み込めない
+ */
+// ----------------------------------------------------------------------------
+void SilenceScanner::load(uint64_t first, size_t frames, void* buf) WAVE11_THROWS(WavIoException)
+{
+	const size_t align = reader_.getBlockAlign();
+	const size_t bytes = frames * align;
+	if (file_.readAt(buf, bytes, reader_.getStreamOffset() + first * align) != bytes) {
+		throw WavIoException("stream is truncated.");
+	}
+	reader_.decodeSamples(buf, frames * reader_.getChannels());
+}
+// ----------------------------------------------------------------------------
+// 先頭の無音の後の最初のフレーム位置を求めます。
+/**
+ * 先頭から読み込み単位ごとに読み込み、最初の有音のフレームで止めます。
+ *
+ * return	最初の有音のフレーム位置。全て無音ならgetFrames()。
+ * @exception	WavIoException	ファイル未オープン、または読み込めない
+ */
+// ----------------------------------------------------------------------------
+uint64_t SilenceScanner::findStart() WAVE11_THROWS(WavIoException)
+{
+	const uint64_t total = getFrames();
+	const WORD ch = getChannels();
+	const Level lv = makeLevel(reader_.getBitPerSample(), reader_.getFormatTag() == 1, threshold_);
+	PooledBuffer buf(chunkFrames_ * reader_.getBlockAlign());
+	for (uint64_t pos = 0; pos < total; ) {
+		const size_t n = (total - pos < chunkFrames_) ? static_cast<size_t>(total - pos) : chunkFrames_;
+		load(pos, n, buf.data());
+		const size_t i = firstLoud(buf.as<BYTE>(), n * ch, lv);
+		if (i < n * ch) {
+			return pos + i / ch;
+		}
+		pos += n;
+	}
+	return total;
+}
+// ----------------------------------------------------------------------------
+// 末尾の無音の直前までのフレーム数を求めます。
+/**
+ * 末尾から読み込み単位ごとに遡って読み込み、最後の有音のフレームで止めます。
+ *
+ * return	最後の有音のフレーム位置に1を足した値。全て無音なら0。
+ * @exception	WavIoException	ファイル未オープン、または読み込めない
+ */
+// ----------------------------------------------------------------------------
+uint64_t SilenceScanner::findEnd() WAVE11_THROWS(WavIoException)
+{
+	const WORD ch = getChannels();
+	const Level lv = makeLevel(reader_.getBitPerSample(), reader_.getFormatTag() == 1, threshold_);
+	PooledBuffer buf(chunkFrames_ * reader_.getBlockAlign());
+	for (uint64_t end = getFrames(); end > 0; ) {
+		const size_t n = (end < chunkFrames_) ? static_cast<size_t>(end) : chunkFrames_;
+		load(end - n, n, buf.data());
+		const size_t i = lastLoud(buf.as<BYTE>(), n * ch, lv);
+		if (i > 0) {
+			return end - n + (i - 1) / ch + 1;
+		}
+		end -= n;
+	}
+	return 0;
+}
+// ----------------------------------------------------------------------------
+// 前後の無音を除いた区間を求めます。
+/**
+ * 両端から位置指定読み込みで探すため、読み込むのは前後の無音と境界のブロックだけです。
+ *
+ * return	有音の区間。全て無音ならフレーム数0。
+ * @exception	WavIoException	ファイル未オープン、または読み込めない
+ */
+// ----------------------------------------------------------------------------
+FrameSegment SilenceScanner::findTrim() WAVE11_THROWS(WavIoException)
+{
+	FrameSegment seg = { 0, 0 };
+	seg.first = findStart();
+	if (seg.first < getFrames()) {
+		seg.frames = findEnd() - seg.first;
+	} else {
+		seg.first = 0;
+	}
+	return seg;
+}
+// ----------------------------------------------------------------------------
+// 指定フレーム数以上続く無音区間を求めます。
+/**
+ * 先頭から末尾まで読み込みます。先頭と末尾の無音も含みます。
+ * 有音の部分は最小のフレーム数ずつ末尾側から調べて読み飛ばします。
+ *
+ * @param[in]	minFrames	無音区間とみなす最小のフレーム数
+ * @param[out]	segments	無音区間（位置の昇順）
+ * return	無音区間の数
+ * @exception	WavIoException	ファイル未オープン、または読み込めない
+ */
+// ----------------------------------------------------------------------------
+size_t SilenceScanner::findSilence(uint64_t minFrames, std::vector<FrameSegment>& segments) WAVE11_THROWS(WavIoException)
+{
+	segments.clear();
+	if (minFrames == 0) {
+		minFrames = 1;
+	}
+	const uint64_t total = getFrames();
+	const WORD ch = getChannels();
+	const size_t width = reader_.getBlockAlign() / ch;
+	const Level lv = makeLevel(reader_.getBitPerSample(), reader_.getFormatTag() == 1, threshold_);
+	PooledBuffer buf(chunkFrames_ * reader_.getBlockAlign());
+	// 現在の無音区間の先頭
+	uint64_t run = 0;
+	for (uint64_t pos = 0; pos < total; ) {
+		const size_t n = (total - pos < chunkFrames_) ? static_cast<size_t>(total - pos) : chunkFrames_;
+		load(pos, n, buf.data());
+		size_t f = static_cast<size_t>((run > pos) ? run - pos : 0);
+		while (f < n) {
+			// 無音区間がminFramesに達するまでの窓に有音があれば、その最後の次からやり直す
+			if (run + minFrames > pos + f) {
+				const size_t end = (run + minFrames - pos < n) ? static_cast<size_t>(run + minFrames - pos) : n;
+				const size_t j = lastLoud(buf.as<BYTE>() + f * ch * width, (end - f) * ch, lv);
+				if (j > 0) {
+					f += (j - 1) / ch + 1;
+					run = pos + f;
+					continue;
+				}
+				f = end;
+				if (f == n) {
+					break;
+				}
+			}
+			// minFrames以上続いた無音の終わりを探す
+			const size_t i = firstLoud(buf.as<BYTE>() + f * ch * width, (n - f) * ch, lv);
+			if (i == (n - f) * ch) {
+				break;
+			}
+			f += i / ch;
+			FrameSegment seg = { run, pos + f - run };
+			segments.push_back(seg);
+			run = pos + ++f;
+		}
+		pos += n;
+	}
+	if (run < total && total - run >= minFrames) {
+		FrameSegment seg = { run, total - run };
+		segments.push_back(seg);
+	}
+	return segments.size();
+}
+// ----------------------------------------------------------------------------
+// 指定フレーム数以上続く無音区間で区切った有音区間を求めます。
+/**
+ * findSilenceで求めた無音区間の間の区間を返します。
+ *
+ * @param[in]	minFrames	区切りとみなす無音の最小のフレーム数
+ * @param[out]	segments	有音区間（位置の昇順）
+ * return	有音区間の数
+ * @exception	WavIoException	ファイル未オープン、または読み込めない
+ */
+// ----------------------------------------------------------------------------
+size_t SilenceScanner::findSound(uint64_t minFrames, std::vector<FrameSegment>& segments) WAVE11_THROWS(WavIoException)
+{
+	std::vector<FrameSegment> gaps;
+	findSilence(minFrames, gaps);
+	segments.clear();
+	uint64_t pos = 0;
+	for (size_t i = 0; i < gaps.size(); i++) {
+		if (gaps[i].first > pos) {
+			FrameSegment seg = { pos, gaps[i].first - pos };
+			segments.push_back(seg);
+		}
+		pos = gaps[i].first + gaps[i].frames;
+	}
+	if (pos < getFrames()) {
+		FrameSegment seg = { pos, getFrames() - pos };
+		segments.push_back(seg);
+	}
+	return segments.size();
+}
+// ----------------------------------------------------------------------------
+// 区間を同じ形式のファイルに書き出します。
+/**
+ * 入力と同じコンテナ・量子化ビット数・チャンネル数・サンプリングレートで書き出します。
+ * サンプル列は変換せずRiffWavWriter::copySamplesで複写するため、Linuxでは
+ * ユーザー空間を経由しません。区間はファイルの範囲に切り詰めます。
+ *
+ * @param[in]	path	出力ファイルのパス
+ * @param[in]	seg		書き出す区間
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool SilenceScanner::writeSegment(const tstring& path, const FrameSegment& seg)
+{
+	const uint64_t total = getFrames();
+	const uint64_t first = (seg.first < total) ? seg.first : total;
+	const uint64_t frames = (seg.frames < total - first) ? seg.frames : total - first;
+	const bool pcm = (reader_.getFormatTag() == 1);
+	// AIFFは浮動小数点を格納できないためAIFF-C（入力もAIFF-C）
+	const WavContainer container = (reader_.getContainer() == CONTAINER_AIFF && !pcm)
+		? CONTAINER_AIFC : reader_.getContainer();
+
+	RiffWavWriter writer(reader_.getBitPerSample(), reader_.getChannels(), reader_.getSamplesPerSec(), pcm);
+	writer.setContainer(container);
+	writer.setSowt(!reader_.isBigEndian());
+	if (writer.isBigEndian() != reader_.isBigEndian() || !file_.isOpen()) {
+		return false;
+	}
+	try {
+		if (!writer.open(path) || !writer.prepare()) {
+			return false;
+		}
+		const uint64_t bytes = frames * reader_.getBlockAlign();
+		if (writer.copySamples(file_, reader_.getStreamOffset() + first * reader_.getBlockAlign(), bytes) != bytes) {
+			return false;
+		}
+		if (!writer.riffFinalize()) {
+			return false;
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	writer.close();
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 前後の無音を除いてファイルに書き出します。
+/**
+ * findTrimの区間をwriteSegmentで書き出します。全て無音なら空のファイルになります。
+ *
+ * @param[in]	path	出力ファイルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool SilenceScanner::writeTrimmed(const tstring& path)
+{
+	FrameSegment seg;
+	try {
+		seg = findTrim();
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return writeSegment(path, seg);
+}
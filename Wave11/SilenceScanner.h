@@ -0,0 +1,130 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SilenceScanner.h
+ * @brief	無音区間の検出と前後の無音の除去を行うクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _SILENCESCANNER_H_
+#define _SILENCESCANNER_H_
+
+#include <cstdint>
+#include <vector>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "PositionalFile.h"
+#include "RiffWavReader.h"
+
+class HeaderCache;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief フレーム単位の区間
+ */
+// ----------------------------------------------------------------------------
+struct FrameSegment {
+	//! 先頭のフレーム位置
+	uint64_t first;
+	//! フレーム数
+	uint64_t frames;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 無音区間の検出クラス
+ *
+ * 全チャンネルのサンプルの絶対値がしきい値以下のフレームを無音とする。
+ * サンプルは32bit floatに変換せず、ファイル上の整数型・浮動小数点型のまま
+ * しきい値を量子化した値とSIMDで比較する。
+ *
+ * 前後の無音は両端から位置指定読み込みで探すため、長いファイルでも
+ * 読み込むのは無音の部分と境界のブロックだけで済む。
+ * 対応する形式はSampleConverter::isSupportedが真となるもの。
+ * このクラスはスレッドセーフではない。
+ */
+// ----------------------------------------------------------------------------
+class SilenceScanner : private Noncopyable
+{
+public:
+	//! 既定のしきい値（dBFS）
+	static const int DefaultThreshold = -60;
+	//! 既定の読み込み単位（フレーム数）
+	static const size_t DefaultChunkFrames = 65536;
+
+	SilenceScanner();
+	virtual ~SilenceScanner() {}
+
+	//! ファイルを開きます。
+	bool open(const tstring&, HeaderCache* = nullptr);
+	//! ファイルを閉じます。
+	void close() { file_.close(); }
+	//! 無音とみなすしきい値を設定します。
+	void setThreshold(double);
+	/**
+	 * @brief	読み込み単位を設定する
+	 * @param[in]	frames	1回の位置指定読み込みのフレーム数
+	 */
+	void setChunkFrames(size_t frames) { chunkFrames_ = (frames == 0) ? 1 : frames; }
+	/**
+	 * @brief	チャンネル数を取得する
+	 * @return	チャンネル数
+	 */
+	WORD getChannels() const { return reader_.getChannels(); }
+	/**
+	 * @brief	フレーム数を取得する
+	 * @return	読み込み可能なフレーム数
+	 */
+	uint64_t getFrames() const { return reader_.getFrames(); }
+
+	//! 先頭の無音の後の最初のフレーム位置を求めます。
+	uint64_t findStart() WAVE11_THROWS(WavIoException);
+	//! 末尾の無音の直前までのフレーム数を求めます。
+	uint64_t findEnd() WAVE11_THROWS(WavIoException);
+	//! 前後の無音を除いた区間を求めます。
+	FrameSegment findTrim() WAVE11_THROWS(WavIoException);
+	//! 指定フレーム数以上続く無音区間を求めます。
+	size_t findSilence(uint64_t, std::vector<FrameSegment>&) WAVE11_THROWS(WavIoException);
+	//! 指定フレーム数以上続く無音区間で区切った有音区間を求めます。
+	size_t findSound(uint64_t, std::vector<FrameSegment>&) WAVE11_THROWS(WavIoException);
+	//! 区間を同じ形式のファイルに書き出します。
+	bool writeSegment(const tstring&, const FrameSegment&);
+	//! 前後の無音を除いてファイルに書き出します。
+	bool writeTrimmed(const tstring&);
+
+private:
+	//! 形式の判定とサンプル列の変換に使う読み込みクラス（ファイルは閉じている）
+	RiffWavReader reader_;
+	//! 位置指定読み込み用のファイル
+	PositionalFile file_;
+	//! 無音とみなすしきい値（振幅比）
+	double threshold_;
+	//! 1回の読み込みのフレーム数
+	size_t chunkFrames_;
+
+	//! フレーム列をファイル上の形式からリトルエンディアンに変換して読み込みます。
+	void load(uint64_t, size_t, void*) WAVE11_THROWS(WavIoException);
+};
+
+#endif // !_SILENCESCANNER_H_
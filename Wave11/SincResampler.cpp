@@ -0,0 +1,213 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SincResampler.cpp
+ * @brief	窓付きsinc補間によるサンプリングレート変換クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "SincResampler.h"
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+namespace {
+
+//! 係数表の最大要素数
+const size_t MaxTableSize = 1 << 20;
+
+uint64_t gcd(uint64_t a, uint64_t b) {
+	while (b != 0) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @param[in]	inFs			入力のサンプリングレート
+ * @param[in]	outFs			出力のサンプリングレート
+ * @param[in]	zeroCrossings	片側のsincの零交差数。大きいほど急峻で重い。
+ * @exception	WavIoException	パラメータ異常
+ */
+// ----------------------------------------------------------------------------
+SincResampler::SincResampler(DWORD inFs, DWORD outFs, int zeroCrossings)
+: phases_(1),
+  step_(1),
+  cutoff_(1.0),
+  halfTaps_(zeroCrossings)
+{
+	if (inFs == 0 || outFs == 0 || zeroCrossings <= 0) {
+		throw WavIoException("invalid resampler parameter.");
+	}
+	uint64_t g = gcd(inFs, outFs);
+	phases_ = outFs / g;
+	step_ = inFs / g;
+	// ダウンサンプリング時は出力のナイキスト周波数で帯域制限する
+	if (outFs < inFs) {
+		cutoff_ = static_cast<double>(outFs) / static_cast<double>(inFs);
+	}
+	halfTaps_ = static_cast<int>(::ceil(zeroCrossings / cutoff_));
+
+	const size_t taps = static_cast<size_t>(halfTaps_) * 2;
+	if (phases_ * taps <= MaxTableSize) {
+		table_.resize(static_cast<size_t>(phases_) * taps);
+		for (uint64_t p = 0; p < phases_; p++) {
+			weights(p, &table_[static_cast<size_t>(p) * taps]);
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// 入力フレーム数に対応する出力フレーム数を求めます。
+/**
+ * @param[in]	inFrames	入力フレーム数
+ * @return	出力フレーム数（切り上げ）
+ */
+// ----------------------------------------------------------------------------
+uint64_t SincResampler::outputFrames(uint64_t inFrames) const
+{
+	return (inFrames * phases_ + step_ - 1) / step_;
+}
+// ----------------------------------------------------------------------------
+// 出力区間の計算に必要な入力区間を求めます。
+/**
+ * @param[in]	outStart	出力区間の先頭フレーム
+ * @param[in]	outCount	出力区間のフレーム数
+ * @param[in]	inTotal		入力の総フレーム数
+ * @param[out]	first		必要な入力区間の先頭フレーム
+ * @param[out]	count		必要な入力区間のフレーム数
+ */
+// ----------------------------------------------------------------------------
+void SincResampler::inputRange(uint64_t outStart, size_t outCount, uint64_t inTotal,
+	uint64_t& first, size_t& count) const
+{
+	first = 0;
+	count = 0;
+	if (outCount == 0 || inTotal == 0) {
+		return;
+	}
+	uint64_t lo = outStart * step_ / phases_;
+	uint64_t hi = (outStart + outCount - 1) * step_ / phases_ + halfTaps_;
+	lo = (lo + 1 > static_cast<uint64_t>(halfTaps_)) ? lo + 1 - halfTaps_ : 0;
+	if (hi >= inTotal) hi = inTotal - 1;
+	if (lo > hi) {
+		return;
+	}
+	first = lo;
+	count = static_cast<size_t>(hi - lo + 1);
+}
+// ----------------------------------------------------------------------------
+// 出力区間を計算します。
+/**
+ * 入力はinputRangeで求めた区間を含んでいる必要があります。
+ * 入力の範囲外（負の位置と総フレーム数以降）は0として扱います。
+ *
+ * @param[in]	in			インターリーブされた入力
+ * @param[in]	inFirst		inの先頭フレームの位置
+ * @param[in]	inCount		inのフレーム数
+ * @param[in]	inTotal		入力の総フレーム数
+ * @param[in]	ch			チャンネル数
+ * @param[out]	out			インターリーブされた出力
+ * @param[in]	outStart	出力区間の先頭フレーム
+ * @param[in]	outCount	出力区間のフレーム数
+ */
+// ----------------------------------------------------------------------------
+void SincResampler::process(const float* in, uint64_t inFirst, size_t inCount, uint64_t inTotal,
+	WORD ch, float* out, uint64_t outStart, size_t outCount) const
+{
+	const size_t taps = static_cast<size_t>(halfTaps_) * 2;
+	std::vector<float> local(table_.empty() ? taps : 0);
+	const uint64_t inEnd = (inFirst + inCount < inTotal) ? inFirst + inCount : inTotal;
+
+	for (size_t n = 0; n < outCount; n++) {
+		const uint64_t num = (outStart + n) * step_;
+		const uint64_t ipos = num / phases_;
+		const uint64_t phase = num % phases_;
+		const float* w;
+		if (table_.empty()) {
+			weights(phase, &local[0]);
+			w = &local[0];
+		} else {
+			w = &table_[static_cast<size_t>(phase) * taps];
+		}
+
+		// 係数wのk番目は入力位置 ipos - halfTaps + 1 + k に対応する
+		float* dst = out + n * ch;
+		for (WORD c = 0; c < ch; c++) {
+			dst[c] = 0.f;
+		}
+		for (size_t k = 0; k < taps; k++) {
+			int64_t i = static_cast<int64_t>(ipos) - halfTaps_ + 1 + static_cast<int64_t>(k);
+			if (i < static_cast<int64_t>(inFirst) || i >= static_cast<int64_t>(inEnd)) {
+				continue;
+			}
+			const float* src = in + static_cast<size_t>(i - static_cast<int64_t>(inFirst)) * ch;
+			for (WORD c = 0; c < ch; c++) {
+				dst[c] += src[c] * w[k];
+			}
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// 指定位相の係数を計算します。
+/**
+ * ブラックマン窓を掛けたsinc関数の係数を、直流利得が1になるよう正規化します。
+ *
+ * @param[in]	phase	位相（0～位相数-1）
+ * @param[out]	w		片側タップ数×2個の係数
+ */
+// ----------------------------------------------------------------------------
+void SincResampler::weights(uint64_t phase, float* w) const
+{
+	const double frac = static_cast<double>(phase) / static_cast<double>(phases_);
+	const int taps = halfTaps_ * 2;
+	double sum = 0.0;
+	for (int k = 0; k < taps; k++) {
+		// 補間位置からの距離（入力サンプル単位）
+		double t = static_cast<double>(k - halfTaps_ + 1) - frac;
+		double v = 0.0;
+		if (::fabs(t) < halfTaps_) {
+			double x = cutoff_ * t;
+			double sinc = (x == 0.0) ? 1.0 : ::sin(M_PI * x) / (M_PI * x);
+			double r = t / halfTaps_;
+			double win = 0.42 + 0.5 * ::cos(M_PI * r) + 0.08 * ::cos(2.0 * M_PI * r);
+			v = cutoff_ * sinc * win;
+		}
+		w[k] = static_cast<float>(v);
+		sum += v;
+	}
+	// 出力先で正規化し、サンプルごとの一時領域を確保しない
+	if (sum != 0.0) {
+		const double scale = 1.0 / sum;
+		for (int k = 0; k < taps; k++) {
+			w[k] = static_cast<float>(w[k] * scale);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	SincResampler.h
+ * @brief	窓付きsinc補間によるサンプリングレート変換クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _SINCRESAMPLER_H_
+#define _SINCRESAMPLER_H_
+
+#include <cstdint>
+#include <vector>
+#include "WavIoType.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 窓付きsinc補間によるサンプリングレート変換クラス
+ *
+ * 出力サンプルnは入力の位置 n * 入力レート / 出力レート の周辺のサンプルだけから
+ * 計算され、内部状態を持たない。そのため出力を任意の区間に分割して別々に
+ * 計算しても、一括で計算した結果とビット単位で一致する。
+ *
+ * レート比を既約分数にした分母（位相数）が小さい場合は係数表を事前計算する。
+ * processはconstであり、複数スレッドから同時に呼び出してよい。
+ */
+// ----------------------------------------------------------------------------
+class SincResampler
+{
+public:
+	SincResampler(DWORD, DWORD, int = 16);
+	virtual ~SincResampler() {}
+
+	//! 入力フレーム数に対応する出力フレーム数を求めます。
+	uint64_t outputFrames(uint64_t) const;
+	//! 出力区間の計算に必要な入力区間を求めます。
+	void inputRange(uint64_t, size_t, uint64_t, uint64_t&, size_t&) const;
+	//! 出力区間を計算します。
+	void process(const float*, uint64_t, size_t, uint64_t, WORD, float*, uint64_t, size_t) const;
+
+private:
+	//! 位相数（出力レート/gcd）
+	uint64_t phases_;
+	//! 入力ステップ（入力レート/gcd）
+	uint64_t step_;
+	//! 入力ナイキスト周波数に対する遮断周波数の比
+	double cutoff_;
+	//! 片側のタップ数
+	int halfTaps_;
+	//! 位相ごとの係数表。空なら都度計算する。
+	std::vector<float> table_;
+
+	//! 指定位相の係数を計算します。
+	void weights(uint64_t, float*) const;
+
+	SincResampler();
+};
+
+#endif // !_SINCRESAMPLER_H_
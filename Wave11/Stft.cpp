@@ -0,0 +1,439 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Stft.cpp
+ * @brief	短時間フーリエ変換（スペクトログラム）解析クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "Stft.h"
+#include <cmath>
+#include <algorithm>
+#include "SampleConverter.h"
+#include "BufferPool.h"
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+// ----------------------------------------------------------------------------
+/**
+ * @param[in]	fftSize	FFT点数
+ * @param[in]	hop		ホップ長
+ * @param[in]	fs		解析対象のサンプリングレート
+ */
+// ----------------------------------------------------------------------------
+StftFileWriter::StftFileWriter(DWORD fftSize, DWORD hop, DWORD fs)
+: BinaryWriter(),
+  fftSize_(fftSize),
+  hop_(hop),
+  fs_(fs),
+  frames_(0)
+{
+}
+// ----------------------------------------------------------------------------
+// ヘッダーの書き出しを行います。
+/**
+ * フレーム数を0としたヘッダーを書き出します。\n
+ * フレームの書き出し前に実行する必要があります。
+ *
+ * return	書き出しに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool StftFileWriter::prepare()
+{
+	const char magic[] = { 'S', 'T', 'F', 'T' };
+
+	frames_ = 0;
+	try {
+		if (this->writeBytes(magic, 4) != 4) {
+			return false;
+		}
+		this->writeWORD(1);		// バージョン
+		this->writeWORD(1);		// 16bit dB
+		this->writeDWORD(fftSize_);
+		this->writeDWORD(hop_);
+		this->writeDWORD(fftSize_ / 2 + 1);
+		this->writeDWORD(fs_);
+		this->writeDWORD(0);
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 1フレーム分を書き出します。
+/**
+ * 振幅をdB値に変換し、1/256dB刻みの16bit値に量子化して書き出します。
+ *
+ * @param[in]	mag		振幅スペクトル
+ * @param[in]	bins	ビン数
+ * return	書き出しに成功すれば真
+ */
+// ----------------------------------------------------------------------------
+bool StftFileWriter::onFrame(const float* mag, size_t bins)
+{
+	if (bins != fftSize_ / 2 + 1) {
+		return false;
+	}
+	packed_.resize(bins * 2);
+	for (size_t k = 0; k < bins; k++) {
+		double db = 20.0 * ::log10(static_cast<double>(mag[k]) + 1e-30);
+		double q = ::floor((db - STFT_DB_FLOOR) * 256.0 + 0.5);
+		WORD v = static_cast<WORD>(q < 0.0 ? 0.0 : (q > 65535.0 ? 65535.0 : q));
+		toBytes(&packed_[k * 2], v);
+	}
+	try {
+		if (this->writeBytes(&packed_[0], packed_.size()) != packed_.size()) {
+			return false;
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	frames_++;
+	return true;
+}
+// ----------------------------------------------------------------------------
+// フレーム数を確定して書き出しを終了します。
+/**
+ * ヘッダーのフレーム数を書き込みます。
+ *
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool StftFileWriter::finalize()
+{
+	try {
+		if (!this->seek(24, SEEK_SET)) {
+			return false;
+		}
+		this->writeDWORD(frames_);
+		if (!this->seek(0, SEEK_END)) {
+			return false;
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// ヘッダーを読み込み、フレーム読み込みの準備を行います。
+/**
+ * return	正常終了で真。STFTファイルでない場合は偽となる。
+ */
+// ----------------------------------------------------------------------------
+bool StftFileReader::prepare()
+{
+	if (!this->seek(0, SEEK_SET)) {
+		return false;
+	}
+	try {
+		char buf[4];
+		if (this->readBytes(buf, 4) != 4 || strncmp(buf, "STFT", 4) != 0) {
+			return false;
+		}
+		WORD version = this->readWORD();
+		WORD encoding = this->readWORD();
+		if (version != 1 || encoding != 1) {
+			return false;
+		}
+		fftSize_ = this->readDWORD();
+		hop_ = this->readDWORD();
+		bins_ = this->readDWORD();
+		fs_ = this->readDWORD();
+		frames_ = this->readDWORD();
+	} catch (const WavIoException&) {
+		return false;
+	}
+	if (bins_ != fftSize_ / 2 + 1) {
+		return false;
+	}
+	packed_.resize(bins_ * 2);
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 1フレーム分のdB値を読み込みます。
+/**
+ * @param[out]	db	ビン数分のdB値を格納するバッファ
+ * return	読み込めれば真。終端に到達していれば偽。
+ */
+// ----------------------------------------------------------------------------
+bool StftFileReader::readFrame(float* db)
+{
+	if (db == nullptr || packed_.empty()) {
+		return false;
+	}
+	try {
+		if (this->readBytes(&packed_[0], packed_.size()) != packed_.size()) {
+			return false;
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	for (DWORD k = 0; k < bins_; k++) {
+		db[k] = static_cast<float>(toWORD(&packed_[k * 2]) / 256.0 + STFT_DB_FLOOR);
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+/**
+ * 窓関数の係数とスレッドごとのFFTを準備します。
+ *
+ * @param[in]	fftSize	FFT点数。4以上の2のべき乗。
+ * @param[in]	hop		ホップ長。1以上FFT点数以下。
+ * @param[in]	window	窓関数の種類
+ * @param[in]	pool	フレームの並列変換に使うスレッドプール。nullptrなら逐次処理。
+ * @exception	WavIoException	パラメータ異常
+ */
+// ----------------------------------------------------------------------------
+StftAnalyzer::StftAnalyzer(size_t fftSize, size_t hop, StftWindow window, ThreadPool* pool)
+: fftSize_(fftSize),
+  hop_(hop),
+  window_(fftSize),
+  pool_(pool),
+  covered_(0),
+  frames_(0)
+{
+	if (hop == 0 || hop > fftSize) {
+		throw WavIoException("invalid STFT hop size.");
+	}
+
+	for (size_t i = 0; i < fftSize; i++) {
+		double x = 2.0 * M_PI * static_cast<double>(i) / static_cast<double>(fftSize);
+		double w = 1.0;
+		switch (window) {
+		case STFT_WINDOW_HANN:
+			w = 0.5 - 0.5 * ::cos(x);
+			break;
+		case STFT_WINDOW_HAMMING:
+			w = 0.54 - 0.46 * ::cos(x);
+			break;
+		case STFT_WINDOW_BLACKMAN:
+			w = 0.42 - 0.5 * ::cos(x) + 0.08 * ::cos(2.0 * x);
+			break;
+		default:
+			break;
+		}
+		window_[i] = static_cast<float>(w);
+	}
+
+	size_t slots = (pool_ != nullptr) ? pool_->size() + 1 : 1;
+	for (size_t i = 0; i < slots; i++) {
+		ffts_.push_back(std::unique_ptr<RealFft>(new RealFft(fftSize)));
+		frameBufs_.push_back(std::vector<float>(fftSize));
+	}
+}
+// ----------------------------------------------------------------------------
+// 内部状態を初期化します。
+/**
+ * 未処理の信号を破棄し、出力フレーム数を0に戻します。
+ */
+// ----------------------------------------------------------------------------
+void StftAnalyzer::reset()
+{
+	buffer_.clear();
+	covered_ = 0;
+	frames_ = 0;
+}
+// ----------------------------------------------------------------------------
+// モノラル信号を追加し、揃ったフレームを出力します。
+/**
+ * 出力先が偽を返した場合、受け付けられなかったフレームの信号は保持し、
+ * 次のpushまたはflushで出力し直します。
+ *
+ * @param[in]	samples	モノラル信号
+ * @param[in]	count	サンプル数
+ * @param[in]	sink	出力先
+ * return	出力先が全フレームを受け付ければ真
+ */
+// ----------------------------------------------------------------------------
+bool StftAnalyzer::push(const float* samples, size_t count, StftSink& sink)
+{
+	if (samples == nullptr || count == 0) {
+		return true;
+	}
+	buffer_.insert(buffer_.end(), samples, samples + count);
+	return drain(sink);
+}
+// ----------------------------------------------------------------------------
+// 未出力の信号をゼロ詰めして出力します。
+/**
+ * どのフレームにも含まれていないサンプルが残っていれば、
+ * ゼロ詰めした最終フレームを出力します。
+ *
+ * @param[in]	sink	出力先
+ * return	出力先が全フレームを受け付ければ真
+ */
+// ----------------------------------------------------------------------------
+bool StftAnalyzer::flush(StftSink& sink)
+{
+	// 中断で残った揃ったフレームを先に出力する
+	if (!drain(sink)) {
+		return false;
+	}
+	if (buffer_.size() <= covered_) {
+		buffer_.clear();
+		covered_ = 0;
+		return true;
+	}
+	const size_t size = buffer_.size();
+	buffer_.resize(fftSize_, 0.f);
+	if (!drain(sink)) {
+		// 受け付けられなかった場合はゼロ詰めを取り消し、再度flushできるようにする
+		buffer_.resize(size);
+		return false;
+	}
+	buffer_.clear();
+	covered_ = 0;
+	return true;
+}
+// ----------------------------------------------------------------------------
+// バッファ中の揃ったフレームを全て出力します。
+/**
+ * スレッドプールがあれば一定数のフレームをまとめて並列に変換し、
+ * 時間順に出力先へ渡します。出力先が受け付けたフレームの分だけ信号を捨てるため、
+ * 中断した後に続けて追加すれば、受け付けられなかったフレームから出力し直します。
+ *
+ * @param[in]	sink	出力先
+ * return	出力先が全フレームを受け付ければ真
+ */
+// ----------------------------------------------------------------------------
+bool StftAnalyzer::drain(StftSink& sink)
+{
+	if (buffer_.size() < fftSize_) {
+		return true;
+	}
+	const size_t total = (buffer_.size() - fftSize_) / hop_ + 1;
+	const size_t nbins = bins();
+	const size_t slots = ffts_.size();
+	// 一度に変換するフレーム数。出力の一時領域の大きさを抑える。
+	const size_t batch = slots * 16;
+
+	bool ret = true;
+	// 出力先が受け付けたフレーム数
+	size_t accepted = 0;
+	for (size_t base = 0; base < total && ret; base += batch) {
+		const size_t n = std::min(batch, total - base);
+		out_.resize(n * nbins);
+
+		auto work = [&](size_t slot) {
+			RealFft& fft = *ffts_[slot];
+			float* frame = &frameBufs_[slot][0];
+			const size_t stride = (pool_ != nullptr && n > 1) ? std::min(slots, n) : 1;
+			for (size_t f = slot; f < n; f += stride) {
+				const float* src = &buffer_[(base + f) * hop_];
+				for (size_t i = 0; i < fftSize_; i++) {
+					frame[i] = src[i] * window_[i];
+				}
+				fft.magnitude(frame, &out_[f * nbins]);
+			}
+		};
+		if (pool_ != nullptr && n > 1) {
+			pool_->parallelFor(std::min(slots, n), work);
+		} else {
+			work(0);
+		}
+
+		for (size_t f = 0; f < n; f++) {
+			if (!sink.onFrame(&out_[f * nbins], nbins)) {
+				ret = false;
+				break;
+			}
+			frames_++;
+			accepted++;
+		}
+	}
+
+	if (accepted > 0) {
+		buffer_.erase(buffer_.begin(), buffer_.begin() + accepted * hop_);
+		covered_ = std::min(buffer_.size(), fftSize_ - hop_);
+	}
+	return ret;
+}
+// ----------------------------------------------------------------------------
+// RIFF-WAVファイルのストリーム全体を解析します。
+/**
+ * prepare済みのリーダーからストリームを一定サイズずつ読み込み、
+ * モノラル化してSTFTを行います。最後にflushまで行います。\n
+ * 読み込みはストリーム先頭から行われている前提です。
+ *
+ * @param[in]	reader	prepare済みのリーダー
+ * @param[in]	sink	出力先
+ * @param[in]	channel	解析するチャンネル番号。負数なら全チャンネルの平均。
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool StftAnalyzer::analyze(RiffWavReader& reader, StftSink& sink, int channel)
+{
+	const WORD ch = reader.getChannels();
+	const WORD bits = reader.getBitPerSample();
+	const bool pcm = (reader.getFormatTag() == 1);
+	const size_t frameBytes = reader.getBlockAlign();
+	if (ch == 0 || frameBytes == 0 || !SampleConverter::isSupported(bits, pcm)
+		|| channel >= static_cast<int>(ch)) {
+		return false;
+	}
+
+	const size_t blockFrames = 4096;
+	PooledBuffer rawBuf(blockFrames * frameBytes);
+	PooledBuffer interleavedBuf(blockFrames * ch * sizeof(float));
+	PooledBuffer monoBuf(blockFrames * sizeof(float));
+	BYTE* raw = rawBuf.as<BYTE>();
+	float* interleaved = interleavedBuf.as<float>();
+	float* mono = monoBuf.as<float>();
+
+	size_t remaining = reader.getLength() / frameBytes;
+	while (remaining > 0) {
+		size_t want = std::min(blockFrames, remaining);
+		size_t got = 0;
+		if (reader.getStream(raw, want * frameBytes, got) < 0) {
+			return false;
+		}
+		size_t frames = got / frameBytes;
+		if (frames == 0) {
+			break;
+		}
+		remaining -= frames;
+
+		SampleConverter::toFloat(raw, interleaved, frames * ch, bits, pcm);
+		if (channel >= 0) {
+			for (size_t i = 0; i < frames; i++) {
+				mono[i] = interleaved[i * ch + channel];
+			}
+		} else {
+			const float scale = 1.f / ch;
+			for (size_t i = 0; i < frames; i++) {
+				float sum = 0.f;
+				for (WORD c = 0; c < ch; c++) {
+					sum += interleaved[i * ch + c];
+				}
+				mono[i] = sum * scale;
+			}
+		}
+		if (!push(mono, frames, sink)) {
+			return false;
+		}
+	}
+	return flush(sink);
+}
@@ -0,0 +1,282 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	Stft.h
+ * @brief	短時間フーリエ変換（スペクトログラム）解析クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _STFT_H_
+#define _STFT_H_
+
+#include <vector>
+#include <memory>
+#include "RealFft.h"
+#include "RiffWavReader.h"
+#include "BinaryReader.h"
+#include "BinaryWriter.h"
+#include "ThreadPool.h"
+
+//! STFTファイルに記録できるdB値の下限
+#define STFT_DB_FLOOR	(-160.0)
+
+//! 窓関数の種類
+enum StftWindow {
+	STFT_WINDOW_RECTANGULAR,	//!< 矩形窓
+	STFT_WINDOW_HANN,			//!< ハン窓
+	STFT_WINDOW_HAMMING,		//!< ハミング窓
+	STFT_WINDOW_BLACKMAN		//!< ブラックマン窓
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief STFTの出力先IF
+ *
+ * フレームは時間順に1フレームずつ渡される。
+ */
+// ----------------------------------------------------------------------------
+class StftSink
+{
+public:
+	virtual ~StftSink() {}
+	/**
+	 * @brief	1フレーム分の振幅スペクトルを受け取る
+	 * @param[in]	mag		振幅スペクトル
+	 * @param[in]	bins	ビン数
+	 * @return	処理を継続する場合は真
+	 */
+	virtual bool onFrame(const float* mag, size_t bins) = 0;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief STFT結果をメモリに蓄積する出力先
+ */
+// ----------------------------------------------------------------------------
+class StftMemorySink : public StftSink
+{
+public:
+	StftMemorySink() : bins_(0) {}
+	virtual ~StftMemorySink() {}
+
+	bool onFrame(const float* mag, size_t bins) {
+		bins_ = bins;
+		data_.insert(data_.end(), mag, mag + bins);
+		return true;
+	}
+	/**
+	 * @brief	蓄積したフレーム数を取得する
+	 * @return	フレーム数
+	 */
+	size_t frames() const { return bins_ == 0 ? 0 : data_.size() / bins_; }
+	/**
+	 * @brief	1フレームあたりのビン数を取得する
+	 * @return	ビン数
+	 */
+	size_t bins() const { return bins_; }
+	/**
+	 * @brief	指定フレームの振幅スペクトルを取得する
+	 * @param[in]	index	フレーム番号
+	 * @return	振幅スペクトルの先頭
+	 */
+	const float* frame(size_t index) const { return &data_[index * bins_]; }
+	//! 蓄積結果を破棄する
+	void clear() { data_.clear(); }
+
+private:
+	//! フレーム順に並べた振幅スペクトル
+	std::vector<float> data_;
+	//! 1フレームあたりのビン数
+	size_t bins_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief STFT結果をコンパクトなバイナリファイルに書き出す出力先
+ *
+ * ファイルは28バイトのヘッダーと、各ビンのdB値を16bitに量子化した
+ * フレーム列からなる。全てリトルエンディアン。
+ * | オフセット | 内容 |
+ * |---|---|
+ * | 0 | "STFT" |
+ * | 4 | バージョン（WORD） |
+ * | 6 | 符号化方式（WORD、1 = 16bit dB） |
+ * | 8 | FFT点数（DWORD） |
+ * | 12 | ホップ長（DWORD） |
+ * | 16 | ビン数（DWORD） |
+ * | 20 | サンプリングレート（DWORD） |
+ * | 24 | フレーム数（DWORD、finalizeで確定） |
+ *
+ * 量子化値qとdB値の関係は dB = q / 256 + STFT_DB_FLOOR となる。
+ */
+// ----------------------------------------------------------------------------
+class StftFileWriter : public BinaryWriter, public StftSink
+{
+
+public:
+	StftFileWriter(DWORD, DWORD, DWORD);
+	virtual ~StftFileWriter() {}
+
+	//! ヘッダーの書き出しを行います。
+	bool prepare();
+	//! 1フレーム分を書き出します。
+	bool onFrame(const float*, size_t);
+	//! フレーム数を確定して書き出しを終了します。
+	bool finalize();
+
+private:
+	//! FFT点数
+	const DWORD fftSize_;
+	//! ホップ長
+	const DWORD hop_;
+	//! サンプリングレート
+	const DWORD fs_;
+	//! 書き出し済みフレーム数
+	DWORD frames_;
+	//! 量子化済みフレームのバッファ
+	std::vector<BYTE> packed_;
+
+	StftFileWriter();
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief StftFileWriterが書き出したファイルの読み込みクラス
+ */
+// ----------------------------------------------------------------------------
+class StftFileReader : public BinaryReader
+{
+public:
+	StftFileReader() : BinaryReader(), fftSize_(0), hop_(0), bins_(0), fs_(0), frames_(0) {}
+	virtual ~StftFileReader() {}
+
+	//! ヘッダーを読み込み、フレーム読み込みの準備を行います。
+	bool prepare();
+	//! 1フレーム分のdB値を読み込みます。
+	bool readFrame(float*);
+
+	//! FFT点数を取得する
+	DWORD getFftSize() const { return fftSize_; }
+	//! ホップ長を取得する
+	DWORD getHop() const { return hop_; }
+	//! ビン数を取得する
+	DWORD getBins() const { return bins_; }
+	//! サンプリングレートを取得する
+	DWORD getSamplesPerSec() const { return fs_; }
+	//! フレーム数を取得する
+	DWORD getFrames() const { return frames_; }
+
+private:
+	//! FFT点数
+	DWORD fftSize_;
+	//! ホップ長
+	DWORD hop_;
+	//! ビン数
+	DWORD bins_;
+	//! サンプリングレート
+	DWORD fs_;
+	//! フレーム数
+	DWORD frames_;
+	//! 量子化済みフレームのバッファ
+	std::vector<BYTE> packed_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ストリーミングSTFT解析クラス
+ *
+ * pushで与えたモノラル信号をホップ長ごとにフレーム化し、窓掛けとFFTを行って
+ * 振幅スペクトルをStftSinkへ時間順に渡す。
+ * 内部に保持する信号はFFT点数と一回のpush分に限られるため、
+ * 終わりのないストリームでもメモリ使用量は増えない。
+ *
+ * スレッドプールを与えると、まとまった数のフレームを並列に変換する。
+ * このクラスのインスタンスはスレッドセーフではない。
+ */
+// ----------------------------------------------------------------------------
+class StftAnalyzer : private Noncopyable
+{
+public:
+	StftAnalyzer(size_t, size_t, StftWindow = STFT_WINDOW_HANN, ThreadPool* = nullptr);
+	virtual ~StftAnalyzer() {}
+
+	/**
+	 * @brief	FFT点数を取得する
+	 * @return	FFT点数
+	 */
+	size_t getFftSize() const { return fftSize_; }
+	/**
+	 * @brief	ホップ長を取得する
+	 * @return	ホップ長（サンプル数）
+	 */
+	size_t getHop() const { return hop_; }
+	/**
+	 * @brief	1フレームあたりのビン数を取得する
+	 * @return	ビン数
+	 */
+	size_t bins() const { return fftSize_ / 2 + 1; }
+	/**
+	 * @brief	出力済みフレーム数を取得する
+	 * @return	フレーム数
+	 */
+	size_t frames() const { return frames_; }
+
+	//! モノラル信号を追加し、揃ったフレームを出力します。
+	bool push(const float*, size_t, StftSink&);
+	//! 未出力の信号をゼロ詰めして出力します。
+	bool flush(StftSink&);
+	//! 内部状態を初期化します。
+	void reset();
+	//! RIFF-WAVファイルのストリーム全体を解析します。
+	bool analyze(RiffWavReader&, StftSink&, int = -1);
+
+private:
+	//! FFT点数
+	const size_t fftSize_;
+	//! ホップ長
+	const size_t hop_;
+	//! 窓関数の係数
+	std::vector<float> window_;
+	//! フレームの並列変換に使うスレッドプール
+	ThreadPool* pool_;
+	//! 並列処理単位ごとのFFT
+	std::vector<std::unique_ptr<RealFft> > ffts_;
+	//! 並列処理単位ごとの窓掛け済みフレーム
+	std::vector<std::vector<float> > frameBufs_;
+	//! 変換結果の一時領域
+	std::vector<float> out_;
+	//! 未処理の信号。先頭は次のフレームの開始位置。
+	std::vector<float> buffer_;
+	//! バッファ先頭のうち出力済みフレームに含まれるサンプル数
+	size_t covered_;
+	//! 出力済みフレーム数
+	size_t frames_;
+
+	//! バッファ中の揃ったフレームを全て出力します。
+	bool drain(StftSink&);
+
+	StftAnalyzer();
+};
+
+#endif // !_STFT_H_
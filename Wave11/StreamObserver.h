@@ -0,0 +1,64 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	StreamObserver.h
+ * @brief	ストリームの読み書きを監視するIFのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _STREAMOBSERVER_H_
+#define _STREAMOBSERVER_H_
+
+#include <cstddef>
+#include "RiffWavParser.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ストリームの読み書きを監視するIF
+ *
+ * RiffWavReader/RiffWavWriterに登録すると、ストリーム先頭から順に
+ * 読み書きしたペイロードのバイト列が通知される。読み書きと同じパスで
+ * 計測や解析を行うために使う。通知されるバイト列はフレーム境界で
+ * 区切られているとは限らない。
+ */
+// ----------------------------------------------------------------------------
+class StreamObserver
+{
+public:
+	virtual ~StreamObserver() {}
+
+	/**
+	 * @brief	ストリームの開始を通知する
+	 * @param[in]	format	ストリームの形式
+	 */
+	virtual void onStreamBegin(const WAVEFORMATEX& format) = 0;
+	/**
+	 * @brief	読み書きしたペイロードを通知する
+	 * @param[in]	buf		ペイロード
+	 * @param[in]	size	バイトサイズ
+	 */
+	virtual void onStream(const void* buf, size_t size) = 0;
+};
+
+#endif // !_STREAMOBSERVER_H_
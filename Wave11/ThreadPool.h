@@ -0,0 +1,181 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	ThreadPool.h
+ * @brief	固定数ワーカーのスレッドプールのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include "Noncopyable.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 固定数のワーカースレッドでタスクを処理するスレッドプール
+ *
+ * submitしたタスクは投入順にワーカーへ割り当てられる。
+ * 複数の利用者から同時にsubmit/parallelForしてもよい。
+ */
+// ----------------------------------------------------------------------------
+class ThreadPool : private Noncopyable
+{
+public:
+	/**
+	 * @param[in]	threads	ワーカースレッド数。0ならハードウェアスレッド数。
+	 */
+	explicit ThreadPool(size_t threads = 0) : stop_(false) {
+		if (threads == 0) {
+			threads = std::thread::hardware_concurrency();
+			if (threads == 0) threads = 1;
+		}
+		workers_.reserve(threads);
+		for (size_t i = 0; i < threads; i++) {
+			workers_.push_back(std::thread(&ThreadPool::run, this));
+		}
+	}
+	/** デストラクタは投入済みタスクを全て処理してからワーカーを終了する */
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cond_.notify_all();
+		for (size_t i = 0; i < workers_.size(); i++) {
+			workers_[i].join();
+		}
+	}
+
+	/**
+	 * @brief	ワーカースレッド数を取得する
+	 * @return	ワーカースレッド数
+	 */
+	size_t size() const { return workers_.size(); }
+	/**
+	 * @brief	タスクを投入する
+	 * @param[in]	task	実行するタスク。例外を投げてはならない。
+	 */
+	void submit(const std::function<void()>& task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.push_back(task);
+		}
+		cond_.notify_one();
+	}
+	/**
+	 * @brief	[0, count)の各インデックスに対して関数を並列実行し、完了を待つ
+	 *
+	 * 呼び出しスレッドも処理に参加する。関数が例外を投げた場合は
+	 * 全インデックスの処理終了後に最初の例外を再送出する。
+	 * @attention	ワーカースレッド上のタスクから呼んではならない。
+	 *
+	 * @param[in]	count	インデックス数
+	 * @param[in]	func	void(size_t)の関数
+	 */
+	template <class F>
+	void parallelFor(size_t count, F func) {
+		if (count == 0) return;
+		ForState state(count);
+		size_t helpers = (count - 1 < workers_.size()) ? count - 1 : workers_.size();
+		for (size_t i = 0; i < helpers; i++) {
+			submit([&state, &func]() { state.work(func); });
+		}
+		state.work(func);
+		state.wait(helpers);
+		if (state.error) {
+			std::rethrow_exception(state.error);
+		}
+	}
+
+private:
+	/**
+	 * @brief parallelFor一回分の共有状態
+	 */
+	struct ForState {
+		explicit ForState(size_t n) : count(n), next(0), finished(0) {}
+		const size_t count;
+		std::atomic<size_t> next;
+		size_t finished;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable cond;
+
+		template <class F>
+		void work(F& func) {
+			for (size_t i = next++; i < count; i = next++) {
+				try {
+					func(i);
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error) error = std::current_exception();
+				}
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			finished++;
+			cond.notify_all();
+		}
+		//! 呼び出しスレッド分を含めhelpers + 1本の完了を待つ
+		void wait(size_t helpers) {
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this, helpers]() { return finished == helpers + 1; });
+		}
+	};
+
+	//! ワーカースレッドの本体
+	void run() {
+		while (1) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+				if (tasks_.empty()) return;
+				task = tasks_.front();
+				tasks_.pop_front();
+			}
+			task();
+		}
+	}
+
+	//! ワーカースレッド
+	std::vector<std::thread> workers_;
+	//! 未処理タスク
+	std::deque<std::function<void()> > tasks_;
+	//! タスクキューの排他
+	std::mutex mutex_;
+	//! タスク投入通知
+	std::condition_variable cond_;
+	//! 終了要求
+	bool stop_;
+};
+
+#endif // !_THREADPOOL_H_
@@ -0,0 +1,287 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavBatchCheck.cpp
+ * @brief	複数プロセスでの分散一括処理の検査
+ *
+ * WAVE11_BATCHCHECKを定義した場合だけ有効になる（make batchcheck）。POSIX専用。
+ * 一つのマニフェストに対してシャードごとのプロセスをforkで同時に起動し、
+ * 一つを処理の途中でSIGKILLで停止させてから再起動する。各プロセスは処理した
+ * ジョブを共有のログに追記し、次の性質を検査する。
+ * - ジョブは担当シャードのプロセスだけが処理し、シャード間で重複しない
+ * - 再起動後に全てのジョブの成功がいずれかのジャーナルに記録されている
+ * - 再起動したプロセスはジャーナルに成功が記録されたジョブを処理しない
+ * - 二度処理されるのは、停止時に処理中だったジョブだけである
+ *
+ * 引数は一時ファイルのフォルダ（既定はカレント）。
+ */
+// ----------------------------------------------------------------------------
+#if defined(WAVE11_BATCHCHECK)
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "BatchDriver.h"
+
+namespace {
+
+//! ジョブ数
+const size_t Jobs = 400;
+//! シャード（プロセス）数
+const size_t Shards = 4;
+//! 途中で停止させるシャード
+const size_t Victim = 1;
+//! 停止させるまでに始めるジョブ数
+const size_t KillAfter = 30;
+//! 各プロセスのスレッド数
+const size_t Threads = 4;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	1シャードを処理するプロセスを起動する
+ *
+ * 子プロセスはマニフェストとジャーナルを読み、担当分を処理して集計をパイプに書く。
+ * 処理したジョブは「段階 シャード 入力パス」の1行として共有のログに追記する。
+ *
+ * @param[in]	dir			一時ファイルのフォルダ
+ * @param[in]	shard		シャード番号
+ * @param[in]	phase		ログに記録する段階（0が初回、1が再起動）
+ * @param[in]	killAfter	この数のジョブを始めたら自身をSIGKILLで停止する。0なら停止しない。
+ * @param[out]	fd			集計を読むパイプ
+ * @return	子プロセスのID。失敗時は-1。
+ */
+// ----------------------------------------------------------------------------
+pid_t spawn(const tstring& dir, size_t shard, int phase, size_t killAfter, int& fd)
+{
+	int pipes[2];
+	if (::pipe(pipes) != 0) {
+		return -1;
+	}
+	const pid_t pid = ::fork();
+	if (pid != 0) {
+		::close(pipes[1]);
+		fd = pipes[0];
+		return pid;
+	}
+	::close(pipes[0]);
+
+	std::vector<BatchJob> jobs;
+	if (!BatchDriver::loadManifest(dir + _T("wave11batch.manifest"), jobs)) {
+		::_exit(2);
+	}
+	const int log = ::open((dir + _T("wave11batch.log")).c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (log < 0) {
+		::_exit(2);
+	}
+	ThreadPool pool(Threads);
+	BatchDriver driver(shard, Shards, &pool);
+	char journal[32];
+	::snprintf(journal, sizeof(journal), "wave11batch%zu.journal", shard);
+	if (!driver.openJournal(dir + journal)) {
+		::_exit(2);
+	}
+	std::atomic<size_t> started(0);
+	const BatchStats stats = driver.run(jobs, [&](const BatchJob& job) {
+		if (killAfter > 0 && started++ >= killAfter) {
+			::kill(::getpid(), SIGKILL);
+		}
+		char line[256];
+		const int n = ::snprintf(line, sizeof(line), "%d %zu %s\n", phase, shard, job.src.c_str());
+		// O_APPENDの1回の書き込みは他のプロセスの行と混ざらない
+		const bool ok = n > 0 && ::write(log, line, n) == n;
+		// 停止時に処理中のジョブが残るよう、記録までの間を空ける
+		::usleep(1000);
+		return ok;
+	});
+	::close(log);
+	const bool sent = ::write(pipes[1], &stats, sizeof(stats)) == static_cast<ssize_t>(sizeof(stats));
+	::_exit(sent ? 0 : 2);
+}
+// ----------------------------------------------------------------------------
+/**
+ * @brief	子プロセスの終了を待ち、集計を受け取る
+ * @param[in]	pid		子プロセスのID
+ * @param[in]	fd		集計を読むパイプ
+ * @param[out]	stats	集計
+ * @param[out]	status	waitpidの終了状態
+ * @return	集計を受け取れれば真
+ */
+// ----------------------------------------------------------------------------
+bool reap(pid_t pid, int fd, BatchStats& stats, int& status)
+{
+	const bool got = ::read(fd, &stats, sizeof(stats)) == static_cast<ssize_t>(sizeof(stats));
+	::close(fd);
+	status = 0;
+	::waitpid(pid, &status, 0);
+	return got;
+}
+
+} // namespace
+
+#define BATCH_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	分散・中断・再開の性質を検査する
+ * @return	全て成り立てば0
+ */
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	const tstring dir = (argc > 1) ? tstring(argv[1]) + _T("/") : tstring();
+	const tstring manifest = dir + _T("wave11batch.manifest");
+	const tstring logPath = dir + _T("wave11batch.log");
+	std::vector<tstring> journals(Shards);
+	for (size_t s = 0; s < Shards; s++) {
+		char name[32];
+		::snprintf(name, sizeof(name), "wave11batch%zu.journal", s);
+		journals[s] = dir + name;
+		::remove(journals[s].c_str());
+	}
+	::remove(logPath.c_str());
+
+	FILE* fp = ::fopen(manifest.c_str(), "wb");
+	if (fp == nullptr) {
+		return 1;
+	}
+	for (size_t i = 0; i < Jobs; i++) {
+		::fprintf(fp, "in/%04zu.wav\tout/%04zu.wav\n", i, i);
+	}
+	::fclose(fp);
+
+	int failures = 0;
+	// 初回。Victimだけ途中で停止させる
+	std::vector<pid_t> pids(Shards);
+	std::vector<int> fds(Shards);
+	for (size_t s = 0; s < Shards; s++) {
+		pids[s] = spawn(dir, s, 0, (s == Victim) ? KillAfter : 0, fds[s]);
+		if (pids[s] < 0) {
+			return 1;
+		}
+	}
+	std::vector<BatchStats> stats(Shards);
+	for (size_t s = 0; s < Shards; s++) {
+		int status;
+		const bool got = reap(pids[s], fds[s], stats[s], status);
+		if (s == Victim) {
+			BATCH_CHECK(!got && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+		} else {
+			BATCH_CHECK(got && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+			BATCH_CHECK(stats[s].skipped == 0 && stats[s].failed == 0 && stats[s].succeeded == stats[s].assigned);
+		}
+	}
+
+	// 停止したシャードのジャーナルに残った成功を数えてから再起動する
+	std::vector<BatchJob> jobs;
+	BATCH_CHECK(BatchDriver::loadManifest(manifest, jobs) && jobs.size() == Jobs);
+	size_t journaled = 0;
+	std::vector<bool> before(jobs.size(), false);
+	{
+		BatchDriver victim(Victim, Shards);
+		BATCH_CHECK(victim.openJournal(journals[Victim]));
+		for (size_t i = 0; i < jobs.size(); i++) {
+			before[i] = victim.isDone(jobs[i]);
+			if (before[i]) journaled++;
+		}
+	}
+	BATCH_CHECK(journaled > 0);
+	int fd;
+	const pid_t pid = spawn(dir, Victim, 1, 0, fd);
+	BatchStats restart;
+	int status;
+	BATCH_CHECK(pid > 0 && reap(pid, fd, restart, status) && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	BATCH_CHECK(restart.skipped == journaled && restart.failed == 0);
+	BATCH_CHECK(restart.skipped + restart.succeeded == restart.assigned);
+
+	// ログを突き合わせる
+	std::map<tstring, std::vector<std::pair<int, size_t> > > runs;
+	fp = ::fopen(logPath.c_str(), "rb");
+	BATCH_CHECK(fp != nullptr);
+	if (fp != nullptr) {
+		int phase;
+		size_t shard;
+		char src[256];
+		while (::fscanf(fp, "%d %zu %255s", &phase, &shard, src) == 3) {
+			runs[src].push_back(std::make_pair(phase, shard));
+		}
+		::fclose(fp);
+	}
+	size_t assigned = 0;
+	size_t repeated = 0;
+	for (size_t s = 0; s < Shards; s++) {
+		BatchDriver driver(s, Shards);
+		BATCH_CHECK(driver.openJournal(journals[s]));
+		for (size_t i = 0; i < jobs.size(); i++) {
+			const BatchJob& job = jobs[i];
+			if (!driver.isMine(job)) {
+				BATCH_CHECK(!driver.isDone(job));
+				continue;
+			}
+			assigned++;
+			// 全ジョブが担当シャードのジャーナルで完了している
+			BATCH_CHECK(driver.isDone(job));
+			const std::vector<std::pair<int, size_t> >& r = runs[job.src];
+			BATCH_CHECK(!r.empty());
+			for (size_t k = 0; k < r.size(); k++) {
+				// 担当シャード以外は処理しない
+				BATCH_CHECK(r[k].second == s);
+				// 再起動前に成功が記録されたジョブは再起動後に処理しない
+				BATCH_CHECK(!(before[i] && r[k].first == 1));
+			}
+			if (r.size() > 1) {
+				// 二度目は再起動したプロセスで、停止時に処理中だったジョブだけ
+				BATCH_CHECK(s == Victim && r.size() == 2 && r[0].first == 0 && r[1].first == 1);
+				repeated++;
+			}
+		}
+	}
+	BATCH_CHECK(assigned == Jobs);
+	BATCH_CHECK(runs.size() == Jobs);
+	BATCH_CHECK(repeated <= Threads);
+
+	::printf("jobs %zu, shards %zu, journaled before restart %zu, resumed %zu, repeated %zu\n",
+		Jobs, Shards, journaled, restart.succeeded, repeated);
+	if (failures == 0) {
+		::remove(manifest.c_str());
+		::remove(logPath.c_str());
+		for (size_t s = 0; s < Shards; s++) {
+			::remove(journals[s].c_str());
+		}
+	}
+	return (failures == 0) ? 0 : 1;
+}
+
+#endif // WAVE11_BATCHCHECK
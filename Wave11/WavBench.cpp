@@ -0,0 +1,372 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavBench.cpp
+ * @brief	読み書きの主要経路のベンチマーク
+ *
+ * WAVE11_BENCHを定義した場合だけ有効になる（make bench）。
+ * 波形生成、writeFloat・writeBytesによる書き出し、getStream・getSamplesによる
+ * 読み込み、変換、無音検出、フィルターを順に実行し、経路ごとの処理速度を表示する。
+ * 読み込み→変換→書き出しのループは、定常状態でBufferPoolがシステムから
+ * メモリを確保しないことも検査する。多数の小さなファイルの読み込みは、
+ * RiffWavReaderで1ファイルずつ開いて読む場合とAsyncWavBatchでまとめて読む場合を、
+ * ページキャッシュにある場合とない場合（POSIXのみ）で比べる。
+ * make pgoではこの実行結果をプロファイルとして最適化ビルドに使う。
+ *
+ * 引数は音声の長さ（秒、既定は60）と一時ファイルのフォルダ（既定はカレント）。
+ */
+// ----------------------------------------------------------------------------
+#if defined(WAVE11_BENCH)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "WaveGenerator.h"
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+#include "SampleConverter.h"
+#include "WavTranscoder.h"
+#include "SilenceScanner.h"
+#include "FilterBank.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "AsyncIo.h"
+#include "AsyncWavBatch.h"
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+//! サンプリングレート
+const int Rate = 48000;
+//! チャンネル数
+const WORD Channels = 2;
+//! 1回に読み書きするフレーム数
+const size_t BlockFrames = 4096;
+//! 小さなファイルの数
+const size_t SmallFiles = 256;
+//! 小さなファイルのフレーム数
+const size_t SmallFrames = BlockFrames;
+//! ページキャッシュにある小さなファイルを読む回数
+const size_t SmallRepeat = 8;
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 経過時間を計り、処理速度を表示するクラス
+ */
+// ----------------------------------------------------------------------------
+class Stage
+{
+public:
+	/**
+	 * @param[in]	name	経路の名前
+	 * @param[in]	samples	処理するサンプル数
+	 */
+	Stage(const char* name, uint64_t samples) : name_(name), samples_(samples), start_(std::chrono::steady_clock::now()) {}
+	~Stage() {
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+		::printf("%-24s %9.1f ms %9.1f Msamples/s\n", name_, elapsed.count() * 1e3,
+			(elapsed.count() > 0) ? samples_ / elapsed.count() * 1e-6 : 0.0);
+	}
+
+private:
+	const char* name_;
+	const uint64_t samples_;
+	const std::chrono::steady_clock::time_point start_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	小さなファイルをRiffWavReaderで1ファイルずつ開いて読む
+ * @param[in]	names	ファイルのパス
+ * @param[out]	data	読み込み先。ファイルごとにSmallFramesフレーム分
+ * @return	全て読めれば真
+ */
+// ----------------------------------------------------------------------------
+bool readSmallSync(const std::vector<tstring>& names, std::vector<BYTE>& data)
+{
+	for (size_t i = 0; i < names.size(); i++) {
+		RiffWavReader reader;
+		size_t got;
+		if (!reader.open(names[i]) || !reader.prepare()
+			|| reader.getSamples(&data[i * SmallFrames * Channels * sizeof(short)], SmallFrames, got) < 0
+			|| got != SmallFrames) {
+			return false;
+		}
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+/**
+ * @brief	小さなファイルをAsyncWavBatchでまとめて解析し、読む
+ * @param[in]	io		要求を発行する非同期入出力
+ * @param[in]	names	ファイルのパス
+ * @param[out]	data	読み込み先。ファイルごとにSmallFramesフレーム分
+ * @return	全て読めれば真
+ */
+// ----------------------------------------------------------------------------
+bool readSmallBatch(AsyncIo& io, const std::vector<tstring>& names, std::vector<BYTE>& data)
+{
+	AsyncWavBatch batch(io);
+	std::vector<std::unique_ptr<RiffWavReader> > readers(names.size());
+	std::vector<RiffWavReader*> ptrs(names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		readers[i].reset(new RiffWavReader());
+		if (!readers[i]->open(names[i])) return false;
+		ptrs[i] = readers[i].get();
+	}
+	std::vector<bool> ok;
+	if (batch.prepareAll(ptrs, ok) != names.size()) return false;
+	std::vector<AsyncWavBlock> blocks(names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		AsyncWavBlock b = { ptrs[i], 0, SmallFrames, &data[i * SmallFrames * Channels * sizeof(short)], 0 };
+		blocks[i] = b;
+	}
+	if (batch.readBlocks(blocks) != names.size()) return false;
+	for (size_t i = 0; i < names.size(); i++) {
+		if (blocks[i].result != static_cast<int64_t>(SmallFrames)) return false;
+	}
+	return true;
+}
+
+#if !defined(_WIN32)
+// ----------------------------------------------------------------------------
+/**
+ * @brief	ファイルをページキャッシュから追い出す
+ * @param[in]	names	ファイルのパス
+ */
+// ----------------------------------------------------------------------------
+void evict(const std::vector<tstring>& names)
+{
+	for (size_t i = 0; i < names.size(); i++) {
+		const int fd = ::open(names[i].c_str(), O_RDONLY);
+		if (fd < 0) continue;
+		::fdatasync(fd);
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+}
+#endif
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	主要経路を順に実行する
+ * @return	全て成功すれば0
+ */
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	const double seconds = (argc > 1) ? ::atof(argv[1]) : 60.0;
+	const tstring dir = (argc > 2) ? tstring(argv[2]) + _T("/") : tstring();
+	const tstring pcm16 = dir + _T("wave11bench16.wav");
+	const tstring pcm24 = dir + _T("wave11bench24.wav");
+	const tstring trans = dir + _T("wave11benchtr.wav");
+	const tstring loop = dir + _T("wave11benchlp.wav");
+	const size_t frames = static_cast<size_t>(seconds * Rate) / BlockFrames * BlockFrames;
+	const uint64_t samples = static_cast<uint64_t>(frames) * Channels;
+	if (frames == 0) {
+		::fprintf(stderr, "usage: %s [seconds] [dir]\n", argv[0]);
+		return 1;
+	}
+
+	// 無音を挟んだ波形を生成する
+	std::vector<float> signal(samples);
+	{
+		Stage stage("generate", samples);
+		WaveGenerator gens[] = {
+			WaveGenerator(440, Rate), WaveGenerator(660, Rate), WaveGenerator(220, Rate), WaveGenerator(880, Rate)
+		};
+		for (size_t i = 0; i < frames; i++) {
+			const size_t section = i / Rate % 6;
+			float l = 0.f, r = 0.f;
+			switch (section) {
+			case 0: l = gens[0].SinSample(); r = gens[1].SinSample(); break;
+			case 1: l = gens[2].SawSample(); r = gens[3].TriangleSample(); break;
+			case 2: l = gens[0].PulseSample() * 0.5f; r = gens[1].WnoiseSample() * 0.1f; break;
+			case 3: l = gens[3].TriangleSample(); r = gens[2].SinSample(); break;
+			default: break;
+			}
+			signal[i * Channels] = l;
+			signal[i * Channels + 1] = r;
+		}
+	}
+
+	std::vector<short> raw(samples);
+	SampleConverter::fromFloat(signal.data(), raw.data(), samples, 16, true);
+	{
+		Stage stage("writeBytes 16bit", samples);
+		RiffWavWriter writer(16, Channels, Rate);
+		if (!writer.open(pcm16) || !writer.prepare()) return 1;
+		for (size_t i = 0; i < frames; i += BlockFrames) {
+			writer.writeBytes(&raw[i * Channels], BlockFrames * Channels * sizeof(short));
+		}
+		if (!writer.riffFinalize()) return 1;
+	}
+	{
+		Stage stage("writeFloat 24bit TPDF", samples);
+		RiffWavWriter writer(24, Channels, Rate);
+		writer.setDither(DITHER_TPDF);
+		if (!writer.open(pcm24) || !writer.prepare()) return 1;
+		for (size_t i = 0; i < frames; i += BlockFrames) {
+			writer.writeFloat(&signal[i * Channels], BlockFrames);
+		}
+		if (!writer.riffFinalize()) return 1;
+	}
+
+	std::vector<BYTE> block(BlockFrames * Channels * 3);
+	std::vector<float> decoded(BlockFrames * Channels);
+	{
+		Stage stage("getStream 16bit", samples);
+		RiffWavReader reader;
+		if (!reader.open(pcm16) || !reader.prepare()) return 1;
+		size_t got;
+		while (reader.getStream(block.data(), BlockFrames * Channels * sizeof(short), got) == 0 && got > 0) {
+			SampleConverter::toFloat(block.data(), decoded.data(), got / sizeof(short), 16, true);
+		}
+	}
+	{
+		Stage stage("getSamples 24bit", samples);
+		RiffWavReader reader;
+		if (!reader.open(pcm24) || !reader.prepare()) return 1;
+		size_t got;
+		while (reader.getSamples(block.data(), BlockFrames, got) == 0 && got > 0) {
+			SampleConverter::toFloat(block.data(), decoded.data(), got * Channels, 24, true);
+		}
+	}
+
+	{
+		// 読み込み→変換→書き出し。数ブロックで暖機した後はプールから確保されること
+		const size_t warmup = 4;
+		Stage stage("read/convert/write", samples);
+		RiffWavReader reader;
+		RiffWavWriter writer(16, Channels, Rate);
+		if (!reader.open(pcm16) || !reader.prepare() || !writer.open(loop) || !writer.prepare()) return 1;
+		uint64_t before = 0;
+		for (size_t i = 0; i < frames / BlockFrames; i++) {
+			if (i == warmup) {
+				before = BufferPool::instance().stats().systemAllocations;
+			}
+			PooledBuffer in(BlockFrames * Channels * sizeof(short));
+			PooledBuffer conv(BlockFrames * Channels * sizeof(float));
+			size_t got;
+			if (reader.getSamples(in.data(), BlockFrames, got) < 0 || got == 0) break;
+			SampleConverter::toFloat(in.data(), conv.as<float>(), got * Channels, 16, true);
+			writer.writeFloat(conv.as<float>(), got);
+		}
+		if (!writer.riffFinalize()) return 1;
+		const uint64_t after = BufferPool::instance().stats().systemAllocations;
+		if (frames / BlockFrames > warmup && after != before) {
+			::fprintf(stderr, "read/convert/write: %llu system allocations in steady state\n",
+				static_cast<unsigned long long>(after - before));
+			return 1;
+		}
+	}
+
+	{
+		// 多数の小さなファイルを1ファイルずつ読む場合とAsyncWavBatchでまとめて読む場合
+		std::vector<tstring> names(SmallFiles);
+		for (size_t i = 0; i < SmallFiles; i++) {
+			otstringstream name;
+			name << dir << _T("wave11benchsm") << i << _T(".wav");
+			names[i] = name.str();
+			RiffWavWriter writer(16, Channels, Rate);
+			if (!writer.open(names[i]) || !writer.prepare()) return 1;
+			writer.writeBytes(&raw[(i * SmallFrames) % (frames - SmallFrames + 1) * Channels], SmallFrames * Channels * sizeof(short));
+			if (!writer.riffFinalize()) return 1;
+		}
+		const uint64_t smallSamples = static_cast<uint64_t>(SmallFiles) * SmallFrames * Channels;
+		std::vector<BYTE> data(SmallFiles * SmallFrames * Channels * sizeof(short));
+		// リングの生成と初回の割り当ては計測から除く
+		std::unique_ptr<AsyncIo> io = AsyncIo::create();
+		if (!readSmallSync(names, data) || !readSmallBatch(*io, names, data)) return 1;
+		{
+			Stage stage("small files sync", smallSamples * SmallRepeat);
+			for (size_t k = 0; k < SmallRepeat; k++) {
+				if (!readSmallSync(names, data)) return 1;
+			}
+		}
+		{
+			Stage stage("small files batch", smallSamples * SmallRepeat);
+			for (size_t k = 0; k < SmallRepeat; k++) {
+				if (!readSmallBatch(*io, names, data)) return 1;
+			}
+		}
+#if !defined(_WIN32)
+		// ページキャッシュにない場合。ストレージの往復待ちを重ねられるため一括読み込みが速い
+		evict(names);
+		{
+			Stage stage("small files sync cold", smallSamples);
+			if (!readSmallSync(names, data)) return 1;
+		}
+		evict(names);
+		{
+			Stage stage("small files batch cold", smallSamples);
+			if (!readSmallBatch(*io, names, data)) return 1;
+		}
+#endif
+		for (size_t i = 0; i < SmallFiles; i++) {
+			::remove(names[i].c_str());
+		}
+	}
+
+	ThreadPool pool;
+	{
+		Stage stage("transcode 16->24 44.1k", samples);
+		WavTranscoder transcoder(24, true, 44100, &pool);
+		if (!transcoder.transcode(pcm16, trans)) return 1;
+	}
+	{
+		Stage stage("findSilence 24bit", samples);
+		SilenceScanner scanner;
+		std::vector<FrameSegment> gaps;
+		if (!scanner.open(pcm24)) return 1;
+		scanner.findSilence(Rate / 2, gaps);
+	}
+	{
+		Stage stage("biquad x4", samples);
+		BiquadCascade cascade(Channels);
+		cascade.addStage(BiquadCoeffs::highpass(Rate, 80));
+		cascade.addStage(BiquadCoeffs::peaking(Rate, 1000, 1.0, 3.0));
+		cascade.addStage(BiquadCoeffs::highShelf(Rate, 8000, -2.0));
+		cascade.addStage(BiquadCoeffs::lowpass(Rate, 18000));
+		for (size_t i = 0; i < frames; i += BlockFrames) {
+			cascade.process(&signal[i * Channels], BlockFrames);
+		}
+	}
+
+	::remove(pcm16.c_str());
+	::remove(pcm24.c_str());
+	::remove(trans.c_str());
+	::remove(loop.c_str());
+	return 0;
+}
+
+#endif // WAVE11_BENCH
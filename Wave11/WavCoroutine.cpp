@@ -0,0 +1,293 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavCoroutine.cpp
+ * @brief	コルーチンによるRIFF-WAVの非同期読み書きクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "WavCoroutine.h"
+
+#ifdef WAVE11_COROUTINE
+
+#include "BufferPool.h"
+#include "HeaderCache.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	コンストラクタ
+ * @param[in]	depth	同時に発行する要求数
+ */
+// ----------------------------------------------------------------------------
+WavExecutor::WavExecutor(size_t depth)
+: io_(AsyncIo::create(depth)),
+  live_(0),
+  failures_(0)
+{
+}
+// ----------------------------------------------------------------------------
+// 処理を開始し、完了まで実行を任せます。
+/**
+ * 処理は最初の読み書きで中断するまで呼び出し元で進み、以降はrunの中で進みます。
+ *
+ * @param[in]	task	処理
+ */
+// ----------------------------------------------------------------------------
+void WavExecutor::spawn(WavTask<void> task)
+{
+	live_++;
+	drive(this, std::move(task));
+}
+// ----------------------------------------------------------------------------
+// 全ての処理が完了するまで入出力を処理します。
+/**
+ * 溜まった要求をまとめて発行し、完了を回収して対応するコルーチンを再開します。
+ * 再開したコルーチンが出した要求は次の周回でまとめて発行します。
+ */
+// ----------------------------------------------------------------------------
+void WavExecutor::run()
+{
+	std::vector<AsyncIoCompletion> done(io_->depth());
+	std::vector<IoAwaiter*> ready;
+	while (live_ > 0) {
+		while (!backlog_.empty() && io_->pending() < io_->depth()) {
+			IoAwaiter* a = backlog_.front();
+			if (!io_->push(a->req_)) {
+				break;
+			}
+			backlog_.pop_front();
+		}
+		if (io_->pending() == 0) {
+			// 入出力を待たずに中断している処理は再開できない
+			break;
+		}
+		const size_t n = io_->wait(done.data(), done.size(), 1);
+		ready.clear();
+		for (size_t i = 0; i < n; i++) {
+			IoAwaiter* a = reinterpret_cast<IoAwaiter*>(static_cast<uintptr_t>(done[i].tag));
+			a->result_ = done[i].result;
+			ready.push_back(a);
+		}
+		for (size_t i = 0; i < ready.size(); i++) {
+			ready[i]->handle_.resume();
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+// spawnした処理を実行します。
+/**
+ * @param[in]	executor	イベントループ
+ * @param[in]	task		処理
+ */
+// ----------------------------------------------------------------------------
+WavExecutor::Detached WavExecutor::drive(WavExecutor* executor, WavTask<void> task)
+{
+	try {
+		co_await task;
+	} catch (...) {
+		executor->failures_++;
+	}
+	executor->live_--;
+}
+// ----------------------------------------------------------------------------
+// 要求を受け付けます。
+/**
+ * 同時要求数に空きがあればAsyncIoに溜め、なければ空くまで保留します。
+ *
+ * @param[in]	a	中断したコルーチンの待機
+ */
+// ----------------------------------------------------------------------------
+void WavExecutor::enqueue(IoAwaiter* a)
+{
+	a->req_.tag = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(a));
+	if (!backlog_.empty() || !io_->push(a->req_)) {
+		backlog_.push_back(a);
+	}
+}
+
+// ----------------------------------------------------------------------------
+// ファイルを開きます。
+/**
+ * ヘッダーを同期的に解析し、位置指定読み込み用に開き直します。
+ *
+ * @param[in]	path	ファイルのパス
+ * @param[in]	cache	ヘッダーの解析結果キャッシュ。nullptrなら毎回解析する。
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool CoWavReader::open(const tstring& path, HeaderCache* cache)
+{
+	file_.close();
+	pos_ = 0;
+	const bool prepared = (cache != nullptr) ? cache->open(reader_, path)
+		: (reader_.open(path) && reader_.prepare());
+	reader_.close();
+	return prepared && file_.openRead(path);
+}
+// ----------------------------------------------------------------------------
+// フレーム単位で非同期に読み込みます。
+/**
+ * 読み込み位置から最大frames分を読み込み、読み込み位置を進めます。
+ *
+ * @param[out]	buf		frames×nBlockAlignバイトを格納可能なバッファ。完了まで保持すること。
+ * @param[in]	frames	読み込むフレーム数
+ * @return	co_awaitで読み込んだフレーム数を返す処理。ストリーム終端では要求より少ない。
+ * @exception	WavIoException	読み込みエラー発生
+ */
+// ----------------------------------------------------------------------------
+WavTask<size_t> CoWavReader::readFrames(void* buf, size_t frames)
+{
+	const uint64_t total = reader_.getFrames();
+	const size_t align = reader_.getBlockAlign();
+	const uint64_t first = pos_;
+	const size_t n = static_cast<size_t>((total - first < frames) ? total - first : frames);
+	pos_ += n;
+
+	const size_t bytes = n * align;
+	const uint64_t offset = static_cast<uint64_t>(reader_.getStreamOffset()) + first * align;
+	size_t got = 0;
+	while (got < bytes) {
+		const int64_t r = co_await executor_.readAt(file_.handle(), static_cast<BYTE*>(buf) + got, bytes - got, offset + got);
+		if (r < 0) {
+			throw WavIoException("async read error.");
+		}
+		if (r == 0) {
+			break;
+		}
+		got += static_cast<size_t>(r);
+	}
+	const size_t result = got / align;
+	reader_.decodeSamples(buf, result * reader_.getChannels());
+	co_return result;
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	コンストラクタ
+ * @param[in]	executor	イベントループ
+ * @param[in]	qbit		量子化ビット数
+ * @param[in]	ch			チャンネル数
+ * @param[in]	fs			サンプリングレート
+ * @param[in]	fmt			WAVE_FORMAT_PCMなら真、WAVE_FORMAT_IEEE_FLOATなら偽
+ */
+// ----------------------------------------------------------------------------
+CoWavWriter::CoWavWriter(WavExecutor& executor, WORD qbit, WORD ch, DWORD fs, bool fmt)
+: executor_(executor),
+  writer_(qbit, ch, fs, fmt),
+  width_(qbit / 8),
+  blockAlign_(static_cast<size_t>(qbit / 8) * ch),
+  dataOffset_(0),
+  reserved_(0)
+{
+}
+// ----------------------------------------------------------------------------
+// ファイルを開き、ヘッダーを書き出します。
+/**
+ * @param[in]	path		ファイルのパス
+ * @param[in]	container	コンテナ形式
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool CoWavWriter::open(const tstring& path, WavContainer container)
+{
+	reserved_ = 0;
+	writer_.setContainer(container);
+	if (!writer_.open(path) || !writer_.prepare() || !writer_.flush()) {
+		return false;
+	}
+	const int64_t offset = writer_.tell();
+	if (offset < 0 || !file_.openWrite(path)) {
+		return false;
+	}
+	dataOffset_ = static_cast<uint64_t>(offset);
+	return true;
+}
+// ----------------------------------------------------------------------------
+// フレーム単位で非同期に書き出します。
+/**
+ * WavTaskは最初のco_awaitまで実行されないため、書き出し位置はコルーチンの
+ * 外で呼び出し時に確保し、書き出しはwriteReservedに任せます。
+ *
+ * @param[in]	buf		RIFF-WAV形式のフレーム列。完了まで保持すること。
+ * @param[in]	frames	フレーム数
+ * @return	co_awaitで書き出したフレーム数を返す処理
+ * @exception	WavIoException	書き出しエラー発生（co_await時）
+ */
+// ----------------------------------------------------------------------------
+WavTask<size_t> CoWavWriter::write(const void* buf, size_t frames)
+{
+	const uint64_t offset = dataOffset_ + reserved_;
+	reserved_ += static_cast<uint64_t>(frames) * blockAlign_;
+	return writeReserved(buf, frames, offset);
+}
+// ----------------------------------------------------------------------------
+// 確保した位置へ非同期に書き出します。
+/**
+ * 変換したサンプルを書き出します。
+ *
+ * @param[in]	buf		RIFF-WAV形式のフレーム列。完了まで保持すること。
+ * @param[in]	frames	フレーム数
+ * @param[in]	offset	書き出し先のファイル先頭からのバイトオフセット
+ * @return	co_awaitで書き出したフレーム数を返す処理
+ * @exception	WavIoException	書き出しエラー発生
+ */
+// ----------------------------------------------------------------------------
+WavTask<size_t> CoWavWriter::writeReserved(const void* buf, size_t frames, uint64_t offset)
+{
+	const size_t bytes = frames * blockAlign_;
+
+	PooledBuffer encoded;
+	const BYTE* src = static_cast<const BYTE*>(buf);
+	if (writer_.needsEncode()) {
+		encoded.resize(bytes);
+		writer_.encodeSamples(buf, encoded.data(), bytes / width_);
+		src = encoded.as<BYTE>();
+	}
+	size_t done = 0;
+	while (done < bytes) {
+		const int64_t r = co_await executor_.writeAt(file_.handle(), src + done, bytes - done, offset + done);
+		if (r <= 0) {
+			throw WavIoException("async write error.");
+		}
+		done += static_cast<size_t>(r);
+	}
+	co_return frames;
+}
+// ----------------------------------------------------------------------------
+// ヘッダーのサイズを確定して閉じます。
+/**
+ * 全てのwriteの完了後に呼び出すこと。
+ *
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool CoWavWriter::finalize()
+{
+	file_.close();
+	const bool ret = writer_.riffFinalize();
+	writer_.close();
+	return ret;
+}
+
+#endif // WAVE11_COROUTINE
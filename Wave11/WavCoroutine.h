@@ -0,0 +1,388 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavCoroutine.h
+ * @brief	コルーチンによるRIFF-WAVの非同期読み書きクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _WAVCOROUTINE_H_
+#define _WAVCOROUTINE_H_
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define WAVE11_COROUTINE
+#endif
+
+#ifdef WAVE11_COROUTINE
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "AsyncIo.h"
+#include "PositionalFile.h"
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+
+class HeaderCache;
+
+template<typename T> class WavTask;
+
+namespace detail {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief WavTaskのpromiseの共通部分
+ *
+ * 開始は最初のco_awaitまで遅延し、終了時は待っているコルーチンへ直接制御を移す。
+ */
+// ----------------------------------------------------------------------------
+struct WavTaskPromiseBase {
+	//! 完了時に再開するコルーチン
+	std::coroutine_handle<> continuation;
+	//! コルーチン内で送出された例外
+	std::exception_ptr error;
+
+	/**
+	 * @brief 終了時の待機
+	 */
+	struct FinalAwaiter {
+		bool await_ready() const noexcept { return false; }
+		template<typename P>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+			std::coroutine_handle<> next = h.promise().continuation;
+			return next ? next : std::noop_coroutine();
+		}
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	FinalAwaiter final_suspend() const noexcept { return {}; }
+	void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+//! 値を返すWavTaskのpromise
+template<typename T>
+struct WavTaskPromise : WavTaskPromiseBase {
+	//! 戻り値
+	std::optional<T> value;
+
+	WavTask<T> get_return_object() noexcept;
+	void return_value(T v) { value = std::move(v); }
+	T result() {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return std::move(*value);
+	}
+};
+
+//! 値を返さないWavTaskのpromise
+template<>
+struct WavTaskPromise<void> : WavTaskPromiseBase {
+	WavTask<void> get_return_object() noexcept;
+	void return_void() const noexcept {}
+	void result() {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+} // namespace detail
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief co_awaitで結果を受け取る非同期処理
+ *
+ * co_awaitした時点で開始し、完了すると戻り値を返すか、送出された例外を再送出する。
+ * WavExecutor::spawnに渡すと、待つコルーチンなしに開始できる。
+ */
+// ----------------------------------------------------------------------------
+template<typename T = void>
+class WavTask : private Noncopyable
+{
+public:
+	typedef detail::WavTaskPromise<T> promise_type;
+	typedef std::coroutine_handle<promise_type> handle_type;
+
+	explicit WavTask(handle_type h = nullptr) noexcept : handle_(h) {}
+	WavTask(WavTask&& rhs) noexcept : handle_(std::exchange(rhs.handle_, nullptr)) {}
+	WavTask& operator =(WavTask&& rhs) noexcept {
+		if (this != &rhs) {
+			if (handle_) {
+				handle_.destroy();
+			}
+			handle_ = std::exchange(rhs.handle_, nullptr);
+		}
+		return *this;
+	}
+	virtual ~WavTask() {
+		if (handle_) {
+			handle_.destroy();
+		}
+	}
+
+	bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept {
+		handle_.promise().continuation = waiter;
+		return handle_;
+	}
+	T await_resume() { return handle_.promise().result(); }
+
+private:
+	//! コルーチンのハンドル
+	handle_type handle_;
+};
+
+namespace detail {
+
+template<typename T>
+inline WavTask<T> WavTaskPromise<T>::get_return_object() noexcept {
+	return WavTask<T>(std::coroutine_handle<WavTaskPromise<T> >::from_promise(*this));
+}
+
+inline WavTask<void> WavTaskPromise<void>::get_return_object() noexcept {
+	return WavTask<void>(std::coroutine_handle<WavTaskPromise<void> >::from_promise(*this));
+}
+
+} // namespace detail
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 非同期入出力の完了でコルーチンを再開するイベントループ
+ *
+ * コルーチンが読み書きをco_awaitすると、要求をAsyncIo（Linuxではio_uring）に
+ * 溜めて中断する。runは溜まった要求をまとめて発行し、完了したものから
+ * 対応するコルーチンを再開する。そのため多数のファイルのストリームを
+ * 1スレッドで並行して処理できる。複数のコアを使う場合は、スレッドごとに
+ * インスタンスを作り、ストリームを振り分ける。
+ *
+ * 一つのインスタンスのspawnとrunは同じスレッドから呼び出すこと。
+ */
+// ----------------------------------------------------------------------------
+class WavExecutor : private Noncopyable
+{
+public:
+	/**
+	 * @brief 読み書きの待機
+	 */
+	class IoAwaiter {
+	public:
+		IoAwaiter(WavExecutor& executor, const AsyncIoRequest& req) : executor_(executor), req_(req), result_(0) {}
+		bool await_ready() const noexcept { return req_.size == 0; }
+		void await_suspend(std::coroutine_handle<> h) { handle_ = h; executor_.enqueue(this); }
+		/**
+		 * @brief	結果を取得する
+		 * @return	読み書きしたバイト数。エラー時は負のエラー番号。
+		 */
+		int64_t await_resume() const noexcept { return result_; }
+
+	private:
+		friend class WavExecutor;
+		//! 要求を受け付けたイベントループ
+		WavExecutor& executor_;
+		//! 要求
+		AsyncIoRequest req_;
+		//! 結果
+		int64_t result_;
+		//! 完了時に再開するコルーチン
+		std::coroutine_handle<> handle_;
+	};
+
+	explicit WavExecutor(size_t = AsyncIo::DefaultDepth);
+	virtual ~WavExecutor() {}
+
+	//! 処理を開始し、完了まで実行を任せます。
+	void spawn(WavTask<void>);
+	//! 全ての処理が完了するまで入出力を処理します。
+	void run();
+	/**
+	 * @brief	例外で終了した処理の数を取得する
+	 * @return	spawnした処理のうち例外を送出して終了した数
+	 */
+	size_t failures() const { return failures_; }
+	/**
+	 * @brief	入出力の実装名を取得する
+	 * @return	"io_uring"または"threadpool"
+	 */
+	const char* backend() const { return io_->name(); }
+
+	/**
+	 * @brief	位置指定の読み込みを待機する
+	 * @param[in]	handle	ファイル記述子またはHANDLE
+	 * @param[out]	buf		読み込み先。完了まで保持すること。
+	 * @param[in]	size	バイトサイズ
+	 * @param[in]	offset	ファイル先頭からのバイトオフセット
+	 * @return	co_awaitで読み込んだバイト数（エラー時は負のエラー番号）を返す待機
+	 */
+	IoAwaiter readAt(intptr_t handle, void* buf, size_t size, uint64_t offset) {
+		AsyncIoRequest req = { handle, buf, size, offset, false, 0 };
+		return IoAwaiter(*this, req);
+	}
+	/**
+	 * @brief	位置指定の書き出しを待機する
+	 * @param[in]	handle	ファイル記述子またはHANDLE
+	 * @param[in]	buf		書き出し元。完了まで保持すること。
+	 * @param[in]	size	バイトサイズ
+	 * @param[in]	offset	ファイル先頭からのバイトオフセット
+	 * @return	co_awaitで書き出したバイト数（エラー時は負のエラー番号）を返す待機
+	 */
+	IoAwaiter writeAt(intptr_t handle, const void* buf, size_t size, uint64_t offset) {
+		AsyncIoRequest req = { handle, const_cast<void*>(buf), size, offset, true, 0 };
+		return IoAwaiter(*this, req);
+	}
+
+private:
+	/**
+	 * @brief spawnした処理を包む、待つ者のないコルーチン
+	 */
+	struct Detached {
+		struct promise_type {
+			Detached get_return_object() const noexcept { return Detached(); }
+			std::suspend_never initial_suspend() const noexcept { return {}; }
+			std::suspend_never final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			void unhandled_exception() const noexcept {}
+		};
+	};
+
+	//! 非同期入出力
+	std::unique_ptr<AsyncIo> io_;
+	//! 同時要求数を越えて発行を待っている要求
+	std::deque<IoAwaiter*> backlog_;
+	//! 未完了の処理数
+	size_t live_;
+	//! 例外で終了した処理数
+	size_t failures_;
+
+	//! spawnした処理を実行します。
+	static Detached drive(WavExecutor*, WavTask<void>);
+	//! 要求を受け付けます。
+	void enqueue(IoAwaiter*);
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief コルーチンでRIFF-WAVを読み込むクラス
+ *
+ * ヘッダーはopenで同期的に解析し、サンプルはWavExecutorを通して非同期に
+ * 位置指定で読み込む。読み込んだサンプルはRiffWavReader::getStreamと同じく
+ * RIFF-WAV形式に変換して返す。
+ */
+// ----------------------------------------------------------------------------
+class CoWavReader : private Noncopyable
+{
+public:
+	explicit CoWavReader(WavExecutor& executor) : executor_(executor), pos_(0) {}
+	virtual ~CoWavReader() {}
+
+	//! ファイルを開きます。
+	bool open(const tstring&, HeaderCache* = nullptr);
+	/**
+	 * @brief	形式を取得する
+	 * @return	ヘッダーを解析した読み込みクラス（ファイルは閉じている）
+	 */
+	const RiffWavReader& format() const { return reader_; }
+	/**
+	 * @brief	読み込み位置をフレーム単位で取得する
+	 * @return	ストリーム先頭からのフレーム位置
+	 */
+	uint64_t tellFrame() const { return pos_; }
+	/**
+	 * @brief	読み込み位置をフレーム単位で移動する
+	 * @param[in]	frame	フレーム位置
+	 * @return	範囲内なら真
+	 */
+	bool seekFrame(uint64_t frame) {
+		if (frame > reader_.getFrames()) return false;
+		pos_ = frame;
+		return true;
+	}
+	//! フレーム単位で非同期に読み込みます。
+	WavTask<size_t> readFrames(void*, size_t);
+
+private:
+	//! イベントループ
+	WavExecutor& executor_;
+	//! ヘッダーを解析した読み込みクラス
+	RiffWavReader reader_;
+	//! 位置指定読み込み用のファイル
+	PositionalFile file_;
+	//! 読み込み位置のフレーム
+	uint64_t pos_;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief コルーチンでRIFF-WAVを書き出すクラス
+ *
+ * ヘッダーはopenとfinalizeで同期的に書き出し、サンプルはWavExecutorを通して
+ * 非同期に位置指定で書き出す。writeに与えるのはRIFF-WAV形式のサンプルで、
+ * コンテナ形式に応じてRiffWavWriter::encodeSamplesで変換する。
+ * 書き出し位置はwriteの呼び出し時に確保するため、返された処理をco_awaitする
+ * 順序や完了を待たずに続けてwriteしてもよい（処理自体は最初のco_awaitで始まる）。
+ */
+// ----------------------------------------------------------------------------
+class CoWavWriter : private Noncopyable
+{
+public:
+	CoWavWriter(WavExecutor&, WORD, WORD, DWORD, bool = true);
+	virtual ~CoWavWriter() {}
+
+	//! ファイルを開き、ヘッダーを書き出します。
+	bool open(const tstring&, WavContainer = CONTAINER_RIFF);
+	//! フレーム単位で非同期に書き出します。
+	WavTask<size_t> write(const void*, size_t);
+	//! ヘッダーのサイズを確定して閉じます。
+	bool finalize();
+
+private:
+	//! イベントループ
+	WavExecutor& executor_;
+	//! ヘッダーの書き出しクラス
+	RiffWavWriter writer_;
+	//! 位置指定書き出し用のファイル
+	PositionalFile file_;
+	//! 1サンプルのバイトサイズ
+	const size_t width_;
+	//! 1フレームのバイトサイズ
+	const size_t blockAlign_;
+	//! ストリーム先頭のバイトオフセット
+	uint64_t dataOffset_;
+	//! 確保済みの書き出し位置（ストリーム先頭からのバイト数）
+	uint64_t reserved_;
+
+	//! 確保した位置へ非同期に書き出します。
+	WavTask<size_t> writeReserved(const void*, size_t, uint64_t);
+};
+
+#endif // WAVE11_COROUTINE
+
+#endif // !_WAVCOROUTINE_H_
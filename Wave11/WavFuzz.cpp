@@ -0,0 +1,322 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavFuzz.cpp
+ * @brief	ヘッダー解析のファズ・性質検査の入口
+ *
+ * WAVE11_FUZZを定義した場合だけ有効になる。libFuzzer（-fsanitize=fuzzer）や
+ * AFL++のafl-clang-fastはLLVMFuzzerTestOneInputを直接呼び出す。
+ * WAVE11_FUZZ_MAINも定義すると、引数のファイルを順に与えるmainと、
+ * 引数がない場合の解析時間の線形性検査が有効になる（make fuzzcheck）。
+ *
+ * 入力の先頭バイトが偶数（RIFF-WAVの'R'、Wave64の'r'を含む）なら入力をファイルとして
+ * 解析し、奇数なら続くバイトを形式とペイロードとしてRiffWavWriterで書き出し、
+ * RiffWavReaderで読み戻す。性質が成り立たない場合はabortする。
+ */
+// ----------------------------------------------------------------------------
+#if defined(WAVE11_FUZZ)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "RiffWavParser.h"
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+#include "WavRecovery.h"
+
+#if defined(_WIN32)
+#include <process.h>
+#define WAVE11_GETPID _getpid
+#else
+#include <unistd.h>
+#define WAVE11_GETPID getpid
+#endif
+
+#define FUZZ_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			::fprintf(stderr, "fuzz check failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+			::abort(); \
+		} \
+	} while (0)
+
+namespace {
+
+//! 解析の結果
+struct ParseResult {
+	RiffWavParser::Status status;
+	RiffWavInfo info;
+	//! feedの呼び出し回数
+	size_t steps;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	ファイル全体のバイト列を一定サイズのバッファに区切って解析する
+ *
+ * RiffWavReader::prepareと同じく、中断した位置から続きのバッファを与える。
+ *
+ * @param[in]	data		ファイル全体のバイト列
+ * @param[in]	size		バイト列のサイズ
+ * @param[in]	window		1回に与えるバイトサイズ
+ * @param[in]	recovery	復旧モードなら真
+ * @return	解析の結果
+ */
+// ----------------------------------------------------------------------------
+ParseResult parse(const BYTE* data, size_t size, size_t window, bool recovery)
+{
+	RiffWavParser parser;
+	parser.reset(size);
+	parser.setRecovery(recovery);
+	ParseResult r;
+	r.steps = 0;
+	uint64_t base = 0;
+	while (1) {
+		const size_t n = (size - base < window) ? static_cast<size_t>(size - base) : window;
+		r.status = parser.feed(data + base, n, base);
+		r.steps++;
+		r.info = parser.info();
+		if (r.status != RiffWavParser::PARSE_NEED_MORE) {
+			return r;
+		}
+		// 続きがない場合は途中で切れたファイル
+		if (parser.nextOffset() <= base || parser.nextOffset() >= size) {
+			FUZZ_CHECK(parser.nextOffset() >= base);
+			r.status = RiffWavParser::PARSE_INVALID;
+			return r;
+		}
+		base = parser.nextOffset();
+	}
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	解析の性質を検査する
+ *
+ * - バッファの区切り方によらず結果が同じ
+ * - feedの呼び出し回数はファイルサイズに比例する範囲に収まる
+ * - 解析できた場合、ペイロードはファイル内にあり、フレームサイズは0でない
+ * - 復旧モードでは、ペイロード長はファイル終端までのフレーム境界に揃う
+ */
+// ----------------------------------------------------------------------------
+void checkParse(const BYTE* data, size_t size)
+{
+	const size_t windows[] = { 48, 173, RiffWavParser::DefaultWindow };
+	for (int recovery = 0; recovery < 2; recovery++) {
+		const ParseResult whole = parse(data, size, (size == 0) ? 1 : size, recovery != 0);
+		for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+			const ParseResult r = parse(data, size, windows[i], recovery != 0);
+			FUZZ_CHECK(r.status == whole.status);
+			FUZZ_CHECK(r.steps <= size / 8 + 2);
+			if (r.status == RiffWavParser::PARSE_DONE) {
+				FUZZ_CHECK(r.info.container == whole.info.container);
+				FUZZ_CHECK(::memcmp(&r.info.format, &whole.info.format, sizeof(WAVEFORMATEX)) == 0);
+				FUZZ_CHECK(r.info.dataOffset == whole.info.dataOffset);
+				FUZZ_CHECK(r.info.dataLength == whole.info.dataLength);
+			}
+		}
+		if (whole.status != RiffWavParser::PARSE_DONE) {
+			continue;
+		}
+		const RiffWavInfo& info = whole.info;
+		FUZZ_CHECK(RiffWavParser::isValidFormat(info.format));
+		FUZZ_CHECK(info.format.nBlockAlign != 0);
+		FUZZ_CHECK(info.dataOffset <= size);
+		if (recovery) {
+			FUZZ_CHECK(info.dataOffset + info.dataLength <= size);
+			FUZZ_CHECK(info.dataLength % info.format.nBlockAlign == 0);
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	書き出しと読み戻しの往復を検査する
+ *
+ * 入力の先頭2バイトで形式とコンテナを選び、残りをペイロードとする。
+ * 読み戻した形式・フレーム数・ペイロードが書き出したものと一致し、
+ * AIFF・AIFF-C以外では修復クラスが損傷なしと判定することを確かめる。
+ */
+// ----------------------------------------------------------------------------
+void checkRoundTrip(const BYTE* data, size_t size)
+{
+	if (size < 3) {
+		return;
+	}
+	const WORD ch = 1 + (data[1] & 7);
+	const WORD qbit = 8 * (1 + ((data[1] >> 3) & 3));
+	const bool pcm = (qbit != 32) || ((data[2] & 1) == 0);
+	const WavContainer containers[] = { CONTAINER_RIFF, CONTAINER_W64, CONTAINER_RIFX, CONTAINER_AIFF, CONTAINER_AIFC };
+	WavContainer container = containers[(data[2] >> 1) % 5];
+	if (container == CONTAINER_AIFF && !pcm) {
+		container = CONTAINER_AIFC;
+	}
+	const bool aiff = (container == CONTAINER_AIFF || container == CONTAINER_AIFC);
+	const bool sowt = ((data[2] >> 4) & 1) != 0;
+	const size_t frameBytes = qbit / 8 * ch;
+	const size_t frames = (size - 3) / frameBytes;
+	const BYTE* payload = data + 3;
+
+	char path[64];
+	::snprintf(path, sizeof(path), "wave11_fuzz_%d.wav", static_cast<int>(WAVE11_GETPID()));
+	{
+		RiffWavWriter writer(qbit, ch, 44100, pcm);
+		writer.setContainer(container);
+		writer.setSowt(sowt);
+		FUZZ_CHECK(writer.open(path));
+		FUZZ_CHECK(writer.prepare());
+		FUZZ_CHECK(writer.writeBytes(payload, frames * frameBytes) == frames * frameBytes);
+		FUZZ_CHECK(writer.riffFinalize());
+	}
+	{
+		RiffWavReader reader;
+		FUZZ_CHECK(reader.open(path));
+		FUZZ_CHECK(reader.prepare());
+		FUZZ_CHECK(reader.getContainer() == container);
+		FUZZ_CHECK(reader.getChannels() == ch && reader.getBitPerSample() == qbit);
+		FUZZ_CHECK(reader.getFormatTag() == (pcm ? 1 : 3));
+		FUZZ_CHECK(reader.getFrames() == frames);
+		std::vector<BYTE> back(frames * frameBytes + 1);
+		size_t got = 0;
+		if (frames > 0) {
+			reader.getStream(back.data(), back.size(), got);
+		}
+		FUZZ_CHECK(got == frames * frameBytes);
+		FUZZ_CHECK(got == 0 || ::memcmp(back.data(), payload, got) == 0);
+		FUZZ_CHECK(reader.tellFrame() == frames);
+	}
+	if (!aiff) {
+		WavRecovery recovery;
+		WavRecoveryResult result;
+		FUZZ_CHECK(recovery.repair(path, result, false));
+		FUZZ_CHECK(!result.damaged && result.frames == frames);
+	}
+	::remove(path);
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	ファザーの入口
+ * @param[in]	data	入力のバイト列
+ * @param[in]	size	入力のサイズ
+ * @return	常に0
+ */
+// ----------------------------------------------------------------------------
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	if (size > 0 && (data[0] & 1) != 0) {
+		checkRoundTrip(data, size);
+	} else {
+		checkParse(data, size);
+	}
+	return 0;
+}
+
+#if defined(WAVE11_FUZZ_MAIN)
+
+namespace {
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	fmtとdataの前に空のチャンクを並べたファイルの解析時間を計る
+ * @param[in]	chunks	空のチャンク数
+ * @return	解析時間（秒）
+ */
+// ----------------------------------------------------------------------------
+double timeChunks(size_t chunks)
+{
+	std::vector<BYTE> file;
+	const BYTE head[] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E' };
+	file.insert(file.end(), head, head + sizeof(head));
+	const BYTE junk[] = { 'j', 'u', 'n', 'k', 0, 0, 0, 0 };
+	for (size_t i = 0; i < chunks; i++) {
+		file.insert(file.end(), junk, junk + sizeof(junk));
+	}
+	const BYTE tail[] = {
+		'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0x44, 0xAC, 0, 0, 0x88, 0x58, 1, 0, 2, 0, 16, 0,
+		'd', 'a', 't', 'a', 2, 0, 0, 0, 0, 0
+	};
+	file.insert(file.end(), tail, tail + sizeof(tail));
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const ParseResult r = parse(file.data(), file.size(), RiffWavParser::DefaultWindow, false);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	FUZZ_CHECK(r.status == RiffWavParser::PARSE_DONE && r.info.dataLength == 2);
+	return elapsed.count();
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief	引数のファイルを入力として与える。引数がなければ解析時間の線形性を検査する。
+ * @return	検査に成功すれば0
+ */
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			std::vector<uint8_t> buf;
+			FILE* fp = ::fopen(argv[i], "rb");
+			if (fp == nullptr) {
+				::fprintf(stderr, "%s: cannot open\n", argv[i]);
+				return 1;
+			}
+			uint8_t tmp[4096];
+			size_t n;
+			while ((n = ::fread(tmp, 1, sizeof(tmp), fp)) > 0) {
+				buf.insert(buf.end(), tmp, tmp + n);
+			}
+			::fclose(fp);
+			LLVMFuzzerTestOneInput(buf.data(), buf.size());
+		}
+		return 0;
+	}
+
+	// チャンク数を4倍にしたときの解析時間が4倍程度に収まること
+	const size_t small = 1 << 16;
+	double t1 = timeChunks(small);
+	double t4 = timeChunks(small * 4);
+	for (int retry = 0; retry < 3 && t4 > t1 * 8; retry++) {
+		t1 = timeChunks(small);
+		t4 = timeChunks(small * 4);
+	}
+	::printf("%u chunks: %.6f s, %u chunks: %.6f s\n",
+		static_cast<unsigned>(small), t1, static_cast<unsigned>(small * 4), t4);
+	if (t4 > t1 * 8 + 0.001) {
+		::fprintf(stderr, "header parsing is not linear in chunk count\n");
+		return 1;
+	}
+	return 0;
+}
+
+#endif // WAVE11_FUZZ_MAIN
+
+#endif // WAVE11_FUZZ
@@ -75,5 +75,13 @@ public:
 	virtual ~WavIoException(void) {}
 };
 
+/**
+ * @brief	WavIoExceptionを送出しうる関数の印
+ *
+ * 動的例外仕様はC++11で非推奨、C++17で廃止されたため、どの規格でも何も指定せずに
+ * 展開する。送出しうる例外を宣言に書き残すためだけに使う。
+ */
+#define WAVE11_THROWS(e)
+
 
 #endif // !_WAVIOTYPE_H_
@@ -0,0 +1,214 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavRecovery.cpp
+ * @brief	書き出し途中で終了したRIFF-WAVのヘッダー修復クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include <cstring>
+#include "WavRecovery.h"
+#include "PositionalFile.h"
+
+namespace {
+
+//! 書き換え対象のサイズ欄
+struct SizeField {
+	//! ファイル上のバイト位置
+	uint64_t offset;
+	//! 欄のバイト数（4または8）
+	size_t width;
+	//! 正しい値
+	uint64_t value;
+};
+
+inline uint64_t getN(const BYTE* b, size_t width, bool be) {
+	uint64_t v = 0;
+	for (size_t i = 0; i < width; i++) {
+		v = (v << 8) | b[be ? i : width - 1 - i];
+	}
+	return v;
+}
+
+inline void putN(BYTE* b, size_t width, uint64_t v, bool be) {
+	for (size_t i = 0; i < width; i++) {
+		b[be ? width - 1 - i : i] = static_cast<BYTE>(v >> (i * 8));
+	}
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// ファイルのヘッダーを検査し、必要なら修復します。
+/**
+ * 復旧モードのRiffWavParserでヘッダーを解析し、RIFFチャンクとdataチャンクの
+ * サイズ欄を正しい値と比較します。異なる欄だけを位置指定で書き換えます。
+ * dataチャンクがファイル終端まで続く場合のRIFFチャンクのサイズは、
+ * 端数のフレームを除いたdataチャンクの終端までとします。
+ *
+ * @param[in]	path	対象ファイルのパス
+ * @param[out]	result	検査・修復の結果
+ * @param[in]	write	偽なら検査のみでファイルは変更しない
+ * return	解析でき、修復が必要なら書き換えに成功した場合に真
+ */
+// ----------------------------------------------------------------------------
+bool WavRecovery::repair(const tstring& path, WavRecoveryResult& result, bool write)
+{
+	::memset(&result, 0, sizeof(result));
+
+	PositionalFile file;
+	if (!(write ? file.openWrite(path, false) : file.openRead(path))) {
+		return false;
+	}
+	const int64_t fileEnd = file.size();
+	if (fileEnd <= 0) {
+		return false;
+	}
+	const uint64_t fileSize = static_cast<uint64_t>(fileEnd);
+
+	// ヘッダーの解析
+	RiffWavParser parser;
+	parser.reset(fileSize);
+	parser.setRecovery(true);
+	BYTE window[RiffWavParser::DefaultWindow];
+	uint64_t base = 0;
+	try {
+		while (1) {
+			size_t size = file.readAt(window, sizeof(window), base);
+			RiffWavParser::Status status = parser.feed(window, size, base);
+			if (status == RiffWavParser::PARSE_DONE) {
+				break;
+			}
+			if (status == RiffWavParser::PARSE_INVALID
+				|| parser.nextOffset() <= base || parser.nextOffset() >= fileSize) {
+				return false;
+			}
+			base = parser.nextOffset();
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+
+	const RiffWavInfo& info = parser.info();
+	if (info.container == CONTAINER_AIFF || info.container == CONTAINER_AIFC) {
+		// AIFFはCOMMのフレーム数も書き換える必要があり、対象外
+		return false;
+	}
+	result.valid = true;
+	result.container = info.container;
+	result.dataOffset = info.dataOffset;
+	result.dataLength = info.dataLength;
+	result.frames = info.dataLength / info.format.nBlockAlign;
+
+	// 正しいサイズ欄の値
+	const bool w64 = (info.container == CONTAINER_W64);
+	const bool be = (info.container == CONTAINER_RIFX);
+	const uint64_t dataEnd = info.dataOffset + info.dataLength;
+	SizeField fields[2];
+	if (w64) {
+		const uint64_t riffEnd = (dataEnd + 7) & ~static_cast<uint64_t>(7);
+		fields[0].offset = 16;
+		fields[0].width = 8;
+		fields[0].value = (riffEnd <= fileSize) ? riffEnd : dataEnd;
+		fields[1].offset = info.dataOffset - 8;
+		fields[1].width = 8;
+		fields[1].value = info.dataLength + 24;
+	} else {
+		const uint64_t riffEnd = dataEnd + (info.dataLength & 1);
+		if (info.dataLength > 0xFFFFFFFFULL || riffEnd - 8 > 0xFFFFFFFFULL) {
+			// 4GBを越えるRIFF-WAVはサイズ欄で表せない
+			return false;
+		}
+		fields[0].offset = 4;
+		fields[0].width = 4;
+		fields[0].value = ((riffEnd <= fileSize) ? riffEnd : dataEnd) - 8;
+		fields[1].offset = info.dataOffset - 4;
+		fields[1].width = 4;
+		fields[1].value = info.dataLength;
+	}
+
+	try {
+		for (size_t i = 0; i < 2; i++) {
+			const SizeField& f = fields[i];
+			BYTE cur[8];
+			if (file.readAt(cur, f.width, f.offset) != f.width) {
+				return false;
+			}
+			const uint64_t recorded = getN(cur, f.width, be);
+			// dataチャンクの後に別のチャンクがある正常なファイルのRIFFサイズは変更しない
+			if (i == 0 && !info.inferred && recorded >= f.value
+				&& recorded <= fileSize - (w64 ? 0 : 8)) {
+				continue;
+			}
+			if (recorded == f.value) {
+				continue;
+			}
+			result.damaged = true;
+			if (!write) {
+				continue;
+			}
+			BYTE buf[8];
+			putN(buf, f.width, f.value, be);
+			if (file.writeAt(buf, f.width, f.offset) != f.width) {
+				return false;
+			}
+			result.repaired = true;
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 複数ファイルのヘッダーを検査し、必要なら修復します。
+/**
+ * ファイルごとに独立しているため、スレッドプールがあれば並列に処理します。
+ *
+ * @param[in]	paths	対象ファイルのパス
+ * @param[out]	results	ファイルごとの結果。pathsと同じ要素数になる。
+ * @param[in]	write	偽なら検査のみでファイルは変更しない
+ * return	repairが成功したファイル数
+ */
+// ----------------------------------------------------------------------------
+size_t WavRecovery::repairAll(const std::vector<tstring>& paths, std::vector<WavRecoveryResult>& results, bool write)
+{
+	results.assign(paths.size(), WavRecoveryResult());
+	std::vector<char> ok(paths.size(), 0);
+	auto task = [&](size_t i) {
+		ok[i] = repair(paths[i], results[i], write) ? 1 : 0;
+	};
+	if (pool_ != nullptr) {
+		pool_->parallelFor(paths.size(), task);
+	} else {
+		for (size_t i = 0; i < paths.size(); i++) {
+			task(i);
+		}
+	}
+
+	size_t count = 0;
+	for (size_t i = 0; i < ok.size(); i++) {
+		count += ok[i];
+	}
+	return count;
+}
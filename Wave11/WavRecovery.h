@@ -0,0 +1,93 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavRecovery.h
+ * @brief	書き出し途中で終了したRIFF-WAVのヘッダー修復クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _WAVRECOVERY_H_
+#define _WAVRECOVERY_H_
+
+#include <vector>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "ThreadPool.h"
+#include "RiffWavParser.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief ヘッダー修復の結果
+ */
+// ----------------------------------------------------------------------------
+struct WavRecoveryResult {
+	//! ヘッダーを解析できたなら真
+	bool valid;
+	//! ヘッダーのサイズがファイルと食い違っていたなら真
+	bool damaged;
+	//! ヘッダーを書き換えたなら真
+	bool repaired;
+	//! コンテナ形式
+	WavContainer container;
+	//! 修復後のdataチャンクのペイロードのバイト位置
+	uint64_t dataOffset;
+	//! 修復後のdataチャンクのペイロードのバイトサイズ
+	uint64_t dataLength;
+	//! 修復後のフレーム数
+	uint64_t frames;
+};
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 書き出し途中で終了したRIFF-WAV/RIFX/Wave64のヘッダー修復クラス
+ *
+ * RiffWavWriter::riffFinalizeを呼ぶ前にプロセスが終了したファイルや、
+ * 途中で切れたファイルのRIFF/dataチャンクのサイズを、ファイルサイズと
+ * フレーム境界から求め直す。書き換えるのはサイズ欄の数バイトだけで、
+ * サンプルデータは読みも書きもしないため、ファイルの大きさによらず短時間で終わる。
+ * 端数のフレームはファイルに残り、dataチャンクのサイズから除外する。
+ * AIFF・AIFF-Cは対象外で、repairは偽を返す。
+ */
+// ----------------------------------------------------------------------------
+class WavRecovery : private Noncopyable
+{
+public:
+	/**
+	 * @brief	コンストラクタ
+	 * @param[in]	pool	repairAllで使うスレッドプール。nullptrなら逐次処理。
+	 */
+	explicit WavRecovery(ThreadPool* pool = nullptr) : pool_(pool) {}
+	virtual ~WavRecovery() {}
+
+	//! ファイルのヘッダーを検査し、必要なら修復します。
+	bool repair(const tstring&, WavRecoveryResult&, bool = true);
+	//! 複数ファイルのヘッダーを検査し、必要なら修復します。
+	size_t repairAll(const std::vector<tstring>&, std::vector<WavRecoveryResult>&, bool = true);
+
+private:
+	//! repairAllで使うスレッドプール
+	ThreadPool* pool_;
+};
+
+#endif // !_WAVRECOVERY_H_
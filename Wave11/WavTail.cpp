@@ -0,0 +1,172 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavTail.cpp
+ * @brief	追記中のRIFF-WAVを追いかけて読み込むクラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "WavTail.h"
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#define WAVTAIL_USE_INOTIFY
+#endif
+
+// ----------------------------------------------------------------------------
+WavTail::WavTail()
+: reader_(),
+  pollMs_(DefaultPollMs),
+  notify_(-1)
+{
+}
+// ----------------------------------------------------------------------------
+// ファイルを開いてヘッダーを解析します。
+/**
+ * 書き出し側がまだヘッダーを書き出していない場合は失敗するため、
+ * 呼び出し側で再試行してください。
+ *
+ * @param[in]	path	ファイルのパス
+ * return	ヘッダーを解析できれば真
+ */
+// ----------------------------------------------------------------------------
+bool WavTail::open(const tstring& path)
+{
+	close();
+	reader_.setFollow(true);
+	if (!reader_.open(path) || !reader_.prepare()) {
+		reader_.close();
+		return false;
+	}
+#if defined(WAVTAIL_USE_INOTIFY)
+	notify_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notify_ >= 0 && ::inotify_add_watch(notify_, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+		::close(notify_);
+		notify_ = -1;
+	}
+#endif
+	return true;
+}
+// ----------------------------------------------------------------------------
+void WavTail::close()
+{
+#if defined(WAVTAIL_USE_INOTIFY)
+	if (notify_ >= 0) {
+		::close(notify_);
+	}
+#endif
+	notify_ = -1;
+	reader_.close();
+}
+// ----------------------------------------------------------------------------
+// 読み込み位置から読み込めるフレーム数を取得します。
+/**
+ * ファイルサイズを問い合わせ、追記された分を読み込み可能な範囲に加えます。
+ *
+ * return	読み込み位置から読み込めるフレーム数
+ */
+// ----------------------------------------------------------------------------
+uint64_t WavTail::available()
+{
+	const uint64_t frames = reader_.refresh();
+	const uint64_t pos = reader_.tellFrame();
+	return (frames > pos) ? frames - pos : 0;
+}
+// ----------------------------------------------------------------------------
+// 指定フレーム数が読み込めるようになるまで待ちます。
+/**
+ * @param[in]	frames		必要なフレーム数
+ * @param[in]	timeoutMs	待ち時間の上限（ミリ秒）。0なら待たずに判定のみ行う。
+ * return	指定フレーム数が読み込めるなら真。時間切れなら偽。
+ */
+// ----------------------------------------------------------------------------
+bool WavTail::wait(uint64_t frames, int timeoutMs)
+{
+	const std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (available() < frames) {
+		const int64_t rest = std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		if (rest <= 0) {
+			return false;
+		}
+		waitChange((rest < pollMs_) ? static_cast<int>(rest) : pollMs_);
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+// 追記されたフレームを読み込みます。
+/**
+ * 読み込めるフレームがなければ最大timeoutMsミリ秒待ち、読み込めるだけ読み込みます。
+ *
+ * @param[out]	buf			読み込み先。frames * ブロックアラインのバイト数が必要。
+ * @param[in]	frames		読み込む最大のフレーム数
+ * @param[in]	timeoutMs	待ち時間の上限（ミリ秒）
+ * return	読み込んだフレーム数
+ */
+// ----------------------------------------------------------------------------
+size_t WavTail::read(void* buf, size_t frames, int timeoutMs)
+{
+	if (buf == nullptr || frames == 0 || !wait(1, timeoutMs)) {
+		return 0;
+	}
+	const uint64_t avail = available();
+	const size_t n = (avail < frames) ? static_cast<size_t>(avail) : frames;
+	size_t got = 0;
+	if (reader_.getSamples(buf, n, got) < 0) {
+		return 0;
+	}
+	return got;
+}
+// ----------------------------------------------------------------------------
+// ファイルの更新を待ちます。
+/**
+ * inotifyが使える場合は更新の通知まで、使えない場合は指定時間だけ待ちます。
+ *
+ * @param[in]	ms	待ち時間の上限（ミリ秒）
+ */
+// ----------------------------------------------------------------------------
+void WavTail::waitChange(int ms)
+{
+#if defined(WAVTAIL_USE_INOTIFY)
+	if (notify_ >= 0) {
+		struct pollfd pfd;
+		pfd.fd = notify_;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (::poll(&pfd, 1, ms) > 0) {
+			// 通知はサイズの問い合わせの契機にするだけなので読み捨てる
+			char events[4096];
+			while (::read(notify_, events, sizeof(events)) > 0) {
+			}
+		}
+		return;
+	}
+#endif
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
@@ -0,0 +1,91 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavTail.h
+ * @brief	追記中のRIFF-WAVを追いかけて読み込むクラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _WAVTAIL_H_
+#define _WAVTAIL_H_
+
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "RiffWavReader.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief 追記中のRIFF-WAVを追いかけて読み込むクラス
+ *
+ * 追従モードのRiffWavReaderで読み込み、データが足りなければファイルの更新を待つ。
+ * Linuxではinotifyで更新を待ち、追記から短い遅延で読み込める。
+ * それ以外の環境や、通知が届かないネットワークファイルシステムでは
+ * 一定間隔でファイルサイズを問い合わせる。
+ */
+// ----------------------------------------------------------------------------
+class WavTail : private Noncopyable
+{
+public:
+	//! 既定の問い合わせ間隔（ミリ秒）
+	static const int DefaultPollMs = 20;
+
+	WavTail();
+	/** デストラクタでファイルは自動クローズする */
+	virtual ~WavTail() { close(); }
+
+	//! ファイルを開いてヘッダーを解析します。
+	bool open(const tstring&);
+	//! ファイルのクローズ
+	void close();
+	/**
+	 * @brief	問い合わせ間隔を設定する
+	 * @param[in]	ms	通知がない場合にファイルサイズを問い合わせる間隔（ミリ秒）
+	 */
+	void setPollInterval(int ms) { pollMs_ = (ms <= 0) ? DefaultPollMs : ms; }
+	/**
+	 * @brief	読み込みに使うRiffWavReaderを取得する
+	 * @return	追従モードでprepare済みのRiffWavReader
+	 */
+	RiffWavReader& reader() { return reader_; }
+
+	//! 読み込み位置から読み込めるフレーム数を取得します。
+	uint64_t available();
+	//! 指定フレーム数が読み込めるようになるまで待ちます。
+	bool wait(uint64_t, int);
+	//! 追記されたフレームを読み込みます。
+	size_t read(void*, size_t, int);
+
+private:
+	//! 読み込みに使うRiffWavReader
+	RiffWavReader reader_;
+	//! 問い合わせ間隔（ミリ秒）
+	int pollMs_;
+	//! inotifyの記述子。使えなければ-1。
+	int notify_;
+
+	//! ファイルの更新を待ちます。
+	void waitChange(int);
+};
+
+#endif // !_WAVTAIL_H_
@@ -0,0 +1,187 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavTranscoder.cpp
+ * @brief	RIFF-WAVの並列形式変換クラスの実装
+ */
+// ----------------------------------------------------------------------------
+#include "WavTranscoder.h"
+#include <atomic>
+#include "RiffWavReader.h"
+#include "RiffWavWriter.h"
+#include "PositionalFile.h"
+#include "SampleConverter.h"
+#include "BufferPool.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @param[in]	qbit	出力の量子化ビット数
+ * @param[in]	fmt		出力がWAVE_FORMAT_PCMなら真、WAVE_FORMAT_IEEE_FLOATなら偽
+ * @param[in]	fs		出力のサンプリングレート。0なら入力と同じ。
+ * @param[in]	pool	チャンク処理に使うスレッドプール。nullptrなら逐次処理。
+ */
+// ----------------------------------------------------------------------------
+WavTranscoder::WavTranscoder(WORD qbit, bool fmt, DWORD fs, ThreadPool* pool)
+: qbit_(qbit),
+  fmt_(fmt),
+  fs_(fs),
+  pool_(pool),
+  chunkFrames_(DefaultChunkFrames)
+{
+}
+// ----------------------------------------------------------------------------
+// ファイルを変換します。
+/**
+ * 出力ファイルはヘッダーを書き出した後、data領域全体を事前確保してから
+ * チャンクごとに書き出し、最後にRIFF-WAVヘッダーのサイズを確定します。
+ * 入力のdata領域が宣言された長さに満たない場合は失敗とします。
+ *
+ * @param[in]	src	入力ファイルのパス
+ * @param[in]	dst	出力ファイルのパス
+ * return	正常終了で真
+ */
+// ----------------------------------------------------------------------------
+bool WavTranscoder::transcode(const tstring& src, const tstring& dst)
+{
+	// 入力ヘッダーの解析
+	RiffWavReader reader;
+	if (!reader.open(src) || !reader.prepare()) {
+		return false;
+	}
+	const WORD ch = reader.getChannels();
+	const WORD inBits = reader.getBitPerSample();
+	const bool inPcm = (reader.getFormatTag() == 1);
+	const DWORD inFs = reader.getSamplesPerSec();
+	const size_t inBlock = reader.getBlockAlign();
+	const uint64_t inOffset = static_cast<uint64_t>(reader.getStreamOffset());
+	const uint64_t inFrames = reader.getLength() / inBlock;
+	// AIFFは浮動小数点型を表せないため、浮動小数点型への変換はAIFF-Cで書き出す
+	const WavContainer container = (reader.getContainer() == CONTAINER_AIFF && !fmt_)
+		? CONTAINER_AIFC : reader.getContainer();
+	reader.close();
+
+	const DWORD outFs = (fs_ == 0) ? inFs : fs_;
+	const size_t outBlock = static_cast<size_t>(qbit_ / 8) * ch;
+	if (!SampleConverter::isSupported(inBits, inPcm) || !SampleConverter::isSupported(qbit_, fmt_)) {
+		return false;
+	}
+	const bool copy = (inBits == qbit_ && inPcm == fmt_ && inFs == outFs);
+
+	std::unique_ptr<SincResampler> resampler;
+	uint64_t outFrames = inFrames;
+	if (inFs != outFs) {
+		resampler.reset(new SincResampler(inFs, outFs));
+		outFrames = resampler->outputFrames(inFrames);
+	}
+
+	// 出力ヘッダーの書き出しとdata領域の事前確保
+	RiffWavWriter writer(qbit_, ch, outFs, fmt_);
+	writer.setContainer(container);
+	writer.setSowt(!reader.isBigEndian());
+	if (!writer.open(dst) || !writer.prepare() || !writer.flush()) {
+		return false;
+	}
+	const int64_t outOffset = writer.tell();
+
+	PositionalFile in;
+	PositionalFile out;
+	if (outOffset < 0 || !in.openRead(src) || !out.openWrite(dst)) {
+		return false;
+	}
+	if (!out.allocate(static_cast<uint64_t>(outOffset) + outFrames * outBlock)) {
+		return false;
+	}
+
+	const size_t chunkFrames = chunkFrames_;
+	const size_t chunks = static_cast<size_t>((outFrames + chunkFrames - 1) / chunkFrames);
+	std::atomic<bool> failed(false);
+
+	auto job = [&](size_t index) {
+		const uint64_t outStart = static_cast<uint64_t>(index) * chunkFrames;
+		const size_t outCount = static_cast<size_t>(
+			(outFrames - outStart < chunkFrames) ? outFrames - outStart : chunkFrames);
+
+		uint64_t inStart = outStart;
+		size_t inCount = outCount;
+		if (resampler) {
+			resampler->inputRange(outStart, outCount, inFrames, inStart, inCount);
+		}
+
+		PooledBuffer raw(inCount * inBlock);
+		const size_t rawBytes = inCount * inBlock;
+		// 読み込み範囲は宣言されたデータ長に収まるため、不足はファイルの欠損とみなす
+		if (in.readAt(raw.data(), rawBytes, inOffset + inStart * inBlock) != rawBytes) {
+			failed = true;
+			return;
+		}
+
+		const uint64_t dstPos = static_cast<uint64_t>(outOffset) + outStart * outBlock;
+		const size_t outBytes = outCount * outBlock;
+		// 複写ならファイル上の形式のまま書き出す
+		if (copy) {
+			if (out.writeAt(raw.data(), outBytes, dstPos) != outBytes) {
+				failed = true;
+			}
+			return;
+		}
+
+		// RIFX・AIFFのバイト順の反転は変換と同じ走査で行う
+		PooledBuffer samples(inCount * ch * sizeof(float));
+		reader.decodeFloat(raw.data(), samples.as<float>(), inCount * ch);
+		PooledBuffer resampled;
+		const float* result = samples.as<float>();
+		if (resampler) {
+			resampled.resize(outCount * ch * sizeof(float));
+			resampler->process(samples.as<float>(), inStart, inCount, inFrames, ch,
+				resampled.as<float>(), outStart, outCount);
+			result = resampled.as<float>();
+		}
+		PooledBuffer converted(outBytes);
+		SampleConverter::fromFloat(result, converted.data(), outCount * ch, qbit_, fmt_);
+		writer.encodeSamples(converted.data(), converted.data(), outCount * ch);
+		if (out.writeAt(converted.data(), outBytes, dstPos) != outBytes) {
+			failed = true;
+		}
+	};
+
+	try {
+		if (pool_ != nullptr && chunks > 1) {
+			pool_->parallelFor(chunks, job);
+		} else {
+			for (size_t i = 0; i < chunks; i++) {
+				job(i);
+			}
+		}
+	} catch (const WavIoException&) {
+		return false;
+	}
+	in.close();
+	out.close();
+
+	if (failed) {
+		return false;
+	}
+	return writer.riffFinalize();
+}
@@ -0,0 +1,86 @@
+/**
+* Copyright (c) 2012-2016 Sakura-Zen soft All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+* THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// ----------------------------------------------------------------------------
+/**
+ * @file	WavTranscoder.h
+ * @brief	RIFF-WAVの並列形式変換クラスのヘッダー
+ */
+// ----------------------------------------------------------------------------
+#ifndef _WAVTRANSCODER_H_
+#define _WAVTRANSCODER_H_
+
+#include <memory>
+#include "WavIoType.h"
+#include "Noncopyable.h"
+#include "ThreadPool.h"
+#include "SincResampler.h"
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief RIFF-WAVの量子化ビット数・形式・サンプリングレートの変換クラス
+ *
+ * 出力のdata領域をフレーム境界で固定長のチャンクに分割し、チャンクごとに
+ * 必要な入力区間を位置指定で読み込み、変換して、事前確保した出力ファイルの
+ * 対応する位置へ位置指定で書き出す。チャンク間に依存がないため、
+ * スレッドプールを与えるとコア数に応じて並列に処理する。
+ *
+ * 変換結果はスレッド数やチャンク長によらず、逐次処理とビット単位で一致する。
+ * 入力と出力の形式・レートが同じ場合はバイト列をそのまま複写する。
+ * 出力のコンテナ形式（RIFF-WAV/Wave64/RIFX/AIFF/AIFF-C）は入力に合わせる。
+ * ただしAIFFから浮動小数点型への変換はAIFF-Cで書き出す。
+ */
+// ----------------------------------------------------------------------------
+class WavTranscoder : private Noncopyable
+{
+public:
+	//! 既定のチャンク長（フレーム数）
+	static const size_t DefaultChunkFrames = 65536;
+
+	WavTranscoder(WORD, bool = true, DWORD = 0, ThreadPool* = nullptr);
+	virtual ~WavTranscoder() {}
+
+	/**
+	 * @brief	チャンク長を設定する
+	 * @param[in]	frames	1チャンクあたりの出力フレーム数
+	 */
+	void setChunkFrames(size_t frames) { chunkFrames_ = (frames == 0) ? DefaultChunkFrames : frames; }
+	//! ファイルを変換します。
+	bool transcode(const tstring&, const tstring&);
+
+private:
+	//! 出力の量子化ビット数
+	const WORD qbit_;
+	//! 出力の量子化フォーマット（真が整数型PCM）
+	const bool fmt_;
+	//! 出力のサンプリングレート。0なら入力と同じ。
+	const DWORD fs_;
+	//! チャンク処理に使うスレッドプール
+	ThreadPool* pool_;
+	//! 1チャンクあたりの出力フレーム数
+	size_t chunkFrames_;
+
+	WavTranscoder();
+};
+
+#endif // !_WAVTRANSCODER_H_
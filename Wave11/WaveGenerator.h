@@ -118,7 +118,7 @@ public:
 	 * @brief	正弦波のサンプル生成（16bit）
 	 * @return	生成サンプル
 	 */
-	short SinSample16() { return static_cast<short>(SinSample16() * 32767); }
+	short SinSample16() { return static_cast<short>(SinSample() * 32767); }
 	/**
 	 * @brief	ホワイトノイズのサンプル生成（16bit）
 	 * @return	生成サンプル
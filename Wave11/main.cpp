@@ -2,49 +2,46 @@
 #include "RiffWavWriter.h"
 #include "RiffWavReader.h"
 #include "WaveGenerator.h"
+#include "BufferPool.h"
 
 using namespace std;
 
 int main(int argc, char** argv)
 {
 	const int SamplesCount = 44100;
-	short buffer[SamplesCount];
-
-	RiffWavReader* rr = new RiffWavReader();
-	if (rr->open(_T("sawsample.wav"))) {
-		if (rr->prepare()) {
-			cout << rr->getChannels() << endl;
-			cout << rr->getSamplesPerSec() << endl;
+	PooledBuffer buffer(SamplesCount * sizeof(float));
+	float* samples = buffer.as<float>();
+
+	RiffWavReader rr;
+	if (rr.open(_T("sawsample.wav"))) {
+		if (rr.prepare()) {
+			cout << rr.getChannels() << endl;
+			cout << rr.getSamplesPerSec() << endl;
 		}
 	}
 
-	RiffWavWriter* rw = new RiffWavWriter(16, 1, 44100);
+	RiffWavWriter rw(16, 1, 44100);
+	rw.setDither(DITHER_TPDF);
 
-	WaveGenerator* wg = new WaveGenerator(440, 44100);
+	WaveGenerator wg(440, 44100);
 	for (int i = 0;i < SamplesCount; i++) {
-		buffer[i] = wg->SawSample16();
+		samples[i] = wg.SawSample();
 	}
 
-	if (rw->open(_T("sample.wav"))) {
-		if (rw->prepare()) {
-			const size_t length = sizeof(buffer);
-
+	if (rw.open(_T("sample.wav"))) {
+		if (rw.prepare()) {
 			for (int i = 0; i < 3; i++) {
-				size_t result = rw->writeBytes(buffer, length);
-				if (result < length) {
+				size_t result = rw.writeFloat(samples, SamplesCount);
+				if (result < SamplesCount) {
 					cout << "write error" << endl;
 				}
 			}
 
-			if (!rw->riffFinalize()) {
+			if (!rw.riffFinalize()) {
 				cout << "write error" << endl;
 			}
 		}
 	}
 
-	delete wg;
-	delete rr;
-	delete rw;
-
 	return 0;
 }